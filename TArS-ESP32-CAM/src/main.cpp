@@ -5,29 +5,88 @@
 #include <WiFi.h>
 #include <HTTPClient.h>
 
+// library for the LAN trigger from ESP32-S3 over UDP
+#include <WiFiUdp.h>
+
+// library for keeping HTTP connections to the server alive between requests (TArS-common)
+#include <ConnectionManager.h>
+
+// library for the messages exchanged with ESP32-S3 (TArS-common)
+#include <TArSProtocol.h>
+
+// library for reading the fields of the server replies straight from the HTTP stream (TArS-common)
+#include <JsonScanner.h>
+
+// library for the latency histograms and counters served on the metrics endpoint (TArS-common)
+#include <Metrics.h>
+
+// library for classifying the image on the board itself, int8 model with a static tensor arena (TArS-common)
+#include <EdgeClassifier.h>
+
+// library for the motion trigger, finds an item at rest in the chute in grayscale frames (TArS-common)
+#include <MotionDetector.h>
+
+// library for keeping the images on the MicroSD card in one preallocated file with an index (TArS-common)
+#include <ImageStore.h>
+
+// library for connecting to Wi-Fi with the access point and lease of the last connection, no scan and no DHCP (TArS-common)
+#include <WiFiLink.h>
+
+// library for the image buffers allocated once at boot, an image is copied in at capture and uploaded from there (TArS-common)
+#include <FramePool.h>
+
+// library for the lock-free queues the images and upload results are handed between loop() and the upload task on (TArS-common)
+#include <RingBuffer.h>
+
 // library for the file system with microSD card
 #include <FS.h>
 #include <SD_MMC.h>
 
 // library for camera configuration
 #include "esp_camera.h"
+#include "img_converters.h"
 #include "driver/rtc_io.h"
 
 // library to disable brownour problems
 #include "soc/soc.h" 
 #include "soc/rtc_cntl_reg.h"
 
-// library for emulating EEPROM functionality in ESP32-CAM
-#include "EEPROM.h"
+// library for FreeRTOS task, semaphore, queue and event group, uploading and saving images and blinking the LED in the background,
+// starting camera and MicroSD card in parallel at boot
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
 
 /* Network and Wi-Fi related Config
 - Include wifi_credentials.h file for Wi-Fi credentials
 - Include serverCredentials.h file for server credentials
 - Define pin for Wi-Fi connection indicator (INDICATOR_PIN)
 - Creating object instance of HTTPClient: clientESP32CAM
-- Setting up flag as boolean variable to control HTTP request
-    - doHTTPPOSTimage: flag to control HTTP POST request to send image to server
-    - Is set to false so the image is not taken before an event occurs
+- Creating object instance of ConnectionManager: connectionManager (status poll, loop()) and uploadConnection
+  (uploads, taskUploadWorker())
+    - Every request goes through one of them, the socket to the server is kept open between requests
+    - One each, so the status poll never waits for an upload on the other core
+- Creating object instance of WiFiLink: wifiLink
+    - Connects and reconnects on the events of the Wi-Fi driver, straight to the access point of the last connection
+      with its IP lease, see WiFiLink.h
+- Initialize imageSlot, slot of imagePool holding the image just captured, -1 if none
+    - Classified by loop() and then handed to taskUploadWorker() to send it to server, see the image pool config
+- Initialize scanID variable (string) to store the scan ID of the current trigger
+    - Set by ESP32-S3 together with the trigger, sent back to the server with the image
+    - Lets ESP32-S3 fetch the result of exactly this image
+- Initialize host and path of predictURL, parsed once in taskParsePredictURL()
+    - The image is streamed from the camera frame buffer straight to the socket, the request is written by hand
+- Initialize uploadRequest, the request line, headers and form fields of an upload, see TArSProtocol.h
+    - Only used by taskUploadWorker()
+- Define UPLOAD_RESPONSE_TIMEOUT_MS, time to wait for the server reply after the upload
+- Initialize lastReconnectLog to print the reconnect message every 3 seconds while offline
+- Initialize lastStatsLog to print the connection counters and the capture profile every minute
+- Creating object instance of WiFiUDP: triggerUDP, listening on LOCAL_TRIGGER_PORT for the LAN trigger
+- Define STATUS_POLL_MS and STATUS_POLL_FALLBACK_MS, interval of the cloud status poll
+    - STATUS_POLL_FALLBACK_MS once the LAN trigger works (localTriggerSeen), the poll is then only a fallback
+- Initialize lastStatusPoll, millis() value of the last cloud status poll
+- Initialize lastCapturedScanID, so a trigger arriving both over the LAN and from the cloud is captured once
 */
 #include "wifi_credentials.h"
 #include "serverCredentials.h"
@@ -36,20 +95,82 @@
 
 HTTPClient clientESP32CAM;
 
-bool doHTTPPOSTimage = false;
+ConnectionManager connectionManager;
+ConnectionManager uploadConnection;
+
+WiFiLink wifiLink;
+
+int imageSlot = -1;
+
+String scanID = "";
+
+String predictHost = "";
+String predictPath = "/";
+char uploadRequest[TARS_UPLOAD_HEAD_MAX + TARS_UPLOAD_FORM_MAX];
+
+#define UPLOAD_RESPONSE_TIMEOUT_MS 10000
+
+unsigned long lastReconnectLog = 0;
+unsigned long lastStatsLog = 0;
+
+WiFiUDP triggerUDP;
+
+#define STATUS_POLL_MS 2000
+#define STATUS_POLL_FALLBACK_MS 15000
+
+unsigned long lastStatusPoll = 0;
+bool localTriggerSeen = false;
+String lastCapturedScanID = "";
+
+/* Status LED config
+- INDICATOR_PIN is driven by taskLEDWorker() only, a FreeRTOS task, so blinking never holds up loop()
+    - The LED is active low: LOW turns it on
+- LED_PATTERNS: the named blink patterns, a blink is off, on, off for stepMs each
+    - LED_PATTERN_IDLE: no blink, only shows ledIdleOn (on while Wi-Fi is connected)
+    - LED_PATTERN_TRIGGER: 2 blinks, trigger picked up from the cloud status
+    - LED_PATTERN_UPLOADED: 2 blinks, image accepted by the server (HTTP 201)
+    - LED_PATTERN_BAD_REQUEST: 4 blinks, image refused by the server (HTTP 400)
+    - LED_PATTERN_SERVER_ERROR: 5 blinks, HTTP 500 on status or upload
+- Define LED_QUEUE_LENGTH, patterns waiting in ledPatterns to be played in order
+    - A pattern arriving while the queue is full is dropped and counted in metrics as led_patterns_dropped
+- Initialize ledIdleOn, state of the LED between patterns, set by taskSetIndicator()
+*/
+struct LEDPattern {
+    const char *name;
+    int blinks;
+    int stepMs;
+};
+
+#define LED_PATTERN_IDLE 0
+#define LED_PATTERN_TRIGGER 1
+#define LED_PATTERN_UPLOADED 2
+#define LED_PATTERN_BAD_REQUEST 3
+#define LED_PATTERN_SERVER_ERROR 4
+
+const LEDPattern LED_PATTERNS[] = {
+    {"idle", 0, 0},
+    {"trigger", 2, 1000},
+    {"uploaded", 2, 1000},
+    {"bad request", 4, 1000},
+    {"server error", 5, 1000},
+};
+
+#define LED_QUEUE_LENGTH 4
+
+QueueHandle_t ledPatterns = NULL;
+volatile bool ledIdleOn = false;
 
 /* Camera config
-- Define EEPROM_SIZE to record the number of images taken
+- Define SAVE_IMAGE_TO_SD to keep a copy of each image in imageStore on the SD card
+    - Optional, the upload does not depend on it, images that could not be uploaded are kept in any case
+    - Written by taskUploadWorker() from imagePool once the image is uploaded, loop() goes on capturing meanwhile
 - Define GPIO pins for camera configuration
-- Initialize pictureCount variable as a unique ID for each image
-- Initialize imagePath variable (string) to store the path of each image taken
 - Initialize flags for camera configuration
     - initCamera: flag to check camera initialization status
     - captureImage: flag to check image capture status
-    - saveImage: flag to check whether image is saved to SD card or not
     - initMicroSD: flag to check SD card initialization status
 */
-#define EEPROM_SIZE 1
+#define SAVE_IMAGE_TO_SD true
 
 #define PWDN_GPIO_NUM     32
 #define RESET_GPIO_NUM    -1
@@ -69,25 +190,328 @@ bool doHTTPPOSTimage = false;
 #define HREF_GPIO_NUM     23
 #define PCLK_GPIO_NUM     22
 
-unsigned int pictureCount = 0;
-
-String imagePath = "NULL";
-
 bool initCamera = false;
 bool captureImage = false;
-bool saveImage = false;
 bool initMicroSD = false;
 
+/* Capture profile config
+- A capture profile sets what part of the sensor is read out, the output size and the JPEG quality range
+    - frameSize: frame size the camera driver is initialized with, sizes the frame buffers
+    - windowX, windowY, windowWidth, windowHeight: region of interest in UXGA sensor coordinates
+        - windowWidth 0 reads the whole frame at frameSize
+    - outputWidth, outputHeight: size the sensor DSP scales the region of interest down to
+    - qualityMin, qualityMax: JPEG quality range (lower is better), the start value is qualityMin
+    - needsPSRAM: profile only fits the frame buffers in PSRAM
+    - jpegMaxBytes: largest JPEG expected at qualityMin, size of a slot of imagePool
+- PROFILE_FULL: whole UXGA frame, the original setting
+- PROFILE_SVGA: whole SVGA frame, used if PROFILE_FULL is selected but no PSRAM is found
+- PROFILE_CHUTE: the chute only, scaled down to 240x240 on the sensor
+    - The classifier takes 224x224 input, the server only has to center crop, so nothing it uses is lost
+    - About 6 KB per image instead of about 190 KB
+- Define CAPTURE_PROFILE, index of the profile in CAPTURE_PROFILES
+- Define UPLOAD_TARGET_MS, upload time the JPEG quality is adapted to
+    - uploadKBps: upload throughput, moving average over the recent taskHTTPPOSTimage() calls
+    - Quality is lowered while the current image size would take longer than UPLOAD_TARGET_MS to upload
+    - Quality is raised again while it would take less than half of UPLOAD_TARGET_MS
+- Initialize captureProfile (profile in use) and jpegQuality (quality in use, 0 until the camera is first started)
+*/
+struct CaptureProfile {
+    const char *name;
+    framesize_t frameSize;
+    int windowX;
+    int windowY;
+    int windowWidth;
+    int windowHeight;
+    int outputWidth;
+    int outputHeight;
+    int qualityMin;
+    int qualityMax;
+    bool needsPSRAM;
+    size_t jpegMaxBytes;
+};
+
+#define PROFILE_FULL 0
+#define PROFILE_SVGA 1
+#define PROFILE_CHUTE 2
+
+const CaptureProfile CAPTURE_PROFILES[] = {
+    {"full", FRAMESIZE_UXGA, 0, 0, 0, 0, 1600, 1200, 10, 10, true, 393216},
+    {"svga", FRAMESIZE_SVGA, 0, 0, 0, 0, 800, 600, 12, 12, false, 131072},
+    {"chute", FRAMESIZE_240X240, 320, 120, 960, 960, 240, 240, 8, 20, false, 32768},
+};
+
+#define CAPTURE_PROFILE PROFILE_CHUTE
+#define UPLOAD_TARGET_MS 500
+
+int captureProfile = CAPTURE_PROFILE;
+int jpegQuality = 0;
+float uploadKBps = 0;
+
+/* Image pool config
+- The camera frame buffer is given back right after capture, the image is copied into a slot of imagePool first
+    - imagePool: IMAGE_POOL_SLOTS slots of jpegMaxBytes of the capture profile, allocated once by taskBootCamera(),
+      in PSRAM if the device has it, see FramePool.h
+    - IMAGE_POOL_SLOTS_NO_PSRAM slot only without PSRAM, it shares the internal RAM with the frame buffer
+    - The memory of the images is fixed at boot and printed, nothing is allocated per image
+    - An image larger than a slot is dropped, counted in metrics as frames_too_large
+- Capture and upload run at the same time, on the two cores:
+    - loop() (core 1) acquires a slot, captures into it, classifies it and pushes the slot number to readyFrames
+    - taskUploadWorker() (core 0) pops it, uploads it with uploadConnection, keeps it in imageStore if needed,
+      and pushes an UploadReport to uploadReports
+    - loop() records the report in metrics and gives the slot back to imagePool, the next image can be captured
+      while the previous one is still being uploaded
+    - A trigger while every slot is in use is not captured, counted in metrics as pool_full
+- readyFrames and uploadReports are RingBuffer (single producer, single consumer, lock-free), uploadWake wakes
+  taskUploadWorker() once a slot is pushed, it looks at imageStore at least every UPLOAD_IDLE_MS otherwise
+- imageSlots: what is known about the image in each slot, written by loop() before the slot is pushed
+    - scanID, jpegQuality at capture, result of edgeClassifier, captureStartedAt (millis() when the trigger was picked up)
+- UploadReport: result of one image, slot -1 for an image sent again from imageStore by taskDrainQueue()
+    - httpCode (0 if not sent, e.g. offline), uploadMs, captureToUploadMs (0 if it did not get through),
+      sdWriteMs (0 if no copy was written), queued (kept in imageStore to send again) and imageSize
+*/
+#define IMAGE_POOL_SLOTS 3
+#define IMAGE_POOL_SLOTS_NO_PSRAM 1
+#define UPLOAD_IDLE_MS 50
+
+struct ImageSlot {
+    char scanID[SCAN_ID_MAX_LENGTH];
+    int profile;
+    int jpegQuality;
+    int edgeLabel;
+    float edgeConfidence;
+    unsigned long captureStartedAt;
+};
+
+struct UploadReport {
+    int slot;
+    int httpCode;
+    unsigned long uploadMs;
+    unsigned long captureToUploadMs;
+    unsigned long sdWriteMs;
+    bool queued;
+    size_t imageSize;
+};
+
+FramePool imagePool;
+ImageSlot imageSlots[IMAGE_POOL_SLOTS];
+RingBuffer<int, 4> readyFrames;
+RingBuffer<UploadReport, 8> uploadReports;
+SemaphoreHandle_t uploadWake = NULL;
+
+/* Fresh frame config
+- esp_camera_fb_get() can hand out a frame taken before the trigger
+    - With CAMERA_GRAB_WHEN_EMPTY the driver fills a free buffer at once and keeps it, e.g. showing the previous item
+    - The first frames after esp_camera_init() are taken before auto exposure and white balance settled
+- The camera runs with CAMERA_GRAB_LATEST: the sensor streams all the time, so it is warm when a trigger comes,
+  and the buffers are overwritten with the newest frames
+- taskCaptureImage() only keeps a frame that started after the trigger was picked up (captureTriggerUs)
+  and at least CAPTURE_WARMUP_MS after the camera was started (cameraStartedUs), by the timestamp of the frame buffer
+    - Other frames are given back at once, counted as stale_frames in metrics, CAPTURE_MAX_FRAMES frames at most
+    - The time from trigger to the start of the frame kept is recorded in metrics as trigger_to_shutter
+- Times are micros() values, the same esp_timer clock fb->timestamp is taken from, compared wrap-safe
+*/
+#define CAPTURE_WARMUP_MS 500
+#define CAPTURE_MAX_FRAMES 4
+
+unsigned long cameraStartedUs = 0;
+unsigned long captureTriggerUs = 0;
+
+/* Edge classifier config
+- Define EDGE_CLASSIFIER_ENABLED to classify every captured image on the board, see EdgeClassifier.h
+    - The result goes to ESP32-S3 over the LAN (LOCAL_EDGE_RESULT), ESP32-S3 only sorts on it if its EDGE_SORT_ENABLED
+      is on, off by default until the weights come from a model trained on photos of the real chute, see EdgeModel.h
+    - The image is still uploaded, with the result in the edge_class and edge_confidence fields, for the server to confirm
+- Define EDGE_DECODE_SCALE, the JPEG is decoded at 1/8 scale: PROFILE_CHUTE (240x240) becomes 30x30, the input of the model
+- Initialize edgeFrame, buffer for the decoded RGB565 frame, frames up to SVGA fit (EDGE_FRAME_MAX_BYTES)
+- Creating object instance of EdgeClassifier: edgeClassifier, its tensor arena is part of it
+- The result of an image is kept in its entry of imageSlots, edgeLabel -1 if there is none
+- Initialize s3Address and s3Port, where the LAN trigger came from, the result is sent there
+*/
+#define EDGE_CLASSIFIER_ENABLED true
+#define EDGE_DECODE_SCALE JPG_SCALE_8X
+#define EDGE_FRAME_MAX_BYTES (100 * 75 * 2)
+
+uint8_t edgeFrame[EDGE_FRAME_MAX_BYTES];
+EdgeClassifier edgeClassifier;
+IPAddress s3Address;
+uint16_t s3Port = 0;
+
+/* Motion trigger config
+- Define MOTION_TRIGGER_ENABLED to capture once an item has come to rest in the chute, without a button press
+    - While no image waits to be classified and a slot of imagePool is free, the camera streams MOTION_FRAME_SIZE grayscale frames into motionDetector, see MotionDetector.h
+    - One frame every MOTION_FRAME_INTERVAL_MS (15 fps) at most, loop() serves the LAN trigger and the uploads in between
+    - The camera driver can not change between grayscale and JPEG while running, taskSwitchCamera() starts it again
+      in the other mode, after the item is found at rest and again once its image is captured
+    - Keeps capturing while Wi-Fi is down, the images wait in imageStore and are sent once it is back
+    - The button on ESP32-S3 keeps working, its trigger switches the camera back to JPEG
+- Define OFFLINE_MOTION_TRIGGER to watch the chute with motionDetector while Wi-Fi is down, even without MOTION_TRIGGER_ENABLED
+    - The button trigger reaches the camera over the network only (LAN or cloud), without this nothing is captured offline
+    - Only once Wi-Fi was connected before (lastOnline), the connect at boot does not switch the camera to grayscale and back
+    - Watching starts at once, an item put in the chute before the first frame would be taken for the background
+    - Once Wi-Fi is back the camera goes back to JPEG and waits for the button trigger again
+    - The image is kept for the server only, no motion notice is sent: ESP32-S3 sorts on its button presses, a press
+      queued during the outage would start a second scan of the same item
+- The scan ID of a motion capture is made on ESP32-CAM and sent to ESP32-S3 with LOCAL_MOTION_MESSAGE, see TArSProtocol.h
+    - Sent again every MOTION_NOTICE_RETRY_MS until acknowledged, or until the item is gone from the chute
+- Creating object instance of MotionDetector: motionDetector, previous frame and background are part of it
+- Initialize motionTrigger (motion trigger in use) and offlineMotionTrigger (in use while offline), both turned off if
+  the camera does not start in grayscale
+- Initialize cameraMotionMode, camera runs in grayscale for motionDetector
+- Initialize motionCounter, number of motion captures since boot, part of the scan ID
+- Initialize motionNoticeScanID (scan ID not acknowledged yet, empty if none) and lastMotionNotice
+- Initialize lastMotionFrame, millis() value of the last frame given to motionDetector
+- Initialize lastOnline, millis() value of the last pass of loop() with Wi-Fi connected
+*/
+#define MOTION_TRIGGER_ENABLED false
+#define OFFLINE_MOTION_TRIGGER true
+#define MOTION_FRAME_SIZE FRAMESIZE_QQVGA
+#define MOTION_FRAME_WIDTH 160
+#define MOTION_FRAME_HEIGHT 120
+#define MOTION_FRAME_INTERVAL_MS 66
+#define MOTION_NOTICE_RETRY_MS 300
+
+MotionDetector motionDetector;
+bool motionTrigger = MOTION_TRIGGER_ENABLED;
+bool offlineMotionTrigger = OFFLINE_MOTION_TRIGGER;
+bool cameraMotionMode = false;
+unsigned int motionCounter = 0;
+String motionNoticeScanID = "";
+unsigned long lastMotionNotice = 0;
+unsigned long lastMotionFrame = 0;
+unsigned long lastOnline = 0;
+
+/* Image store config
+- Images are kept on the MicroSD card in imageStore, see ImageStore.h
+    - Opened by taskBootStorage(), only used by taskUploadWorker() from then on
+    - One preallocated data file in IMAGE_STORE_DIR, a ring of IMAGE_STORE_BLOCKS blocks of 32 KB, no file per image
+    - The index of the records stays in RAM and is checkpointed to the card now and then,
+      a record written after the last checkpoint is found again by its header after a reset
+    - Each record keeps scan ID, capture time (millis()), capture profile, upload state and the result of edgeClassifier
+- Every image goes in after its upload if SAVE_IMAGE_TO_SD, otherwise only if it could not be uploaded
+    - An image not uploaded stays IMAGE_STATE_PENDING and is sent again later, the oldest records are overwritten
+      once the ring is full (counted in metrics as images_dropped if still pending)
+- Define QUEUE_BATCH_SIZE and QUEUE_BATCH_INTERVAL_MS to rate limit the replay
+    - At most QUEUE_BATCH_SIZE images are sent again every QUEUE_BATCH_INTERVAL_MS
+- Define QUEUE_CHUNK_SIZE, size of queueChunk, the fixed buffer a stored image is sent through
+- Initialize queueBatchCount and queueBatchStart to keep track of the current batch
+- Initialize replayReady, set by loop() once the cloud status was polled since Wi-Fi came back, cleared while offline
+    - The server clears a pending trigger when an image comes in, a replay sent first would swallow the cloud
+      trigger of a scan ESP32-S3 started during the outage
+- Define STORE_CHECKPOINT_MS, the index is checkpointed at least this often, lastStoreCheckpoint is the time of the last one
+- Initialize initStore flag to check store initialization status
+*/
+#define IMAGE_STORE_DIR "/tars"
+#define IMAGE_STORE_BLOCKS 1024
+#define QUEUE_BATCH_SIZE 3
+#define QUEUE_BATCH_INTERVAL_MS 30000
+#define QUEUE_CHUNK_SIZE 4096
+#define STORE_CHECKPOINT_MS 60000
+
+ImageStore imageStore;
+uint8_t queueChunk[QUEUE_CHUNK_SIZE];
+
+int queueBatchCount = 0;
+unsigned long queueBatchStart = 0;
+unsigned long lastStoreCheckpoint = 0;
+volatile bool replayReady = false;
+
+bool initStore = false;
+
+/* Metrics config
+- metrics: latency histograms and counters of the device, see Metrics.h
+    - Printed on Serial every minute and served by metricsServer on METRICS_PORT (GET /metrics)
+    - Only touched by loop(), taskUploadWorker() hands its times over in uploadReports, see taskCollectUploads()
+- Latency: capture (esp_camera_fb_get(), stale frames included), trigger_to_shutter (trigger picked up until
+  the frame kept started), sd_write (SD copy), status_poll (cloud status request),
+  upload (live image), capture_to_upload (trigger picked up until the server took the image), replay (queued image),
+  camera_switch (camera started again in the other mode), motion_frame (grayscale frame and motion detection),
+  wifi_connect (Wi-Fi started or lost until connected again, handed over by wifiLink.poll()), boot (power-on until ready)
+- Counters: LAN, cloud and motion triggers, failed captures, stale frames given back, triggers while imagePool was full,
+  images larger than a slot, upload retries on a fresh connection, images queued,
+  images dropped from imageStore before they were uploaded, index checkpoints of imageStore,
+  motion notices never acknowledged, the HTTP response codes, plus the connection counters of connectionManager
+  and uploadConnection and the Wi-Fi losses and fast connects of wifiLink
+- Initialize uploadRetries, counted by taskUploadImage() on the upload task, watched by metrics
+*/
+Metrics metrics("cam");
+WiFiServer metricsServer(METRICS_PORT);
+
+unsigned long uploadRetries = 0;
+
+/* Boot config
+- setup() only starts the parts of the boot, they get ready in parallel and each sets its bit in bootReady (event group)
+    - BOOT_CAMERA: camera started and motionDetector prepared, by taskBootCamera() on core 0
+    - BOOT_STORAGE: MicroSD card mounted and imageStore opened, by taskBootStorage() on core 1
+    - BOOT_WIFI: wifiLink connected for the first time, set by taskBootProgress()
+- A part that failed sets its bit as well, initCamera, initMicroSD and initStore tell what works
+- loop() waits for BOOT_LOCAL (camera and storage), the network stages need Wi-Fi on top, as before
+- bootPartMs: millis() at which each part got ready, in the order of the bits
+- bootReadyMs: power-on until every part was ready, 0 until then, printed and recorded in metrics as boot
+*/
+#define BOOT_CAMERA (1 << 0)
+#define BOOT_STORAGE (1 << 1)
+#define BOOT_WIFI (1 << 2)
+#define BOOT_LOCAL (BOOT_CAMERA | BOOT_STORAGE)
+#define BOOT_ALL (BOOT_LOCAL | BOOT_WIFI)
+#define BOOT_PARTS 3
+
+EventGroupHandle_t bootReady = NULL;
+volatile unsigned long bootPartMs[BOOT_PARTS] = {0, 0, 0};
+unsigned long bootReadyMs = 0;
+
+/* taskLEDWorker() function
+- FreeRTOS task owning INDICATOR_PIN, created in setup()
+- Wait for the next pattern in ledPatterns with xQueueReceive() function
+- Play it with vTaskDelay() function, only this task waits, loop() keeps running
+- Show ledIdleOn once the pattern is done
+*/
+void taskLEDWorker(void *) {
+    for (;;) {
+        int pattern = LED_PATTERN_IDLE;
+        xQueueReceive(ledPatterns, &pattern, portMAX_DELAY);
+        const LEDPattern &played = LED_PATTERNS[pattern];
+        for (int i = 0; i < played.blinks; i++) {
+            digitalWrite(INDICATOR_PIN, HIGH); vTaskDelay(pdMS_TO_TICKS(played.stepMs));
+            digitalWrite(INDICATOR_PIN, LOW); vTaskDelay(pdMS_TO_TICKS(played.stepMs));
+            digitalWrite(INDICATOR_PIN, HIGH); vTaskDelay(pdMS_TO_TICKS(played.stepMs));
+        }
+        digitalWrite(INDICATOR_PIN, ledIdleOn ? LOW : HIGH);
+    }
+}
+
+// taskShowPattern() function, to queue pattern for taskLEDWorker() without waiting
+void taskShowPattern(int pattern) {
+    if (xQueueSend(ledPatterns, &pattern, 0) != pdTRUE) {
+        metrics.count("led_patterns_dropped");
+    }
+}
+
+// taskSetIndicator() function, to set the LED state between patterns, shown at once if no pattern is playing
+void taskSetIndicator(bool on) {
+    if (on == ledIdleOn) {
+        return;
+    }
+    ledIdleOn = on;
+    int pattern = LED_PATTERN_IDLE;
+    xQueueSend(ledPatterns, &pattern, 0);
+}
+
 /* taskInitCamera() function
-- Initialize camera using esp_camera_init() function
+- Initialize camera using esp_camera_init() function, with frame size and quality of CAPTURE_PROFILE
+    - Or in grayscale at MOTION_FRAME_SIZE for motionDetector if motion is true
+    - CAMERA_GRAB_LATEST, see Fresh frame config, the time it started is kept in cameraStartedUs
 - Implementing error handling with if-else statement
-    - Ensure certain settings selected only if device has PSRAM
+    - Fall back to PROFILE_SVGA if the profile needs PSRAM and the device has none
+    - Two frame buffers in PSRAM only if device has PSRAM
     - Ensure camera is properly initialized before executing other tasks
+- jpegQuality starts at the best quality of the profile, it is kept when the camera is started again
 - Camera settings for brightness, contrast, etc.
-- Set initCamera flag to true if all executed properly
+- Read out only the region of interest of the profile with .set_res_raw() method, not in grayscale
+    - Mode 0 of the OV2640 (UXGA timing), window at windowX and windowY, scaled to the output size
+- Set initCamera flag to true if all executed properly, cameraMotionMode tells the mode it runs in
 - Further reading: https://dronebotworkshop.com/esp32-cam-microsd/
 */
-void taskInitCamera() {
+void taskInitCamera(bool motion) {
     camera_config_t config;
     config.ledc_channel = LEDC_CHANNEL_0;
     config.ledc_timer = LEDC_TIMER_0;
@@ -108,17 +532,20 @@ void taskInitCamera() {
     config.pin_pwdn = PWDN_GPIO_NUM;
     config.pin_reset = RESET_GPIO_NUM;
     config.xclk_freq_hz = 20000000;
-    config.pixel_format = PIXFORMAT_JPEG;
+    config.pixel_format = motion ? PIXFORMAT_GRAYSCALE : PIXFORMAT_JPEG;
+    config.grab_mode = CAMERA_GRAB_LATEST;
 
-    if (psramFound()) {
-        config.frame_size = FRAMESIZE_UXGA;
-        config.jpeg_quality = 10;
-        config.fb_count = 2;
-    } else {
-        config.frame_size = FRAMESIZE_SVGA;
-        config.jpeg_quality = 12;
-        config.fb_count = 1;
+    if (CAPTURE_PROFILES[captureProfile].needsPSRAM && !psramFound()) {
+        captureProfile = PROFILE_SVGA;
+    }
+    const CaptureProfile &profile = CAPTURE_PROFILES[captureProfile];
+    if (jpegQuality == 0) {
+        jpegQuality = profile.qualityMin;
     }
+    config.frame_size = motion ? MOTION_FRAME_SIZE : profile.frameSize;
+    config.jpeg_quality = jpegQuality;
+    config.fb_count = psramFound() ? 2 : 1;
+    config.fb_location = psramFound() ? CAMERA_FB_IN_PSRAM : CAMERA_FB_IN_DRAM;
 
     esp_err_t err = esp_camera_init(&config);
     if (err != ESP_OK) {
@@ -173,9 +600,40 @@ void taskInitCamera() {
     s->set_dcw(s, 1);
     // COLOR BAR PATTERN (0 = Disable , 1 = Enable)
     s->set_colorbar(s, 0);
+    // REGION OF INTEREST (mode 0 = UXGA, window offset and size, output size)
+    if (profile.windowWidth > 0 && !motion) {
+        s->set_res_raw(s, 0, 0, 0, 0, profile.windowX, profile.windowY, profile.windowWidth, profile.windowHeight,
+                       profile.outputWidth, profile.outputHeight, true, false);
+    }
+    cameraMotionMode = motion;
+    cameraStartedUs = micros();
     initCamera = true;
 }
 
+/* taskSwitchCamera() function
+- Start the camera again in grayscale for motionDetector (motion true) or in JPEG with the capture profile
+    - Nothing to do if it already runs in that mode, the frame buffer must have been given back before
+- Stop the camera with esp_camera_deinit() function and call taskInitCamera() function, the time is recorded in metrics as camera_switch
+- Turn motionTrigger and offlineMotionTrigger off for good if the camera does not start in grayscale, and go back to JPEG
+- Return true if the camera runs in the requested mode
+*/
+bool taskSwitchCamera(bool motion) {
+    if (initCamera == true && cameraMotionMode == motion) {
+        return true;
+    }
+    unsigned long switchStart = millis();
+    esp_camera_deinit();
+    taskInitCamera(motion);
+    if (initCamera == false && motion == true) {
+        motionTrigger = false;
+        offlineMotionTrigger = false;
+        taskInitCamera(false);
+        return false;
+    }
+    metrics.record("camera_switch", millis() - switchStart);
+    return initCamera;
+}
+
 /* taskInitMicroSD() function
 - Initialize MicroSD card configuration
 - Implementing error handling with if-else statement
@@ -196,234 +654,895 @@ void taskInitMicroSD() {
     initMicroSD = true;
 }
 
+// taskFrameMicros() function, to read the timestamp of a frame buffer (start of the frame) as a micros() value
+unsigned long taskFrameMicros(const camera_fb_t *fb) {
+    return (unsigned long)((uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec);
+}
+
+// taskFreshFrame() function, to check that a frame started after the trigger and after the sensor warmed up
+bool taskFreshFrame(const camera_fb_t *fb) {
+    unsigned long frameUs = taskFrameMicros(fb);
+    return (long)(frameUs - captureTriggerUs) >= 0 && (long)(frameUs - cameraStartedUs) >= CAPTURE_WARMUP_MS * 1000L;
+}
+
 /* taskCaptureImage() function
-- Capture image from camera using esp_camera_fb_get() function
-- Set captureImage flag to true if image captured properly
+- Capture image from camera using esp_camera_fb_get() function, its time is recorded in metrics as capture
+    - Wait until CAPTURE_WARMUP_MS after the camera was started first
+    - Give back a frame taskFreshFrame() does not accept and take the next one, CAPTURE_MAX_FRAMES frames at most
+- Return the frame buffer, taskStartCapture() copies it into imagePool and gives it back
+- Set captureImage flag to true if image captured properly, trigger_to_shutter is recorded in metrics
 - Implementing error handling with if-else statement
-    - Check if camera failed to capture image by examining fb variable
-    - Check if file is not opened by examining file variable
-- Creating object instance of File: file, an empty file, with path as reference
-- Write image buffer to file with file.write() function
-- Release the memory allocated for image buffer with esp_camera_fb_return() function
-- Release the memory allocated for file with .close() method
-- Set saveImage flag to true if image saved properly
+    - Check if camera failed to capture image by examining fb variable, also if no fresh frame came, NULL is returned
 */
-void taskCaptureImage(String path) {
-    camera_fb_t * fb = esp_camera_fb_get();
+camera_fb_t *taskCaptureImage() {
+    unsigned long captureStart = millis();
+    long warmupLeftUs = (long)(cameraStartedUs + CAPTURE_WARMUP_MS * 1000UL - micros());
+    if (warmupLeftUs > 0) {
+        delay(warmupLeftUs / 1000 + 1);
+    }
+    camera_fb_t * fb = NULL;
+    for (int frame = 0; frame < CAPTURE_MAX_FRAMES; frame++) {
+        fb = esp_camera_fb_get();
+        if (!fb || taskFreshFrame(fb)) {
+            break;
+        }
+        esp_camera_fb_return(fb);
+        fb = NULL;
+        metrics.count("stale_frames");
+    }
+    metrics.record("capture", millis() - captureStart);
 
     if (!fb) {
+        metrics.count("capture_failures");
         captureImage = false;
-        return;
+        return NULL;
     }
+    metrics.record("trigger_to_shutter", (taskFrameMicros(fb) - captureTriggerUs) / 1000);
     captureImage = true;
+    return fb;
+}
 
-    fs::FS &fs = SD_MMC;
-    File file = fs.open(path.c_str(), FILE_WRITE);
-    if (!file) {
-        saveImage = false;
-    } else {
-        file.write(fb->buf, fb->len);
+/* taskInitStore() function
+- Open imageStore on the MicroSD card, only if MicroSD card is initialized
+- .begin() method creates IMAGE_STORE_DIR and the data file on a new card, otherwise it loads the index,
+  so images not uploaded before a restart are kept
+- Set initStore flag to true if all executed properly
+*/
+void taskInitStore() {
+    if (initMicroSD == false) {
+        initStore = false;
+        return;
+    }
+    initStore = imageStore.begin(SD_MMC, IMAGE_STORE_DIR, IMAGE_STORE_BLOCKS);
+}
+
+// taskBootDone() function, to note the time a part of the boot (BOOT_CAMERA, ...) got ready and set its bit in bootReady
+void taskBootDone(EventBits_t part) {
+    bootPartMs[__builtin_ctz(part)] = millis();
+    xEventGroupSetBits(bootReady, part);
+}
+
+/* taskInitImagePool() function
+- Allocate imagePool with .begin() method, only if camera is initialized, the capture profile in use is known from then on
+    - IMAGE_POOL_SLOTS slots of jpegMaxBytes in PSRAM, IMAGE_POOL_SLOTS_NO_PSRAM slot in internal RAM otherwise
+- Print the memory it takes, fixed from here on
+- Set initCamera flag to false if it can not be allocated, no image can be captured without it
+*/
+void taskInitImagePool() {
+    if (initCamera == false) {
+        return;
+    }
+    int slots = psramFound() ? IMAGE_POOL_SLOTS : IMAGE_POOL_SLOTS_NO_PSRAM;
+    if (!imagePool.begin(slots, CAPTURE_PROFILES[captureProfile].jpegMaxBytes)) {
+        Serial.println("Image pool: " + String(slots) + " x " + String(CAPTURE_PROFILES[captureProfile].jpegMaxBytes) +
+                       " bytes do not fit");
+        initCamera = false;
+        return;
+    }
+    Serial.println("Image pool: " + String(imagePool.slots()) + " x " + String(imagePool.slotBytes()) + " bytes in " +
+                   (imagePool.inPSRAM() ? "PSRAM" : "RAM"));
+}
+
+/* taskBootCamera() function
+- FreeRTOS task created by setup(), starts the camera while the MicroSD card and Wi-Fi start in parallel
+- Call taskInitCamera() function in JPEG, loop() switches it to grayscale for the motion trigger
+- Allocate the image buffers with taskInitImagePool() function
+- Prepare motionDetector for MOTION_FRAME_WIDTH x MOTION_FRAME_HEIGHT frames with .begin() method, only if motionTrigger
+  or offlineMotionTrigger
+- Set BOOT_CAMERA and delete itself
+*/
+void taskBootCamera(void *) {
+    taskInitCamera(false);
+    taskInitImagePool();
+    bool motionReady = (motionTrigger || offlineMotionTrigger) && motionDetector.begin(MOTION_FRAME_WIDTH, MOTION_FRAME_HEIGHT);
+    motionTrigger = motionTrigger && motionReady;
+    offlineMotionTrigger = offlineMotionTrigger && motionReady;
+    taskBootDone(BOOT_CAMERA);
+    vTaskDelete(NULL);
+}
+
+/* taskBootStorage() function
+- FreeRTOS task created by setup(), mounts the MicroSD card while the camera and Wi-Fi start in parallel
+- Call taskInitMicroSD() and taskInitStore() function, images not uploaded before a restart are sent again
+- Set BOOT_STORAGE and delete itself
+*/
+void taskBootStorage(void *) {
+    taskInitMicroSD();
+    taskInitStore();
+    taskBootDone(BOOT_STORAGE);
+    vTaskDelete(NULL);
+}
+
+/* taskStartCapture() function
+- Capture the image for the trigger carrying scanID, from the LAN or from the cloud
+- Implementing error handling with if-else statement
+    - Check if camera is not initialized properly, MicroSD card is optional
+    - Check if the image of this scanID was already captured, a trigger can arrive both ways
+    - Check if a slot of imagePool is free with .acquire() method, counted in metrics as pool_full if not
+- Switch the camera to JPEG with taskSwitchCamera() function, if it streams grayscale for the motion trigger
+- Call taskCaptureImage() function, motionDetector does not trigger again for the item captured
+- Copy the image into the slot with imagePool.copy() method and give the frame buffer back at once
+    - The camera is free for the next trigger while this image is classified and uploaded
+    - An image larger than the slot is dropped, counted in metrics as frames_too_large
+- Fill in the entry of the slot in imageSlots: scanID, captureProfile, jpegQuality and captureStartedAt (captureTriggerUs)
+- Remember scanID in lastCapturedScanID and the slot in imageSlot, loop() classifies it and hands it over
+- Return true if the image of scanID is captured
+*/
+bool taskStartCapture() {
+    if (initCamera == false) {
+        return false;
+    }
+    if (scanID.length() > 0 && scanID == lastCapturedScanID) {
+        return true;
+    }
+    int slot = imagePool.acquire();
+    if (slot < 0) {
+        metrics.count("pool_full");
+        return false;
+    }
+
+    unsigned long captureStartedAt = millis();
+    captureTriggerUs = micros();
+    camera_fb_t *fb = taskSwitchCamera(false) ? taskCaptureImage() : NULL;
+    if (fb == NULL) {
+        imagePool.release(slot);
+        return false;
+    }
+    motionDetector.markCaptured();
+    bool copied = imagePool.copy(slot, fb->buf, fb->len, fb->width, fb->height);
+    esp_camera_fb_return(fb);
+    if (copied == false) {
+        metrics.count("frames_too_large");
+        imagePool.release(slot);
+        return false;
+    }
+
+    ImageSlot &image = imageSlots[slot];
+    snprintf(image.scanID, sizeof(image.scanID), "%s", scanID.c_str());
+    image.profile = captureProfile;
+    image.jpegQuality = jpegQuality;
+    image.edgeLabel = -1;
+    image.edgeConfidence = 0;
+    image.captureStartedAt = captureStartedAt;
+    lastCapturedScanID = scanID;
+    imageSlot = slot;
+    return true;
+}
+
+/* taskUDPtrigger() function
+- Check for trigger sent by ESP32-S3 over the LAN, see TArSProtocol.h
+- Read one datagram with .parsePacket() and .read() method, nothing to do if none arrived
+- Handling the message with if-else statement
+    - LOCAL_TRIGGER_ACK of the motion notice waiting in motionNoticeScanID: stop sending it, remember the sender
+      in s3Address and s3Port, set localTriggerSeen flag to true as the LAN works
+    - Ignore anything else that is not LOCAL_TRIGGER_MESSAGE followed by a scan ID
+    - Ignore a trigger while no slot of imagePool is free, ESP32-S3 falls back to the cloud
+    - A repeated trigger of the image just captured is only acknowledged again, its first reply got lost
+- Remember the sender in s3Address and s3Port for the edge result
+- Store the scan ID in scanID and call taskStartCapture() function
+- Reply LOCAL_TRIGGER_ACK with the scan ID of the trigger to the sender once the image is captured
+    - triggerScanID, not scanID: a cloud trigger may have changed scanID since a repeated trigger was captured
+- Set localTriggerSeen flag to true, the cloud status is then polled less often
+*/
+void taskUDPtrigger() {
+    if (triggerUDP.parsePacket() <= 0) {
+        return;
+    }
+    char message[LOCAL_TRIGGER_MAX_LENGTH + 1];
+    int messageLength = triggerUDP.read(message, LOCAL_TRIGGER_MAX_LENGTH);
+    message[max(messageLength, 0)] = '\0';
+    String triggerMessage = message;
+    triggerMessage.trim();
+    if (motionNoticeScanID.length() > 0 && triggerMessage == String(LOCAL_TRIGGER_ACK) + motionNoticeScanID) {
+        s3Address = triggerUDP.remoteIP();
+        s3Port = triggerUDP.remotePort();
+        motionNoticeScanID = "";
+        localTriggerSeen = true;
+        return;
+    }
+    if (!triggerMessage.startsWith(LOCAL_TRIGGER_MESSAGE)) {
+        return;
+    }
+    String triggerScanID = triggerMessage.substring(strlen(LOCAL_TRIGGER_MESSAGE));
+    s3Address = triggerUDP.remoteIP();
+    s3Port = triggerUDP.remotePort();
+    if (triggerScanID != lastCapturedScanID) {
+        if (imageSlot >= 0 || imagePool.available() == 0) {
+            return;
+        }
+        scanID = triggerScanID;
+        metrics.count("lan_triggers");
+        if (taskStartCapture() == false) {
+            return;
+        }
+    }
+    triggerUDP.beginPacket(triggerUDP.remoteIP(), triggerUDP.remotePort());
+    triggerUDP.print(String(LOCAL_TRIGGER_ACK) + triggerScanID);
+    triggerUDP.endPacket();
+    localTriggerSeen = true;
+}
+
+// taskSendToS3() function, to send message to ESP32-S3, where its last trigger came from, or broadcast on the subnet if none came yet,
+// dropped while offline (a motion notice is sent again by taskRepeatMotionNotice() once Wi-Fi is back)
+void taskSendToS3(const String &message) {
+    if (!wifiLink.connected()) {
+        return;
+    }
+    triggerUDP.beginPacket(s3Port != 0 ? s3Address : WiFi.broadcastIP(), s3Port != 0 ? s3Port : LOCAL_TRIGGER_PORT);
+    triggerUDP.print(message);
+    triggerUDP.endPacket();
+}
+
+// taskSendMotionNotice() function, to send LOCAL_MOTION_MESSAGE with motionNoticeScanID to ESP32-S3 with taskSendToS3()
+void taskSendMotionNotice() {
+    lastMotionNotice = millis();
+    taskSendToS3(String(LOCAL_MOTION_MESSAGE) + motionNoticeScanID);
+}
+
+/* taskRepeatMotionNotice() function
+- Send the motion notice again if it is not acknowledged MOTION_NOTICE_RETRY_MS after the last one
+    - Also after a Wi-Fi loss, ESP32-S3 starts the scan late rather than never
+- Give up once motionDetector found the chute empty again, counted as motion_notices_lost in metrics
+    - The item was taken out, its image is uploaded anyway
+*/
+void taskRepeatMotionNotice() {
+    if (motionNoticeScanID.length() == 0 || millis() - lastMotionNotice < MOTION_NOTICE_RETRY_MS) {
+        return;
+    }
+    if (motionDetector.state() == MOTION_STATE_EMPTY) {
+        metrics.count("motion_notices_lost");
+        motionNoticeScanID = "";
+        return;
+    }
+    taskSendMotionNotice();
+}
+
+/* taskClassifyImage() function
+- Classify the image in slot of imagePool on the board with edgeClassifier, only if EDGE_CLASSIFIER_ENABLED
+    - Always a JPEG, taskStartCapture() switched the camera to JPEG before
+- Decode the JPEG at EDGE_DECODE_SCALE into edgeFrame with jpg2rgb565() function, a frame that does not fit is skipped
+- Store the result in the entry of the slot in imageSlots, the time it took is recorded in metrics as edge_classify
+- Send LOCAL_EDGE_RESULT with the scan ID, label and confidence to ESP32-S3 with taskSendToS3() function
+*/
+void taskClassifyImage(int slot) {
+    ImageSlot &image = imageSlots[slot];
+    const PoolFrame &frame = imagePool.frame(slot);
+    image.edgeLabel = -1;
+    if (EDGE_CLASSIFIER_ENABLED == false) {
+        return;
+    }
+    int width = frame.width >> EDGE_DECODE_SCALE;
+    int height = frame.height >> EDGE_DECODE_SCALE;
+    if ((size_t)width * height * 2 > sizeof(edgeFrame)) {
+        return;
     }
-    file.close();
+
+    unsigned long classifyStart = millis();
+    EdgeResult result;
+    if (!jpg2rgb565(frame.buf, frame.len, edgeFrame, EDGE_DECODE_SCALE) ||
+        !edgeClassifier.classifyRGB565(edgeFrame, width, height, result)) {
+        return;
+    }
+    metrics.record("edge_classify", millis() - classifyStart);
+    image.edgeLabel = result.label;
+    image.edgeConfidence = result.confidence;
+
+    if (image.scanID[0] != '\0') {
+        taskSendToS3(String(LOCAL_EDGE_RESULT) + image.scanID + " " + EdgeClassifier::label(image.edgeLabel) + " " +
+                     String(image.edgeConfidence, 2));
+    }
+}
+
+/* taskHandOverImage() function
+- Hand the image in imageSlot to taskUploadWorker(): push the slot to readyFrames and wake it with uploadWake
+    - readyFrames has room for every slot, the push can not fail
+- Set imageSlot to -1, the camera is free for the next trigger
+*/
+void taskHandOverImage() {
+    readyFrames.push(imageSlot);
+    xSemaphoreGive(uploadWake);
+    imageSlot = -1;
+}
+
+/* taskWatchMotion() function
+- Give the next grayscale frame to motionDetector, at most every MOTION_FRAME_INTERVAL_MS
+    - Always if motionTrigger, otherwise only if offlineMotionTrigger and Wi-Fi is down after it was connected
+    - Once Wi-Fi is back, switch the camera to JPEG with taskSwitchCamera() function, ready for the button trigger
+    - Only while a slot of imagePool is free, the camera is switched to grayscale with taskSwitchCamera() function first
+    - The images before may still be uploading, they are no longer in the frame buffers
+- Grab the frame with esp_camera_fb_get() function, run it through motionDetector and give it back at once
+    - The time for frame and detection is recorded in metrics as motion_frame
+- Once an item came to rest, counted as motion_triggers in metrics:
+    - Make a scanID from the MAC address, motionCounter and millis(), capture the item with taskStartCapture() function
+    - Tell ESP32-S3 about the new scan with taskSendMotionNotice() function, only if motionTrigger (not while offline only)
+*/
+void taskWatchMotion() {
+    if ((motionTrigger == false && offlineMotionTrigger == false) || imageSlot >= 0) {
+        return;
+    }
+    if (motionTrigger == false && (wifiLink.connected() || lastOnline == 0)) {
+        if (cameraMotionMode == true) {
+            taskSwitchCamera(false);
+        }
+        return;
+    }
+    if (imagePool.available() == 0) {
+        return;
+    }
+    if (millis() - lastMotionFrame < MOTION_FRAME_INTERVAL_MS || taskSwitchCamera(true) == false) {
+        return;
+    }
+    lastMotionFrame = millis();
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) {
+        metrics.count("capture_failures");
+        return;
+    }
+    bool settled = fb->format == PIXFORMAT_GRAYSCALE && motionDetector.update(fb->buf);
     esp_camera_fb_return(fb);
-    saveImage = true;
+    metrics.record("motion_frame", millis() - lastMotionFrame);
+    if (settled == false) {
+        return;
+    }
+
+    metrics.count("motion_triggers");
+    String camID = WiFi.macAddress();
+    camID.replace(":", "");
+    scanID = "tars-cam-" + camID + "-" + String(++motionCounter) + "-" + String(millis());
+    if (taskStartCapture() == true && motionTrigger == true) {
+        motionNoticeScanID = scanID;
+        taskSendMotionNotice();
+    }
 }
 
 /* taskHTTPGETtrigger() function
 - Check for trigger to capture image with HTTP GET request
-- Trigger is set by button attached to ESP32-S3
-- Implementing error handling with if-else statement
-    - Check if camera or MicroSD card is not initialized properly
-- Start HTTP connection with .begin() method
-- Parse HTTP response code with .GET() method
-- Get payload from HTTP response with .getString() method
+- Trigger is set by button attached to ESP32-S3, fallback if the LAN trigger did not get through
+- Start HTTP request on the kept-alive connection with connectionManager.begin() method
+- Parse HTTP response code with connectionManager.GET() method, its time is recorded in metrics as status_poll
+- Read the status and scan_id fields straight from the HTTP stream with JsonScanner, into buffers on the stack
+- Finish HTTP request with connectionManager.end() method, the connection stays open
 - Handling HTTP response code and payload with if-else statement
-    - Check if HTTP response code is 200
-    - Check if payload contains "true" string
-        - Construct path with string concatenation
-        - Call taskCaptureImage() function with path as parameter
-        - Increment pictureCount by 1, only if image is captured
-    - Check if HTTP response code is 500
-- Terminate HTTP connection with .end() method
+    - Check if HTTP response code is 200 and the status field is true
+        - Store the scan ID from the payload in scanID, empty if the server did not send one
+        - Nothing to do if the image of this scan ID was already captured after the LAN trigger
+        - Show LED_PATTERN_TRIGGER with taskShowPattern(), played in the background
+        - Call taskStartCapture() function
+        - Set localTriggerSeen flag to false, the LAN trigger did not get through so poll often again
+    - Check if HTTP response code is 500, show LED_PATTERN_SERVER_ERROR
 */
 void taskHTTPGETtrigger() {
-    if (initCamera == false || initMicroSD == false) {
+    if (initCamera == false) {
         return;
     }
 
-    clientESP32CAM.begin(getStatusURL);
-    int httpResponseCode = clientESP32CAM.GET();
-    String HTTPpayloadJSON = clientESP32CAM.getString();
-    int isPayloadTrue = HTTPpayloadJSON.indexOf("true");
+    char status[8];
+    char statusScanID[SCAN_ID_MAX_LENGTH];
+    JsonField fields[] = {
+        {"status", status, sizeof(status)},
+        {"scan_id", statusScanID, sizeof(statusScanID)},
+    };
+    JsonScanner json(fields, 2);
 
-    if (httpResponseCode == 200) {
-        for (int i = 0; i < 2; i++) {
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-            digitalWrite(INDICATOR_PIN, LOW); delay(1000);
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-        }
+    unsigned long pollStart = millis();
+    connectionManager.begin(clientESP32CAM, getStatusURL);
+    int httpResponseCode = connectionManager.GET(clientESP32CAM);
+    WiFiClient *stream = clientESP32CAM.getStreamPtr();
+    if (httpResponseCode == 200 && stream != NULL) {
+        json.readFrom(*stream, clientESP32CAM.getSize());
+    }
+    connectionManager.end(clientESP32CAM);
+    metrics.record("status_poll", millis() - pollStart);
+    metrics.countHTTP(httpResponseCode);
 
-        if (isPayloadTrue != -1) {
-            pictureCount = EEPROM.read(0) + 1;
-            imagePath = "/picture" + String(pictureCount) + ".jpg";
-            taskCaptureImage(imagePath);
-            if (captureImage == false || saveImage == false) {
-                clientESP32CAM.end();
-                return;
-            } else {
-                EEPROM.write(0, pictureCount);
-                EEPROM.commit();
-                doHTTPPOSTimage = true;
-            }
-        } else {
-            clientESP32CAM.end();
+    if (httpResponseCode == 200 && strcmp(status, "true") == 0) {
+        scanID = fields[1].truncated ? "" : statusScanID;
+        if (scanID.length() > 0 && scanID == lastCapturedScanID) {
             return;
         }
+
+        taskShowPattern(LED_PATTERN_TRIGGER);
+        localTriggerSeen = false;
+        metrics.count("cloud_triggers");
+        taskStartCapture();
     } else if (httpResponseCode == 500) {
-        for (int i = 0; i < 5; i++) {
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-            digitalWrite(INDICATOR_PIN, LOW); delay(1000);
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-        }
-        clientESP32CAM.end();
-        return;
+        taskShowPattern(LED_PATTERN_SERVER_ERROR);
     }
-    clientESP32CAM.end();
 }
 
-/* taskHTTPPOSTimage() function
-- Send image to server with HTTP POST request
-- Open the saved image file with .open() method and path as reference
-- Read file size with .size() method
-- Create image buffer imageBuffer in size of fileSize
-- Copy the file content to imageBuffer with .read() method
-- Construct HTTP POST request in multipart/form-data format
-    - Create components of multipart/form-data header and footer
-    - Using .reserve() method to reserve memory for HTTPpayloadJSON
-- Start HTTP connection with .begin() method
-- Send HTTP POST request with .POST() method
-- Parse HTTP response code with .POST() method and blink LED accordingly
-- Terminate HTTP connection with .end() method
-- Set doHTTPPOSTimage flag to false to ensure task is only executed once
-*/
-void taskHTTPPOSTimage(String path) {
-    fs::FS &fs = SD_MMC;
-    File file = fs.open(path.c_str(), FILE_READ);
-    if (!file) {
-        return;
-    }
-
-    size_t fileSize = file.size();
-    std::vector<uint8_t> imageBuffer(fileSize);
-    file.read(imageBuffer.data(), fileSize);
-    file.close();
+/* taskParsePredictURL() function
+- Split predictURL into host and path for the request line and Host header of the streamed upload
+- Port and scheme are handled by connectionManager
+*/
+void taskParsePredictURL() {
+    uint16_t predictPort;
+    bool predictSecure;
+    ConnectionManager::parseURL(predictURL, predictHost, predictPort, predictPath, predictSecure);
+}
 
+/* taskUploadImage() function
+- Send one image to server with HTTP POST request, streamed without copying the image, on taskUploadWorker()
+    - From memory (imageBuffer), the slot of imagePool of a live capture
+    - Or from an open file (imageFile), read in QUEUE_CHUNK_SIZE pieces into queueChunk
+- Construct HTTP POST request in multipart/form-data format into uploadRequest, with tarsUploadForm() and
+  tarsUploadHead() of TArSProtocol.h
+    - Add the scan_id field before the image, only if imageScanID is set
+    - Add the capture_profile field, the name of imageProfile in CAPTURE_PROFILES, the profile the image was taken with
+    - Add the jpeg_quality field if imageQuality is known (not for queued images)
+    - Add the edge_class and edge_confidence fields if imageLabel is set, an image classified by taskClassifyImage(),
+      live or read back from imageStore
+    - Content-Length is known up front from the form fields, TARS_UPLOAD_FOOTER and imageSize
+    - The form is written behind the room of the head first, then moved right behind the head, one write for both
+- Take the kept-alive socket to the server with uploadConnection.connect() method
+- Write request header, image and footer to the socket with .write() method
+- Read the reply with uploadConnection.readResponse() method, waiting up to UPLOAD_RESPONSE_TIMEOUT_MS
+- Send once more on a fresh connection if it failed on a reused one (closed by the server while idle), counted in uploadRetries
+    - A queued image is read again from the start of the image in imageFile
+- Return HTTP response code, or -1 if the image could not be sent or no reply came back
+*/
+int taskUploadImage(const char *imageScanID, int imageProfile, int imageQuality, int imageLabel, float imageConfidence,
+                    const uint8_t *imageBuffer, File *imageFile, size_t imageSize) {
     /* Create HTTP POST structure with data concatenation.
     The final form of the data being sent is as follows:
     POST /your_backend_services HTTP/1.1
     Host: your_server_ip_or_domain
-    Content-Type: multipart/form-data; boundary=ThisIsTheRequestBoundary
+    Content-Type: multipart/form-data; boundary=RequestBoundary
     Content-Length: <contentLength>
 
     --RequestBoundary
-    Content-Disposition: form-data; name="file"; filename="picture1.jpeg"
+    Content-Disposition: form-data; name="scan_id"
+
+    <imageScanID>
+    --RequestBoundary
+    Content-Disposition: form-data; name="capture_profile"
+
+    <profile name>
+    --RequestBoundary
+    Content-Disposition: form-data; name="jpeg_quality"
+
+    <imageQuality>
+    --RequestBoundary
+    Content-Disposition: form-data; name="edge_class"
+
+    <paper/metal/plastic>
+    --RequestBoundary
+    Content-Disposition: form-data; name="edge_confidence"
+
+    <0.00 - 1.00>
+    --RequestBoundary
+    Content-Disposition: form-data; name="file"; filename="payload.jpg"
     Content-Type: image/jpeg
 
-    <imageBuffer>
-    --ThisIsTheRequestBoundary--
-    */   
-    
-    String boundary = "RequestBoundary";
-    String headerRequest = "--" + boundary + "\r\n";
-    String footerRequest = "\r\n--" + boundary + "--\r\n";
-    headerRequest += "Content-Disposition: form-data; name=\"file\"; filename=\"payload.jpg\"\"\r\n";
-    headerRequest += "Content-Type: image/jpeg\r\n\r\n";
-    size_t contentLength = headerRequest.length() + fileSize + footerRequest.length();
-    std::vector<uint8_t> HTTPpayloadJSON;
-    HTTPpayloadJSON.reserve(contentLength);
-    HTTPpayloadJSON.insert(HTTPpayloadJSON.end(), headerRequest.begin(), headerRequest.end());
-    HTTPpayloadJSON.insert(HTTPpayloadJSON.end(), imageBuffer.begin(), imageBuffer.end());
-    HTTPpayloadJSON.insert(HTTPpayloadJSON.end(), footerRequest.begin(), footerRequest.end());
-    clientESP32CAM.begin(predictURL);
-    clientESP32CAM.addHeader("Content-Type", "multipart/form-data; boundary=RequestBoundary");
-    clientESP32CAM.addHeader("Content-Length", String(contentLength));
-    int httpResponseCode = clientESP32CAM.POST(HTTPpayloadJSON.data(), HTTPpayloadJSON.size());
-
-    if (httpResponseCode == 201) {
-        for (int i = 0; i < 2; i++) {
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-            digitalWrite(INDICATOR_PIN, LOW); delay(1000);
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
+    <image>
+    --RequestBoundary--
+    */
+
+    TArSUploadFields fields = {imageScanID, CAPTURE_PROFILES[imageProfile].name, imageQuality,
+                               imageLabel >= 0 ? EdgeClassifier::label(imageLabel) : NULL, imageConfidence};
+    char *form = uploadRequest + TARS_UPLOAD_HEAD_MAX;
+    size_t formLength = tarsUploadForm(form, TARS_UPLOAD_FORM_MAX, fields);
+    size_t footerLength = strlen(TARS_UPLOAD_FOOTER);
+    size_t headLength = tarsUploadHead(uploadRequest, TARS_UPLOAD_HEAD_MAX, predictHost.c_str(), predictPath.c_str(),
+                                       formLength + imageSize + footerLength);
+    if (formLength >= TARS_UPLOAD_FORM_MAX || headLength >= TARS_UPLOAD_HEAD_MAX) {
+        return -1;
+    }
+    memmove(uploadRequest + headLength, form, formLength);
+    size_t requestLength = headLength + formLength;
+
+    size_t imageStart = imageFile != NULL ? imageFile->position() : 0;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (attempt > 0) {
+            uploadRetries++;
         }
-    } else if (httpResponseCode == 400) {
-        for (int i = 0; i < 4; i++) {
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-            digitalWrite(INDICATOR_PIN, LOW); delay(1000);
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
+        WiFiClient *uploadClient = attempt == 0 ? uploadConnection.connect(predictURL) : uploadConnection.reconnect();
+        if (uploadClient == NULL) {
+            return -1;
         }
-    } else if (httpResponseCode == 500) {
-        for (int i = 0; i < 5; i++) {
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
-            digitalWrite(INDICATOR_PIN, LOW); delay(1000);
-            digitalWrite(INDICATOR_PIN, HIGH); delay(1000);
+        bool sent = uploadClient->write((const uint8_t *)uploadRequest, requestLength) == requestLength;
+        if (imageBuffer != NULL) {
+            sent = sent && uploadClient->write(imageBuffer, imageSize) == imageSize;
+        } else {
+            imageFile->seek(imageStart);
+            size_t remaining = imageSize;
+            while (sent && remaining > 0) {
+                size_t chunkSize = imageFile->read(queueChunk, min(remaining, (size_t)QUEUE_CHUNK_SIZE));
+                sent = chunkSize > 0 && uploadClient->write(queueChunk, chunkSize) == chunkSize;
+                remaining -= chunkSize;
+            }
+        }
+        sent = sent && uploadClient->write((const uint8_t *)TARS_UPLOAD_FOOTER, footerLength) == footerLength;
+
+        int httpResponseCode = -1;
+        if (sent) {
+            httpResponseCode = uploadConnection.readResponse(UPLOAD_RESPONSE_TIMEOUT_MS);
+        } else {
+            uploadConnection.release(false);
+        }
+        if (httpResponseCode > 0 || !uploadConnection.reused()) {
+            return httpResponseCode;
+        }
+    }
+    return -1;
+}
+
+/* taskAdaptJpegQuality() function
+- Update uploadKBps with the throughput of the last upload, imageSize bytes in uploadMs
+- Estimate how long an image of this size takes at uploadKBps
+- Step jpegQuality within the range of the capture profile and set it with .set_quality() method
+    - Worse by 2 if the estimate is above UPLOAD_TARGET_MS, better by 1 if below half of it
+    - Takes effect from the next capture, called by taskCollectUploads() on loop(), the task owning the camera
+*/
+void taskAdaptJpegQuality(size_t imageSize, unsigned long uploadMs) {
+    float sampleKBps = (float)imageSize / max(uploadMs, 1UL);
+    uploadKBps = uploadKBps == 0 ? sampleKBps : uploadKBps * 0.7 + sampleKBps * 0.3;
+
+    const CaptureProfile &profile = CAPTURE_PROFILES[captureProfile];
+    float estimatedMs = imageSize / uploadKBps;
+    int quality = jpegQuality;
+    if (estimatedMs > UPLOAD_TARGET_MS) {
+        quality = min(jpegQuality + 2, profile.qualityMax);
+    } else if (estimatedMs < UPLOAD_TARGET_MS / 2) {
+        quality = max(jpegQuality - 1, profile.qualityMin);
+    }
+    if (quality != jpegQuality) {
+        sensor_t *s = esp_camera_sensor_get();
+        s->set_quality(s, quality);
+        jpegQuality = quality;
+    }
+}
+
+// taskReportUpload() function, to hand report over to loop() in uploadReports, waiting while loop() has not collected the earlier ones
+void taskReportUpload(const UploadReport &report) {
+    while (!uploadReports.push(report)) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/* taskHTTPPOSTimage() function
+- Send the image in slot of imagePool to server with taskUploadImage(), on taskUploadWorker()
+    - Streamed straight from the slot, no copy is made, only if Wi-Fi is connected
+    - Not through: offline, no reply, connection failure or HTTP response code 5xx
+- Keep the image in imageStore: always if SAVE_IMAGE_TO_SD, otherwise only if it did not get through
+    - Reserve and write its record with .reserve() and .write() method, straight from the slot, with its capture profile
+    - Store the result of edgeClassifier with .setClass() method, set IMAGE_STATE_UPLOADED if the server took the image,
+      otherwise it stays pending for taskDrainQueue()
+    - Checkpoint the index of imageStore once enough changed, with .checkpoint() method
+- Hand the HTTP response code and the times over to loop() with taskReportUpload(), loop() gives the slot back
+*/
+void taskHTTPPOSTimage(int slot) {
+    const PoolFrame &frame = imagePool.frame(slot);
+    const ImageSlot &image = imageSlots[slot];
+    UploadReport report = {slot, 0, 0, 0, 0, false, frame.len};
+
+    if (wifiLink.connected()) {
+        unsigned long uploadStart = millis();
+        report.httpCode = taskUploadImage(image.scanID, image.profile, image.jpegQuality, image.edgeLabel,
+                                          image.edgeConfidence, frame.buf, NULL, frame.len);
+        report.uploadMs = millis() - uploadStart;
+    }
+    bool uploaded = report.httpCode > 0 && report.httpCode < 500;
+    if (uploaded == true) {
+        report.captureToUploadMs = max(millis() - image.captureStartedAt, 1UL);
+    }
+
+    if (initStore == true && (SAVE_IMAGE_TO_SD == true || uploaded == false)) {
+        unsigned long writeStart = millis();
+        uint32_t seq = imageStore.reserve(image.scanID, frame.len, image.captureStartedAt, image.profile);
+        if (seq != 0 && imageStore.write(seq, frame.buf)) {
+            imageStore.setClass(seq, image.edgeLabel, image.edgeConfidence);
+            if (uploaded == true) {
+                imageStore.setState(seq, IMAGE_STATE_UPLOADED);
+            } else {
+                report.queued = true;
+            }
+            imageStore.checkpoint(false);
+        } else if (seq != 0) {
+            imageStore.setState(seq, IMAGE_STATE_FAILED);
         }
+        report.sdWriteMs = max(millis() - writeStart, 1UL);
+    }
+    taskReportUpload(report);
+}
+
+/* taskDrainQueue() function
+- Send the oldest image pending in imageStore again with taskUploadImage(), one image per call, on taskUploadWorker()
+    - Called only when no live image is waiting in readyFrames, so the replay never holds back a new upload
+- Rate limit the replay in batches of QUEUE_BATCH_SIZE images every QUEUE_BATCH_INTERVAL_MS
+- Find the record with .oldestPending() method, read its scan ID and stream its image with .openImage() method
+    - Memory use is bounded by queueChunk, whatever the size of the image
+    - Sent with the capture profile and the class of edgeClassifier stored with the image, as the live upload had them
+- Handling HTTP response code with if-else statement
+    - Check if HTTP response code is 1xx to 4xx, the server is done with the image (as for a live upload), set it
+      IMAGE_STATE_UPLOADED, so a refused image (e.g. 404 or 413) never holds up the images queued behind it
+    - Check if the image can not be read back or its profile is not in CAPTURE_PROFILES, set it IMAGE_STATE_FAILED
+      so the replay moves on
+    - Otherwise keep the image and wait for the next batch before trying again
+- Hand the HTTP response code and the time over to loop() with taskReportUpload(), as slot -1
+- Return true if an image was sent
+*/
+bool taskDrainQueue() {
+    if (initStore == false || imageStore.pending() == 0) {
+        return false;
+    }
+    if (queueBatchCount >= QUEUE_BATCH_SIZE) {
+        if (millis() - queueBatchStart < QUEUE_BATCH_INTERVAL_MS) {
+            return false;
+        }
+        queueBatchCount = 0;
+    }
+    if (queueBatchCount == 0) {
+        queueBatchStart = millis();
+    }
+    queueBatchCount++;
+
+    uint32_t seq = imageStore.oldestPending();
+    char queuedScanID[SCAN_ID_MAX_LENGTH];
+    size_t queuedSize = 0;
+    int queuedLabel = -1;
+    float queuedConfidence = 0;
+    int queuedProfile = 0;
+    File *file = imageStore.openImage(seq, queuedScanID, sizeof(queuedScanID), queuedSize, queuedLabel,
+                                      queuedConfidence, queuedProfile);
+    if (file == NULL || queuedProfile >= (int)(sizeof(CAPTURE_PROFILES) / sizeof(CAPTURE_PROFILES[0]))) {
+        imageStore.setState(seq, IMAGE_STATE_FAILED);
+        return false;
     }
+    unsigned long replayStart = millis();
+    int httpResponseCode = taskUploadImage(queuedScanID, queuedProfile, 0, queuedLabel, queuedConfidence, NULL, file,
+                                           queuedSize);
+    UploadReport report = {-1, httpResponseCode, millis() - replayStart, 0, 0, false, queuedSize};
 
-    clientESP32CAM.end();
-    doHTTPPOSTimage = false;
+    if (httpResponseCode > 0 && httpResponseCode < 500) {
+        imageStore.setState(seq, IMAGE_STATE_UPLOADED);
+        imageStore.checkpoint(false);
+    } else {
+        queueBatchCount = QUEUE_BATCH_SIZE;
+    }
+    taskReportUpload(report);
+    return true;
+}
+
+/* taskUploadWorker() function
+- FreeRTOS task created by setup() on core 0, next to the Wi-Fi stack, loop() captures on core 1 meanwhile
+- Wait for camera and MicroSD card with xEventGroupWaitBits() function (BOOT_LOCAL)
+- Take the next slot from readyFrames and send it with taskHTTPPOSTimage() function
+- With no live image waiting:
+    - Send one queued image again with taskDrainQueue() function, only if Wi-Fi is connected and replayReady
+    - Checkpoint the index of imageStore every STORE_CHECKPOINT_MS with .checkpoint() method, whatever changed
+    - Wait for the next slot with xSemaphoreTake() function on uploadWake, UPLOAD_IDLE_MS at most
+*/
+void taskUploadWorker(void *) {
+    xEventGroupWaitBits(bootReady, BOOT_LOCAL, pdFALSE, pdTRUE, portMAX_DELAY);
+    for (;;) {
+        int slot = -1;
+        if (readyFrames.pop(slot)) {
+            taskHTTPPOSTimage(slot);
+            continue;
+        }
+        if (wifiLink.connected() && replayReady == true && taskDrainQueue()) {
+            continue;
+        }
+        if (initStore == true && millis() - lastStoreCheckpoint >= STORE_CHECKPOINT_MS) {
+            imageStore.checkpoint(true);
+            lastStoreCheckpoint = millis();
+        }
+        xSemaphoreTake(uploadWake, pdMS_TO_TICKS(UPLOAD_IDLE_MS));
+    }
+}
+
+/* taskCollectUploads() function
+- Take the reports of taskUploadWorker() from uploadReports, on loop(), the only task touching metrics and the camera
+- Image sent again from imageStore (slot -1): record replay and the HTTP response code in metrics
+- Live image:
+    - Record sd_write if a copy was written, count images_queued if it is kept to send again
+    - If it was sent: record upload and the HTTP response code, and capture_to_upload if it got through
+    - Adapt the JPEG quality to the measured upload time with taskAdaptJpegQuality() if it got through
+    - Show the LED pattern of the HTTP response code with taskShowPattern(), played in the background
+    - Give the slot back with imagePool.release() method, the next image can be captured into it
+*/
+void taskCollectUploads() {
+    UploadReport report;
+    while (uploadReports.pop(report)) {
+        if (report.slot < 0) {
+            metrics.record("replay", report.uploadMs);
+            metrics.countHTTP(report.httpCode);
+            continue;
+        }
+        if (report.sdWriteMs > 0) {
+            metrics.record("sd_write", report.sdWriteMs);
+        }
+        if (report.queued == true) {
+            metrics.count("images_queued");
+        }
+        if (report.httpCode != 0) {
+            if (report.captureToUploadMs > 0) {
+                taskAdaptJpegQuality(report.imageSize, report.uploadMs);
+                metrics.record("capture_to_upload", report.captureToUploadMs);
+            }
+            metrics.record("upload", report.uploadMs);
+            metrics.countHTTP(report.httpCode);
+        }
+
+        if (report.httpCode == 201) {
+            taskShowPattern(LED_PATTERN_UPLOADED);
+        } else if (report.httpCode == 400) {
+            taskShowPattern(LED_PATTERN_BAD_REQUEST);
+        } else if (report.httpCode == 500) {
+            taskShowPattern(LED_PATTERN_SERVER_ERROR);
+        }
+        imagePool.release(report.slot);
+    }
+}
+
+/* taskBootProgress() function
+- Function to follow the boot from loop(), until every part is ready
+- Set BOOT_WIFI once wifiLink is connected for the first time
+- Once every part is ready, keep the power-on-to-ready time in bootReadyMs, record it in metrics as boot
+  and print it with the time each part got ready
+*/
+void taskBootProgress() {
+    if (bootReadyMs != 0) {
+        return;
+    }
+    EventBits_t ready = xEventGroupGetBits(bootReady);
+    if ((ready & BOOT_WIFI) == 0 && wifiLink.connected()) {
+        taskBootDone(BOOT_WIFI);
+        ready |= BOOT_WIFI;
+    }
+    if ((ready & BOOT_ALL) != BOOT_ALL) {
+        return;
+    }
+    bootReadyMs = max(millis(), 1UL);
+    metrics.record("boot", bootReadyMs);
+    Serial.println("Ready after " + String(bootReadyMs) + " ms: camera " + String(bootPartMs[0]) + " ms, MicroSD " +
+                   String(bootPartMs[1]) + " ms, Wi-Fi " + String(bootPartMs[2]) + " ms");
 }
 
 /* setup() function
-- Function to initialize the device
-- Initialize EEPROM memory with .begin() method in size of EEPROM_SIZE
+- Function to start the device, returns before the boot is done, see the boot config
+- Initialize the serial monitor using .begin() method
 - Disable brownout detection with WRITE_PERI_REG() function
-- Call taskInitCamera() function to initialize camera
-- Call taskInitMicroSD() function to initialize MicroSD card
-- Configure GPIO pin for Wi-Fi connection indicator
-- Implementing error handling with while loop
-    - Loop breaks if Wi-Fi is connected
-    - Reconnect to Wi-Fi every 3 seconds if Wi-Fi is not connected
+- Create bootReady, start connecting to Wi-Fi with wifiLink.begin() method first, fast if the access point and lease
+  of the last connection are in NVS, it connects in the background from here on
+- Start taskBootCamera() on core 0 and taskBootStorage() on core 1 with xTaskCreatePinnedToCore() function,
+  camera and MicroSD card start in parallel
+- Create uploadWake and start taskUploadWorker() on core 0, it waits for the boot by itself
+- Call taskParsePredictURL() function to prepare the image upload
+- Start listening for the LAN trigger with .begin() method on LOCAL_TRIGGER_PORT
+- Configure GPIO pin for Wi-Fi connection indicator, create ledPatterns and taskLEDWorker() to drive it
+- Start the metrics endpoint with metricsServer.begin() method, watch uploadRetries, the connection counters of
+  connectionManager and uploadConnection, the counters of imageStore and of wifiLink
 */
 void setup() {
     delay(100);
 
-    EEPROM.begin(EEPROM_SIZE);
+    Serial.begin(115200);
+
     WRITE_PERI_REG(RTC_CNTL_BROWN_OUT_REG, 0);
-    
-    taskInitCamera();
 
-    taskInitMicroSD();
+    bootReady = xEventGroupCreate();
+
+    wifiLink.begin(ssid, password);
+
+    xTaskCreatePinnedToCore(taskBootCamera, "taskBootCamera", 4096, NULL, 1, NULL, 0);
+    xTaskCreatePinnedToCore(taskBootStorage, "taskBootStorage", 8192, NULL, 1, NULL, 1);
+
+    uploadWake = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(taskUploadWorker, "taskUploadWorker", 8192, NULL, 1, NULL, 0);
+
+    taskParsePredictURL();
+
+    triggerUDP.begin(LOCAL_TRIGGER_PORT);
 
     pinMode(INDICATOR_PIN, OUTPUT);
 
     digitalWrite(INDICATOR_PIN, HIGH);
 
-    WiFi.begin(ssid, password);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(3000);
-    }
+    ledPatterns = xQueueCreate(LED_QUEUE_LENGTH, sizeof(int));
+    xTaskCreatePinnedToCore(taskLEDWorker, "taskLEDWorker", 2048, NULL, 1, NULL, 0);
+
+    metricsServer.begin();
+    metrics.watch("connections_new", &connectionManager.stats().connectionMisses);
+    metrics.watch("reconnects", &connectionManager.stats().reconnects);
+    metrics.watch("upload_retries", &uploadRetries);
+    metrics.watch("upload_connections_new", &uploadConnection.stats().connectionMisses);
+    metrics.watch("upload_reconnects", &uploadConnection.stats().reconnects);
+    metrics.watch("images_dropped", &imageStore.stats().dropped);
+    metrics.watch("store_checkpoints", &imageStore.stats().checkpoints);
+    metrics.watch("wifi_lost", &wifiLink.stats().linkLosses);
+    metrics.watch("wifi_fast_connects", &wifiLink.stats().fastConnects);
 }
 
 /* loop() function
 - Function to run the device, repeatedly
 - Implementing error handling using if-else statement
-    - in case the device is offline, it will reconnect to Wi-Fi network before doing anything else
     - only executing the HTTP request task when the Wi-Fi is connected
-- Ensure chained, serial execution of the task by checking the flag value in each if-else statement
+    - LAN trigger is checked on every pass, the cloud status every STATUS_POLL_MS (STATUS_POLL_FALLBACK_MS)
+    - in case the device is offline, the loop keeps running while Wi-Fi reconnects in the background
+        - the local part keeps running: the motion trigger captures and classifies as before (OFFLINE_MOTION_TRIGGER
+          turns it on while offline, the button trigger needs the network), taskUploadWorker() keeps the images in
+          imageStore and sends them once Wi-Fi is back, after the first status poll (replayReady)
+- One capture per pass: the cloud status is only polled while no image waits in imageSlot and a slot of imagePool is free
+- Online or not:
+    - Classify a new image with taskClassifyImage() and hand it to taskUploadWorker() with taskHandOverImage(),
+      the upload runs on core 0 while loop() goes on
+    - Collect the results of taskUploadWorker() with taskCollectUploads()
+    - Watch the chute with taskWatchMotion() once the image is handed over
+- Send an unacknowledged motion notice again with taskRepeatMotionNotice() while online
+- Answer a request on the metrics endpoint with metrics.serve() method
+- Call wifiLink.poll() method on every pass, online or not, record the time of a new connection in metrics
+- Follow the boot with taskBootProgress() function, wait up to 10 ms for BOOT_LOCAL with xEventGroupWaitBits() function,
+  nothing else runs until camera and MicroSD card are ready
+- Print the connection counters of connectionManager and uploadConnection, the capture profile in use and metrics
+  every minute
 */
 void loop() {
-    if (WiFi.status() == WL_CONNECTED) {
-        digitalWrite(INDICATOR_PIN, LOW); // Turn on Indicator LED, Wi-Fi is connected
-        delay(2000); // Delay for each HTTP GET request
-        taskHTTPGETtrigger(); // Check for trigger to capture image with HTTP GET request
-        if (doHTTPPOSTimage == true) {
-            taskHTTPPOSTimage(imagePath); // Send image to cloud server with HTTP POST request
+    unsigned long wifiConnectMs = 0;
+    if (wifiLink.poll(wifiConnectMs)) {
+        metrics.record("wifi_connect", wifiConnectMs); // Wi-Fi connected again, cache of the link written if it changed
+    }
+    taskBootProgress(); // Boot bits, power-on-to-ready time once every part is ready
+    if ((xEventGroupWaitBits(bootReady, BOOT_LOCAL, pdFALSE, pdTRUE, pdMS_TO_TICKS(10)) & BOOT_LOCAL) != BOOT_LOCAL) {
+        return; // Camera or MicroSD card still starting
+    }
+    if (wifiLink.connected()) {
+        lastOnline = millis();
+        taskSetIndicator(true); // Turn on Indicator LED, Wi-Fi is connected
+        taskUDPtrigger(); // Check for trigger sent by ESP32-S3 over the LAN, on every pass
+        taskRepeatMotionNotice(); // ESP32-S3 did not acknowledge the last motion capture yet
+        unsigned long statusPollInterval = localTriggerSeen ? STATUS_POLL_FALLBACK_MS : STATUS_POLL_MS;
+        if (imageSlot < 0 && imagePool.available() > 0 && millis() - lastStatusPoll >= statusPollInterval) {
+            lastStatusPoll = millis();
+            taskHTTPGETtrigger(); // Check for trigger to capture image with HTTP GET request
+            replayReady = true; // A pending cloud trigger is picked up, taskUploadWorker() may send stored images again
+        }
+        metrics.serve(metricsServer); // Answer GET /metrics, if someone asks
+        if (millis() - lastStatsLog >= 60000) {
+            Serial.print("Status poll ");
+            connectionManager.printStats(Serial); // Connection reuse and DNS cache counters
+            Serial.print("Upload ");
+            uploadConnection.printStats(Serial);
+            Serial.println("Capture profile: " + String(CAPTURE_PROFILES[captureProfile].name) + ", JPEG quality " +
+                           String(jpegQuality) + ", upload " + String(uploadKBps, 1) + " KB/s");
+            Serial.print("Metrics: ");
+            metrics.printJSON(Serial);
+            Serial.println();
+            lastStatsLog = millis();
         }
     } else {
-        digitalWrite(INDICATOR_PIN, HIGH); // Turn off LED, Wi-Fi is disconnected
-        do {
+        taskSetIndicator(false); // Turn off LED, Wi-Fi is disconnected, wifiLink reconnects on the event of the driver
+        replayReady = false;
+        if (millis() - lastReconnectLog >= 3000) {
             Serial.println("Reconnecting to Wi-Fi...");
-            delay(3000);
-        } while (WiFi.status() != WL_CONNECTED);
+            lastReconnectLog = millis();
+        }
     }
-}
\ No newline at end of file
+    if (imageSlot >= 0) {
+        taskClassifyImage(imageSlot); // Classify on the board, ESP32-S3 gets the result before the upload starts
+        taskHandOverImage(); // taskUploadWorker() streams it to cloud server on core 0, or keeps it while offline
+    }
+    taskCollectUploads(); // Record the uploads done meanwhile and give their slots back
+    taskWatchMotion(); // Next grayscale frame for the motion trigger, if it is enabled or Wi-Fi is down
+    delay(10);
+}
@@ -11,413 +11,1627 @@
 // Servo motor library for controlling the servo motor with ESP32
 #include <ESP32Servo.h>
 
+// Library for the motion model of the servo motors, how long a move takes from the angle delta (TArS-common)
+#include <ServoMotion.h>
+
 // Network library (Connect to Wi-Fi and send HTTP request)
 #include <WiFi.h>
 #include <HTTPClient.h>
 
+// Library for sending the trigger straight to ESP32-CAM over the LAN
+#include <WiFiUdp.h>
+
+// Library for keeping HTTP connections to the server alive between requests (TArS-common)
+#include <ConnectionManager.h>
+
+// Library for connecting to Wi-Fi with the access point and lease of the last connection, no scan and no DHCP (TArS-common)
+#include <WiFiLink.h>
+
+// Library for the messages exchanged with ESP32-CAM (TArS-common)
+#include <TArSProtocol.h>
+
+// Library for finding the bin of a class label without a string compare, the table is built by the compiler (TArS-common)
+#include <LabelMap.h>
+
+// Library for the lock-free queue of button presses filled by the interrupt handler (TArS-common)
+#include <RingBuffer.h>
+
+// Library for reading the fields of the server replies straight from the HTTP stream (TArS-common)
+#include <JsonScanner.h>
+
+// Library for keeping the calibrated depth of each trash bin in flash
+#include <Preferences.h>
+
+// Library for the latency histograms and counters served on the metrics endpoint (TArS-common)
+#include <Metrics.h>
+
+// FreeRTOS task, queue, semaphore and event group library, running the HTTP requests and the LCD updates next to the control loop,
+// measuring the bins while Wi-Fi connects at boot
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
 /* LCD config
 - Using 0x27 as I2C address
 - Config the LCD to display in 20 columns and 4 rows
 */
 LiquidCrystal_I2C lcd(0x27, 20, 4);
 
+/* LCD frame buffer config
+- Nothing but taskLCDWorker() writes to the LCD after setup() started it, everything else draws into lcdFrame
+    - lcdShown: what the LCD shows, lcdFrame: what it should show, a cell is dirty while the two differ
+    - Only the dirty cells go over the I2C bus, setCursor() is only sent when a dirty cell does not follow the last one written
+    - lcd.clear() is never used, a screen blanks the rows it does not use with spaces, so the LCD does not flicker
+- Drawing into lcdFrame gives lcdDirty, taskLCDWorker() waits LCD_SETTLE_MS more so a screen drawn in several calls goes out in one pass
+- Screens are templates of LCD_ROWS lines, drawn with taskShowScreen() function, the values are then drawn at their column with taskDrawText()
+*/
+const int LCD_COLS = 20;
+const int LCD_ROWS = 4;
+const int LCD_SETTLE_MS = 2;
+char lcdFrame[LCD_ROWS][LCD_COLS];
+char lcdShown[LCD_ROWS][LCD_COLS];
+SemaphoreHandle_t lcdDirty;
+
+const char *const SCREEN_STARTING[LCD_ROWS] = {"", "     Starting", "    the device", ""};
+const char *const SCREEN_TRASH_TYPE[LCD_ROWS] = {"Type: ", "Put the trash in!", "", ""};
+const int TRASH_TYPE_COLUMN = 6;
+const char *const SCREEN_SENDING[LCD_ROWS] = {"Sending request", "to server ...", "", ""};
+const char *const SCREEN_CAPACITY[LCD_ROWS] = {"Capacity (%): ", "", "", ""};
+
+/* Bin config
+- Include the server URLs and the bin IDs stored in serverCredentials.h
+- BINS: one row per trash bin, the index of its row is the trash type, a bin is added with one row here
+  and its bin ID in serverCredentials.h
+    - name: shown when the trash is sorted, shortName: shown on the capacity screen
+    - labels: class labels of the server and of the edge classifier sorted into the bin, up to BIN_LABELS_MAX,
+      nullptr if fewer
+    - id: address of its bin ID in serverCredentials.h
+    - pipeAngle: angle of the pipe over the bin, trigPin and echoPin: pins of its ultrasonic sensor
+- BIN_LABELS: class label to trash type, built by the compiler from BINS with taskBinLabels(), see LabelMap.h
+- Capacity screen: one bin per row under the title, in columns of CAPACITY_CELL characters once there are more bins
+  than CAPACITY_ROWS, the capacity at CAPACITY_COLUMN of the cell after the short name
+*/
+#include "serverCredentials.h"
+
+const int BIN_LABELS_MAX = 2;
+
+struct BinConfig {
+    const char *name;
+    const char *shortName;
+    const char *labels[BIN_LABELS_MAX];
+    const char *const *id;
+    int pipeAngle;
+    int trigPin;
+    int echoPin;
+};
+
+constexpr BinConfig BINS[] = {
+    {"Cardboard", "Cardboard", {"paper", "cardboard"}, &cardboardBinID, 70, 4, 5},
+    {"Metal Can", "Metal Can", {"metal", nullptr}, &metalCanBinID, 90, 6, 7},
+    {"Plastic Bottle", "Plastic", {"plastic", nullptr}, &plasticBinID, 110, 1, 2},
+};
+const int BIN_COUNT = sizeof(BINS) / sizeof(BINS[0]);
+static_assert(BIN_COUNT <= 16, "ultrasonicPending keeps one bit per bin");
+
+typedef LabelMap<labelSlotsFor(BIN_COUNT * BIN_LABELS_MAX)> BinLabels;
+
+// taskBinLabels() function, to map every label of BINS to its trash type, run by the compiler
+constexpr BinLabels taskBinLabels() {
+    BinLabels map;
+    for (int bin = 0; bin < BIN_COUNT; bin++) {
+        for (const char *label : BINS[bin].labels) {
+            if (label != nullptr) {
+                map.add(label, bin);
+            }
+        }
+    }
+    return map;
+}
+
+constexpr BinLabels BIN_LABELS = taskBinLabels();
+static_assert(BIN_LABELS.valid(), "a label of BINS is in two bins, or two labels have the same hash");
+
+const int CAPACITY_ROWS = LCD_ROWS - 1;
+const int CAPACITY_CELL = LCD_COLS / ((BIN_COUNT + CAPACITY_ROWS - 1) / CAPACITY_ROWS);
+const int CAPACITY_COLUMN = CAPACITY_CELL - 4 < 11 ? CAPACITY_CELL - 4 : 11;
+static_assert(CAPACITY_CELL >= 10, "the capacity screen shows up to two columns of bins");
+
 /* Servo motor config
 - Using pin 8 as PWM transmitter servo motor to move the sorting pipe
 - Using pin 21 as PWM transmitter servo motor to move the trash bin gate
-- If Cardboard waste detected, the pipe will move to 70 degrees
-- If Metal Can waste detected, the pipe will move to 90 degrees
-- If Plastic Bottle waste detected, the pipe will move to 110 degrees
+- The pipe moves to the pipeAngle of the bin of the trash type in BINS
+- PIPE_INITIAL_ANGLE: angle of the pipe at power-on and while no scan waits for it
+- The gate is open at GATE_OPEN_ANGLE and closed at GATE_CLOSED_ANGLE
 - Creating object instance for each servo motor: servoPipe and servoGate
+- Creating a motion model for each servo motor: pipeMotion and gateMotion, see ServoMotion.h
+    - SERVO_DEG_PER_S: MG996R under load, about 0.2 s per 60 degrees, SERVO_SETTLE_MS for the horn to stop
+    - Every move goes through taskMoveServo(), which knows how long it takes, instead of a fixed wait
 */
 const int PIPE_PWM_PIN = 8;
 const int GATE_PWM_PIN = 21;
 Servo servoPipe;
 Servo servoGate;
-const int CARDBOARD = 70;
-const int METAL_CAN_OR_INITIAL = 90;
-const int PLASTIC_BOTTLE = 110;
+const int PIPE_INITIAL_ANGLE = 90;
+const int GATE_OPEN_ANGLE = 90;
+const int GATE_CLOSED_ANGLE = 0;
+
+const float SERVO_DEG_PER_S = 300;
+const unsigned long SERVO_SETTLE_MS = 40;
+ServoMotion pipeMotion(SERVO_DEG_PER_S, SERVO_SETTLE_MS);
+ServoMotion gateMotion(SERVO_DEG_PER_S, SERVO_SETTLE_MS);
 
 /* Ultrasonic sensor config
-- Mapping the trigger and echo pin for each ultrasonic sensor
-- Pin 4 and 5 for sensor placed to measure the cardboard trash bin capacity
-- Pin 6 and 7 for sensor placed to measure the metal can trash bin capacity
-- Pin 1 and 2 for sensor placed to measure the plastic bottle trash bin capacity
+- One sensor per trash bin, its trigger and echo pin are in BINS
 - Declaring an array to store the capacity of each trash bin
+- Measurements run in the background, taskServiceUltrasonic() is called by loop() and never waits for an echo
+    - The echo pin interrupt (taskEchoISR) stores the micros() value of both edges, no pulseIn()
+    - One sensor pings at a time, ULTRASONIC_GAP_MS after the previous ping so it cannot hear the echo of another bin
+    - The sensors take turns, ULTRASONIC_SAMPLES pings per bin, at most ULTRASONIC_MAX_PINGS
+    - No echo after ULTRASONIC_TIMEOUT_US (the bin is a few dozen cm deep) is a lost ping
+    - Result: mean of the pings within ULTRASONIC_OUTLIER_CM of the median, needs ULTRASONIC_MIN_VALID of them,
+      the capacity of a bin keeps its last value if a measurement fails
+- UltrasonicSensor: pins (copied from BINS by setup()), calibrated depth of the empty bin, echo edges, the pings of the running measurement
+  and its result (distanceCm, -1 if it failed)
+    - depthCm: distance to the bottom of the empty bin, measured once and kept in Preferences (namespace "ultrasonic")
+    - Calibrated on the first boot, or again when the button is held down at power-on after the bins were emptied
+- ultrasonicPending: bit per bin still to be measured, ultrasonicActive: sensor waiting for its echo, -1 if none
 */
-const int TRIG_PIN_0 = 4; const int ECHO_PIN_0 = 5;
-const int TRIG_PIN_1 = 6; const int ECHO_PIN_1 = 7;
-const int TRIG_PIN_2 = 1; const int ECHO_PIN_2 = 2;
-int capacity[3];
+int capacity[BIN_COUNT];
+
+const int ULTRASONIC_SAMPLES = 5;
+const int ULTRASONIC_MAX_PINGS = 8;
+const int ULTRASONIC_MIN_VALID = 3;
+const float ULTRASONIC_OUTLIER_CM = 2.0;
+const unsigned long ULTRASONIC_TIMEOUT_US = 25000;
+const unsigned long ULTRASONIC_GAP_MS = 25;
+const float ULTRASONIC_DEFAULT_DEPTH_CM = 50.0;
+
+struct UltrasonicSensor {
+    int trigPin;
+    int echoPin;
+    float depthCm;
+    volatile unsigned long echoRise;
+    volatile unsigned long echoFall;
+    float samples[ULTRASONIC_MAX_PINGS];
+    int sampleCount;
+    int pingCount;
+    float distanceCm;
+};
+
+UltrasonicSensor ultrasonicSensors[BIN_COUNT];
+Preferences preferences;
+int ultrasonicPending = 0;
+int ultrasonicActive = -1;
+int ultrasonicNext = 0;
+unsigned long ultrasonicPingStart = 0;
+unsigned long ultrasonicLastPing = 0;
+unsigned long ultrasonicFailures = 0;
 
 /* Network config
 - Include the Wi-Fi credentials stored in wifiCredentials.h
-- Include the server URL stored in serverCredentials.h
-- Setting up flag as boolean variable to control the HTTP request
-    - doHTTPPOSTtrigger: to trigger the camera to capture the image
-    - doHTTPGETprediction: to get the prediction result from the server
-    - doHTTPPOSTcapacity: to update the capacity of the trash bin to the server
 - Creating object instance of HTTPClient: clientESP32S3
-- Declaring a string variable to store the HTTP payload
-- Declaring a variable to store the encoded prediction result
+- Creating object instance of ConnectionManager: connectionManager
+    - Every request goes through it, the socket to the server is kept open between requests
+    - lastStatsLog: millis() value of the last print of the connection counters
+- Creating object instance of WiFiLink: wifiLink
+    - Connects and reconnects on the events of the Wi-Fi driver, straight to the access point of the last connection
+      with its IP lease, see WiFiLink.h
+- Scan correlation, so the S3 only ever sorts on the result of its own image
+    - Every scan has a unique scanID, sent with the trigger and echoed by ESP32-CAM with the image
+    - scanCounter: number of scans since boot, part of scanID
+    - PREDICTION_TIMEOUT_MS: a scan is given up if its prediction is not there after this long
+    - Prediction requests are retried with a backoff, from PREDICTION_BACKOFF_MIN_MS doubling up to PREDICTION_BACKOFF_MAX_MS
+    - PREDICTION_LONG_POLL_S: how long the server may hold a request until the result is ready
+    - HTTP_TIMEOUT_MS: read timeout of every other request on clientESP32S3, the default of HTTPClient
+- LAN trigger, see TArSProtocol.h
+    - LOCAL_TRIGGER_ENABLED: send the trigger to ESP32-CAM over UDP first, the server is only the fallback
+    - triggerUDP: object instance of WiFiUDP, bound to LOCAL_TRIGGER_PORT
+    - camAddress: IP address of ESP32-CAM, learned from its first acknowledgement
+    - LOCAL_TRIGGER_ATTEMPTS and LOCAL_TRIGGER_ACK_TIMEOUT_MS: retries before falling back to the server
+- Edge result, see TArSProtocol.h: ESP32-CAM classifies the image itself and sends the result over the LAN
+    - EDGE_SORT_ENABLED: sort on the edge result at all, off by default (shadow mode: the result is only counted
+      in metrics and uploaded with the image, the prediction of the server decides)
+        - The weights in EdgeModel.h are fitted to the simulator's rendered chute frames, not to photos of the real
+          chute, turn it on only with a model trained on real photos, see EdgeModel.h
+    - EDGE_CONFIDENCE_MIN: if EDGE_SORT_ENABLED, a scan is sorted on the edge result at this confidence or above,
+      without waiting for the server, below it the prediction of the server is used as before
+- Motion trigger, see TArSProtocol.h: ESP32-CAM captured an item on its own, the scan starts with its scan ID
 */
 #include "wifiCredentials.h"
-#include "serverCredentials.h"
-bool doHTTPPOSTtrigger = false;
-bool doHTTPGETprediction = false;
-bool doHTTPPOSTcapacity = false;
 HTTPClient clientESP32S3;
-String HTTPpayloadJSON;
-int predictionResult;
+ConnectionManager connectionManager;
+unsigned long lastStatsLog = 0;
+WiFiLink wifiLink;
+unsigned int scanCounter = 0;
+const unsigned long PREDICTION_TIMEOUT_MS = 90000;
+const unsigned long PREDICTION_BACKOFF_MIN_MS = 1000;
+const unsigned long PREDICTION_BACKOFF_MAX_MS = 8000;
+const int PREDICTION_LONG_POLL_S = 10;
+const int HTTP_TIMEOUT_MS = 5000;
+#define LOCAL_TRIGGER_ENABLED true
+WiFiUDP triggerUDP;
+IPAddress camAddress;
+const int LOCAL_TRIGGER_ATTEMPTS = 3;
+const unsigned long LOCAL_TRIGGER_ACK_TIMEOUT_MS = 300;
+#define EDGE_SORT_ENABLED false
+const float EDGE_CONFIDENCE_MIN = 0.85;
+
+/* Scan pipeline config
+- Every button press (or motion capture of ESP32-CAM) becomes a scan job with its own stages, several scans are in the pipeline at once
+    - Classify: trigger ESP32-CAM and wait for the prediction, one scan at a time as there is one camera
+    - Actuate: move the pipe, open and close the gate, one scan at a time as there is one gate
+    - Measure: measure the bin, its capacity goes to the server with the next telemetry batch
+    - The next scan is classified while the gate of the previous one is still moving
+- buttonPresses: RingBuffer of the millis() value of every press, filled by taskButtonISR(), emptied by loop()
+    - A press waits there until the camera is free, none is lost or merged with the scan before it
+- ScanJob: one scan in the pipeline, SCAN_JOB_COUNT of them in scanJobs
+    - stage: what the scan is doing, STAGE_FREE if the job is unused
+    - stageDeadline: millis() value when the timer of the stage expires, 0 = none
+    - scanID, trashType (encoded prediction result, the index of its bin in BINS), reply (fields of the reply to the last prediction request)
+    - predictionDeadline, predictionBackoff, triggerAttempt: as described in the network config
+    - edgeType, edgeConfidence: edge result of ESP32-CAM (encoded like trashType), edgeType -2 until it arrives
+    - measuredQueued: EVENT_MEASURED of the job is in eventQueue, so taskPollEvents() sends it once per measurement,
+      cleared once it is handled and when the stage changes
+    - pressedAt, stageEnteredAt, stageTime: when the button was pressed and the time spent in each stage,
+      printed once the scan is done, shows where the wall-clock time of a scan goes
+- Stage:
+    - STAGE_TRIGGER_LAN: LAN trigger sent, waiting LOCAL_TRIGGER_ACK_TIMEOUT_MS for the acknowledgement
+    - STAGE_TRIGGER_CLOUD: HTTP_JOB_TRIGGER running
+    - STAGE_PREDICTION_BACKOFF: waiting predictionBackoff before asking for the prediction
+    - STAGE_PREDICTION: HTTP_JOB_PREDICTION running
+    - STAGE_READY: classified, waiting for the gate
+    - STAGE_PIPE_MOVE: pipe on its way to the bin, the gate starts to open so that both arrive at the same time
+    - STAGE_GATE_OPEN: gate open, the user puts the trash in, the bin is measured over and over until the deposit is seen
+        - depositBaseCm: distance in the bin before the trash came, measured while the pipe moves, -1 until known
+        - Deposit: the bin reads DEPOSIT_MIN_CM closer than depositBaseCm, the trash is in the bin
+        - Without a deposit the gate closes after GATE_OPEN_MS (bin full, flat trash, no echo), counted as deposit_timeouts
+    - STAGE_GATE_CLOSE: gate closing, for as long as the gate takes, or GATE_FALL_MS if no deposit was seen
+      as the trash may still be falling
+        - The pipe moves back to PIPE_INITIAL_ANGLE only if no classified scan waits,
+          otherwise it stays or goes straight to the bin of that scan
+    - STAGE_MEASURE: the ultrasonic sensor of the bin is measuring in the background
+- Throughput: itemsSorted since boot, items sorted in the last minute and the best minute so far (peakItemsPerMinute)
+*/
+const int STAGE_FREE = 0;
+const int STAGE_TRIGGER_LAN = 1;
+const int STAGE_TRIGGER_CLOUD = 2;
+const int STAGE_PREDICTION_BACKOFF = 3;
+const int STAGE_PREDICTION = 4;
+const int STAGE_READY = 5;
+const int STAGE_PIPE_MOVE = 6;
+const int STAGE_GATE_OPEN = 7;
+const int STAGE_GATE_CLOSE = 8;
+const int STAGE_MEASURE = 9;
+const int STAGE_COUNT = 10;
+const char *const STAGE_NAMES[STAGE_COUNT] = {
+    "free", "trigger LAN", "trigger cloud", "prediction backoff", "prediction", "ready", "pipe move", "gate open",
+    "gate close", "measure",
+};
+
+struct PredictionReply {
+    char scanID[SCAN_ID_MAX_LENGTH];
+    char detectedType[16];
+    char confidence[12];
+};
+
+struct ScanJob {
+    int stage;
+    unsigned long stageDeadline;
+    String scanID;
+    int trashType;
+    PredictionReply reply;
+    unsigned long predictionDeadline;
+    unsigned long predictionBackoff;
+    int triggerAttempt;
+    int edgeType;
+    float edgeConfidence;
+    bool measuredQueued;
+    float depositBaseCm;
+    unsigned long pressedAt;
+    unsigned long stageEnteredAt;
+    unsigned long stageTime[STAGE_COUNT];
+};
+
+const int SCAN_JOB_COUNT = 4;
+ScanJob scanJobs[SCAN_JOB_COUNT];
+RingBuffer<unsigned long, 8> buttonPresses;
+
+const unsigned long GATE_OPEN_MS = 3000;
+const unsigned long GATE_FALL_MS = 2000;
+const float DEPOSIT_MIN_CM = 1.0;
+
+unsigned long itemsSorted = 0;
+unsigned long itemsSortedAtLastLog = 0;
+unsigned long peakItemsPerMinute = 0;
+
+/* Asynchronous HTTP config
+- Every HTTP request runs on taskHTTPWorker(), a FreeRTOS task on core 0, so loop() never waits for the server
+- HTTPJob: request handed over through httpJobQueue, run one after the other
+    - kind: HTTP_JOB_TRIGGER (taskHTTPPOSTtrigger), HTTP_JOB_PREDICTION (taskHTTPGETprediction)
+      or HTTP_JOB_TELEMETRY (taskHTTPPOSTcapacity with the telemetry batch)
+    - job: index of the scan job in scanJobs, answered with EVENT_HTTP_DONE for the same job
+      (-1 for HTTP_JOB_TELEMETRY, answered with EVENT_TELEMETRY_DONE)
+- A scan job has at most one request in flight, its scanID and reply are not touched by loop() until it is done
+- httpJobQueue holds one request per scan job and the telemetry batch, xQueueSend() never has to wait
+*/
+struct HTTPJob {
+    int kind;
+    int job;
+};
+
+const int HTTP_JOB_TRIGGER = 0;
+const int HTTP_JOB_PREDICTION = 1;
+const int HTTP_JOB_TELEMETRY = 2;
+QueueHandle_t httpJobQueue = NULL;
+
+/* Capacity telemetry config
+- The capacity of every bin goes to the server in batches, taskSampleTelemetry() looks at capacity[] on every pass of loop()
+    - A reading is only queued if the bin changed by TELEMETRY_DELTA_PCT or more since the last queued reading,
+      or if it was not queued for TELEMETRY_HEARTBEAT_MS, so the server still sees that the sensor is alive
+- TelemetryReading: bin, capacity and millis() value of the reading, up to TELEMETRY_BUFFER_SIZE of them in telemetryReadings
+    - Kept while the server can not be reached (Wi-Fi outage, server error) and sent once it is back
+    - Buffer full: the oldest reading is dropped, or the new one while a batch is in flight (telemetryDropped)
+- taskFlushTelemetry(): one HTTP_JOB_TELEMETRY request with up to TELEMETRY_BATCH_MAX readings, in this format:
+    {"readings":[{"bin_id":"a-bin-id","fullness_level_cm":42,"age_s":12}, ...]}
+    - age_s: seconds between the reading and the request, the device has no wall clock
+    - Sent TELEMETRY_FLUSH_MS after the oldest reading was queued, once TELEMETRY_FLUSH_READINGS are queued,
+      or at once if a bin reached TELEMETRY_URGENT_PCT, so it can be emptied soon
+    - A failed batch is sent again TELEMETRY_RETRY_MS later, a batch the server rejects (400) is dropped
+    - telemetryBody: body of the batch, not touched by loop() while telemetryInFlight readings are being sent
+*/
+struct TelemetryReading {
+    uint8_t bin;
+    uint8_t capacity;
+    unsigned long measuredAt;
+};
+
+const int TELEMETRY_BUFFER_SIZE = 32;
+const int TELEMETRY_BATCH_MAX = 16;
+const int TELEMETRY_FLUSH_READINGS = 8;
+const int TELEMETRY_DELTA_PCT = 5;
+const int TELEMETRY_URGENT_PCT = 90;
+const unsigned long TELEMETRY_FLUSH_MS = 60000;
+const unsigned long TELEMETRY_RETRY_MS = 15000;
+const unsigned long TELEMETRY_HEARTBEAT_MS = 900000;
+const size_t TELEMETRY_READING_MAX_LENGTH = 112;
+TelemetryReading telemetryReadings[TELEMETRY_BUFFER_SIZE];
+int telemetryTail = 0;
+int telemetryCount = 0;
+int telemetryInFlight = 0;
+bool telemetryUrgent = false;
+unsigned long telemetryNextFlush = 0;
+int lastQueuedCapacity[BIN_COUNT];
+unsigned long lastQueuedAt[BIN_COUNT];
+char telemetryBody[32 + TELEMETRY_BATCH_MAX * TELEMETRY_READING_MAX_LENGTH];
+size_t telemetryBodyLength = 0;
+unsigned long telemetrySent = 0;
+unsigned long telemetryDropped = 0;
+
+/* Event config
+- loop() is driven by the events in eventQueue instead of flags and delay()
+- Event: what happened, to which scan job (job), the HTTP response code of EVENT_HTTP_DONE (value)
+  and how long the request took (elapsedMs)
+    - EVENT_HTTP_DONE: the request handed to taskHTTPWorker() is finished
+    - EVENT_LAN_ACK: ESP32-CAM acknowledged the LAN trigger of the job
+    - EVENT_EDGE_RESULT: the edge result of the job arrived, stored in the job by taskPollEvents()
+    - EVENT_TIMEOUT: the timer of the stage of the job expired
+    - EVENT_MEASURED: the measurement of the bin of the job is finished
+    - EVENT_TELEMETRY_DONE: the telemetry batch is sent, not tied to a job
+    - EVENT_WIFI_LOST and EVENT_WIFI_UP: change of the Wi-Fi connection, not tied to a job
+- Button presses do not go through eventQueue but through buttonPresses
+- wifiConnected: last Wi-Fi status seen by taskPollEvents(), wifiLink keeps the status of the driver
+- CAPACITY_REFRESH_MS: the capacity of all bins is measured this often, and shown if no scan is running
+    - capacityRefreshRunning: the measurement of all bins is running, shown once it is finished
+- LOOP_TICK_MS: longest time loop() waits for an event, the timers are checked at least this often
+*/
+struct Event {
+    int type;
+    int value;
+    int job;
+    unsigned long elapsedMs;
+};
+
+const int EVENT_HTTP_DONE = 1;
+const int EVENT_LAN_ACK = 2;
+const int EVENT_TIMEOUT = 3;
+const int EVENT_WIFI_LOST = 4;
+const int EVENT_WIFI_UP = 5;
+const int EVENT_MEASURED = 6;
+const int EVENT_TELEMETRY_DONE = 7;
+const int EVENT_EDGE_RESULT = 8;
+
+const int EVENT_QUEUE_LENGTH = 16;
+const unsigned long CAPACITY_REFRESH_MS = 30000;
+const unsigned long LOOP_TICK_MS = 10;
+
+QueueHandle_t eventQueue = NULL;
+unsigned long lastCapacityRefresh = 0;
+bool capacityRefreshRunning = false;
+bool wifiConnected = false;
+
+/* Boot config
+- setup() only starts the parts of the boot, they get ready in parallel and each sets its bit in bootReady (event group)
+    - BOOT_SENSORS: depth of each trash bin loaded or calibrated and the capacity measured and shown,
+      by taskBootSensors() on core 0
+    - BOOT_WIFI: wifiLink connected for the first time, set by taskBootProgress()
+- LCD, servos, queues and the workers are ready when setup() returns
+- loop() leaves the ultrasonic sensors and the LCD to taskBootSensors() until BOOT_SENSORS
+- Scans wait for Wi-Fi as before (wifiConnected), presses during the boot wait in buttonPresses
+- bootPartMs: millis() at which each part got ready, in the order of the bits
+- bootReadyMs: power-on until every part was ready, 0 until then, printed and recorded in metrics as boot
+*/
+const EventBits_t BOOT_SENSORS = 1 << 0;
+const EventBits_t BOOT_WIFI = 1 << 1;
+const EventBits_t BOOT_ALL = BOOT_SENSORS | BOOT_WIFI;
+const int BOOT_PARTS = 2;
+
+EventGroupHandle_t bootReady = NULL;
+volatile unsigned long bootPartMs[BOOT_PARTS] = {0, 0};
+unsigned long bootReadyMs = 0;
+
+/* Metrics config
+- metrics: latency histograms and counters of the device, see Metrics.h
+    - Printed on Serial0 every minute and served by metricsServer on METRICS_PORT (GET /metrics)
+    - Only touched by loop(), taskHTTPWorker() hands the time of a request over with its event
+- Latency of every scan, recorded once it is done by taskRecordScan() function
+    - camera_wait: press until the camera was free for the scan, trigger: until ESP32-CAM got the trigger (LAN or cloud)
+    - inference_wait: from then until the prediction arrived, including the backoff between requests
+    - Sorted scans only: cycle (press until done), gate_wait (classified until the gate was free),
+      kinematics (pipe move, gate open and closing), measure (bin measurement)
+- Latency and response code of every HTTP request: http_trigger, http_prediction, http_capacity
+- Latency of every Wi-Fi connection, Wi-Fi started or lost until connected again: wifi_connect, handed over by wifiLink.poll()
+- Power-on until every part of the boot was ready: boot
+- Counters: LAN trigger retries, cloud fallbacks, prediction retries, failed scans, gates closed without a deposit,
+  scans sorted on the edge result (edge_sorted) and edge results below EDGE_CONFIDENCE_MIN (edge_unsure),
+  scans started by a motion capture of ESP32-CAM (motion_scans),
+  plus the counters of connectionManager, wifiLink (Wi-Fi losses, fast connects), the ultrasonic sensors and the telemetry,
+  watched where they are kept
+*/
+Metrics metrics("s3");
+WiFiServer metricsServer(METRICS_PORT);
 
 /* Interrupt config
-- Interrupt handle to set the flag value when the button is pressed
-- Button is used to update the value in server
-- The value is used by ESP32-CAM to capture the image
+- Interrupt handle to queue the button press in buttonPresses
+- Button is used to start a scan
+- ESP32-CAM captures the image of the scan
+- A press less than BUTTON_LOCKOUT_MS after the last one is a bounce or a double press, it is not queued
+    - Shorter than the fastest cycle (press until the gate closes behind the trash), the next user is not ignored
 */
 const int BUTTON_PIN = 47;
+const unsigned long BUTTON_LOCKOUT_MS = 1000;
 unsigned long button_time = 0;
 unsigned long last_button_time = 0;
 
-/* taskUltrasonicTXRX() function
-- Function to handle the transmission and reception of the ultrasonic sensor
-- Has two parameters: triggerPin and echoPin
-- Has three local variables: duration, distance, and readingResult
-- Emitting pulse for 10us via the triggerPin with digitalWrite() function
-- Reading the bounce-back signal from the echoPin with pulseIn() function
-- Calculating the capacity of the trash bin and store it in the capacity array
-*/
-void taskUltrasonicTXRX(int triggerPin, int echoPin) {
-    long duration;
-    float distance;
-    float readingResult;
-
-    digitalWrite(triggerPin, LOW); delayMicroseconds(2);
-    digitalWrite(triggerPin, HIGH); delayMicroseconds(10);
-    digitalWrite(triggerPin, LOW); delayMicroseconds(2);
-    duration = pulseIn(echoPin, HIGH);
-    distance = (duration * 0.0343) / 2;
-    switch (echoPin) {
-        case 5:
-        readingResult = round((1 - (distance / 50)) * 100);
-        capacity[0] = (int)readingResult;
-        break;
-        case 7:
-        readingResult = round((1 - (distance / 50)) * 100);
-        capacity[1] = (int)readingResult;
-        break;
-        case 2:
-        readingResult = round(( 1- (distance / 50)) * 100);
-        capacity[2] = (int)readingResult;
-        break;
+// taskEchoISR() function, to timestamp both edges of the echo pin of the sensor in `arg`, called on CHANGE
+void IRAM_ATTR taskEchoISR(void *arg) {
+    UltrasonicSensor *sensor = (UltrasonicSensor *)arg;
+    if (digitalRead(sensor->echoPin) == HIGH) {
+        sensor->echoRise = micros();
+    } else if (sensor->echoRise != 0) {
+        sensor->echoFall = micros();
     }
 }
 
-/* taskKinematics() function
-- Function to handle the kinematics of the servo motor
-- Has one parameter: trashType, store the encoded prediction result
-    - 0: Cardboard
-    - 1: Metal Can
-    - 2: Plastic Bottle
-- Implementing switch-case to handle the servo motor movement based on the trash type
-- Display the type of trash detected on the LCD using lcd.print() function
-- Move the pipe to the designated angle based on the trash type using servoPipe.write()
-- Open the gate to allow the trash to fall into the trash bin using servoGate.write()
-- Tell the user to put the trash in the pipe using lcd.print() function
-- Close the gate after the trash is detected using servoGate.write()
-*/
-void taskKinematics(int trashType) {
-    switch (trashType) {
-        case 0:
-            lcd.clear();
-            lcd.setCursor(0, 0); lcd.print("Type: Cardboard");
-            servoPipe.write(CARDBOARD);
-            servoGate.write(90);
-            lcd.setCursor(0, 1); lcd.print("Put the trash in!");
-            delay(3000);
-            servoGate.write(0);
-            delay(2000);
-            servoPipe.write(METAL_CAN_OR_INITIAL);
-            break;
-        case 1:
-            lcd.clear();
-            lcd.setCursor(0, 0); lcd.print("Type: Metal Can");
-            servoPipe.write(METAL_CAN_OR_INITIAL);
-            servoGate.write(90);
-            lcd.setCursor(0, 1); lcd.print("Put the trash in!");
-            delay(3000);
-            servoGate.write(0);
-            delay(2000);
-            servoPipe.write(METAL_CAN_OR_INITIAL);
-            break;
-        case 2:
-            lcd.clear();
-            lcd.setCursor(0, 0); lcd.print("Type: Plastic Bottle");
-            servoPipe.write(PLASTIC_BOTTLE);
-            servoGate.write(90);
-            lcd.setCursor(0, 1); lcd.print("Put the trash in!");
-            delay(3000);
-            servoGate.write(0);
-            delay(2000);
-            servoPipe.write(METAL_CAN_OR_INITIAL);
-            break;
+// taskStartMeasurement() function, to measure the bins in binMask (bit 0 = cardboard) in the background
+void taskStartMeasurement(int binMask) {
+    for (int i = 0; i < BIN_COUNT; i++) {
+        if ((binMask & (1 << i)) != 0 && (ultrasonicPending & (1 << i)) == 0) {
+            ultrasonicSensors[i].sampleCount = 0;
+            ultrasonicSensors[i].pingCount = 0;
+        }
+    }
+    ultrasonicPending |= binMask;
+}
+
+/* taskFinishMeasurement() function
+- Function to filter the pings of bin `bin` once it has enough of them
+- Sorting the samples (a handful, insertion sort) and taking the median
+- Averaging the samples within ULTRASONIC_OUTLIER_CM of the median, a stray reflection or a crosstalk echo reads short
+- Calculating the capacity of the trash bin against its calibrated depth and store it in the capacity array
+*/
+void taskFinishMeasurement(int bin) {
+    UltrasonicSensor &sensor = ultrasonicSensors[bin];
+    ultrasonicPending &= ~(1 << bin);
+    sensor.distanceCm = -1;
+    if (sensor.sampleCount < ULTRASONIC_MIN_VALID) {
+        ultrasonicFailures++;
+        return;
+    }
+    for (int i = 1; i < sensor.sampleCount; i++) {
+        float sample = sensor.samples[i];
+        int j = i;
+        for (; j > 0 && sensor.samples[j - 1] > sample; j--) {
+            sensor.samples[j] = sensor.samples[j - 1];
+        }
+        sensor.samples[j] = sample;
+    }
+    float median = sensor.samples[sensor.sampleCount / 2];
+    float sum = 0;
+    int kept = 0;
+    for (int i = 0; i < sensor.sampleCount; i++) {
+        if (fabs(sensor.samples[i] - median) <= ULTRASONIC_OUTLIER_CM) {
+            sum += sensor.samples[i];
+            kept++;
+        }
+    }
+    if (kept < ULTRASONIC_MIN_VALID) {
+        ultrasonicFailures++;
+        return;
+    }
+    sensor.distanceCm = sum / kept;
+    capacity[bin] = constrain((int)round((1 - sensor.distanceCm / sensor.depthCm) * 100), 0, 100);
+}
+
+/* taskServiceUltrasonic() function
+- Function to move the background measurement one step forward, called by loop() on every pass, returns at once
+- Waiting sensor: take its echo once the falling edge is there, or count a lost ping after ULTRASONIC_TIMEOUT_US
+- No waiting sensor: ULTRASONIC_GAP_MS after the last ping, emit the 10us trigger pulse of the next pending bin
+  with digitalWrite() function, the bins take turns so consecutive pings of one sensor are further apart
+*/
+void taskServiceUltrasonic() {
+    if (ultrasonicActive != -1) {
+        UltrasonicSensor &sensor = ultrasonicSensors[ultrasonicActive];
+        unsigned long echoFall = sensor.echoFall;
+        if (echoFall != 0) {
+            sensor.samples[sensor.sampleCount++] = ((echoFall - sensor.echoRise) * 0.0343) / 2;
+        } else if (micros() - ultrasonicPingStart < ULTRASONIC_TIMEOUT_US) {
+            return;
+        }
+        sensor.pingCount++;
+        if (sensor.sampleCount >= ULTRASONIC_SAMPLES || sensor.pingCount >= ULTRASONIC_MAX_PINGS) {
+            taskFinishMeasurement(ultrasonicActive);
+        }
+        ultrasonicActive = -1;
+        ultrasonicLastPing = millis();
+    }
+
+    if (ultrasonicPending == 0 || millis() - ultrasonicLastPing < ULTRASONIC_GAP_MS) {
+        return;
+    }
+    for (int i = 0; i < BIN_COUNT && ultrasonicActive == -1; i++) {
+        int bin = (ultrasonicNext + i) % BIN_COUNT;
+        if ((ultrasonicPending & (1 << bin)) != 0) {
+            ultrasonicActive = bin;
+        }
     }
+    ultrasonicNext = (ultrasonicActive + 1) % BIN_COUNT;
+    UltrasonicSensor &sensor = ultrasonicSensors[ultrasonicActive];
+    sensor.echoRise = 0;
+    sensor.echoFall = 0;
+    digitalWrite(sensor.trigPin, HIGH); delayMicroseconds(10);
+    digitalWrite(sensor.trigPin, LOW);
+    ultrasonicPingStart = micros();
+}
+
+/* taskCalibrateUltrasonic() function
+- Function to load the depth of each empty trash bin from Preferences
+- Measuring it instead on the first boot or if `recalibrate` is true (button held at power-on), the bins must be empty
+    - Runs the background measurement to the end, only called by taskBootSensors()
+    - A bin that gives no valid reading keeps ULTRASONIC_DEFAULT_DEPTH_CM
+*/
+void taskCalibrateUltrasonic(bool recalibrate) {
+    preferences.begin("ultrasonic", false);
+    if (!recalibrate && preferences.isKey("depth0")) {
+        for (int i = 0; i < BIN_COUNT; i++) {
+            ultrasonicSensors[i].depthCm = preferences.getFloat(("depth" + String(i)).c_str(), ULTRASONIC_DEFAULT_DEPTH_CM);
+        }
+        preferences.end();
+        return;
+    }
+
+    taskStartMeasurement((1 << BIN_COUNT) - 1);
+    while (ultrasonicPending != 0) {
+        taskServiceUltrasonic();
+        delay(1);
+    }
+    for (int i = 0; i < BIN_COUNT; i++) {
+        UltrasonicSensor &sensor = ultrasonicSensors[i];
+        sensor.depthCm = sensor.distanceCm > 0 ? sensor.distanceCm : ULTRASONIC_DEFAULT_DEPTH_CM;
+        preferences.putFloat(("depth" + String(i)).c_str(), sensor.depthCm);
+        Serial0.println("Bin " + String(i) + " calibrated: empty depth " + String(sensor.depthCm, 1) + " cm");
+    }
+    preferences.end();
+}
+
+// taskBootDone() function, to note the time a part of the boot (BOOT_SENSORS, ...) got ready and set its bit in bootReady
+void taskBootDone(EventBits_t part) {
+    bootPartMs[__builtin_ctz(part)] = millis();
+    xEventGroupSetBits(bootReady, part);
+}
+
+// taskDrawText() function, to draw text into lcdFrame from column col of row, cut at the end of the row
+void taskDrawText(int col, int row, const char *text) {
+    for (; col < LCD_COLS && *text != '\0'; col++, text++) {
+        lcdFrame[row][col] = *text;
+    }
+    xSemaphoreGive(lcdDirty);
+}
+
+// taskShowScreen() function, to draw the LCD_ROWS lines of a screen template into lcdFrame, the rest of every row is blanked
+void taskShowScreen(const char *const screen[LCD_ROWS]) {
+    memset(lcdFrame, ' ', sizeof(lcdFrame));
+    for (int row = 0; row < LCD_ROWS; row++) {
+        taskDrawText(0, row, screen[row]);
+    }
+}
+
+/* taskLCDWorker() function
+- Function to push lcdFrame to the LCD, run as a FreeRTOS task so the slow I2C bus never holds up loop()
+- Wait for lcdDirty, then LCD_SETTLE_MS, then write every cell that differs from lcdShown
+    - A cell changed while the pass runs gives lcdDirty again and is written by the next pass
+- The cursor of the LCD moves on by itself after a write, setCursor() is only needed to skip cells that did not change
+*/
+void taskLCDWorker(void *) {
+    while (true) {
+        xSemaphoreTake(lcdDirty, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(LCD_SETTLE_MS));
+        for (int row = 0; row < LCD_ROWS; row++) {
+            int cursor = -1;
+            for (int col = 0; col < LCD_COLS; col++) {
+                char cell = lcdFrame[row][col];
+                if (cell == lcdShown[row][col]) {
+                    continue;
+                }
+                if (cursor != col) {
+                    lcd.setCursor(col, row);
+                }
+                lcd.write(cell);
+                lcdShown[row][col] = cell;
+                cursor = col + 1;
+            }
+        }
+    }
+}
+
+// taskMoveServo() function, to write angle to servo and to its motion model, return the milliseconds until it is there
+unsigned long taskMoveServo(Servo &servo, ServoMotion &motion, int angle) {
+    servo.write(angle);
+    return motion.moveTo(angle, millis());
+}
+
+/* taskKinematics() function
+- Function to open the way for the trash, the gate is opened and closed again by the state machine in loop()
+- Has one parameter: trashType, store the encoded prediction result, the index of its bin in BINS
+- Display the name of the bin and tell the user to put the trash in the pipe with SCREEN_TRASH_TYPE
+- Move the pipe to the pipeAngle of the bin with taskMoveServo() function, nothing to do if it is there already
+- Measure the bin in the background, the distance before the trash comes in tells the deposit apart
+- Return the milliseconds to wait before the gate starts to open: the pipe move minus the time the gate takes to open,
+  so the gate is open just as the pipe arrives, 0 to open it at once
+*/
+unsigned long taskKinematics(int trashType) {
+    taskShowScreen(SCREEN_TRASH_TYPE);
+    taskDrawText(TRASH_TYPE_COLUMN, 0, BINS[trashType].name);
+    unsigned long pipeMs = taskMoveServo(servoPipe, pipeMotion, BINS[trashType].pipeAngle);
+    taskStartMeasurement(1 << trashType);
+    unsigned long gateMs = gateMotion.timeTo(GATE_OPEN_ANGLE, millis());
+    return pipeMs > gateMs ? pipeMs - gateMs : 0;
+}
+
+/* taskUDPtrigger() function
+- Function to send the trigger of a scan job straight to ESP32-CAM over the LAN, without waiting
+- Send LOCAL_TRIGGER_MESSAGE with the scanID of the job
+    - to camAddress once it is known, broadcast on the subnet until then and on the last attempt
+- The acknowledgement is picked up by taskPollEvents()
+*/
+void taskUDPtrigger(ScanJob &job) {
+    bool broadcast = camAddress == IPAddress(0, 0, 0, 0) || job.triggerAttempt == LOCAL_TRIGGER_ATTEMPTS - 1;
+    triggerUDP.beginPacket(broadcast ? WiFi.broadcastIP() : camAddress, LOCAL_TRIGGER_PORT);
+    triggerUDP.print(String(LOCAL_TRIGGER_MESSAGE) + job.scanID);
+    triggerUDP.endPacket();
+    job.triggerAttempt++;
 }
 
 /* taskHTTPPOSTtrigger() function
-- Function to handle the HTTP POST request to trigger the camera
-- Start the HTTP request by using .begin() method
+- Function to handle the HTTP POST request to trigger the camera, runs on taskHTTPWorker()
+- Start the HTTP request on the kept-alive connection by using connectionManager.begin() method
 - Constructing the HTTP payload in JSON format, to set the status to "true"
     - Fill the HTTP payload header with .addHeader() method
-    - Fill the HTTPPayloadJSON String, the body of the request
-- Send the HTTP request with .POST() method
-- Implement error handling using if-else statement
-- Function is called when the button is pressed
-- End the HTTP request with .end() method
-- Set this following flag value:
-    - doHTTPPOSTtrigger: false, to ensure the function is called once
-    - doHTTPGETprediction: true, to run the taskHTTPGETprediction() function
-*/
-void taskHTTPPOSTtrigger() {
-    clientESP32S3.begin(addStatusURL);
+    - Write the body of the request, including the scanID, with tarsStatusBody() of TArSProtocol.h
+- Send the HTTP request with connectionManager.sendRequest() method
+- End the HTTP request with connectionManager.end() method, the connection stays open
+- Return the HTTP response code, handled by taskHandleEvent() of the scan job
+*/
+int taskHTTPPOSTtrigger(const String &scanID) {
+    connectionManager.begin(clientESP32S3, addStatusURL);
     clientESP32S3.addHeader("Content-Type", "application/json");
-    HTTPpayloadJSON = "{\"status\":true}";
-    int httpResponseCode = clientESP32S3.POST(HTTPpayloadJSON);
-    if (httpResponseCode == 201|| httpResponseCode == 200) {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Sending request");
-        lcd.setCursor(0, 1); lcd.print("to server ...");
-    } else if (httpResponseCode == 500 || httpResponseCode == 400) {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Server error");
-        clientESP32S3.end();
-        doHTTPPOSTtrigger = false;
-        return;
-    } else {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Network error");
-        clientESP32S3.end();
-        doHTTPPOSTtrigger = false;
-        return;
-    }
-    clientESP32S3.end();
-    doHTTPPOSTtrigger = false;
-    doHTTPGETprediction = true;
+    char body[TARS_STATUS_BODY_MAX];
+    size_t length = tarsStatusBody(body, sizeof(body), scanID.c_str());
+    int httpResponseCode = connectionManager.sendRequest(clientESP32S3, "POST", (const uint8_t *)body, length);
+    connectionManager.end(clientESP32S3);
+    return httpResponseCode;
 }
 
 /* taskHTTPGETprediction() function
-- Function to handle the HTTP GET request to get the prediction result
-- Start the HTTP request by using .begin() method
-- Get the JSON payload from the server with .GET() method
-- The JSON payload will be received in this format, stored in HTTPpayloadJSON:
+- Function to handle the HTTP GET request to get the prediction result of a scan, runs on taskHTTPWorker()
+- Start the HTTP request on the kept-alive connection by using connectionManager.begin() method
+    - The URL is written by tarsPredictionURL() of TArSProtocol.h
+    - scan_id query parameter: the server only answers with the result of this scan
+    - wait query parameter: the server may hold the request until the result is ready (long-poll),
+      so the read timeout is raised above PREDICTION_LONG_POLL_S for this request only
+- Read the JSON payload straight from the HTTP stream with JsonScanner, no String holds the body
+    - Only scan_id, detected_type and confidence of the top-level object are kept, in reply
+- End the HTTP request with connectionManager.end() method, the connection stays open
+- Set the read timeout back to HTTP_TIMEOUT_MS, so a trigger or a telemetry batch on a dead server does not hold
+  taskHTTPWorker() as long as a long-poll
+- Return the HTTP response code, the reply is read by taskParsePrediction()
+*/
+int taskHTTPGETprediction(const String &scanID, PredictionReply &reply) {
+    JsonField fields[] = {
+        {"scan_id", reply.scanID, sizeof(reply.scanID)},
+        {"detected_type", reply.detectedType, sizeof(reply.detectedType)},
+        {"confidence", reply.confidence, sizeof(reply.confidence)},
+    };
+    JsonScanner json(fields, 3);
+
+    clientESP32S3.setTimeout((PREDICTION_LONG_POLL_S + 5) * 1000);
+    char url[TARS_URL_MAX];
+    tarsPredictionURL(url, sizeof(url), getPredictionURL, scanID.c_str(), PREDICTION_LONG_POLL_S);
+    connectionManager.begin(clientESP32S3, url);
+    int httpResponseCode = connectionManager.GET(clientESP32S3);
+    WiFiClient *stream = clientESP32S3.getStreamPtr();
+    if (httpResponseCode > 0 && stream != NULL) {
+        json.readFrom(*stream, clientESP32S3.getSize());
+    }
+    connectionManager.end(clientESP32S3);
+    clientESP32S3.setTimeout(HTTP_TIMEOUT_MS);
+    return httpResponseCode;
+}
+
+// taskTrashType() function, to encode a detected_type (server) or label (edge result) with BIN_LABELS, -1 if unknown
+int taskTrashType(const char *detectedType) {
+    return BIN_LABELS.find(detectedType);
+}
+
+/* taskParsePrediction() function
+- Function to read the prediction result of a scan from the reply to its prediction request
+- Has three parameters: the HTTP response code, the reply and the scanID of the scan
+- The JSON payload will be received in this format:
     {
         "prediction_id": "a-prediction-id",
         "scan_id": "a-scan-id",
         "timestamp": "date-when-the-image-was-scanned",
-        "detected_type": "metal/cardboard/plastic",
+        "detected_type": "paper/metal/plastic",
+        "confidence": 0.97,
         "image_url": "image-url"
     }
-- Implement search mechanism to find waste type by using indexOf() function
-- Implement error handling using if-else statement
-- Encode the prediction result based on the detected type of trash
-    - 0: Cardboard
-    - 1: Metal Can
-    - 2: Plastic Bottle
-- End the HTTP request with .end() method
-- Set this following flag value:
-    - doHTTPGETprediction: false, to ensure the function is called only once
-    - doHTTPPOSTcapacity: true, to sort the waste and update the capacity of 1/3 trash bin
-*/
-void taskHTTPGETprediction() {
-    clientESP32S3.begin(getPredictionURL);
-    int httpResponseCode = clientESP32S3.GET();
-    HTTPpayloadJSON = clientESP32S3.getString();
-
-    if (httpResponseCode == 200 && HTTPpayloadJSON.indexOf("\"detected_type\"") != -1) {
-        if (HTTPpayloadJSON.indexOf("\"paper\"") != -1) {
-            predictionResult = 0;
-        } else if (HTTPpayloadJSON.indexOf("\"metal\"") != -1) {
-            predictionResult = 1;
-        } else if (HTTPpayloadJSON.indexOf("\"plastic\"") != -1) {
-            predictionResult = 2;
+- Compare the scan_id and detected_type fields as a whole, text in image_url can not match
+- A result is only accepted if the HTTP response code is 200 and it carries our scanID
+- Return the encoded prediction result
+    - 0 or more: the index of the bin in BINS, found by taskTrashType() function
+    - -1: Unknown waste type
+    - -2: No result of this scan yet (202 still processing, 404 image not there yet, 500, network error)
+*/
+int taskParsePrediction(int httpResponseCode, const PredictionReply &reply, const String &scanID) {
+    if (httpResponseCode != 200 || scanID != reply.scanID || reply.detectedType[0] == '\0') {
+        return -2;
+    }
+    return taskTrashType(reply.detectedType);
+}
+
+/* taskHTTPPOSTcapacity() function
+- Function to handle the HTTP POST request to update the capacity of the trash bins, runs on taskHTTPWorker()
+- Start the HTTP request on the kept-alive connection by using connectionManager.begin() method
+- Fill the HTTP payload header with .addHeader() method
+- Send the telemetry batch built by taskFlushTelemetry() with connectionManager.sendRequest() method, no String copy
+- End the HTTP request with connectionManager.end() method, the connection stays open
+- Return the HTTP response code, handled by taskTelemetryDone()
+*/
+int taskHTTPPOSTcapacity(const char *body, size_t length) {
+    connectionManager.begin(clientESP32S3, updateCapacityURL);
+    clientESP32S3.addHeader("Content-Type", "application/json");
+    int httpResponseCode = connectionManager.sendRequest(clientESP32S3, "POST", (const uint8_t *)body, length);
+    connectionManager.end(clientESP32S3);
+    return httpResponseCode;
+}
+
+/* taskHTTPWorker() function
+- FreeRTOS task running the HTTP requests, so the control loop never waits for the server
+- Wait for a request from httpJobQueue with xQueueReceive() function
+- Run the HTTP request for the scan job it belongs to, or the telemetry batch
+- Send EVENT_HTTP_DONE (EVENT_TELEMETRY_DONE) with the HTTP response code and the time it took to eventQueue
+  with xQueueSend() function
+*/
+void taskHTTPWorker(void *) {
+    HTTPJob request;
+    Event event;
+    while (true) {
+        xQueueReceive(httpJobQueue, &request, portMAX_DELAY);
+        unsigned long startedAt = millis();
+        event.type = EVENT_HTTP_DONE;
+        event.job = request.job;
+        switch (request.kind) {
+            case HTTP_JOB_TRIGGER:
+                event.value = taskHTTPPOSTtrigger(scanJobs[request.job].scanID);
+                break;
+            case HTTP_JOB_PREDICTION:
+                event.value = taskHTTPGETprediction(scanJobs[request.job].scanID, scanJobs[request.job].reply);
+                break;
+            case HTTP_JOB_TELEMETRY:
+                event.type = EVENT_TELEMETRY_DONE;
+                event.value = taskHTTPPOSTcapacity(telemetryBody, telemetryBodyLength);
+                break;
+        }
+        event.elapsedMs = millis() - startedAt;
+        xQueueSend(eventQueue, &event, portMAX_DELAY);
+    }
+}
+
+// taskStartHTTPJob() function, to hand a request of scan job `job` over to taskHTTPWorker() without waiting for it
+void taskStartHTTPJob(int kind, int job) {
+    HTTPJob request = {kind, job};
+    xQueueSend(httpJobQueue, &request, portMAX_DELAY);
+}
+
+// taskQueueTelemetry() function, to queue the current capacity of bin `bin` for the next telemetry batch
+void taskQueueTelemetry(int bin) {
+    if (telemetryCount == TELEMETRY_BUFFER_SIZE) {
+        telemetryDropped++;
+        if (telemetryInFlight > 0) {
+            return;
         }
-    } else if (httpResponseCode == 500) {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Server error");
-        clientESP32S3.end();
-        doHTTPGETprediction = false;
+        telemetryTail = (telemetryTail + 1) % TELEMETRY_BUFFER_SIZE;
+        telemetryCount--;
+    }
+    TelemetryReading &reading = telemetryReadings[(telemetryTail + telemetryCount) % TELEMETRY_BUFFER_SIZE];
+    reading.bin = bin;
+    reading.capacity = capacity[bin];
+    reading.measuredAt = millis();
+    telemetryCount++;
+    lastQueuedCapacity[bin] = capacity[bin];
+    lastQueuedAt[bin] = reading.measuredAt;
+    if (capacity[bin] >= TELEMETRY_URGENT_PCT) {
+        telemetryUrgent = true;
+    }
+}
+
+// taskSampleTelemetry() function, to queue a reading of every bin that changed enough or is due for a heartbeat
+void taskSampleTelemetry() {
+    for (int i = 0; i < BIN_COUNT; i++) {
+        if (lastQueuedCapacity[i] < 0 || abs(capacity[i] - lastQueuedCapacity[i]) >= TELEMETRY_DELTA_PCT ||
+            millis() - lastQueuedAt[i] >= TELEMETRY_HEARTBEAT_MS) {
+            taskQueueTelemetry(i);
+        }
+    }
+}
+
+/* taskFlushTelemetry() function
+- Function to send the queued readings as one batch once it is due, see the capacity telemetry config
+- Nothing to do while a batch is in flight, Wi-Fi is down or a failed batch waits for its retry
+- Write the oldest readings into telemetryBody with tarsCapacityReading() of TArSProtocol.h, as many as fit,
+  up to TELEMETRY_BATCH_MAX
+- Hand the batch to taskHTTPWorker() with taskStartHTTPJob() function
+*/
+void taskFlushTelemetry() {
+    if (telemetryInFlight > 0 || telemetryCount == 0 || wifiConnected == false || (long)(millis() - telemetryNextFlush) < 0) {
         return;
-    } else {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Request failed");
-        clientESP32S3.end();
-        doHTTPGETprediction = false;
+    }
+    if (telemetryUrgent == false && telemetryCount < TELEMETRY_FLUSH_READINGS &&
+        millis() - telemetryReadings[telemetryTail].measuredAt < TELEMETRY_FLUSH_MS) {
         return;
     }
-    lcd.clear();
-    lcd.setCursor(0, 0); lcd.print("Processing,");
-    lcd.setCursor(0, 1); lcd.print("please wait ...");
-    clientESP32S3.end();
-    doHTTPGETprediction = false;
-    doHTTPPOSTcapacity = true;
+
+    size_t length = snprintf(telemetryBody, sizeof(telemetryBody), TARS_CAPACITY_OPEN);
+    int count = 0;
+    while (count < telemetryCount && count < TELEMETRY_BATCH_MAX) {
+        const TelemetryReading &reading = telemetryReadings[(telemetryTail + count) % TELEMETRY_BUFFER_SIZE];
+        size_t written = tarsCapacityReading(telemetryBody + length, sizeof(telemetryBody) - length, count == 0,
+                                             *BINS[reading.bin].id, reading.capacity, (millis() - reading.measuredAt) / 1000);
+        if (length + written + 3 > sizeof(telemetryBody)) {
+            break;
+        }
+        length += written;
+        count++;
+    }
+    length += snprintf(telemetryBody + length, sizeof(telemetryBody) - length, TARS_CAPACITY_CLOSE);
+    telemetryBodyLength = length;
+    telemetryInFlight = count;
+    telemetryUrgent = false;
+    taskStartHTTPJob(HTTP_JOB_TELEMETRY, -1);
 }
 
-/* taskHTTPPOSTcapacity() function
-- Function to handle the HTTP POST request to update the capacity of the trash bin
-- Start the HTTP request by using .begin() method
-- Constructing the HTTP payload in JSON format, to update the capacity of the trash bin
-    - Fill the HTTP payload header with .addHeader() method
-    - Fill the HTTPPayloadJSON String, the body of the request
-        - bin_id: the ID of the trash bin
-        - fullness_level_cm: the capacity of the trash bin
-- Send the HTTP request with .POST() method
-- Implement error handling using if-else statement
-- End the HTTP request with .end() method
-- Set this following flag value:
-    - doHTTPPOSTcapacity: false, to ensure the function is called only once
-*/
-void taskHTTPPOSTcapacity(const char* binID, int capacity) {
-    clientESP32S3.begin(updateCapacityURL);
-    clientESP32S3.addHeader("Content-Type", "application/json");
-    HTTPpayloadJSON = "{\"bin_id\": \"" + String(binID) + "\", \"fullness_level_cm\": " + String(capacity) + "}";
-    int httpResponseCode = clientESP32S3.POST(HTTPpayloadJSON);
-    if (httpResponseCode == 201) {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Data sent to cloud");
-    } else if (httpResponseCode == 400) {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Invalid request");
-    } else if (httpResponseCode == 500) {
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Server error");
-    }
-    clientESP32S3.end();
-    doHTTPPOSTcapacity = false;
-}
-
-// taskFlagSetter() function, to set the flag value when the button is pressed
+/* taskTelemetryDone() function
+- Function to handle the HTTP response code of the telemetry batch
+    - 200/201: remove the readings of the batch, the next batch may follow right away
+    - 400: the server will not take this batch, drop it
+    - Anything else: keep the readings, try again TELEMETRY_RETRY_MS later
+*/
+void taskTelemetryDone(int httpResponseCode) {
+    if (httpResponseCode == 201 || httpResponseCode == 200 || httpResponseCode == 400) {
+        telemetryTail = (telemetryTail + telemetryInFlight) % TELEMETRY_BUFFER_SIZE;
+        telemetryCount -= telemetryInFlight;
+        if (httpResponseCode == 400) {
+            telemetryDropped += telemetryInFlight;
+        } else {
+            telemetrySent += telemetryInFlight;
+        }
+        telemetryNextFlush = millis();
+    } else {
+        telemetryNextFlush = millis() + TELEMETRY_RETRY_MS;
+        Serial0.println("Telemetry batch failed (" + String(httpResponseCode) + "), " + String(telemetryCount) + " readings kept");
+    }
+    telemetryInFlight = 0;
+}
+
+// taskButtonISR() function, to queue the button press in buttonPresses, no lock is taken in the interrupt
 // read: https://lastminuteengineers.com/handling-esp32-gpio-interrupts-tutorial/
-void IRAM_ATTR taskFlagSetter() {
+void IRAM_ATTR taskButtonISR() {
   button_time = millis();
-  if (button_time - last_button_time > 2000) {
-    doHTTPPOSTtrigger = true;
+  if (button_time - last_button_time > BUTTON_LOCKOUT_MS) {
+    buttonPresses.push(button_time);
     last_button_time = button_time;
   }
 }
 
-// taskDisplay() function, to display the data layout on the LCD
+// taskDisplay() function, to display the capacity of every bin in its cell, only the capacities that changed go over the bus
 void taskDisplay() {
-    lcd.clear();
-    lcd.setCursor(0, 0); lcd.print("Capacity (%): ");
-    lcd.setCursor(0, 1); lcd.print("Cardboard: ");
-    lcd.setCursor(11, 1); lcd.print(String(capacity[0]));
-    lcd.setCursor(0, 2); lcd.print("Metal Can: ");
-    lcd.setCursor(11, 2); lcd.print(String(capacity[1]));
-    lcd.setCursor(0, 3); lcd.print("Plastic: ");
-    lcd.setCursor(11, 3); lcd.print(String(capacity[2]));
+    taskShowScreen(SCREEN_CAPACITY);
+    for (int i = 0; i < BIN_COUNT; i++) {
+        char name[CAPACITY_COLUMN];
+        snprintf(name, sizeof(name), "%.*s:", CAPACITY_COLUMN - 2, BINS[i].shortName);
+        char cell[CAPACITY_CELL + 1];
+        snprintf(cell, sizeof(cell), "%-*s%d", CAPACITY_COLUMN, name, capacity[i]);
+        taskDrawText((i / CAPACITY_ROWS) * CAPACITY_CELL, 1 + i % CAPACITY_ROWS, cell);
+    }
+}
+
+/* taskBootSensors() function
+- FreeRTOS task created by setup(), measures the bins while Wi-Fi connects
+- Load the calibrated depth of each trash bin with taskCalibrateUltrasonic() function, measure it if the button is held down
+- Measure the capacity of each trash bin and display the data layout on the LCD using taskDisplay() function
+- Set BOOT_SENSORS and delete itself, loop() takes the sensors and the LCD over from here on
+*/
+void taskBootSensors(void *) {
+    taskCalibrateUltrasonic(digitalRead(BUTTON_PIN) == LOW);
+    taskStartMeasurement((1 << BIN_COUNT) - 1);
+    while (ultrasonicPending != 0) {
+        taskServiceUltrasonic();
+        delay(1);
+    }
+    taskDisplay();
+    lastCapacityRefresh = millis();
+    taskBootDone(BOOT_SENSORS);
+    vTaskDelete(NULL);
+}
+
+// taskFindStage() function, to find the scan job in one of the stages first..last, -1 if there is none
+int taskFindStage(int first, int last) {
+    int found = -1;
+    for (int i = 0; i < SCAN_JOB_COUNT; i++) {
+        int stage = scanJobs[i].stage;
+        if (stage >= first && stage <= last && (found == -1 || scanJobs[i].pressedAt < scanJobs[found].pressedAt)) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+// taskGateBusy() function, true while a scan owns the gate, its messages on the LCD are not overwritten then
+bool taskGateBusy() {
+    return taskFindStage(STAGE_PIPE_MOVE, STAGE_GATE_CLOSE) != -1;
+}
+
+// taskRecordScan() function, to record the latency of a scan that is done in metrics, see the metrics config
+void taskRecordScan(const ScanJob &scan, unsigned long now) {
+    metrics.record("camera_wait", scan.stageTime[STAGE_FREE]);
+    unsigned long trigger = scan.stageTime[STAGE_TRIGGER_LAN] + scan.stageTime[STAGE_TRIGGER_CLOUD];
+    unsigned long inference = scan.stageTime[STAGE_PREDICTION_BACKOFF] + scan.stageTime[STAGE_PREDICTION];
+    if (trigger > 0) {
+        metrics.record("trigger", trigger);
+    }
+    if (inference > 0) {
+        metrics.record("inference_wait", inference);
+    }
+    if (scan.trashType >= 0) {
+        metrics.record("cycle", now - scan.pressedAt);
+        metrics.record("gate_wait", scan.stageTime[STAGE_READY]);
+        metrics.record("kinematics", scan.stageTime[STAGE_PIPE_MOVE] + scan.stageTime[STAGE_GATE_OPEN] +
+                                         scan.stageTime[STAGE_GATE_CLOSE]);
+        metrics.record("measure", scan.stageTime[STAGE_MEASURE]);
+    }
+}
+
+// taskRecordHTTP() function, to record the latency and response code of a finished HTTP request in metrics
+void taskRecordHTTP(const char *name, const Event &event) {
+    metrics.record(name, event.elapsedMs);
+    metrics.countHTTP(event.value);
+}
+
+/* taskEnterStage() function
+- Function to move scan job `job` to newStage
+- Add the time spent in the current stage to stageTime
+- Start the timer of newStage, timeoutMs after now, none if timeoutMs is 0
+- Once the scan is done (STAGE_FREE), print how long it waited and spent in each stage on Serial0
+  and record it in metrics with taskRecordScan() function
+*/
+void taskEnterStage(int job, int newStage, unsigned long timeoutMs) {
+    ScanJob &scan = scanJobs[job];
+    unsigned long now = millis();
+    scan.stageTime[scan.stage] += now - scan.stageEnteredAt;
+    scan.stage = newStage;
+    scan.stageEnteredAt = now;
+    scan.stageDeadline = timeoutMs > 0 ? max(now + timeoutMs, 1UL) : 0;
+    scan.measuredQueued = false;
+
+    if (newStage == STAGE_FREE) {
+        String cycleLog = "Scan " + scan.scanID + ": total " + String(now - scan.pressedAt) + " ms";
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            if (scan.stageTime[i] > 0) {
+                cycleLog += ", " + String(i == STAGE_FREE ? "waiting for the camera" : STAGE_NAMES[i]) + " " +
+                            String(scan.stageTime[i]) + " ms";
+            }
+        }
+        Serial0.println(cycleLog);
+        taskRecordScan(scan, now);
+    }
+}
+
+/* taskTriggerDone() function
+- Function to continue once ESP32-CAM got the trigger of scan job `job`, over the LAN or through the server
+- Tell the user the request is on the way with SCREEN_SENDING, unless the gate is busy with another scan
+- Start the prediction timeout and wait PREDICTION_BACKOFF_MIN_MS before the first prediction request
+*/
+void taskTriggerDone(int job) {
+    ScanJob &scan = scanJobs[job];
+    if (!taskGateBusy()) {
+        taskShowScreen(SCREEN_SENDING);
+    }
+    scan.predictionDeadline = millis() + PREDICTION_TIMEOUT_MS;
+    scan.predictionBackoff = PREDICTION_BACKOFF_MIN_MS;
+    taskEnterStage(job, STAGE_PREDICTION_BACKOFF, scan.predictionBackoff);
+}
+
+/* taskStartScan() function
+- Function to start the scan of a button press in free scan job `job`
+- Create a new scanID from the MAC address, the scan counter and millis()
+    - Or take capturedScanID, the scan ID of an image ESP32-CAM already captured on its own (motion trigger)
+- The time between the press and now is counted as waiting for the camera
+- Send the LAN trigger with taskUDPtrigger() function, or hand the trigger to the server if LOCAL_TRIGGER_ENABLED is false
+    - No trigger for a captured image, the scan waits for its prediction right away with taskTriggerDone() function
+*/
+void taskStartScan(int job, unsigned long pressedAt, const String &capturedScanID) {
+    ScanJob &scan = scanJobs[job];
+    if (capturedScanID.length() > 0) {
+        scan.scanID = capturedScanID;
+    } else {
+        scan.scanID = WiFi.macAddress();
+        scan.scanID.replace(":", "");
+        scan.scanID = "tars-" + scan.scanID + "-" + String(++scanCounter) + "-" + String(millis());
+    }
+    scan.trashType = -2;
+    scan.triggerAttempt = 0;
+    scan.edgeType = -2;
+    scan.pressedAt = pressedAt;
+    scan.stageEnteredAt = pressedAt;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        scan.stageTime[i] = 0;
+    }
+
+    if (capturedScanID.length() > 0) {
+        taskTriggerDone(job);
+    } else if (LOCAL_TRIGGER_ENABLED == true) {
+        taskUDPtrigger(scan);
+        taskEnterStage(job, STAGE_TRIGGER_LAN, LOCAL_TRIGGER_ACK_TIMEOUT_MS);
+    } else {
+        taskStartHTTPJob(HTTP_JOB_TRIGGER, job);
+        taskEnterStage(job, STAGE_TRIGGER_CLOUD, 0);
+    }
+}
+
+// taskShowMessage() function, to show a message of a scan on the LCD, unless the gate is busy with another scan
+void taskShowMessage(const char *line0, const char *line1) {
+    if (taskGateBusy()) {
+        return;
+    }
+    const char *const screen[LCD_ROWS] = {line0, line1 != NULL ? line1 : "", "", ""};
+    taskShowScreen(screen);
+}
+
+// taskEdgeConfident() function, to check if the edge result of scan is at EDGE_CONFIDENCE_MIN or above
+bool taskEdgeConfident(const ScanJob &scan) {
+    return scan.edgeType >= 0 && scan.edgeConfidence >= EDGE_CONFIDENCE_MIN;
+}
+
+// taskEdgeSortable() function, to check if scan can be sorted on its edge result, only if EDGE_SORT_ENABLED
+bool taskEdgeSortable(const ScanJob &scan) {
+    return EDGE_SORT_ENABLED == true && taskEdgeConfident(scan);
+}
+
+// taskSortOnEdge() function, to take the edge result of scan job `job` as its prediction, the server is not asked (again)
+void taskSortOnEdge(int job) {
+    ScanJob &scan = scanJobs[job];
+    scan.trashType = scan.edgeType;
+    Serial0.println("Scan " + scan.scanID + ": type " + String(scan.trashType) + " on the camera, confidence " + String(scan.edgeConfidence, 2));
+    metrics.count("edge_sorted");
+    taskShowMessage("Processing,", "please wait ...");
+    taskEnterStage(job, STAGE_READY, 0);
+}
+
+// taskOpenGate() function, to open the gate for scan job `job`, the user has GATE_OPEN_MS at most to put the trash in
+void taskOpenGate(int job) {
+    taskMoveServo(servoGate, gateMotion, GATE_OPEN_ANGLE);
+    taskEnterStage(job, STAGE_GATE_OPEN, GATE_OPEN_MS);
+}
+
+/* taskCloseGate() function
+- Function to close the gate behind the trash of scan job `job` with taskMoveServo() function
+- Stay in STAGE_GATE_CLOSE for as long as the gate takes to close if `deposited`, the trash is in the bin already,
+  otherwise at least GATE_FALL_MS, the pipe must not move while the trash may still be falling
+*/
+void taskCloseGate(int job, bool deposited) {
+    unsigned long gateMs = taskMoveServo(servoGate, gateMotion, GATE_CLOSED_ANGLE);
+    taskEnterStage(job, STAGE_GATE_CLOSE, deposited ? max(gateMs, 1UL) : max(gateMs, GATE_FALL_MS));
+}
+
+/* taskHandleEvent() function
+- Function to run one event through the stages of its scan job, the only place where a stage changes
+- Wi-Fi events are not tied to a job
+    - EVENT_WIFI_LOST: show the reconnect message while no scan runs, a running request simply fails and is retried
+    - EVENT_WIFI_UP: show the connected message while no scan runs, the capacity layout follows one second later
+- Every stage only reacts to the events it waits for, as listed in the scan pipeline config
+- Implement error handling using if-else statement, as the blocking version did
+    - Trigger: 200/201 continues, 400/500 "Server error", anything else "Network error"
+    - Prediction: retried with exponential backoff, given up once predictionDeadline has passed
+    - Edge result: sorted on with taskSortOnEdge() if taskEdgeSortable(), while waiting for the backoff at once,
+      while a prediction request runs once it comes back without a result (the request can not be called back)
+- Gate: opened once the pipe is nearly there, closed once the deposit is seen in the measurements of the bin,
+  see the scan pipeline config
+- Measure: show the capacity layout once the bin is measured, taskSampleTelemetry() picks the new capacity up
+- EVENT_TELEMETRY_DONE is handed to taskTelemetryDone() function
+- Every finished HTTP request is recorded in metrics with taskRecordHTTP() function, retries and failures are counted
+*/
+void taskHandleEvent(Event event) {
+    if (event.type == EVENT_TELEMETRY_DONE) {
+        taskRecordHTTP("http_capacity", event);
+        taskTelemetryDone(event.value);
+        return;
+    }
+    if (event.type == EVENT_WIFI_LOST || event.type == EVENT_WIFI_UP) {
+        wifiConnected = event.type == EVENT_WIFI_UP;
+        if (taskFindStage(STAGE_TRIGGER_LAN, STAGE_MEASURE) == -1) {
+            const char *const screen[LCD_ROWS] = {wifiConnected ? "Wi-Fi Connected!" : "Reconnecting ...", "", "", ""};
+            taskShowScreen(screen);
+            lastCapacityRefresh = millis() - CAPACITY_REFRESH_MS + 1000;
+        }
+        return;
+    }
+
+    int job = event.job;
+    ScanJob &scan = scanJobs[job];
+    if (event.type == EVENT_MEASURED) {
+        scan.measuredQueued = false;
+    }
+    switch (scan.stage) {
+        case STAGE_TRIGGER_LAN:
+            if (event.type == EVENT_LAN_ACK) {
+                taskTriggerDone(job);
+            } else if (event.type == EVENT_TIMEOUT && scan.triggerAttempt < LOCAL_TRIGGER_ATTEMPTS) {
+                metrics.count("trigger_lan_retries");
+                taskUDPtrigger(scan);
+                taskEnterStage(job, STAGE_TRIGGER_LAN, LOCAL_TRIGGER_ACK_TIMEOUT_MS);
+            } else if (event.type == EVENT_TIMEOUT) {
+                metrics.count("trigger_cloud_fallbacks");
+                taskStartHTTPJob(HTTP_JOB_TRIGGER, job);
+                taskEnterStage(job, STAGE_TRIGGER_CLOUD, 0);
+            }
+            break;
+        case STAGE_TRIGGER_CLOUD:
+            if (event.type != EVENT_HTTP_DONE) {
+                break;
+            }
+            taskRecordHTTP("http_trigger", event);
+            if (event.value == 201 || event.value == 200) {
+                taskTriggerDone(job);
+            } else {
+                metrics.count("scans_failed");
+                taskShowMessage(event.value == 500 || event.value == 400 ? "Server error" : "Network error", NULL);
+                taskEnterStage(job, STAGE_FREE, 0);
+            }
+            break;
+        case STAGE_PREDICTION_BACKOFF:
+            if (event.type == EVENT_EDGE_RESULT && taskEdgeSortable(scan)) {
+                taskSortOnEdge(job);
+            } else if (event.type == EVENT_TIMEOUT) {
+                taskStartHTTPJob(HTTP_JOB_PREDICTION, job);
+                scan.predictionBackoff = min(scan.predictionBackoff * 2, PREDICTION_BACKOFF_MAX_MS);
+                taskEnterStage(job, STAGE_PREDICTION, 0);
+            }
+            break;
+        case STAGE_PREDICTION:
+            if (event.type != EVENT_HTTP_DONE) {
+                break;
+            }
+            taskRecordHTTP("http_prediction", event);
+            scan.trashType = taskParsePrediction(event.value, scan.reply, scan.scanID);
+            if (scan.trashType >= 0) {
+                if (scan.reply.confidence[0] != '\0') {
+                    Serial0.println("Scan " + scan.scanID + ": " + scan.reply.detectedType + ", confidence " + scan.reply.confidence);
+                }
+                taskShowMessage("Processing,", "please wait ...");
+                taskEnterStage(job, STAGE_READY, 0);
+            } else if (scan.trashType == -1) {
+                metrics.count("scans_failed");
+                taskShowMessage("Unknown waste type", NULL);
+                taskEnterStage(job, STAGE_FREE, 0);
+            } else if (taskEdgeSortable(scan)) {
+                taskSortOnEdge(job);
+            } else if ((long)(millis() - scan.predictionDeadline) >= 0) {
+                metrics.count("scans_failed");
+                taskShowMessage("No result,", "please try again");
+                taskEnterStage(job, STAGE_FREE, 0);
+            } else {
+                metrics.count("prediction_retries");
+                if (event.value == 500) {
+                    taskShowMessage("Server error,", "retrying ...");
+                }
+                taskEnterStage(job, STAGE_PREDICTION_BACKOFF, scan.predictionBackoff);
+            }
+            break;
+        case STAGE_PIPE_MOVE:
+            if (event.type == EVENT_TIMEOUT) {
+                taskOpenGate(job);
+            }
+            break;
+        case STAGE_GATE_OPEN:
+            if (event.type == EVENT_MEASURED) {
+                float distanceCm = ultrasonicSensors[scan.trashType].distanceCm;
+                if (distanceCm > 0 && scan.depositBaseCm > 0 && scan.depositBaseCm - distanceCm >= DEPOSIT_MIN_CM) {
+                    taskCloseGate(job, true);
+                    break;
+                }
+                if (distanceCm > 0 && scan.depositBaseCm <= 0) {
+                    scan.depositBaseCm = distanceCm;
+                }
+                taskStartMeasurement(1 << scan.trashType);
+            } else if (event.type == EVENT_TIMEOUT) {
+                metrics.count("deposit_timeouts");
+                taskCloseGate(job, false);
+            }
+            break;
+        case STAGE_GATE_CLOSE:
+            if (event.type == EVENT_TIMEOUT) {
+                if (taskFindStage(STAGE_READY, STAGE_READY) == -1) {
+                    taskMoveServo(servoPipe, pipeMotion, PIPE_INITIAL_ANGLE);
+                }
+                itemsSorted++;
+                taskStartMeasurement(1 << scan.trashType);
+                taskEnterStage(job, STAGE_MEASURE, 0);
+            }
+            break;
+        case STAGE_MEASURE:
+            if (event.type == EVENT_MEASURED) {
+                if (!taskGateBusy()) {
+                    taskDisplay();
+                }
+                taskEnterStage(job, STAGE_FREE, 0);
+            }
+            break;
+    }
+}
+
+/* taskSchedule() function
+- Function to move scans forward once the camera or the gate is free
+- Gate: the oldest scan in STAGE_READY moves the pipe with taskKinematics() function, if no other scan owns the gate
+    - The gate opens at once with taskOpenGate() function, or once STAGE_PIPE_MOVE is over
+- Camera: the oldest press in buttonPresses starts a scan with taskStartScan() function
+    - Only if no other scan is being classified, a scan job is free and Wi-Fi is connected
+*/
+void taskSchedule() {
+    int ready = taskFindStage(STAGE_READY, STAGE_READY);
+    if (ready != -1 && !taskGateBusy()) {
+        scanJobs[ready].depositBaseCm = -1;
+        unsigned long gateDelayMs = taskKinematics(scanJobs[ready].trashType);
+        if (gateDelayMs > 0) {
+            taskEnterStage(ready, STAGE_PIPE_MOVE, gateDelayMs);
+        } else {
+            taskOpenGate(ready);
+        }
+    }
+
+    int freeJob = -1;
+    for (int i = 0; i < SCAN_JOB_COUNT && freeJob == -1; i++) {
+        if (scanJobs[i].stage == STAGE_FREE) {
+            freeJob = i;
+        }
+    }
+    unsigned long pressedAt;
+    if (freeJob != -1 && wifiConnected == true && taskFindStage(STAGE_TRIGGER_LAN, STAGE_PREDICTION) == -1 &&
+        buttonPresses.pop(pressedAt)) {
+        taskStartScan(freeJob, pressedAt, "");
+    }
+}
+
+/* taskReadEdgeResult() function
+- Function to read "<scan_id> <label> <confidence>" of a LOCAL_EDGE_RESULT datagram into the scan job it belongs to
+- Only a job between STAGE_TRIGGER_LAN and STAGE_PREDICTION takes it, a late result of a finished scan is dropped
+- Count a result below EDGE_CONFIDENCE_MIN as edge_unsure in metrics
+- Return the index of the job, -1 if none took it
+*/
+int taskReadEdgeResult(char *result) {
+    char *label = strchr(result, ' ');
+    char *confidence = label != NULL ? strchr(label + 1, ' ') : NULL;
+    if (confidence == NULL) {
+        return -1;
+    }
+    *label++ = '\0';
+    *confidence++ = '\0';
+    for (int i = 0; i < SCAN_JOB_COUNT; i++) {
+        ScanJob &scan = scanJobs[i];
+        if (scan.stage >= STAGE_TRIGGER_LAN && scan.stage <= STAGE_PREDICTION && scan.scanID == result) {
+            scan.edgeType = taskTrashType(label);
+            scan.edgeConfidence = atof(confidence);
+            if (!taskEdgeConfident(scan)) {
+                metrics.count("edge_unsure");
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* taskStartMotionScan() function
+- Function to start the scan of an image ESP32-CAM captured on its own, carrying capturedScanID (LOCAL_MOTION_MESSAGE)
+- A repeated message of a scan already running needs nothing more, its acknowledgement got lost
+- Start it in the first free scan job with taskStartScan() function, counted as motion_scans in metrics
+- Return true if the scan runs, to be acknowledged, false if no scan job is free
+*/
+bool taskStartMotionScan(const char *capturedScanID) {
+    int freeJob = -1;
+    for (int i = 0; i < SCAN_JOB_COUNT; i++) {
+        if (scanJobs[i].stage != STAGE_FREE && scanJobs[i].scanID == capturedScanID) {
+            return true;
+        }
+        if (scanJobs[i].stage == STAGE_FREE && freeJob == -1) {
+            freeJob = i;
+        }
+    }
+    if (freeJob == -1) {
+        return false;
+    }
+    metrics.count("motion_scans");
+    taskStartScan(freeJob, millis(), capturedScanID);
+    return true;
+}
+
+/* taskPollEvents() function
+- Function to turn what loop() finds by polling into events in eventQueue
+- EVENT_TIMEOUT for every scan job whose stageDeadline has passed
+    - stageDeadline is cleared only once the event is in eventQueue, if it is full the timeout is sent on a later pass
+- EVENT_LAN_ACK once LOCAL_TRIGGER_ACK with the scanID of a job in STAGE_TRIGGER_LAN arrived
+- EVENT_EDGE_RESULT once LOCAL_EDGE_RESULT with the scanID of a job waiting for its prediction arrived, read by taskReadEdgeResult()
+- LOCAL_MOTION_MESSAGE starts a scan with taskStartMotionScan() function, acknowledged with LOCAL_TRIGGER_ACK to the sender
+  once the scan runs, the sender is ESP32-CAM, so its address is kept in camAddress
+- Other datagrams are dropped
+- EVENT_MEASURED for every scan job in STAGE_GATE_OPEN or STAGE_MEASURE whose bin is no longer pending in the ultrasonic measurement
+    - Once per measurement: not while the last one is still in eventQueue (measuredQueued)
+- EVENT_WIFI_LOST and EVENT_WIFI_UP when the link of wifiLink changed, it follows the events of the Wi-Fi driver
+*/
+void taskPollEvents() {
+    Event event = {EVENT_TIMEOUT, 0, 0, 0};
+    for (int i = 0; i < SCAN_JOB_COUNT; i++) {
+        if (scanJobs[i].stageDeadline != 0 && (long)(millis() - scanJobs[i].stageDeadline) >= 0) {
+            event.job = i;
+            if (xQueueSend(eventQueue, &event, 0) == pdTRUE) {
+                scanJobs[i].stageDeadline = 0;
+            }
+        }
+        bool measuring = scanJobs[i].stage == STAGE_MEASURE || scanJobs[i].stage == STAGE_GATE_OPEN;
+        if (measuring && !scanJobs[i].measuredQueued && (ultrasonicPending & (1 << scanJobs[i].trashType)) == 0) {
+            Event measured = {EVENT_MEASURED, 0, i, 0};
+            scanJobs[i].measuredQueued = xQueueSend(eventQueue, &measured, 0) == pdTRUE;
+        }
+    }
+
+    char ack[LOCAL_TRIGGER_MAX_LENGTH + 1];
+    while (triggerUDP.parsePacket() > 0) {
+        int ackLength = triggerUDP.read(ack, LOCAL_TRIGGER_MAX_LENGTH);
+        ack[max(ackLength, 0)] = '\0';
+        if (strncmp(ack, LOCAL_EDGE_RESULT, strlen(LOCAL_EDGE_RESULT)) == 0) {
+            event.job = taskReadEdgeResult(ack + strlen(LOCAL_EDGE_RESULT));
+            if (event.job != -1) {
+                event.type = EVENT_EDGE_RESULT;
+                xQueueSend(eventQueue, &event, 0);
+            }
+            continue;
+        }
+        if (strncmp(ack, LOCAL_MOTION_MESSAGE, strlen(LOCAL_MOTION_MESSAGE)) == 0) {
+            const char *capturedScanID = ack + strlen(LOCAL_MOTION_MESSAGE);
+            if (capturedScanID[0] != '\0' && taskStartMotionScan(capturedScanID)) {
+                camAddress = triggerUDP.remoteIP();
+                triggerUDP.beginPacket(triggerUDP.remoteIP(), triggerUDP.remotePort());
+                triggerUDP.print(String(LOCAL_TRIGGER_ACK) + capturedScanID);
+                triggerUDP.endPacket();
+            }
+            continue;
+        }
+        for (int i = 0; i < SCAN_JOB_COUNT; i++) {
+            if (scanJobs[i].stage == STAGE_TRIGGER_LAN && String(LOCAL_TRIGGER_ACK) + scanJobs[i].scanID == ack) {
+                camAddress = triggerUDP.remoteIP();
+                event.type = EVENT_LAN_ACK;
+                event.job = i;
+                xQueueSend(eventQueue, &event, 0);
+            }
+        }
+    }
+
+    if (wifiLink.connected() != wifiConnected) {
+        event.type = wifiConnected ? EVENT_WIFI_LOST : EVENT_WIFI_UP;
+        xQueueSend(eventQueue, &event, 0);
+    }
+}
+
+/* taskBootProgress() function
+- Function to follow the boot from loop(), until every part is ready
+- Set BOOT_WIFI once wifiLink is connected for the first time
+- Once every part is ready, keep the power-on-to-ready time in bootReadyMs, record it in metrics as boot
+  and print it with the time each part got ready
+*/
+void taskBootProgress() {
+    if (bootReadyMs != 0) {
+        return;
+    }
+    EventBits_t ready = xEventGroupGetBits(bootReady);
+    if ((ready & BOOT_WIFI) == 0 && wifiLink.connected()) {
+        taskBootDone(BOOT_WIFI);
+        ready |= BOOT_WIFI;
+    }
+    if ((ready & BOOT_ALL) != BOOT_ALL) {
+        return;
+    }
+    bootReadyMs = max(millis(), 1UL);
+    metrics.record("boot", bootReadyMs);
+    Serial0.println("Ready after " + String(bootReadyMs) + " ms: bins measured " + String(bootPartMs[0]) +
+                    " ms, Wi-Fi " + String(bootPartMs[1]) + " ms");
 }
 
 /* setup() function
-- Function to initialize the device
+- Function to start the device, returns before the boot is done, see the boot config
+- Initialize the serial monitor on Serial0 (COM port) using .begin() method
+- Create bootReady, start connecting to Wi-Fi with wifiLink.begin() method first, fast if the access point and lease
+  of the last connection are in NVS, it connects in the background from here on
 - Initialize the I2C configuration using Wire.begin() method
-- Initialize the LCD configuration using lcd.begin() method
-- Configure pins for the ultrasonic sensor using pinMode() function
-- Configure pins for the servo motor PWM transmitter ussing .attach() method
+- Initialize the LCD configuration using lcd.begin() method, the LCD starts blank like lcdShown
+- Start taskLCDWorker() on core 0 with xTaskCreatePinnedToCore() function, the screens are drawn with taskShowScreen() from now on
+- Configure pins of the ultrasonic sensor of each bin in BINS using pinMode() function, the echo pins interrupt
+  on both edges with attachInterruptArg(), no reading and no telemetry queued yet
+- Configure pins for the servo motor PWM transmitter ussing .attach() method, close the gate and move the pipe
+  to PIPE_INITIAL_ANGLE, so pipeMotion and gateMotion start from a known angle
+- Create eventQueue and httpJobQueue with xQueueCreate() function, mark every scan job as free
+- Start taskHTTPWorker() on core 0 with xTaskCreatePinnedToCore() function
 - Configure interrupt for the button using pinMode() and attachInterrupt() function
-- Initialize the Wi-Fi connection using WiFi.begin() method
-- Clear the display before print any new string using lcd.clear() method
-- Implement error handling using while loop
-    - in case the Wi-Fi connection is not established, the loop will keep going
-    - loop breaks when the Wi-Fi connection is established
-- Measuring the capacity of of each trash bin once the device is powered on and online
-- Display the data layout on the LCD using taskDisplay() function
+- Start taskBootSensors() on core 0 with xTaskCreatePinnedToCore() function, the bins are measured while Wi-Fi connects
+- Start listening for the acknowledgement of the LAN trigger with .begin() method on LOCAL_TRIGGER_PORT
+- Start the metrics endpoint with metricsServer.begin() method, watch the counters kept outside metrics,
+  report a histogram or counter that does not fit on Serial0 with metrics.logTo() method
+- The Wi-Fi status is shown by taskHandleEvent() once the connection is made, like every later change
 */
 void setup() {
     delay(100);
 
+    Serial0.begin(115200);
+
+    bootReady = xEventGroupCreate();
+
+    wifiLink.begin(ssid, password);
+
     Wire.begin(10, 9);
     lcd.begin(20, 4);
     lcd.backlight();
+    memset(lcdShown, ' ', sizeof(lcdShown));
+    lcdDirty = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(taskLCDWorker, "taskLCDWorker", 2048, NULL, 1, NULL, 0);
 
-    lcd.setCursor(5, 1); lcd.print("Starting");
-    lcd.setCursor(4, 2); lcd.print("the device");
+    taskShowScreen(SCREEN_STARTING);
 
-    pinMode(TRIG_PIN_0, OUTPUT); pinMode(ECHO_PIN_0, INPUT);
-    pinMode(TRIG_PIN_1, OUTPUT); pinMode(ECHO_PIN_1, INPUT);
-    pinMode(TRIG_PIN_2, OUTPUT); pinMode(ECHO_PIN_2, INPUT);
+    for (int i = 0; i < BIN_COUNT; i++) {
+        ultrasonicSensors[i].trigPin = BINS[i].trigPin;
+        ultrasonicSensors[i].echoPin = BINS[i].echoPin;
+        ultrasonicSensors[i].depthCm = ULTRASONIC_DEFAULT_DEPTH_CM;
+        ultrasonicSensors[i].distanceCm = -1;
+        lastQueuedCapacity[i] = -1;
+        pinMode(ultrasonicSensors[i].trigPin, OUTPUT); digitalWrite(ultrasonicSensors[i].trigPin, LOW);
+        pinMode(ultrasonicSensors[i].echoPin, INPUT);
+        attachInterruptArg(digitalPinToInterrupt(ultrasonicSensors[i].echoPin), taskEchoISR, &ultrasonicSensors[i], CHANGE);
+    }
 
     servoPipe.attach(PIPE_PWM_PIN); 
     servoGate.attach(GATE_PWM_PIN);
+    servoPipe.write(PIPE_INITIAL_ANGLE);
+    servoGate.write(GATE_CLOSED_ANGLE);
+    pipeMotion.begin(PIPE_INITIAL_ANGLE, millis());
+    gateMotion.begin(GATE_CLOSED_ANGLE, millis());
+
+    eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(Event));
+    httpJobQueue = xQueueCreate(SCAN_JOB_COUNT + 1, sizeof(HTTPJob));
+    for (int i = 0; i < SCAN_JOB_COUNT; i++) {
+        scanJobs[i].stage = STAGE_FREE;
+    }
+    xTaskCreatePinnedToCore(taskHTTPWorker, "taskHTTPWorker", 8192, NULL, 1, NULL, 0);
 
     pinMode(BUTTON_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), taskFlagSetter, FALLING);
-
-    WiFi.begin(ssid, password);
-    lcd.clear();
-    lcd.setCursor(0, 0); lcd.print("Wi-Fi status: ");
-    lcd.setCursor(0, 1);
-    lcd.print("Connecting...");
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-    }
-    lcd.setCursor(0, 2);
-    lcd.print("Wi-Fi Connected!");
-    delay(1000);
-
-    taskUltrasonicTXRX(TRIG_PIN_0, ECHO_PIN_0);
-    taskUltrasonicTXRX(TRIG_PIN_1, ECHO_PIN_1);
-    taskUltrasonicTXRX(TRIG_PIN_2, ECHO_PIN_2);
-    taskDisplay();
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), taskButtonISR, FALLING);
+
+    xTaskCreatePinnedToCore(taskBootSensors, "taskBootSensors", 4096, NULL, 1, NULL, 0);
+
+    triggerUDP.begin(LOCAL_TRIGGER_PORT);
+    metricsServer.begin();
+    metrics.logTo(Serial0);
+    metrics.watch("items_sorted", &itemsSorted);
+    metrics.watch("measure_failures", &ultrasonicFailures);
+    metrics.watch("telemetry_dropped", &telemetryDropped);
+    metrics.watch("connections_new", &connectionManager.stats().connectionMisses);
+    metrics.watch("reconnects", &connectionManager.stats().reconnects);
+    metrics.watch("wifi_lost", &wifiLink.stats().linkLosses);
+    metrics.watch("wifi_fast_connects", &wifiLink.stats().fastConnects);
 }
 
 /* loop() function
-- Function to run the device, repeatedly
-- Implementing error handling using if-else statement
-    - in case the device is offline, it will reconnect to Wi-Fi network before doing anything else
-    - only executing the HTTP request task when the Wi-Fi is connected
-- Ensure chained, serial execution of the task by checking the flag value in each if-else statement
-- Hardcoded 45s delay due to poor performance of server's ML inference
-    - Sending HTTP GET request too soon will result in getting previous prediction result
+- Function to run the device, repeatedly, never blocking for longer than LOOP_TICK_MS
+- Call wifiLink.poll() method, record the time of a new Wi-Fi connection in metrics
+- Follow the boot with taskBootProgress() function, wait up to LOOP_TICK_MS for BOOT_SENSORS with xEventGroupWaitBits()
+  function, nothing else runs until the bins are measured
+- Call taskServiceUltrasonic() function to move the background measurement forward
+- Call taskPollEvents() function to turn timers, LAN acknowledgements, measurements and Wi-Fi changes into events
+- Wait up to LOOP_TICK_MS for the next event from eventQueue with xQueueReceive() function
+    - Finished HTTP requests arrive here too
+- Run the event through the stages of its scan job with taskHandleEvent() function
+- Call taskSchedule() function to open the gate for a classified scan and to start the scan of the next press
+- Measure the capacity of each trash bin every CAPACITY_REFRESH_MS, refresh the LCD once it is done if no scan runs
+- Queue the capacity readings and send them in batches with taskSampleTelemetry() and taskFlushTelemetry() function
+- Answer a request on the metrics endpoint with metrics.serve() method, if one is waiting
+- Print the connection counters of connectionManager and the throughput every minute
+    - Items sorted in the last minute and the best minute since boot, the rate reached when people queue at the bin
+    - Bin measurements without enough valid pings since boot
+    - Telemetry readings accepted by the server, waiting in the buffer and dropped since boot
+    - Every histogram and counter of metrics as one line of JSON, after "Metrics: "
 */
 void loop() {
-    if (WiFi.status() == WL_CONNECTED) {
-        if (doHTTPPOSTtrigger == true) {
-            taskHTTPPOSTtrigger();
-            delay(45000);
-        } else if (doHTTPGETprediction == true) {
-            taskHTTPGETprediction();
-            delay(1000);
-        } else if (doHTTPPOSTcapacity == true) {
-            switch (predictionResult) {
-                case 0:
-                    taskKinematics(0);
-                    taskUltrasonicTXRX(TRIG_PIN_0, ECHO_PIN_0);
-                    taskHTTPPOSTcapacity(cardboardBinID, capacity[0]);
-                    taskDisplay();
-                    break;
-                case 1:
-                    taskKinematics(1);
-                    taskUltrasonicTXRX(TRIG_PIN_1, ECHO_PIN_1);
-                    taskHTTPPOSTcapacity(metalCanBinID, capacity[1]);
-                    taskDisplay();
-                    break;
-                case 2:
-                    taskKinematics(2);
-                    taskUltrasonicTXRX(TRIG_PIN_2, ECHO_PIN_2);
-                    taskHTTPPOSTcapacity(plasticBinID, capacity[2]);
-                    taskDisplay();
-                    break;
-            }
+    unsigned long wifiConnectMs = 0;
+    if (wifiLink.poll(wifiConnectMs)) {
+        metrics.record("wifi_connect", wifiConnectMs);
+    }
+    taskBootProgress(); // Boot bits, power-on-to-ready time once every part is ready
+    if ((xEventGroupWaitBits(bootReady, BOOT_SENSORS, pdFALSE, pdTRUE, pdMS_TO_TICKS(LOOP_TICK_MS)) & BOOT_SENSORS) == 0) {
+        return; // taskBootSensors() still measuring the bins
+    }
+    taskServiceUltrasonic();
+    taskPollEvents();
+
+    Event event;
+    if (xQueueReceive(eventQueue, &event, pdMS_TO_TICKS(LOOP_TICK_MS)) == pdTRUE) {
+        taskHandleEvent(event);
+    }
+    taskSchedule();
+
+    if (millis() - lastCapacityRefresh >= CAPACITY_REFRESH_MS) {
+        taskStartMeasurement((1 << BIN_COUNT) - 1);
+        capacityRefreshRunning = true;
+        lastCapacityRefresh = millis();
+    }
+    if (capacityRefreshRunning == true && ultrasonicPending == 0) {
+        capacityRefreshRunning = false;
+        if (taskFindStage(STAGE_TRIGGER_LAN, STAGE_MEASURE) == -1 && wifiConnected == true) {
+            taskDisplay();
         }
-    } else {
-        do {
-            lcd.clear();
-            lcd.setCursor(0, 0); lcd.print("Reconnecting ...");
-            delay(3000);
-        } while (WiFi.status() != WL_CONNECTED);
-        lcd.clear();
-        lcd.setCursor(0, 0); lcd.print("Wi-Fi Connected!");
-        delay(1000);
-        lcd.clear();
-        taskDisplay();
-    }
-}
\ No newline at end of file
+    }
+    taskSampleTelemetry();
+    taskFlushTelemetry();
+    metrics.serve(metricsServer);
+
+    if (millis() - lastStatsLog >= 60000) {
+        connectionManager.printStats(Serial0); // Connection reuse and DNS cache counters
+        unsigned long itemsLastMinute = itemsSorted - itemsSortedAtLastLog;
+        peakItemsPerMinute = max(peakItemsPerMinute, itemsLastMinute);
+        itemsSortedAtLastLog = itemsSorted;
+        Serial0.println("Items sorted: " + String(itemsLastMinute) + " in the last minute, peak " +
+                        String(peakItemsPerMinute) + " per minute, " + String(itemsSorted) + " since boot, " +
+                        String(buttonPresses.dropped()) + " presses dropped, " + String(ultrasonicFailures) +
+                        " failed bin measurements");
+        Serial0.println("Telemetry: " + String(telemetrySent) + " readings sent, " + String(telemetryCount) +
+                        " queued, " + String(telemetryDropped) + " dropped");
+        Serial0.print("Metrics: ");
+        metrics.printJSON(Serial0);
+        Serial0.println();
+        lastStatsLog = millis();
+    }
+}
@@ -0,0 +1,269 @@
+#include "ConnectionManager.h"
+
+ConnectionManager::ConnectionManager() : current_(NULL), reused_(false) {
+    for (int i = 0; i < CONNECTION_MAX_HOSTS; i++) {
+        slots_[i].port = 0;
+        slots_[i].secure = false;
+        slots_[i].resolved = false;
+        slots_[i].resolvedAt = 0;
+        slots_[i].lastUsed = 0;
+    }
+    stats_.connectionHits = 0;
+    stats_.connectionMisses = 0;
+    stats_.dnsHits = 0;
+    stats_.dnsMisses = 0;
+    stats_.reconnects = 0;
+}
+
+/* parseURL() function
+- Split url into host, port, path and scheme
+- Port defaults to 80 for http and 443 for https, path defaults to "/"
+- Return false if there is no host
+*/
+bool ConnectionManager::parseURL(const String &url, String &host, uint16_t &port, String &path, bool &secure) {
+    String rest = url;
+    secure = false;
+    int schemeEnd = rest.indexOf("://");
+    if (schemeEnd != -1) {
+        secure = rest.substring(0, schemeEnd) == "https";
+        rest = rest.substring(schemeEnd + 3);
+    }
+    port = secure ? 443 : 80;
+    int pathStart = rest.indexOf('/');
+    host = pathStart == -1 ? rest : rest.substring(0, pathStart);
+    path = pathStart == -1 ? String("/") : rest.substring(pathStart);
+    int portStart = host.indexOf(':');
+    if (portStart != -1) {
+        port = host.substring(portStart + 1).toInt();
+        host = host.substring(0, portStart);
+    }
+    return host.length() > 0;
+}
+
+/* slotFor() function
+- Find the slot of a server, or take over the least recently used one
+- A slot that is taken over closes its socket and forgets its address
+*/
+ConnectionManager::Slot *ConnectionManager::slotFor(const String &host, uint16_t port, bool secure) {
+    Slot *oldest = &slots_[0];
+    for (int i = 0; i < CONNECTION_MAX_HOSTS; i++) {
+        Slot *slot = &slots_[i];
+        if (slot->port == port && slot->secure == secure && slot->host == host) {
+            return slot;
+        }
+        if (slot->lastUsed < oldest->lastUsed) {
+            oldest = slot;
+        }
+    }
+    oldest->client().stop();
+    oldest->host = host;
+    oldest->port = port;
+    oldest->secure = secure;
+    oldest->resolved = false;
+    if (secure) {
+        oldest->secureClient.setInsecure();
+    }
+    return oldest;
+}
+
+/* open() function
+- Make sure the socket of the slot is connected
+- Reuse the socket if it is still connected (hit), otherwise connect a new one (miss)
+- Connect by cached IP address, resolve it first if unknown or older than CONNECTION_DNS_TTL_MS
+- Forget the address if the connection fails, so the next attempt resolves it again
+*/
+bool ConnectionManager::open(Slot *slot) {
+    slot->lastUsed = millis();
+    if (slot->client().connected()) {
+        stats_.connectionHits++;
+        reused_ = true;
+        return true;
+    }
+    reused_ = false;
+    stats_.connectionMisses++;
+    slot->client().stop();
+
+    if (slot->secure) {
+        return slot->client().connect(slot->host.c_str(), slot->port);
+    }
+    if (slot->resolved && millis() - slot->resolvedAt < CONNECTION_DNS_TTL_MS) {
+        stats_.dnsHits++;
+    } else {
+        stats_.dnsMisses++;
+        slot->resolved = WiFi.hostByName(slot->host.c_str(), slot->address) == 1;
+        slot->resolvedAt = millis();
+        if (!slot->resolved) {
+            return false;
+        }
+    }
+    if (!slot->client().connect(slot->address, slot->port)) {
+        slot->resolved = false;
+        return false;
+    }
+    return true;
+}
+
+/* begin() function
+- Prepare http for a request to url on the kept-alive socket of its server
+- Return false if url is invalid or the server cannot be reached
+*/
+bool ConnectionManager::begin(HTTPClient &http, const String &url) {
+    String host;
+    String path;
+    uint16_t port;
+    bool secure;
+    if (!parseURL(url, host, port, path, secure)) {
+        current_ = NULL;
+        return false;
+    }
+    current_ = slotFor(host, port, secure);
+    http.setReuse(true);
+    http.begin(current_->client(), url);
+    return open(current_);
+}
+
+/* sendRequest() function
+- Send the request prepared with begin(), with the headers added since
+- If it fails on a reused socket (closed by the server while idle), reconnect and send it once more
+- Return HTTP response code, or the negative HTTPClient error code
+*/
+int ConnectionManager::sendRequest(HTTPClient &http, const char *type, const uint8_t *payload, size_t size) {
+    if (current_ == NULL) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    int httpResponseCode = http.sendRequest(type, payload, size);
+    if (httpResponseCode < 0 && reused_) {
+        if (reconnect() == NULL) {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        httpResponseCode = http.sendRequest(type, payload, size);
+    }
+    if (httpResponseCode < 0) {
+        current_->client().stop();
+    }
+    return httpResponseCode;
+}
+
+int ConnectionManager::GET(HTTPClient &http) {
+    return sendRequest(http, "GET", NULL, 0);
+}
+
+int ConnectionManager::POST(HTTPClient &http, const String &payload) {
+    return sendRequest(http, "POST", (const uint8_t *)payload.c_str(), payload.length());
+}
+
+/* end() function
+- Finish the request, the socket stays open unless the server asked to close it
+*/
+void ConnectionManager::end(HTTPClient &http) {
+    http.end();
+}
+
+/* connect() function
+- Give the kept-alive socket of the server of url, for requests written by hand (streamed upload)
+- Return NULL if url is invalid or the server cannot be reached
+- Call release() once the reply has been read
+*/
+WiFiClient *ConnectionManager::connect(const String &url) {
+    String host;
+    String path;
+    uint16_t port;
+    bool secure;
+    if (!parseURL(url, host, port, path, secure)) {
+        current_ = NULL;
+        return NULL;
+    }
+    current_ = slotFor(host, port, secure);
+    if (!open(current_)) {
+        return NULL;
+    }
+    return &current_->client();
+}
+
+/* reconnect() function
+- Close the socket of the last request and open a fresh one to the same server
+- Used for the second attempt of a request that failed on a reused socket
+*/
+WiFiClient *ConnectionManager::reconnect() {
+    if (current_ == NULL) {
+        return NULL;
+    }
+    stats_.reconnects++;
+    current_->client().stop();
+    if (!open(current_)) {
+        return NULL;
+    }
+    return &current_->client();
+}
+
+/* readResponse() function
+- Read the reply to a request written by hand on the socket from connect()
+- Wait up to timeoutMs for the status line, then read the headers and skip the body
+    - Content-Length tells how much body to skip, "Connection: close" that the socket cannot be reused
+- Keep the socket open only if the whole reply was read and the server did not close it
+- Return HTTP response code, or -1 if no reply came back
+*/
+int ConnectionManager::readResponse(unsigned long timeoutMs) {
+    if (current_ == NULL) {
+        return -1;
+    }
+    WiFiClient &client = current_->client();
+    unsigned long responseStart = millis();
+    while (client.available() == 0) {
+        if (!client.connected() || millis() - responseStart > timeoutMs) {
+            release(false);
+            return -1;
+        }
+        delay(10);
+    }
+
+    String statusLine = client.readStringUntil('\n');
+    int httpResponseCode = statusLine.substring(statusLine.indexOf(' ') + 1).toInt();
+    long contentLength = -1;
+    bool keepAlive = httpResponseCode > 0;
+    for (;;) {
+        String headerLine = client.readStringUntil('\n');
+        headerLine.trim();
+        if (headerLine.length() == 0) {
+            break;
+        }
+        int colon = headerLine.indexOf(':');
+        String name = headerLine.substring(0, colon);
+        String value = headerLine.substring(colon + 1);
+        value.trim();
+        if (name.equalsIgnoreCase("Content-Length")) {
+            contentLength = value.toInt();
+        } else if (name.equalsIgnoreCase("Connection") && value.equalsIgnoreCase("close")) {
+            keepAlive = false;
+        }
+    }
+    if (contentLength < 0) {
+        keepAlive = false;
+    }
+    while (keepAlive && contentLength > 0) {
+        uint8_t discard[64];
+        size_t count = client.readBytes(discard, min((long)sizeof(discard), contentLength));
+        if (count == 0) {
+            keepAlive = false;
+        }
+        contentLength -= count;
+    }
+    release(keepAlive);
+    return httpResponseCode > 0 ? httpResponseCode : -1;
+}
+
+/* release() function
+- Give back the socket taken with connect()
+- keepAlive false closes it, for a failed request or a reply that was not read completely
+*/
+void ConnectionManager::release(bool keepAlive) {
+    if (current_ != NULL && !keepAlive) {
+        current_->client().stop();
+    }
+}
+
+void ConnectionManager::printStats(Print &out) const {
+    out.println("Connections: " + String(stats_.connectionHits) + " reused, " + String(stats_.connectionMisses) +
+                " new, " + String(stats_.reconnects) + " reconnects, DNS " + String(stats_.dnsHits) + " cached, " +
+                String(stats_.dnsMisses) + " lookups");
+}
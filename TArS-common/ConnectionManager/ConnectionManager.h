@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+
+/* ConnectionManager
+- Shared by ESP32-CAM and ESP32-S3 to keep HTTP connections to the server alive between requests
+- One slot per server (scheme + host + port), up to CONNECTION_MAX_HOSTS slots
+    - Each slot owns its WiFiClient (WiFiClientSecure for https), HTTPClient borrows it with setReuse(true)
+    - The least recently used slot is given to a new server once all slots are taken
+- Cached DNS: the server address is resolved once and the socket is connected by IP
+    - Resolved again after CONNECTION_DNS_TTL_MS or after a failed connection
+    - https connects by host name, the TLS handshake needs it for SNI, lwIP keeps its own DNS cache
+- Transparent reconnect: a request that fails on a kept-alive socket is sent once more on a fresh one
+- Counters: connection hits (socket reused) and misses (new connection), DNS hits and misses, reconnects
+- Usage with HTTPClient:
+    connectionManager.begin(client, url);
+    client.addHeader(...);
+    int httpResponseCode = connectionManager.POST(client, payload);  // or GET(client)
+    String payload = client.getString();
+    connectionManager.end(client);
+- Usage with a raw socket (streamed upload):
+    WiFiClient *client = connectionManager.connect(url);  // reconnect() for a second attempt
+    client->write(...);
+    int httpResponseCode = connectionManager.readResponse(timeoutMs);  // or release(false) to give up
+*/
+#define CONNECTION_MAX_HOSTS 2
+#define CONNECTION_DNS_TTL_MS 600000
+
+struct ConnectionStats {
+    unsigned long connectionHits;
+    unsigned long connectionMisses;
+    unsigned long dnsHits;
+    unsigned long dnsMisses;
+    unsigned long reconnects;
+};
+
+class ConnectionManager {
+public:
+    ConnectionManager();
+
+    bool begin(HTTPClient &http, const String &url);
+    int GET(HTTPClient &http);
+    int POST(HTTPClient &http, const String &payload);
+    int sendRequest(HTTPClient &http, const char *type, const uint8_t *payload, size_t size);
+    void end(HTTPClient &http);
+
+    WiFiClient *connect(const String &url);
+    WiFiClient *reconnect();
+    int readResponse(unsigned long timeoutMs);
+    void release(bool keepAlive);
+    bool reused() const { return reused_; }
+
+    const ConnectionStats &stats() const { return stats_; }
+    void printStats(Print &out) const;
+
+    static bool parseURL(const String &url, String &host, uint16_t &port, String &path, bool &secure);
+
+private:
+    struct Slot {
+        String host;
+        uint16_t port;
+        bool secure;
+        IPAddress address;
+        bool resolved;
+        unsigned long resolvedAt;
+        unsigned long lastUsed;
+        WiFiClient plainClient;
+        WiFiClientSecure secureClient;
+
+        WiFiClient &client() { return secure ? secureClient : plainClient; }
+    };
+
+    Slot *slotFor(const String &host, uint16_t port, bool secure);
+    bool open(Slot *slot);
+
+    Slot slots_[CONNECTION_MAX_HOSTS];
+    Slot *current_;
+    bool reused_;
+    ConnectionStats stats_;
+};
@@ -0,0 +1,186 @@
+#include "EdgeClassifier.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "EdgeModel.h"
+
+// label() function, to find the name of class index, the same the server answers with in detected_type
+const char *EdgeClassifier::label(int index) {
+    static const char *const LABELS[EDGE_CLASS_COUNT] = {"paper", "metal", "plastic"};
+    return index >= 0 && index < EDGE_CLASS_COUNT ? LABELS[index] : "unknown";
+}
+
+/* requantize() function
+- Function to scale an int32 accumulator by multiplier * 2^(shift - 31), rounded to nearest
+- 64-bit product, so any Q31 multiplier works with any accumulator
+*/
+int32_t EdgeClassifier::requantize(int32_t accumulator, int32_t multiplier, int shift) {
+    int rightShift = 31 - shift;
+    int64_t product = (int64_t)accumulator * multiplier;
+    return (int32_t)((product + ((int64_t)1 << (rightShift - 1))) >> rightShift);
+}
+
+// clampInt8() function, to saturate a requantized value, at low if relu
+static int8_t clampInt8(int32_t value, int32_t low) {
+    return (int8_t)(value < low ? low : (value > 127 ? 127 : value));
+}
+
+/* classifyRGB565() function
+- Function to average the frame down to the input size into the arena, pixel - 128 per channel
+- A box of (width / EDGE_INPUT_WIDTH) x (height / EDGE_INPUT_HEIGHT) pixels makes one input pixel
+- Return false if the frame is smaller than the input
+*/
+bool EdgeClassifier::classifyRGB565(const uint8_t *pixels, int width, int height, EdgeResult &result) {
+    if (width < EDGE_INPUT_WIDTH || height < EDGE_INPUT_HEIGHT) {
+        return false;
+    }
+    int boxWidth = width / EDGE_INPUT_WIDTH;
+    int boxHeight = height / EDGE_INPUT_HEIGHT;
+    int boxPixels = boxWidth * boxHeight;
+    int8_t *input = arena_;
+    for (int y = 0; y < EDGE_INPUT_HEIGHT; y++) {
+        for (int x = 0; x < EDGE_INPUT_WIDTH; x++) {
+            uint32_t r = 0, g = 0, b = 0;
+            for (int by = 0; by < boxHeight; by++) {
+                const uint8_t *pixel = pixels + 2 * ((y * boxHeight + by) * width + x * boxWidth);
+                for (int bx = 0; bx < boxWidth; bx++, pixel += 2) {
+                    uint16_t value = (uint16_t)(pixel[0] << 8 | pixel[1]);
+                    r += (value >> 8) & 0xF8;
+                    g += (value >> 3) & 0xFC;
+                    b += (value << 3) & 0xF8;
+                }
+            }
+            *input++ = (int8_t)(r / boxPixels - 128);
+            *input++ = (int8_t)(g / boxPixels - 128);
+            *input++ = (int8_t)(b / boxPixels - 128);
+        }
+    }
+    return run(result);
+}
+
+// classifyRGB888() function, like classifyRGB565() for pixels of three bytes R, G, B
+bool EdgeClassifier::classifyRGB888(const uint8_t *pixels, int width, int height, EdgeResult &result) {
+    if (width < EDGE_INPUT_WIDTH || height < EDGE_INPUT_HEIGHT) {
+        return false;
+    }
+    int boxWidth = width / EDGE_INPUT_WIDTH;
+    int boxHeight = height / EDGE_INPUT_HEIGHT;
+    int boxPixels = boxWidth * boxHeight;
+    int8_t *input = arena_;
+    for (int y = 0; y < EDGE_INPUT_HEIGHT; y++) {
+        for (int x = 0; x < EDGE_INPUT_WIDTH; x++) {
+            uint32_t sum[3] = {0, 0, 0};
+            for (int by = 0; by < boxHeight; by++) {
+                const uint8_t *pixel = pixels + 3 * ((y * boxHeight + by) * width + x * boxWidth);
+                for (int bx = 0; bx < boxWidth * 3; bx++) {
+                    sum[bx % 3] += pixel[bx];
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                *input++ = (int8_t)(sum[c] / boxPixels - 128);
+            }
+        }
+    }
+    return run(result);
+}
+
+/* run() function
+- Function to run the layers of EdgeModel.h on the input at the start of the arena
+- The arena is split in two halves, every layer reads one and writes the other
+- Return false if a tensor does not fit in half of the arena
+- The confidence is the softmax of the class scores, EDGE_SCORE_SCALE turns a score into a logit
+*/
+bool EdgeClassifier::run(EdgeResult &result) {
+    width_ = EDGE_INPUT_WIDTH;
+    height_ = EDGE_INPUT_HEIGHT;
+    channels_ = EDGE_INPUT_CHANNELS;
+    result.macs = 0;
+    int8_t *in = arena_;
+    int8_t *out = arena_ + EDGE_ARENA_BYTES / 2;
+    size_t used = (size_t)width_ * height_ * channels_;
+    for (size_t i = 0; i < sizeof(EDGE_LAYERS) / sizeof(EDGE_LAYERS[0]); i++) {
+        const EdgeLayer &layer = EDGE_LAYERS[i];
+        if (layer.kind == EDGE_LAYER_AVERAGE) {
+            average(layer, in, out);
+        } else if (!convolve(layer, in, out, result.macs)) {
+            return false;
+        }
+        size_t outSize = (size_t)width_ * height_ * channels_;
+        used = used > outSize ? used : outSize;
+        int8_t *swap = in;
+        in = out;
+        out = swap;
+    }
+    arenaUsed_ = 2 * used;
+
+    int best = 0;
+    for (int i = 0; i < EDGE_CLASS_COUNT; i++) {
+        result.scores[i] = in[i];
+        if (in[i] > in[best]) {
+            best = i;
+        }
+    }
+    float total = 0;
+    for (int i = 0; i < EDGE_CLASS_COUNT; i++) {
+        total += expf((in[i] - in[best]) * EDGE_SCORE_SCALE);
+    }
+    result.label = best;
+    result.confidence = 1.0f / total;
+    return true;
+}
+
+/* convolve() function
+- Function to run one EDGE_LAYER_CONV layer from in to out, NHWC, same padding with the input zero point
+- Output size is the input size divided by stride, rounded up
+*/
+bool EdgeClassifier::convolve(const EdgeLayer &layer, const int8_t *in, int8_t *out, uint32_t &macs) {
+    int outWidth = (width_ + layer.stride - 1) / layer.stride;
+    int outHeight = (height_ + layer.stride - 1) / layer.stride;
+    if ((size_t)outWidth * outHeight * layer.outChannels > EDGE_ARENA_BYTES / 2) {
+        return false;
+    }
+    int pad = layer.kernel / 2;
+    int32_t low = layer.relu ? layer.outZero : -128;
+    for (int oy = 0; oy < outHeight; oy++) {
+        for (int ox = 0; ox < outWidth; ox++) {
+            for (int oc = 0; oc < layer.outChannels; oc++) {
+                int32_t accumulator = layer.bias[oc];
+                const int8_t *weight = layer.weights + oc * layer.kernel * layer.kernel * channels_;
+                for (int ky = 0; ky < layer.kernel; ky++) {
+                    int iy = oy * layer.stride + ky - pad;
+                    for (int kx = 0; kx < layer.kernel; kx++, weight += channels_) {
+                        int ix = ox * layer.stride + kx - pad;
+                        if (iy < 0 || iy >= height_ || ix < 0 || ix >= width_) {
+                            continue;
+                        }
+                        const int8_t *pixel = in + (iy * width_ + ix) * channels_;
+                        for (int ic = 0; ic < channels_; ic++) {
+                            accumulator += (pixel[ic] - layer.inZero) * weight[ic];
+                        }
+                    }
+                }
+                macs += layer.kernel * layer.kernel * channels_;
+                *out++ = clampInt8(layer.outZero + requantize(accumulator, layer.multiplier, layer.shift), low);
+            }
+        }
+    }
+    width_ = outWidth;
+    height_ = outHeight;
+    channels_ = layer.outChannels;
+    return true;
+}
+
+// average() function, to run one EDGE_LAYER_AVERAGE layer, every channel becomes its mean, rounded to nearest
+void EdgeClassifier::average(const EdgeLayer &layer, const int8_t *in, int8_t *out) {
+    int32_t count = width_ * height_;
+    for (int c = 0; c < channels_; c++) {
+        int32_t sum = 0;
+        for (int i = 0; i < count; i++) {
+            sum += in[i * channels_ + c] - layer.inZero;
+        }
+        out[c] = clampInt8(layer.outZero + (sum + count / 2) / count, -128);
+    }
+    width_ = 1;
+    height_ = 1;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* EdgeClassifier
+- Small int8 convolutional classifier for paper, metal and plastic, run on the board itself
+- No heap: the activations live in the tensor arena inside the object, the weights are const (flash)
+- Fixed-point all the way to the class scores, like TensorFlow Lite Micro int8 kernels
+    - Activations: int8 with a zero point, weights: symmetric int8, bias: int32 in accumulator units
+    - Accumulators are int32, brought back to int8 with a Q31 multiplier and a shift (requantize())
+    - Only the softmax over the three scores, giving the confidence, is done in float
+- Input: EDGE_INPUT_WIDTH x EDGE_INPUT_HEIGHT RGB, any larger frame is averaged down to it
+    - classifyRGB565(): pixels as jpg2rgb565() writes them (high byte first), e.g. a JPEG decoded at 1/8 scale
+    - classifyRGB888(): pixels as R, G, B bytes, e.g. a PPM file on the host
+- The layers are listed in EdgeModel.h, a trained int8 export can replace them as long as it uses
+  EDGE_LAYER_CONV (1x1 convolutions double as fully connected layers) and EDGE_LAYER_AVERAGE
+- Usage:
+    EdgeClassifier classifier;              // global, the arena is EDGE_ARENA_BYTES
+    EdgeResult result;
+    if (classifier.classifyRGB565(pixels, 30, 30, result) && result.confidence >= 0.8f) {
+        ... EdgeClassifier::label(result.label) ...
+    }
+*/
+#define EDGE_INPUT_WIDTH 30
+#define EDGE_INPUT_HEIGHT 30
+#define EDGE_INPUT_CHANNELS 3
+#define EDGE_CLASS_COUNT 3
+#define EDGE_ARENA_BYTES 6144
+
+#define EDGE_LAYER_CONV 0
+#define EDGE_LAYER_AVERAGE 1
+
+/* EdgeLayer
+- kind: EDGE_LAYER_CONV (same padding) or EDGE_LAYER_AVERAGE (global average pooling, keeps the scale)
+- kernel, stride, outChannels: shape of the convolution, weights are [outChannels][kernel][kernel][inChannels]
+- multiplier, shift: requantization scale multiplier * 2^(shift - 31) from accumulator to output
+- inZero, outZero: zero points of input and output, relu clamps the output at outZero
+*/
+struct EdgeLayer {
+    int kind;
+    int kernel;
+    int stride;
+    int outChannels;
+    const int8_t *weights;
+    const int32_t *bias;
+    int32_t multiplier;
+    int shift;
+    int8_t inZero;
+    int8_t outZero;
+    bool relu;
+};
+
+/* EdgeResult
+- label: index of the best class, see label()
+- confidence: softmax probability of that class, 0..1
+- scores: class scores (int8) of the last layer
+- macs: multiply-accumulates it took, for the benchmark
+*/
+struct EdgeResult {
+    int label;
+    float confidence;
+    int8_t scores[EDGE_CLASS_COUNT];
+    uint32_t macs;
+};
+
+class EdgeClassifier {
+public:
+    bool classifyRGB565(const uint8_t *pixels, int width, int height, EdgeResult &result);
+    bool classifyRGB888(const uint8_t *pixels, int width, int height, EdgeResult &result);
+
+    static const char *label(int index);
+    static int32_t requantize(int32_t accumulator, int32_t multiplier, int shift);
+    size_t arenaUsed() const { return arenaUsed_; }
+
+private:
+    bool run(EdgeResult &result);
+    bool convolve(const EdgeLayer &layer, const int8_t *in, int8_t *out, uint32_t &macs);
+    void average(const EdgeLayer &layer, const int8_t *in, int8_t *out);
+
+    int8_t arena_[EDGE_ARENA_BYTES];
+    int width_ = 0;
+    int height_ = 0;
+    int channels_ = 0;
+    size_t arenaUsed_ = 0;
+};
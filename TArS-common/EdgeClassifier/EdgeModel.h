@@ -0,0 +1,60 @@
+#pragma once
+
+#include "EdgeClassifier.h"
+
+/* EdgeModel
+- Layers run by EdgeClassifier, included by EdgeClassifier.cpp only
+- colour (1x1 conv, 3 -> 3, ReLU): what colour the chute shows, per input pixel
+    - warm: R - B, cool: B - R, bright: luma (R + 2G + B) / 4 above the dark chute (90)
+- texture (3x3 conv, stride 2, 3 -> 4, ReLU): 15 x 15 map of
+    - warm and cool summed over the 3x3 window
+    - gloss: the Laplacian of bright, both signs, four times amplified: highlight and shadow bands
+      of a curved can, the edges of the item add a little to every class
+- pool (global average): the four features of the whole frame
+- class (1x1 conv on 1x1, 4 -> 3): one score per class, paper, metal, plastic
+    - Fitted by softmax regression on the pooled features of synthetic chute frames, see
+      TArS-simulator/hal/sim/Scene.h, then scaled to int8 (weights x40, bias in accumulator units)
+    - EDGE_SCORE_SCALE: a score of 10 is a logit of 1
+- Activations keep the zero point -128 up to the scores, so a ReLU output uses all of 0..255
+- These weights are hand-designed for, and fitted to, the simulator's rendered frames only: the agreement the
+  simulator reports is not a measure of the real chute, ESP32-S3 does not sort on it (EDGE_SORT_ENABLED false)
+- Producing weights for the real chute:
+    - Photograph items of each class in the chute with PROFILE_CHUTE, decode at 1/8 scale (30x30 RGB, as taskClassifyImage()),
+      keep part of them aside for the test
+    - Train a model of the same layers (1x1 conv 3 -> 3 ReLU, 3x3 conv stride 2 3 -> 4 ReLU, global average, 1x1 conv 4 -> 3)
+      on the RGB values 0..255, e.g. in PyTorch or Keras
+    - Quantize to int8 with zero point -128 for the activations: weights scaled by a power of two into -127..127,
+      bias in accumulator units (input scale x weight scale), the shift of each layer in EDGE_LAYERS undoes the scale
+    - Paste the arrays here, check accuracy and the confident share on the test photos with edge_bench (README),
+      only then turn on EDGE_SORT_ENABLED of ESP32-S3
+*/
+static const int8_t COLOR_WEIGHTS[] = {
+    4, 0, -4,
+    -4, 0, 4,
+    1, 2, 1,
+};
+static const int32_t COLOR_BIAS[] = {0, 0, -360};
+
+static const int8_t TEXTURE_WEIGHTS[] = {
+    1, 0, 0,  1, 0, 0,  1, 0, 0,  1, 0, 0,  1, 0, 0,  1, 0, 0,  1, 0, 0,  1, 0, 0,  1, 0, 0,
+    0, 1, 0,  0, 1, 0,  0, 1, 0,  0, 1, 0,  0, 1, 0,  0, 1, 0,  0, 1, 0,  0, 1, 0,  0, 1, 0,
+    0, 0, -4,  0, 0, -4,  0, 0, -4,  0, 0, -4,  0, 0, 32,  0, 0, -4,  0, 0, -4,  0, 0, -4,  0, 0, -4,
+    0, 0, 4,  0, 0, 4,  0, 0, 4,  0, 0, 4,  0, 0, -32,  0, 0, 4,  0, 0, 4,  0, 0, 4,  0, 0, 4,
+};
+static const int32_t TEXTURE_BIAS[] = {0, 0, 0, 0};
+
+static const int8_t CLASS_WEIGHTS[] = {
+    75, -68, -84, -84,
+    -51, -41, 116, 116,
+    -24, 109, -31, -31,
+};
+static const int32_t CLASS_BIAS[] = {1795, -1495, -301};
+
+#define EDGE_SCORE_SCALE 0.1f
+
+static const EdgeLayer EDGE_LAYERS[] = {
+    {EDGE_LAYER_CONV, 1, 1, 3, COLOR_WEIGHTS, COLOR_BIAS, 1 << 30, -1, -128, -128, true},       // x 1/4
+    {EDGE_LAYER_CONV, 3, 2, 4, TEXTURE_WEIGHTS, TEXTURE_BIAS, 1 << 30, -2, -128, -128, true},   // x 1/8
+    {EDGE_LAYER_AVERAGE, 0, 0, 0, NULL, NULL, 0, 0, -128, -128, false},
+    {EDGE_LAYER_CONV, 1, 1, 3, CLASS_WEIGHTS, CLASS_BIAS, 1 << 30, -6, -128, 0, false},         // x 1/128
+};
@@ -0,0 +1,58 @@
+#include "FramePool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* begin() function
+- Allocate the block of all slots once, a second call keeps the first pool
+- PSRAM first if the board has it, internal RAM otherwise
+*/
+bool FramePool::begin(int slots, size_t slotBytes) {
+    if (memory_ != NULL) {
+        return true;
+    }
+    if (slots < 1 || slots > FRAME_POOL_MAX_SLOTS || slotBytes == 0) {
+        return false;
+    }
+    psram_ = psramFound();
+    memory_ = (uint8_t *)(psram_ ? ps_malloc((size_t)slots * slotBytes) : malloc((size_t)slots * slotBytes));
+    if (memory_ == NULL) {
+        return false;
+    }
+    slots_ = slots;
+    slotBytes_ = slotBytes;
+    for (int slot = 0; slot < slots; slot++) {
+        frames_[slot].buf = memory_ + (size_t)slot * slotBytes;
+        frames_[slot].len = 0;
+    }
+    freeMask_ = (1u << slots) - 1;
+    return true;
+}
+
+int FramePool::acquire() {
+    if (freeMask_ == 0) {
+        return -1;
+    }
+    int slot = __builtin_ctz(freeMask_);
+    freeMask_ &= ~(1u << slot);
+    return slot;
+}
+
+void FramePool::release(int slot) {
+    if (slot < 0 || slot >= slots_) {
+        return;
+    }
+    frames_[slot].len = 0;
+    freeMask_ |= 1u << slot;
+}
+
+bool FramePool::copy(int slot, const uint8_t *data, size_t len, int width, int height) {
+    if (slot < 0 || slot >= slots_ || len > slotBytes_) {
+        return false;
+    }
+    memcpy(frames_[slot].buf, data, len);
+    frames_[slot].len = len;
+    frames_[slot].width = (uint16_t)width;
+    frames_[slot].height = (uint16_t)height;
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* FramePool
+- Fixed pool of JPEG frame buffers, allocated once at boot, so handling an image allocates nothing afterwards
+- begin(slots, slotBytes): one block of slots x slotBytes, up to FRAME_POOL_MAX_SLOTS slots
+    - In PSRAM with ps_malloc() if the board has it, in internal RAM otherwise
+    - bytes() is all the memory the pool takes, fixed from begin() on, begin() returns false if it can not be allocated
+- acquire() hands out a free slot (-1 if none), release() gives it back, both from one task, the owner of the pool
+    - In between the slot belongs to whichever task it was handed to, e.g. through a RingBuffer of slot numbers
+- copy(slot, data, len, width, height): the image into the slot, false if it is larger than slotBytes()
+- frame(slot): buffer, length and size of the image in the slot
+- Usage:
+    FramePool pool;
+    pool.begin(3, 32768);                   // at boot, 96 KB in PSRAM
+    int slot = pool.acquire();
+    if (slot >= 0 && pool.copy(slot, fb->buf, fb->len, fb->width, fb->height)) {
+        esp_camera_fb_return(fb);           // the camera can take the next frame at once
+        ready.push(slot);                   // handed to the task that uploads it
+    }
+    ...
+    pool.release(slot);                     // once it came back, on the task that acquired it
+*/
+#define FRAME_POOL_MAX_SLOTS 8
+
+struct PoolFrame {
+    uint8_t *buf;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+};
+
+class FramePool {
+public:
+    bool begin(int slots, size_t slotBytes);
+
+    int acquire();
+    void release(int slot);
+    bool copy(int slot, const uint8_t *data, size_t len, int width, int height);
+
+    PoolFrame &frame(int slot) { return frames_[slot]; }
+    int slots() const { return slots_; }
+    int available() const { return __builtin_popcount(freeMask_); }
+    size_t slotBytes() const { return slotBytes_; }
+    size_t bytes() const { return (size_t)slots_ * slotBytes_; }
+    bool inPSRAM() const { return psram_; }
+
+private:
+    uint8_t *memory_ = NULL;
+    PoolFrame frames_[FRAME_POOL_MAX_SLOTS] = {};
+    uint32_t freeMask_ = 0;   // bit n: slot n is free
+    int slots_ = 0;
+    size_t slotBytes_ = 0;
+    bool psram_ = false;
+};
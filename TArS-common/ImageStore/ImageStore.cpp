@@ -0,0 +1,412 @@
+#include "ImageStore.h"
+
+#include <string.h>
+
+static const uint32_t IMAGE_MAGIC = 0x474D4954;   // "TIMG"
+static const uint32_t INDEX_MAGIC = 0x58444954;   // "TIDX"
+
+static_assert(sizeof(ImageHeader) == IMAGE_STORE_HEADER_BYTES, "ImageHeader must fill IMAGE_STORE_HEADER_BYTES");
+static_assert(sizeof(ImageRecord) == 20, "ImageRecord is written to the index file as it is");
+
+// fnv1a() function, to add size bytes of data to the FNV-1a hash, the checksum of headers and index files
+static uint32_t fnv1a(const void *data, size_t size, uint32_t hash = 2166136261u) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+ImageStore::ImageStore()
+    : fs_(NULL), ready_(false), blocks_(1), oldestSeq_(1), nextSeq_(1), nextBlock_(0), replaySeq_(1), pending_(0),
+      checkpoint_(0), changes_(0), stats_() {
+    memset(&header_, 0, sizeof(header_));
+    memset(records_, 0, sizeof(records_));
+}
+
+/* begin() function
+- Function to open the store in directory, a ring of blocks blocks, creating the folder and the data file if needed
+    - The data file is preallocated in one step, by writing its last byte, and started from scratch if its size
+      does not match blocks (the index files of the old one are removed)
+- Load the newest valid index file with loadIndex(), a record still being written at the checkpoint is checked by
+  its header, then take up the records written after the checkpoint with recover()
+- Return false if the card can not hold the store
+*/
+bool ImageStore::begin(fs::FS &fs, const char *directory, uint32_t blocks) {
+    ready_ = false;
+    if (blocks == 0 || blocks > IMAGE_STORE_MAX_BLOCKS) {
+        return false;
+    }
+    fs_ = &fs;
+    blocks_ = blocks;
+    oldestSeq_ = nextSeq_ = replaySeq_ = 1;
+    nextBlock_ = pending_ = checkpoint_ = changes_ = 0;
+    stats_ = ImageStoreStats();
+    memset(records_, 0, sizeof(records_));
+
+    String folder = directory;
+    if (!fs.exists(folder) && !fs.mkdir(folder)) {
+        return false;
+    }
+    dataPath_ = folder + "/images.bin";
+    indexPath_[0] = folder + "/index0.bin";
+    indexPath_[1] = folder + "/index1.bin";
+
+    size_t total = offsetOf(blocks_);
+    bool fresh = !fs.exists(dataPath_);
+    if (!fresh) {
+        file_ = fs.open(dataPath_, "r+");
+        fresh = !file_ || file_.size() != total;
+        file_.close();
+    }
+    if (fresh) {
+        File data = fs.open(dataPath_, FILE_WRITE);
+        uint8_t zero = 0;
+        bool allocated = data && data.seek(total - 1) && data.write(&zero, 1) == 1;
+        data.close();
+        fs.remove(indexPath_[0]);
+        fs.remove(indexPath_[1]);
+        if (!allocated) {
+            return false;
+        }
+    }
+    file_ = fs.open(dataPath_, "r+");
+    if (!file_) {
+        return false;
+    }
+    ready_ = true;
+
+    if (!fresh) {
+        uint32_t checkpoints[2] = {0, 0};
+        bool valid[2];
+        for (int i = 0; i < 2; i++) {
+            valid[i] = loadIndex(indexPath_[i], checkpoints[i], false);
+        }
+        int newest = valid[1] && (!valid[0] || checkpoints[1] > checkpoints[0]) ? 1 : 0;
+        if (valid[newest]) {
+            loadIndex(indexPath_[newest], checkpoint_, true);
+        }
+        for (uint32_t seq = oldestSeq_; seq < nextSeq_; seq++) {
+            ImageRecord &record = entry(seq);
+            if (record.state == IMAGE_STATE_WRITING) {
+                ImageHeader header;
+                record.state = readHeader(record.block, header) && header.seq == seq ? IMAGE_STATE_PENDING : IMAGE_STATE_FAILED;
+            }
+            pending_ += record.state == IMAGE_STATE_PENDING;
+        }
+        recover();
+    }
+    return true;
+}
+
+// blocksFor() function, to count the blocks a record of an image of size bytes takes
+uint32_t ImageStore::blocksFor(size_t size) const {
+    return (uint32_t)((IMAGE_STORE_HEADER_BYTES + size + IMAGE_STORE_BLOCK_BYTES - 1) / IMAGE_STORE_BLOCK_BYTES);
+}
+
+/* place() function
+- Function to find the first block of the next record, blocks long, and make room for it
+- The record goes to nextBlock_, or to block 0 if it does not fit before the end of the ring
+    - Records between nextBlock_ and the end are the oldest ones then, they are dropped first
+- Drop the oldest records as long as the oldest one overlaps the new one, records lie in the ring in their order
+*/
+uint32_t ImageStore::place(uint32_t blocks) {
+    uint32_t start = nextBlock_;
+    if (start + blocks > blocks_) {
+        while (records() > 0 && entry(oldestSeq_).block >= start) {
+            dropOldest();
+        }
+        start = 0;
+    }
+    while (records() > 0) {
+        const ImageRecord &oldest = entry(oldestSeq_);
+        if (oldest.block >= start + blocks || start >= (uint32_t)oldest.block + oldest.blocks) {
+            break;
+        }
+        dropOldest();
+    }
+    return start;
+}
+
+// dropOldest() function, to give up the oldest record, counted in stats() if it was not uploaded yet
+void ImageStore::dropOldest() {
+    ImageRecord &oldest = entry(oldestSeq_);
+    if (oldest.state == IMAGE_STATE_PENDING) {
+        pending_--;
+        stats_.dropped++;
+    }
+    oldest.state = 0;
+    oldestSeq_++;
+    changed();
+}
+
+/* reserve() function
+- Function to make room for the next record, an image of size bytes with scanID, captured at capturedAt (millis())
+  with the capture profile profile
+- The record is in IMAGE_STATE_WRITING until write() is done, its header is prepared in header_
+- Return the sequence number of the record, 0 if the store is not ready or the image is larger than the ring
+*/
+uint32_t ImageStore::reserve(const char *scanID, size_t size, uint32_t capturedAt, int profile) {
+    uint32_t blocks = blocksFor(size);
+    if (!ready_ || blocks > blocks_) {
+        return 0;
+    }
+    uint32_t start = place(blocks);
+    uint32_t seq = nextSeq_++;
+    ImageRecord &record = entry(seq);
+    record.seq = seq;
+    record.capturedAt = capturedAt;
+    record.size = (uint32_t)size;
+    record.block = (uint16_t)start;
+    record.blocks = (uint16_t)blocks;
+    record.state = IMAGE_STATE_WRITING;
+    record.label = -1;
+    record.confidence = 0;
+    record.profile = (uint8_t)profile;
+    nextBlock_ = (start + blocks) % blocks_;
+
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = IMAGE_MAGIC;
+    header_.seq = seq;
+    header_.size = (uint32_t)size;
+    header_.capturedAt = capturedAt;
+    header_.blocks = blocks;
+    header_.profile = (uint32_t)profile;
+    strncpy(header_.scanID, scanID, IMAGE_STORE_SCAN_ID_LENGTH - 1);
+    header_.checksum = fnv1a(&header_, sizeof(header_));
+    changed();
+    return seq;
+}
+
+/* write() function
+- Function to write image into the record just reserved with reserve()
+- Two large writes from the start of a block, so both are aligned to the sectors of the card
+    - First everything after the first sector of the record, straight from image
+    - Then the first sector: header and the start of the image, from sector_
+    - A reset in between leaves the header of an older record in the block, the record is never taken up half written
+- The record is IMAGE_STATE_PENDING if both writes went through, IMAGE_STATE_FAILED otherwise
+- Return true if the image is written
+*/
+bool ImageStore::write(uint32_t seq, const uint8_t *image) {
+    if (record(seq) == NULL || entry(seq).state != IMAGE_STATE_WRITING || header_.seq != seq) {
+        return false;
+    }
+    ImageRecord &record = entry(seq);
+    size_t size = record.size;
+    size_t inSector = min(size, (size_t)(IMAGE_STORE_SECTOR_BYTES - IMAGE_STORE_HEADER_BYTES));
+    size_t start = offsetOf(record.block);
+    bool written = true;
+    if (size > inSector) {
+        written = file_.seek(start + IMAGE_STORE_SECTOR_BYTES) &&
+                  file_.write(image + inSector, size - inSector) == size - inSector;
+    }
+    memcpy(sector_, &header_, IMAGE_STORE_HEADER_BYTES);
+    memcpy(sector_ + IMAGE_STORE_HEADER_BYTES, image, inSector);
+    written = written && file_.seek(start) &&
+              file_.write(sector_, IMAGE_STORE_HEADER_BYTES + inSector) == IMAGE_STORE_HEADER_BYTES + inSector;
+    file_.flush();
+
+    record.state = written ? IMAGE_STATE_PENDING : IMAGE_STATE_FAILED;
+    pending_ += written;
+    changed();
+    return written;
+}
+
+// setState() function, to set the state of record seq, e.g. IMAGE_STATE_UPLOADED once the server took the image
+void ImageStore::setState(uint32_t seq, int state) {
+    if (record(seq) == NULL || entry(seq).state == state) {
+        return;
+    }
+    ImageRecord &record = entry(seq);
+    pending_ -= record.state == IMAGE_STATE_PENDING;
+    pending_ += state == IMAGE_STATE_PENDING;
+    record.state = (uint8_t)state;
+    changed();
+}
+
+// setClass() function, to keep the result of the edge classifier with record seq
+void ImageStore::setClass(uint32_t seq, int label, float confidence) {
+    if (record(seq) == NULL) {
+        return;
+    }
+    ImageRecord &record = entry(seq);
+    record.label = (int8_t)label;
+    record.confidence = (uint8_t)(constrain(confidence, 0.0f, 1.0f) * 100 + 0.5f);
+    changed();
+}
+
+/* oldestPending() function
+- Function to find the oldest record in IMAGE_STATE_PENDING, for the replay
+- replaySeq_ moves past records that are done (uploaded or failed), so the search starts near the pending ones
+- Return its sequence number, 0 if there is none
+*/
+uint32_t ImageStore::oldestPending() {
+    if (pending_ == 0) {
+        return 0;
+    }
+    replaySeq_ = max(replaySeq_, oldestSeq_);
+    while (replaySeq_ < nextSeq_ && (entry(replaySeq_).state == IMAGE_STATE_UPLOADED || entry(replaySeq_).state == IMAGE_STATE_FAILED)) {
+        replaySeq_++;
+    }
+    for (uint32_t seq = replaySeq_; seq < nextSeq_; seq++) {
+        if (entry(seq).state == IMAGE_STATE_PENDING) {
+            return seq;
+        }
+    }
+    return 0;
+}
+
+/* openImage() function
+- Function to read the header of record seq and leave the data file at the start of its image
+- Copy its scan ID into scanID (scanIDSize bytes, terminator included) and its size into size
+- Copy the class stored with setClass() into label (-1 if none) and confidence, its capture profile into profile
+- Return the data file, NULL if the record is gone or its header does not match
+    - Read the image with .read() method before the next call to the store
+*/
+File *ImageStore::openImage(uint32_t seq, char *scanID, size_t scanIDSize, size_t &size, int &label, float &confidence,
+                            int &profile) {
+    const ImageRecord *found = record(seq);
+    ImageHeader header;
+    if (found == NULL || (found->state != IMAGE_STATE_PENDING && found->state != IMAGE_STATE_UPLOADED) ||
+        !readHeader(found->block, header) || header.seq != seq || scanIDSize == 0) {
+        return NULL;
+    }
+    strncpy(scanID, header.scanID, scanIDSize - 1);
+    scanID[scanIDSize - 1] = '\0';
+    size = header.size;
+    label = found->label;
+    confidence = found->confidence / 100.0f;
+    profile = found->profile;
+    file_.seek(offsetOf(found->block) + IMAGE_STORE_HEADER_BYTES);
+    return &file_;
+}
+
+/* checkpoint() function
+- Function to write the index to the index file not written last time, only if something changed
+    - Without force only once IMAGE_STORE_CHECKPOINT_CHANGES changes added up
+- IndexHeader with checksum, then the records from the oldest to the newest, in at most two writes
+- Return true if the index file was written
+*/
+bool ImageStore::checkpoint(bool force) {
+    if (!ready_ || changes_ == 0 || (!force && changes_ < IMAGE_STORE_CHECKPOINT_CHANGES)) {
+        return false;
+    }
+    IndexHeader header = {INDEX_MAGIC, checkpoint_ + 1, blocks_, oldestSeq_, nextSeq_, nextBlock_, 0};
+    uint32_t count = records();
+    uint32_t first = oldestSeq_ % blocks_;
+    uint32_t tail = min(count, blocks_ - first);
+    uint32_t hash = fnv1a(&header, sizeof(header));
+    hash = fnv1a(&records_[first], tail * sizeof(ImageRecord), hash);
+    hash = fnv1a(records_, (count - tail) * sizeof(ImageRecord), hash);
+    header.checksum = hash;
+
+    File index = fs_->open(indexPath_[header.checkpoint % 2], FILE_WRITE);
+    if (!index) {
+        return false;
+    }
+    bool written = index.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    written = written && index.write((const uint8_t *)&records_[first], tail * sizeof(ImageRecord)) == tail * sizeof(ImageRecord);
+    if (count > tail) {
+        written = written && index.write((const uint8_t *)records_, (count - tail) * sizeof(ImageRecord)) == (count - tail) * sizeof(ImageRecord);
+    }
+    index.close();
+    if (written) {
+        checkpoint_ = header.checkpoint;
+        changes_ = 0;
+        stats_.checkpoints++;
+    }
+    return written;
+}
+
+// record() function, to find record seq in the index, NULL if it was dropped or not reserved yet
+const ImageRecord *ImageStore::record(uint32_t seq) const {
+    if (seq < oldestSeq_ || seq >= nextSeq_) {
+        return NULL;
+    }
+    return &records_[seq % blocks_];
+}
+
+// readHeader() function, to read the header at block and check magic, checksum and size
+bool ImageStore::readHeader(uint32_t block, ImageHeader &header) {
+    if (!file_.seek(offsetOf(block)) || file_.read((uint8_t *)&header, sizeof(header)) != sizeof(header)) {
+        return false;
+    }
+    uint32_t checksum = header.checksum;
+    header.checksum = 0;
+    bool valid = header.magic == IMAGE_MAGIC && fnv1a(&header, sizeof(header)) == checksum &&
+                 header.blocks == blocksFor(header.size) && block + header.blocks <= blocks_;
+    header.checksum = checksum;
+    return valid;
+}
+
+/* loadIndex() function
+- Function to read the index file at path and check it against its checksum and the size of the ring
+- Leave its checkpoint number in checkpoint, copy it into the index only if apply is true
+- Return true if the index file is valid
+*/
+bool ImageStore::loadIndex(const String &path, uint32_t &checkpoint, bool apply) {
+    File index = fs_->open(path, FILE_READ);
+    if (!index) {
+        return false;
+    }
+    IndexHeader header;
+    bool valid = index.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == INDEX_MAGIC &&
+                 header.blocks == blocks_ && header.oldestSeq > 0 && header.nextSeq >= header.oldestSeq &&
+                 header.nextSeq - header.oldestSeq <= blocks_ && header.nextBlock < blocks_;
+    uint32_t checksum = header.checksum;
+    header.checksum = 0;
+    uint32_t hash = fnv1a(&header, sizeof(header));
+    for (uint32_t seq = header.oldestSeq; valid && seq < header.nextSeq; seq++) {
+        ImageRecord record;
+        valid = index.read((uint8_t *)&record, sizeof(record)) == sizeof(record) && record.seq == seq;
+        hash = fnv1a(&record, sizeof(record), hash);
+        if (valid && apply) {
+            entry(seq) = record;
+        }
+    }
+    index.close();
+    if (!valid || hash != checksum) {
+        return false;
+    }
+    checkpoint = header.checkpoint;
+    if (apply) {
+        oldestSeq_ = replaySeq_ = header.oldestSeq;
+        nextSeq_ = header.nextSeq;
+        nextBlock_ = header.nextBlock;
+    }
+    return true;
+}
+
+/* recover() function
+- Function to take up the records written after the last checkpoint, one after the other
+- The next record has the next sequence number in its header, at nextBlock_ or at block 0 if the ring wrapped
+- Taken up as IMAGE_STATE_PENDING, the oldest records they overwrote are dropped like in reserve()
+*/
+void ImageStore::recover() {
+    while (true) {
+        ImageHeader header;
+        uint32_t block = nextBlock_;
+        bool found = readHeader(block, header) && header.seq == nextSeq_;
+        if (!found && block != 0) {
+            block = 0;
+            found = readHeader(block, header) && header.seq == nextSeq_;
+        }
+        if (!found || place(header.blocks) != block) {
+            return;
+        }
+        ImageRecord &record = entry(nextSeq_);
+        record.seq = nextSeq_++;
+        record.capturedAt = header.capturedAt;
+        record.size = header.size;
+        record.block = (uint16_t)block;
+        record.blocks = (uint16_t)header.blocks;
+        record.state = IMAGE_STATE_PENDING;
+        record.label = -1;
+        record.confidence = 0;
+        record.profile = (uint8_t)header.profile;
+        nextBlock_ = (block + header.blocks) % blocks_;
+        pending_++;
+        stats_.recovered++;
+        changed();
+    }
+}
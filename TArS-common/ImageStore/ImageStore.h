@@ -0,0 +1,137 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+/* ImageStore
+- Log-structured store of the captured images on the SD card, in place of one FAT file per image
+    - One data file, preallocated once: a ring of IMAGE_STORE_BLOCK_BYTES blocks, the cluster size of an SDHC card
+    - No file is created per image, the FAT directory never grows, a write costs the same on an empty or a full card
+- A record starts on a block boundary and takes as many blocks as its image needs
+    - Header (ImageHeader: sequence number, size, capture time, capture profile, scan ID) in the first
+      IMAGE_STORE_HEADER_BYTES,
+      the JPEG right after it
+    - Written in two large writes, from the second sector of the record on first, then the first sector with the header:
+      a record with a valid header is complete
+    - Once the ring is full, the oldest records are overwritten, pending ones are counted as dropped in stats()
+- Index: one ImageRecord (20 bytes) per record in RAM, found by sequence number in constant time
+    - Capture time, size, first block, upload state, capture profile and the class of the edge classifier
+    - openImage() hands profile and class back with the image, a replayed upload carries what the live one had
+    - Checkpointed to two index files in turn, after IMAGE_STORE_CHECKPOINT_CHANGES changes or when asked,
+      with a checksum, so a checkpoint cut off by a reset leaves the other one
+    - begin() loads the newest valid index file and takes up the records written after it by their headers,
+      changes of state since the checkpoint are lost (an image already uploaded is sent once more)
+- States: IMAGE_STATE_WRITING (reserved, not written yet), IMAGE_STATE_PENDING (written, not uploaded),
+  IMAGE_STATE_UPLOADED (the server is done with it), IMAGE_STATE_FAILED (not written completely, unreadable)
+- Threads: write() may run in another task, as long as the caller leaves the store alone until it returns
+- Usage:
+    ImageStore imageStore;                                       // global, the index is part of it
+    imageStore.begin(SD_MMC, "/tars", 1024);                     // 32 MB ring
+    uint32_t seq = imageStore.reserve(scanID, fb->len, millis(), profile);
+    imageStore.write(seq, fb->buf);                              // e.g. in a background task
+    imageStore.setClass(seq, label, confidence);                 // read back by openImage()
+    imageStore.setState(seq, IMAGE_STATE_UPLOADED);
+    File *file = imageStore.openImage(imageStore.oldestPending(), scanID, sizeof(scanID), size, label, confidence,
+                                      profile);                  // at the JPEG
+    imageStore.checkpoint(false);                                // writes the index once enough has changed
+*/
+#define IMAGE_STORE_BLOCK_BYTES 32768
+#define IMAGE_STORE_MAX_BLOCKS 1024
+#define IMAGE_STORE_HEADER_BYTES 96
+#define IMAGE_STORE_SECTOR_BYTES 512
+#define IMAGE_STORE_SCAN_ID_LENGTH 64
+#define IMAGE_STORE_CHECKPOINT_CHANGES 16
+
+#define IMAGE_STATE_WRITING 1
+#define IMAGE_STATE_PENDING 2
+#define IMAGE_STATE_UPLOADED 3
+#define IMAGE_STATE_FAILED 4
+
+struct ImageHeader {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t size;
+    uint32_t capturedAt;
+    uint32_t blocks;
+    uint32_t checksum;   // of the header with checksum 0
+    uint32_t profile;    // index of the capture profile of the camera
+    char scanID[IMAGE_STORE_SCAN_ID_LENGTH];
+    uint8_t reserved[IMAGE_STORE_HEADER_BYTES - 28 - IMAGE_STORE_SCAN_ID_LENGTH];
+};
+
+struct ImageRecord {
+    uint32_t seq;
+    uint32_t capturedAt;   // millis() of the capture
+    uint32_t size;
+    uint16_t block;
+    uint16_t blocks;
+    uint8_t state;
+    int8_t label;          // class of the edge classifier, -1 if none
+    uint8_t confidence;    // in percent
+    uint8_t profile;       // index of the capture profile of the camera
+};
+
+struct ImageStoreStats {
+    unsigned long dropped;       // pending records overwritten before they were uploaded
+    unsigned long checkpoints;
+    unsigned long recovered;     // records taken up from their headers in begin()
+};
+
+class ImageStore {
+public:
+    ImageStore();
+
+    bool begin(fs::FS &fs, const char *directory, uint32_t blocks);
+    uint32_t reserve(const char *scanID, size_t size, uint32_t capturedAt, int profile);
+    bool write(uint32_t seq, const uint8_t *image);
+    void setState(uint32_t seq, int state);
+    void setClass(uint32_t seq, int label, float confidence);
+    uint32_t oldestPending();
+    File *openImage(uint32_t seq, char *scanID, size_t scanIDSize, size_t &size, int &label, float &confidence,
+                    int &profile);
+    bool checkpoint(bool force);
+
+    const ImageRecord *record(uint32_t seq) const;
+    uint32_t records() const { return nextSeq_ - oldestSeq_; }
+    uint32_t pending() const { return pending_; }
+    const ImageStoreStats &stats() const { return stats_; }
+
+private:
+    struct IndexHeader {
+        uint32_t magic;
+        uint32_t checkpoint;
+        uint32_t blocks;
+        uint32_t oldestSeq;
+        uint32_t nextSeq;
+        uint32_t nextBlock;
+        uint32_t checksum;   // of header and records with checksum 0
+    };
+
+    ImageRecord &entry(uint32_t seq) { return records_[seq % blocks_]; }
+    size_t offsetOf(uint32_t block) const { return (size_t)block * IMAGE_STORE_BLOCK_BYTES; }
+    uint32_t blocksFor(size_t size) const;
+    uint32_t place(uint32_t blocks);
+    void dropOldest();
+    void changed() { changes_++; }
+    bool readHeader(uint32_t block, ImageHeader &header);
+    bool loadIndex(const String &path, uint32_t &checkpoint, bool apply);
+    void recover();
+
+    fs::FS *fs_;
+    File file_;
+    String dataPath_;
+    String indexPath_[2];
+    bool ready_;
+    uint32_t blocks_;
+    uint32_t oldestSeq_;
+    uint32_t nextSeq_;
+    uint32_t nextBlock_;
+    uint32_t replaySeq_;
+    uint32_t pending_;
+    uint32_t checkpoint_;
+    uint32_t changes_;
+    ImageHeader header_;   // prepared by reserve() for write()
+    uint8_t sector_[IMAGE_STORE_SECTOR_BYTES];
+    ImageRecord records_[IMAGE_STORE_MAX_BLOCKS];
+    ImageStoreStats stats_;
+};
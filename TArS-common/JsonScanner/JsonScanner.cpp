@@ -0,0 +1,257 @@
+#include "JsonScanner.h"
+
+#include <string.h>
+
+JsonScanner::JsonScanner(JsonField *fields, size_t fieldCount) : fields_(fields), fieldCount_(fieldCount) {
+    reset();
+}
+
+// reset() function, to scan a new document, the fields are marked as not found
+void JsonScanner::reset() {
+    state_ = START;
+    keyLength_ = 0;
+    keyTooLong_ = false;
+    current_ = NULL;
+    valueLength_ = 0;
+    escape_ = false;
+    unicodeDigits_ = 0;
+    nestedDepth_ = 0;
+    nestedString_ = false;
+    for (size_t i = 0; i < fieldCount_; i++) {
+        fields_[i].found = false;
+        fields_[i].truncated = false;
+        if (fields_[i].capacity > 0) {
+            fields_[i].value[0] = '\0';
+        }
+    }
+}
+
+// field() function, to find the field called name, NULL if it is not one of the fields
+JsonField *JsonScanner::field(const char *name) {
+    for (size_t i = 0; i < fieldCount_; i++) {
+        if (strcmp(fields_[i].name, name) == 0) {
+            return &fields_[i];
+        }
+    }
+    return NULL;
+}
+
+// append() function, to add one character to the value of the field being read, if it is one of the fields
+void JsonScanner::append(char ch) {
+    if (current_ == NULL) {
+        return;
+    }
+    if (valueLength_ + 1 < current_->capacity) {
+        current_->value[valueLength_++] = ch;
+        current_->value[valueLength_] = '\0';
+    } else {
+        current_->truncated = true;
+    }
+}
+
+/* unescape() function
+- Function to decode the character after a backslash, or one of the four hex digits of \uXXXX
+- Return true if it produced a character in out
+*/
+bool JsonScanner::unescape(char ch, char &out) {
+    if (unicodeDigits_ > 0) {
+        out = '?';
+        return --unicodeDigits_ == 0;
+    }
+    escape_ = false;
+    switch (ch) {
+        case 'b': out = '\b'; break;
+        case 'f': out = '\f'; break;
+        case 'n': out = '\n'; break;
+        case 'r': out = '\r'; break;
+        case 't': out = '\t'; break;
+        case 'u': unicodeDigits_ = 4; return false;
+        default: out = ch; break;
+    }
+    return true;
+}
+
+// endKey() function, to look the key up once its closing quote is read, the value that follows is kept if it matches
+void JsonScanner::endKey() {
+    key_[keyLength_] = '\0';
+    current_ = keyTooLong_ ? NULL : field(key_);
+    keyLength_ = 0;
+    keyTooLong_ = false;
+}
+
+/* feed() function
+- Function to move the tokenizer one character forward
+- Return false once the document is not valid JSON (state FAILED), the rest of it is ignored
+*/
+bool JsonScanner::feed(char ch) {
+    bool space = ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+    char out;
+    switch (state_) {
+        case START:
+            if (ch == '{') {
+                state_ = KEY_OR_END;
+            } else if (!space) {
+                return fail();
+            }
+            return true;
+        case KEY_OR_END:
+            if (ch == '"') {
+                state_ = KEY;
+            } else if (ch == '}') {
+                state_ = DONE;
+            } else if (!space) {
+                return fail();
+            }
+            return true;
+        case KEY:
+            if (escape_ || unicodeDigits_ > 0) {
+                if (!unescape(ch, out)) {
+                    return true;
+                }
+                ch = out;
+            } else if (ch == '\\') {
+                escape_ = true;
+                return true;
+            } else if (ch == '"') {
+                endKey();
+                state_ = COLON;
+                return true;
+            }
+            if (keyLength_ < JSON_KEY_MAX_LENGTH) {
+                key_[keyLength_++] = ch;
+            } else {
+                keyTooLong_ = true;
+            }
+            return true;
+        case COLON:
+            if (ch == ':') {
+                state_ = VALUE;
+            } else if (!space) {
+                return fail();
+            }
+            return true;
+        case VALUE:
+            if (space) {
+                return true;
+            }
+            if (ch == '{' || ch == '[') {
+                current_ = NULL;
+                nestedDepth_ = 1;
+                nestedString_ = false;
+                state_ = NESTED;
+                return true;
+            }
+            if (ch != '"' && ch != '-' && (ch < '0' || ch > '9') && ch != 't' && ch != 'f' && ch != 'n') {
+                return fail();
+            }
+            valueLength_ = 0;
+            if (current_ != NULL) {
+                current_->found = true;
+                current_->truncated = false;
+                if (current_->capacity > 0) {
+                    current_->value[0] = '\0';
+                }
+            }
+            if (ch == '"') {
+                state_ = STRING_VALUE;
+            } else {
+                append(ch);
+                state_ = SCALAR_VALUE;
+            }
+            return true;
+        case STRING_VALUE:
+            if (escape_ || unicodeDigits_ > 0) {
+                if (unescape(ch, out)) {
+                    append(out);
+                }
+            } else if (ch == '\\') {
+                escape_ = true;
+            } else if (ch == '"') {
+                state_ = COMMA_OR_END;
+            } else {
+                append(ch);
+            }
+            return true;
+        case SCALAR_VALUE:
+            if (ch == ',') {
+                state_ = KEY_OR_END;
+            } else if (ch == '}') {
+                state_ = DONE;
+            } else if (space) {
+                state_ = COMMA_OR_END;
+            } else {
+                append(ch);
+            }
+            return true;
+        case NESTED:
+            if (nestedString_) {
+                if (escape_) {
+                    escape_ = false;
+                } else if (ch == '\\') {
+                    escape_ = true;
+                } else if (ch == '"') {
+                    nestedString_ = false;
+                }
+            } else if (ch == '"') {
+                nestedString_ = true;
+            } else if (ch == '{' || ch == '[') {
+                nestedDepth_++;
+            } else if ((ch == '}' || ch == ']') && --nestedDepth_ == 0) {
+                state_ = COMMA_OR_END;
+            }
+            return true;
+        case COMMA_OR_END:
+            if (ch == ',') {
+                state_ = KEY_OR_END;
+            } else if (ch == '}') {
+                state_ = DONE;
+            } else if (!space) {
+                return fail();
+            }
+            return true;
+        case DONE:
+            return space ? true : fail();
+        case FAILED:
+        default:
+            return false;
+    }
+}
+
+// feed() function, to scan length characters of data, return how many were accepted
+size_t JsonScanner::feed(const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (!feed(data[i])) {
+            return i;
+        }
+    }
+    return length;
+}
+
+/* readFrom() function
+- Function to scan an HTTP body straight from the socket, through a small buffer on the stack
+- length: Content-Length of the body (HTTPClient getSize()), all of it is read so the connection can be kept alive
+    - -1 if unknown: read what has arrived until the top-level object is closed, a chunked body is not supported
+- Stops early if the stream times out, return the number of bytes read
+*/
+size_t JsonScanner::readFrom(Stream &stream, int length) {
+    char chunk[64];
+    size_t total = 0;
+    while (length < 0 || total < (size_t)length) {
+        size_t wanted = sizeof(chunk);
+        if (length >= 0 && (size_t)length - total < wanted) {
+            wanted = (size_t)length - total;
+        } else if (length < 0 && stream.available() < (int)wanted) {
+            wanted = stream.available() > 0 ? (size_t)stream.available() : 1;
+        }
+        size_t got = stream.readBytes(chunk, wanted);
+        if (got == 0) {
+            break;
+        }
+        total += got;
+        feed(chunk, got);
+        if (length < 0 && (complete() || failed())) {
+            break;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* JsonScanner
+- Incremental tokenizer for the small JSON objects the server answers with, no heap allocation
+- Fed one character at a time, straight from the HTTP stream (readFrom()) or from a buffer (feed())
+- Only the members of the top-level object listed in JsonField are kept, in buffers owned by the caller
+    - Strings are unescaped (\uXXXX becomes '?'), numbers and true/false/null are kept as their text
+    - Nested objects and arrays are skipped, a key with the same name inside them never matches
+    - A value longer than its buffer is cut and marked truncated
+- A key longer than JSON_KEY_MAX_LENGTH can not be one of the fields and is skipped
+- Usage:
+    char detectedType[16];
+    JsonField fields[] = {{"detected_type", detectedType, sizeof(detectedType)}};
+    JsonScanner json(fields, 1);
+    json.readFrom(*http.getStreamPtr(), http.getSize());
+    if (json.complete() && fields[0].found) { ... }
+*/
+#define JSON_KEY_MAX_LENGTH 24
+
+struct JsonField {
+    const char *name;
+    char *value;
+    size_t capacity;
+    bool found = false;
+    bool truncated = false;
+};
+
+class JsonScanner {
+public:
+    JsonScanner(JsonField *fields, size_t fieldCount);
+
+    void reset();
+    bool feed(char ch);
+    size_t feed(const char *data, size_t length);
+    size_t readFrom(Stream &stream, int length);
+
+    bool complete() const { return state_ == DONE; }
+    bool failed() const { return state_ == FAILED; }
+    JsonField *field(const char *name);
+
+private:
+    enum State {
+        START,          // before the top-level '{'
+        KEY_OR_END,     // after '{' of the top-level object
+        KEY,            // inside a key string
+        COLON,          // after a key
+        VALUE,          // after ':'
+        STRING_VALUE,   // inside a top-level string value
+        SCALAR_VALUE,   // inside a top-level number, true, false or null
+        NESTED,         // inside a nested object or array
+        COMMA_OR_END,   // after a top-level value
+        DONE,
+        FAILED,
+    };
+
+    bool fail() { state_ = FAILED; return false; }
+    void append(char ch);
+    bool unescape(char ch, char &out);
+    void endKey();
+
+    JsonField *fields_;
+    size_t fieldCount_;
+    State state_;
+    char key_[JSON_KEY_MAX_LENGTH + 1];
+    size_t keyLength_;
+    bool keyTooLong_;
+    JsonField *current_;
+    size_t valueLength_;
+    bool escape_;
+    int unicodeDigits_;
+    int nestedDepth_;
+    bool nestedString_;
+};
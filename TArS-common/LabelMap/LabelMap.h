@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* LabelMap
+- Label to value lookup built by the compiler, e.g. the class label of a prediction to the index of its bin
+- add() hashes the label with FNV-1a (labelHash()) and keeps the hash and the value (0 or more) in an open addressing
+  table of SLOTS entries
+    - Called in a constexpr function, the table is part of the firmware image, no heap and no setup
+    - SLOTS must be a power of two, labelSlotsFor(labels) gives one at least twice the number of labels,
+      so a lookup probes one or two slots however many labels there are
+    - valid() is false if the table is full or two labels have the same hash, check it with static_assert
+- find() hashes the label once and compares hashes only, no string compare
+    - A label that is not in the table finds -1, unless its 32-bit hash is the one of a label that is
+- Usage:
+    constexpr LabelMap<8> makeLabels() {
+        LabelMap<8> map;
+        map.add("paper", 0);
+        map.add("cardboard", 0);
+        map.add("metal", 1);
+        return map;
+    }
+    constexpr LabelMap<8> LABELS = makeLabels();
+    static_assert(LABELS.valid(), "labels do not fit");
+    int value = LABELS.find(label);         // -1 if the label is unknown
+*/
+constexpr uint32_t labelHash(const char *label) {
+    uint32_t hash = 2166136261u;
+    for (; *label != '\0'; label++) {
+        hash = (hash ^ (uint8_t)*label) * 16777619u;
+    }
+    return hash;
+}
+
+constexpr size_t labelSlotsFor(size_t labels) {
+    size_t slots = 2;
+    while (slots < labels * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+template <size_t SLOTS>
+class LabelMap {
+    static_assert(SLOTS >= 2 && (SLOTS & (SLOTS - 1)) == 0, "LabelMap SLOTS must be a power of two");
+
+public:
+    constexpr LabelMap() : hashes_(), values_(), valid_(true) {
+        for (size_t i = 0; i < SLOTS; i++) {
+            values_[i] = -1;
+        }
+    }
+
+    constexpr void add(const char *label, int value) {
+        if (value < 0) {
+            valid_ = false;
+            return;
+        }
+        uint32_t hash = labelHash(label);
+        for (size_t probe = 0; probe < SLOTS; probe++) {
+            size_t slot = (hash + probe) & (SLOTS - 1);
+            if (values_[slot] == -1) {
+                hashes_[slot] = hash;
+                values_[slot] = value;
+                return;
+            }
+            if (hashes_[slot] == hash) {
+                valid_ = false;   // label added twice, or two labels with one hash
+                return;
+            }
+        }
+        valid_ = false;
+    }
+
+    constexpr int find(const char *label) const {
+        uint32_t hash = labelHash(label);
+        for (size_t probe = 0; probe < SLOTS; probe++) {
+            size_t slot = (hash + probe) & (SLOTS - 1);
+            if (values_[slot] == -1 || hashes_[slot] == hash) {
+                return values_[slot];
+            }
+        }
+        return -1;
+    }
+
+    constexpr bool valid() const { return valid_; }
+
+private:
+    uint32_t hashes_[SLOTS];
+    int values_[SLOTS];   // -1: empty slot
+    bool valid_;
+};
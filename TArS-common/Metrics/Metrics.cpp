@@ -0,0 +1,244 @@
+#include "Metrics.h"
+
+#include <string.h>
+
+/* bucketOf() function
+- Function to find the bucket of a latency, 0..7 ms have a bucket each
+- From 8 ms up every doubling [2^e, 2^(e+1)) is split into eight buckets of 2^(e-3) ms
+*/
+int LatencyHistogram::bucketOf(unsigned long ms) {
+    if (ms < 8) {
+        return (int)ms;
+    }
+    if (ms >= METRICS_MAX_MS) {
+        return METRICS_BUCKETS - 1;
+    }
+    int exponent = 31 - __builtin_clz((uint32_t)ms);
+    return 8 * (exponent - 2) + (int)((ms >> (exponent - 3)) & 7);
+}
+
+// bucketTop() function, to find the highest latency that falls in bucket
+uint32_t LatencyHistogram::bucketTop(int bucket) {
+    if (bucket < 8) {
+        return bucket;
+    }
+    int exponent = bucket / 8 + 2;
+    uint32_t step = 1UL << (exponent - 3);
+    return (uint32_t)(8 + bucket % 8) * step + step - 1;
+}
+
+// record() function, to add one latency in milliseconds
+void LatencyHistogram::record(unsigned long ms) {
+    buckets_[bucketOf(ms)]++;
+    count_++;
+    sum_ += ms;
+    if (ms > max_) {
+        max_ = ms;
+    }
+}
+
+// percentile() function, to find the latency percent % of the recorded ones are at or below, 0 if none is recorded
+uint32_t LatencyHistogram::percentile(int percent) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint32_t rank = max((uint32_t)(((uint64_t)count_ * percent + 99) / 100), (uint32_t)1);
+    uint32_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return min(bucketTop(i), max_);
+        }
+    }
+    return max_;
+}
+
+// reportFull() function, to report on log_ that the kind called name does not fit, only the first one of each kind
+void Metrics::reportFull(const char *kind, const char *name, bool &reported) {
+    if (reported || log_ == NULL) {
+        return;
+    }
+    reported = true;
+    log_->println(String("Metrics ") + board_ + ": no room for " + kind + " \"" + name +
+                  "\", counted in metrics_dropped, raise the limit in Metrics.h");
+}
+
+// record() function, to add a latency to the histogram called name, it is created on first use
+void Metrics::record(const char *name, unsigned long ms) {
+    for (int i = 0; i < histogramCount_; i++) {
+        if (strcmp(histograms_[i].name, name) == 0) {
+            histograms_[i].histogram.record(ms);
+            return;
+        }
+    }
+    if (histogramCount_ == METRICS_MAX_HISTOGRAMS) {
+        dropped_++;
+        reportFull("histogram", name, histogramsFull_);
+        return;
+    }
+    histograms_[histogramCount_].name = name;
+    histograms_[histogramCount_].histogram.record(ms);
+    histogramCount_++;
+}
+
+// histogram() function, to find the histogram called name, NULL if nothing was recorded in it
+const LatencyHistogram *Metrics::histogram(const char *name) const {
+    for (int i = 0; i < histogramCount_; i++) {
+        if (strcmp(histograms_[i].name, name) == 0) {
+            return &histograms_[i].histogram;
+        }
+    }
+    return NULL;
+}
+
+// counter() function, to find the counter called name, created at 0 on first use, NULL once all are taken
+Metrics::Counter *Metrics::counter(const char *name) {
+    for (int i = 0; i < counterCount_; i++) {
+        if (strcmp(counters_[i].name, name) == 0) {
+            return &counters_[i];
+        }
+    }
+    if (counterCount_ == METRICS_MAX_COUNTERS) {
+        dropped_++;
+        reportFull("counter", name, countersFull_);
+        return NULL;
+    }
+    Counter &added = counters_[counterCount_++];
+    added.name = name;
+    added.value = 0;
+    added.watched = NULL;
+    return &added;
+}
+
+// count() function, to add n to the counter called name
+void Metrics::count(const char *name, unsigned long n) {
+    Counter *found = counter(name);
+    if (found != NULL) {
+        found->value += n;
+    }
+}
+
+// watch() function, to report the counter at value as name, it is read each time the metrics are printed
+void Metrics::watch(const char *name, const unsigned long *value) {
+    Counter *found = counter(name);
+    if (found != NULL) {
+        found->watched = value;
+    }
+}
+
+// countHTTP() function, to count one HTTP response code
+void Metrics::countHTTP(int code) {
+    for (int i = 0; i < httpCodeCount_; i++) {
+        if (httpCodes_[i].code == code) {
+            httpCodes_[i].count++;
+            return;
+        }
+    }
+    if (httpCodeCount_ == METRICS_MAX_HTTP_CODES) {
+        dropped_++;
+        return;
+    }
+    httpCodes_[httpCodeCount_].code = code;
+    httpCodes_[httpCodeCount_].count = 1;
+    httpCodeCount_++;
+}
+
+/* printJSON() function
+- Function to write every histogram and counter as one line of JSON, see the format in Metrics.h
+- Written piece by piece to out, no String or buffer holds the whole document
+*/
+void Metrics::printJSON(Print &out) const {
+    out.print("{\"board\":\"");
+    out.print(board_);
+    out.print("\",\"uptime_ms\":");
+    out.print((unsigned long)millis());
+    out.print(",\"heap_free\":");
+    out.print((unsigned long)ESP.getFreeHeap());
+    out.print(",\"heap_min\":");
+    out.print((unsigned long)ESP.getMinFreeHeap());
+
+    out.print(",\"latency_ms\":{");
+    for (int i = 0; i < histogramCount_; i++) {
+        const LatencyHistogram &histogram = histograms_[i].histogram;
+        out.print(i > 0 ? ",\"" : "\"");
+        out.print(histograms_[i].name);
+        out.print("\":{\"n\":");
+        out.print((unsigned long)histogram.count());
+        out.print(",\"p50\":");
+        out.print((unsigned long)histogram.percentile(50));
+        out.print(",\"p95\":");
+        out.print((unsigned long)histogram.percentile(95));
+        out.print(",\"max\":");
+        out.print((unsigned long)histogram.maximum());
+        out.print(",\"mean\":");
+        out.print((unsigned long)histogram.mean());
+        out.print("}");
+    }
+
+    out.print("},\"counters\":{");
+    for (int i = 0; i < counterCount_; i++) {
+        out.print(i > 0 ? ",\"" : "\"");
+        out.print(counters_[i].name);
+        out.print("\":");
+        out.print(counters_[i].watched != NULL ? *counters_[i].watched : counters_[i].value);
+    }
+    if (dropped_ > 0) {
+        out.print(counterCount_ > 0 ? ",\"metrics_dropped\":" : "\"metrics_dropped\":");
+        out.print(dropped_);
+    }
+
+    out.print("},\"http_codes\":{");
+    for (int i = 0; i < httpCodeCount_; i++) {
+        out.print(i > 0 ? ",\"" : "\"");
+        out.print((long)httpCodes_[i].code);
+        out.print("\":");
+        out.print(httpCodes_[i].count);
+    }
+    out.print("}}");
+}
+
+/* serve() function
+- Function to answer the client waiting on server, see Metrics.h, without waiting for anything
+- Take a new client only once the last one is done, it is kept in client_ until its request line is complete
+- Read the bytes already there with .available() and .read() method into request_, up to the end of the request line
+    - The headers after it are not needed and dropped with the connection
+- Drop the client if it closed or sent no request line within METRICS_READ_TIMEOUT_MS
+- Answer printJSON() only if the path is /metrics itself, followed by ' ' or a query ('?'), 404 otherwise
+    - /metricsfoo or /metrics2 are other paths
+- Return true if a client was answered
+*/
+bool Metrics::serve(WiFiServer &server) {
+    if (!client_) {
+        client_ = server.available();
+        if (!client_) {
+            return false;
+        }
+        clientSince_ = millis();
+        requestLength_ = 0;
+    }
+    bool complete = false;
+    while (!complete && client_.available() > 0) {
+        int c = client_.read();
+        if (c == '\n') {
+            complete = true;
+        } else if (c >= 0 && requestLength_ < METRICS_REQUEST_MAX - 1) {
+            request_[requestLength_++] = (char)c;
+        }
+    }
+    if (!complete) {
+        if (millis() - clientSince_ >= METRICS_READ_TIMEOUT_MS) {
+            client_.stop();
+        }
+        return false;
+    }
+    request_[requestLength_] = '\0';
+    if (strncmp(request_, "GET /metrics", 12) == 0 && (request_[12] == ' ' || request_[12] == '?')) {
+        client_.print("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n");
+        printJSON(client_);
+        client_.print("\r\n");
+    } else {
+        client_.print("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+    client_.stop();
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+/* Metrics
+- Latency histograms and counters of one board in fixed memory, shared by ESP32-CAM and ESP32-S3
+- record(name, ms): add one latency to the histogram called name, created on first use
+    - METRICS_BUCKETS buckets, eight per doubling from 8 ms up: p50 and p95 are the top of their bucket,
+      at most 1/8 above the true value, count, max and mean are exact
+    - Latencies of METRICS_MAX_MS or more land in the last bucket, max still shows them
+- count(name, n): add n to the counter called name, created on first use
+- countHTTP(code): count one HTTP response code, negative codes are the HTTPClient errors (refused, timeout, ...)
+- watch(name, value): report a counter kept elsewhere, e.g. the reconnects of ConnectionManager, read when printed
+- Names are not copied, use string literals
+- Up to METRICS_MAX_HISTOGRAMS histograms, METRICS_MAX_COUNTERS counters and METRICS_MAX_HTTP_CODES codes,
+  anything beyond is counted in "metrics_dropped"
+    - The first histogram and the first counter that do not fit are also reported by name on logTo() (Serial unless set),
+      raise the limit then
+- Not thread-safe: record and count from one task (loop()), a time measured on another task is handed over
+  with the event or semaphore that reports its end
+- printJSON(): one line of JSON, printed on Serial and served on the metrics endpoint
+    {"board":"s3","uptime_ms":60000,"heap_free":180000,"heap_min":172000,
+     "latency_ms":{"cycle":{"n":7,"p50":6655,"p95":6712,"max":6712,"mean":6634}, ...},
+     "counters":{"prediction_retries":2, ...},"http_codes":{"200":7,"201":1,"-11":1}}
+- serve(): answer the client waiting on a WiFiServer, if any, returns at once otherwise
+    - GET /metrics (query allowed) gets printJSON(), anything else 404, the connection is closed after the reply
+    - Never waits: reads only the bytes that arrived, a request line cut in pieces is carried over to the next call
+      in request_ (METRICS_REQUEST_MAX, the rest of a longer line is skipped)
+    - A client that has not sent the request line METRICS_READ_TIMEOUT_MS after it connected is dropped
+- Usage:
+    Metrics metrics("s3");
+    WiFiServer metricsServer(METRICS_PORT);
+    unsigned long start = millis();
+    ...
+    metrics.record("upload", millis() - start);
+    metrics.serve(metricsServer);           // in loop(), metricsServer.begin() in setup()
+    metrics.logTo(Serial0);                 // where a histogram or counter that does not fit is reported
+*/
+#define METRICS_BUCKETS 128
+#define METRICS_MAX_MS 262144UL
+#define METRICS_MAX_HISTOGRAMS 20
+#define METRICS_MAX_COUNTERS 24
+#define METRICS_MAX_HTTP_CODES 12
+#define METRICS_PORT 8080
+#define METRICS_READ_TIMEOUT_MS 1000
+#define METRICS_REQUEST_MAX 32
+
+class LatencyHistogram {
+public:
+    void record(unsigned long ms);
+    uint32_t count() const { return count_; }
+    uint32_t maximum() const { return max_; }
+    uint32_t mean() const { return count_ > 0 ? (uint32_t)(sum_ / count_) : 0; }
+    uint32_t percentile(int percent) const;
+
+    static int bucketOf(unsigned long ms);
+    static uint32_t bucketTop(int bucket);
+
+private:
+    uint32_t buckets_[METRICS_BUCKETS] = {};
+    uint32_t count_ = 0;
+    uint32_t max_ = 0;
+    uint64_t sum_ = 0;
+};
+
+class Metrics {
+public:
+    explicit Metrics(const char *board) : board_(board) {}
+
+    void record(const char *name, unsigned long ms);
+    void count(const char *name, unsigned long n = 1);
+    void countHTTP(int code);
+    void watch(const char *name, const unsigned long *value);
+    const LatencyHistogram *histogram(const char *name) const;
+
+    void printJSON(Print &out) const;
+    bool serve(WiFiServer &server);
+    void logTo(Print &out) { log_ = &out; }
+
+private:
+    struct NamedHistogram {
+        const char *name;
+        LatencyHistogram histogram;
+    };
+    struct Counter {
+        const char *name;
+        unsigned long value;
+        const unsigned long *watched;
+    };
+    struct HTTPCode {
+        int code;
+        unsigned long count;
+    };
+
+    Counter *counter(const char *name);
+    void reportFull(const char *kind, const char *name, bool &reported);
+
+    const char *board_;
+    NamedHistogram histograms_[METRICS_MAX_HISTOGRAMS];
+    int histogramCount_ = 0;
+    Counter counters_[METRICS_MAX_COUNTERS];
+    int counterCount_ = 0;
+    HTTPCode httpCodes_[METRICS_MAX_HTTP_CODES];
+    int httpCodeCount_ = 0;
+    unsigned long dropped_ = 0;
+    Print *log_ = &Serial;
+    bool histogramsFull_ = false;
+    bool countersFull_ = false;
+
+    WiFiClient client_;              // client of serve() whose request line is not complete yet
+    unsigned long clientSince_ = 0;
+    char request_[METRICS_REQUEST_MAX];
+    size_t requestLength_ = 0;
+};
@@ -0,0 +1,145 @@
+#include "MotionDetector.h"
+
+#include <string.h>
+
+static const uint32_t LANE_HIGH = 0x80808080;
+static const uint32_t LANE_LOW7 = 0x7F7F7F7F;
+static const uint32_t LANE_ONE = 0x01010101;
+
+/* absDiff7() function
+- Function to find |a - b| of the four pixels in a and b at once, each pixel halved to 7 bits (0..127)
+- (x | 0x80) - y is 128 + x - y in every lane, 1..255, so no lane borrows from the next one
+    - Its top bit tells which of x - y and y - x is the positive one
+*/
+static inline uint32_t absDiff7(uint32_t a, uint32_t b) {
+    uint32_t x = (a >> 1) & LANE_LOW7;
+    uint32_t y = (b >> 1) & LANE_LOW7;
+    uint32_t xy = (x | LANE_HIGH) - y;
+    uint32_t yx = (y | LANE_HIGH) - x;
+    uint32_t sign = xy & LANE_HIGH;
+    uint32_t select = (sign - (sign >> 7)) | sign;
+    return ((xy & select) | (yx & ~select)) & LANE_LOW7;
+}
+
+// overMask() function, to set the top bit of every lane of diff (0..127) above threshold (per lane), no carry out of a lane
+static inline uint32_t overMask(uint32_t diff, uint32_t threshold) {
+    return (diff + (LANE_LOW7 - threshold)) & LANE_HIGH;
+}
+
+// average() function, to average the four pixels of a and b, rounded down, per lane
+static inline uint32_t average(uint32_t a, uint32_t b) {
+    return (a & b) + (((a ^ b) & 0xFEFEFEFE) >> 1);
+}
+
+// sumLanes() function, to add up the four 8-bit counters of lanes
+static inline uint32_t sumLanes(uint32_t lanes) {
+    uint32_t pairs = (lanes & 0x00FF00FF) + ((lanes >> 8) & 0x00FF00FF);
+    return (pairs & 0xFFFF) + (pairs >> 16);
+}
+
+MotionDetector::MotionDetector(int pixelThreshold, int stillPermille, int occupiedPermille, int settleFrames)
+    : threshold_((uint32_t)(pixelThreshold / 2) * LANE_ONE),
+      stillPermille_(stillPermille),
+      occupiedPermille_(occupiedPermille),
+      settleFrames_(settleFrames) {}
+
+/* begin() function
+- Function to size the detector for frames of width x height pixels, the next frame becomes the background
+- Return false if the frame does not fit in MOTION_MAX_PIXELS or is not a whole number of words
+*/
+bool MotionDetector::begin(int width, int height) {
+    size_t pixels = (size_t)width * height;
+    if (width <= 0 || height <= 0 || pixels > MOTION_MAX_PIXELS || pixels % 4 != 0) {
+        words_ = 0;
+        return false;
+    }
+    words_ = pixels / 4;
+    stillMax_ = (uint32_t)(pixels * stillPermille_ / 1000);
+    occupiedMin_ = (uint32_t)(pixels * occupiedPermille_ / 1000);
+    state_ = MOTION_STATE_EMPTY;
+    stillFrames_ = 0;
+    emptyFrames_ = 0;
+    frames_ = 0;
+    return true;
+}
+
+/* update() function
+- Function to run one frame through the detector, in one pass over its words
+    - Count the pixels changed since the previous frame and the pixels that differ from the background
+    - Keep the frame as the previous frame, move the background pixels that are not foreground towards it
+    - The counters are 8-bit lanes, added up every 255 words before they can overflow
+- Move the state forward, see MotionDetector.h
+- Return true on the frame the item is found at rest, once per item
+*/
+bool MotionDetector::update(const uint8_t *frame) {
+    if (words_ == 0) {
+        return false;
+    }
+    const uint32_t *words = (const uint32_t *)frame;
+    if (frames_++ == 0) {
+        memcpy(previous_, words, words_ * 4);
+        memcpy(background_, words, words_ * 4);
+        return false;
+    }
+
+    uint32_t changed = 0;
+    uint32_t foreground = 0;
+    for (size_t start = 0; start < words_; start += 255) {
+        size_t end = start + 255 < words_ ? start + 255 : words_;
+        uint32_t changedLanes = 0;
+        uint32_t foregroundLanes = 0;
+        for (size_t i = start; i < end; i++) {
+            uint32_t pixels = words[i];
+            uint32_t moved = overMask(absDiff7(pixels, previous_[i]), threshold_);
+            uint32_t differs = overMask(absDiff7(pixels, background_[i]), threshold_);
+            changedLanes += moved >> 7;
+            foregroundLanes += differs >> 7;
+
+            uint32_t keep = (differs - (differs >> 7)) | differs;
+            uint32_t background = background_[i];
+            uint32_t learned = average(background, average(background, pixels));
+            background_[i] = (background & keep) | (learned & ~keep);
+            previous_[i] = pixels;
+        }
+        changed += sumLanes(changedLanes);
+        foreground += sumLanes(foregroundLanes);
+    }
+    changed_ = changed;
+    foreground_ = foreground;
+
+    stillFrames_ = changed <= stillMax_ ? stillFrames_ + 1 : 0;
+    bool occupied = foreground >= occupiedMin_;
+    switch (state_) {
+        case MOTION_STATE_EMPTY:
+            if (occupied) {
+                state_ = MOTION_STATE_MOVING;
+            }
+            break;
+        case MOTION_STATE_MOVING:
+            if (!occupied) {
+                state_ = MOTION_STATE_EMPTY;
+            } else if (stillFrames_ >= settleFrames_) {
+                state_ = MOTION_STATE_SETTLED;
+                emptyFrames_ = 0;
+                return true;
+            }
+            break;
+        default:
+            if (changed >= occupiedMin_) {
+                state_ = MOTION_STATE_MOVING;   // taken out, or swapped while no frames came (Wi-Fi loss)
+                break;
+            }
+            emptyFrames_ = occupied ? 0 : emptyFrames_ + 1;
+            if (emptyFrames_ >= settleFrames_) {
+                state_ = MOTION_STATE_EMPTY;
+            }
+            break;
+    }
+    return false;
+}
+
+// markCaptured() function, to treat what is in the chute as captured, e.g. on a button press, no trigger until it is empty again
+void MotionDetector::markCaptured() {
+    state_ = MOTION_STATE_SETTLED;
+    emptyFrames_ = 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* MotionDetector
+- Tells when an item has come to rest in the chute, from a stream of small grayscale frames (QQVGA)
+- Two comparisons per frame, both counted in pixels that differ by more than pixelThreshold
+    - changed: against the previous frame, the item is still moving while many pixels change
+    - foreground: against the background, the empty chute, the chute is occupied while many pixels differ
+    - The background follows slow changes of the light: every pixel that is not foreground moves 1/4 of
+      the way to the new frame, pixels of an item are never learned into it
+- SWAR kernel: four pixels in one 32-bit word, the ESP32 has no SIMD instructions
+    - Pixels are halved to 7 bits first, so a lane never borrows from or carries into the next one
+    - Compare, count and background update are done in one pass over the frame, about 1 ms for QQVGA on the ESP32
+- States:
+    - MOTION_STATE_EMPTY: nothing in the chute
+    - MOTION_STATE_MOVING: an item is in the chute, not at rest yet
+    - MOTION_STATE_SETTLED: the item was at rest for settleFrames frames, update() returned true once,
+      no new trigger until the chute was empty for settleFrames frames, or the chute changed as much as an item
+- No heap: previous frame and background live inside the object, up to MOTION_MAX_PIXELS pixels
+- The first frame after begin() is taken as the background, the chute must be empty then
+- Usage:
+    MotionDetector motion;                       // global, 2 x MOTION_MAX_PIXELS bytes
+    motion.begin(160, 120);
+    if (motion.update(fb->buf)) { ... capture ... }   // frame buffer 4-byte aligned, as the camera driver allocates it
+    motion.markCaptured();                       // captured on a button press, do not trigger for this item
+*/
+#define MOTION_MAX_PIXELS (160 * 120)
+
+#define MOTION_PIXEL_THRESHOLD 24
+#define MOTION_STILL_PERMILLE 2
+#define MOTION_OCCUPIED_PERMILLE 30
+#define MOTION_SETTLE_FRAMES 3
+
+#define MOTION_STATE_EMPTY 0
+#define MOTION_STATE_MOVING 1
+#define MOTION_STATE_SETTLED 2
+
+class MotionDetector {
+public:
+    MotionDetector(int pixelThreshold = MOTION_PIXEL_THRESHOLD, int stillPermille = MOTION_STILL_PERMILLE,
+                   int occupiedPermille = MOTION_OCCUPIED_PERMILLE, int settleFrames = MOTION_SETTLE_FRAMES);
+
+    bool begin(int width, int height);
+    bool update(const uint8_t *frame);
+    void markCaptured();
+
+    int state() const { return state_; }
+    uint32_t changedPixels() const { return changed_; }
+    uint32_t foregroundPixels() const { return foreground_; }
+    uint32_t frames() const { return frames_; }
+
+private:
+    uint32_t previous_[MOTION_MAX_PIXELS / 4];
+    uint32_t background_[MOTION_MAX_PIXELS / 4];
+    size_t words_ = 0;
+    uint32_t threshold_;
+    uint32_t stillMax_ = 0;
+    uint32_t occupiedMin_ = 0;
+    int stillPermille_;
+    int occupiedPermille_;
+    int settleFrames_;
+    int state_ = MOTION_STATE_EMPTY;
+    int stillFrames_ = 0;
+    int emptyFrames_ = 0;
+    uint32_t changed_ = 0;
+    uint32_t foreground_ = 0;
+    uint32_t frames_ = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+
+/* RingBuffer
+- Lock-free single producer, single consumer queue of SIZE items, SIZE must be a power of two
+    - Producer: push(), may be an interrupt handler or a task on the other core
+    - Consumer: pop() and peek(), one task only
+- No allocation, no critical section: head_ is only written by the producer, tail_ only by the consumer
+    - Release/acquire order makes the item visible before the index that publishes it
+- push() fails once SIZE items are waiting, the producer decides what to do with the item (dropped() counts them)
+- Usage:
+    RingBuffer<unsigned long, 8> presses;
+    presses.push(millis());                 // in the ISR
+    unsigned long pressedAt;
+    if (presses.pop(pressedAt)) { ... }     // in loop()
+*/
+template <typename T, size_t SIZE>
+class RingBuffer {
+    static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "RingBuffer SIZE must be a power of two");
+
+public:
+    bool push(const T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= SIZE) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items_[head & (SIZE - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        if (!peek(item)) {
+            return false;
+        }
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool peek(T &item) const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) {
+            return false;
+        }
+        item = items_[tail & (SIZE - 1)];
+        return true;
+    }
+
+    size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    unsigned long dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    T items_[SIZE];
+    std::atomic<size_t> head_{0};
+    std::atomic<size_t> tail_{0};
+    std::atomic<unsigned long> dropped_{0};
+};
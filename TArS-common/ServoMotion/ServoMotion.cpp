@@ -0,0 +1,64 @@
+#include "ServoMotion.h"
+
+ServoMotion::ServoMotion(float degPerSec, unsigned long settleMs)
+    : degPerSec_(degPerSec), settleMs_(settleMs), from_(0), to_(0), startMs_(0), durationMs_(0) {}
+
+// begin() function, to start the model at the angle written on attach, from an unknown angle, a full turn at most
+void ServoMotion::begin(int angle, unsigned long now) {
+    from_ = angle;
+    to_ = angle;
+    startMs_ = now;
+    durationMs_ = travelMs(MOTION_FULL_TURN_DEG);
+}
+
+// travelMs() function, to find the time a move of degrees takes, settle time included, 0 for no move
+unsigned long ServoMotion::travelMs(float degrees) const {
+    if (degrees <= 0) {
+        return 0;
+    }
+    return (unsigned long)(degrees * 1000 / degPerSec_ + 0.5f) + settleMs_;
+}
+
+/* moveTo() function
+- Function to start a move to angle in the model, the caller writes angle to the servo
+- The move starts from angleAt(now), a move still running is cut short there
+- A servo already at angle keeps what is left of its settle time
+- Return the milliseconds until the servo is at angle
+*/
+unsigned long ServoMotion::moveTo(int angle, unsigned long now) {
+    if (angle == to_) {
+        return remainingMs(now);
+    }
+    from_ = angleAt(now);
+    to_ = angle;
+    startMs_ = now;
+    durationMs_ = travelMs(fabs(to_ - from_));
+    return durationMs_;
+}
+
+// timeTo() function, to find the milliseconds a move to angle started now would take, what is left of the move running if it is the same
+unsigned long ServoMotion::timeTo(int angle, unsigned long now) const {
+    if (angle == to_) {
+        return remainingMs(now);
+    }
+    return travelMs(fabs(angle - angleAt(now)));
+}
+
+/* angleAt() function
+- Function to estimate the angle of the servo at now, at constant speed from from_ to to_
+- The settle time at the end of a move does not change the angle
+*/
+float ServoMotion::angleAt(unsigned long now) const {
+    float travelled = (long)(now - startMs_) > 0 ? (now - startMs_) * degPerSec_ / 1000 : 0;
+    float span = fabs(to_ - from_);
+    if (travelled >= span) {
+        return to_;
+    }
+    return to_ > from_ ? from_ + travelled : from_ - travelled;
+}
+
+// remainingMs() function, to find the milliseconds until the move running is done, 0 once the servo is there
+unsigned long ServoMotion::remainingMs(unsigned long now) const {
+    long left = (long)(startMs_ + durationMs_ - now);
+    return left > 0 ? (unsigned long)left : 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* ServoMotion
+- Motion model of a hobby servo, which has no position feedback: a write() starts the move, the servo turns
+  at its own speed until it gets there
+- moveTo(angle, now): tell the model a write(angle) was just made, return the milliseconds until the servo is there
+    - Duration: angle delta at degPerSec, plus settleMs for the horn to stop swinging, 0 if it is there already
+    - A move started before the last one finished starts from the angle estimated for now, not from its target
+- timeTo(angle, now): the duration of that move without making it, e.g. to start a second servo so both arrive together
+- begin(angle, now): the angle written when the servo is attached, where it was is unknown,
+  so the move is taken as a full MOTION_FULL_TURN_DEG turn
+- Times are millis() values, compared wrap-safe
+- Usage:
+    ServoMotion pipeMotion(300, 40);
+    servoPipe.write(110);
+    unsigned long travelMs = pipeMotion.moveTo(110, millis());
+    if (pipeMotion.arrived(millis())) { ... }
+*/
+#define MOTION_FULL_TURN_DEG 180
+
+class ServoMotion {
+public:
+    ServoMotion(float degPerSec, unsigned long settleMs);
+
+    void begin(int angle, unsigned long now);
+    unsigned long moveTo(int angle, unsigned long now);
+    unsigned long timeTo(int angle, unsigned long now) const;
+    float angleAt(unsigned long now) const;
+    unsigned long remainingMs(unsigned long now) const;
+    bool arrived(unsigned long now) const { return remainingMs(now) == 0; }
+    int target() const { return to_; }
+
+private:
+    unsigned long travelMs(float degrees) const;
+
+    float degPerSec_;
+    unsigned long settleMs_;
+    float from_;
+    int to_;
+    unsigned long startMs_;
+    unsigned long durationMs_;
+};
@@ -0,0 +1,70 @@
+#include "TArSProtocol.h"
+
+#include <stdio.h>
+
+// clamp() function, to turn the return value of snprintf() into the length the text needs, 0 on an encoding error
+static size_t clamp(int written) {
+    return written < 0 ? 0 : (size_t)written;
+}
+
+size_t tarsStatusBody(char *out, size_t size, const char *scanID) {
+    return clamp(snprintf(out, size, "{\"status\":true,\"scan_id\":\"%s\"}", scanID));
+}
+
+size_t tarsPredictionURL(char *out, size_t size, const char *baseURL, const char *scanID, int waitS) {
+    return clamp(snprintf(out, size, "%s?scan_id=%s&wait=%d", baseURL, scanID, waitS));
+}
+
+size_t tarsCapacityReading(char *out, size_t size, bool first, const char *binID, int capacity, unsigned long ageS) {
+    return clamp(snprintf(out, size, "%s{\"bin_id\":\"%s\",\"fullness_level_cm\":%d,\"age_s\":%lu}", first ? "" : ",",
+                          binID, capacity, ageS));
+}
+
+// appendField() function, to append one form field at length of out, past the end of out only length grows
+static void appendField(char *out, size_t size, size_t &length, const char *name, const char *value) {
+    length += clamp(snprintf(length < size ? out + length : NULL, length < size ? size - length : 0,
+                             "--" TARS_UPLOAD_BOUNDARY "\r\nContent-Disposition: form-data; name=\"%s\"\r\n\r\n%s\r\n",
+                             name, value));
+}
+
+/* tarsUploadForm() function
+- Fields in this order, each one only if it has a value:
+    --RequestBoundary
+    Content-Disposition: form-data; name="scan_id"
+
+    <scan_id>
+  then capture_profile, jpeg_quality, edge_class and edge_confidence (two decimals) the same way, then the head
+  of the file part:
+    --RequestBoundary
+    Content-Disposition: form-data; name="file"; filename="payload.jpg"
+    Content-Type: image/jpeg
+
+*/
+size_t tarsUploadForm(char *out, size_t size, const TArSUploadFields &fields) {
+    char number[16];
+    size_t length = 0;
+    if (fields.scanID != NULL && fields.scanID[0] != '\0') {
+        appendField(out, size, length, "scan_id", fields.scanID);
+    }
+    appendField(out, size, length, "capture_profile", fields.profile);
+    if (fields.jpegQuality > 0) {
+        snprintf(number, sizeof(number), "%d", fields.jpegQuality);
+        appendField(out, size, length, "jpeg_quality", number);
+    }
+    if (fields.edgeLabel != NULL) {
+        appendField(out, size, length, "edge_class", fields.edgeLabel);
+        snprintf(number, sizeof(number), "%.2f", fields.edgeConfidence);
+        appendField(out, size, length, "edge_confidence", number);
+    }
+    length += clamp(snprintf(length < size ? out + length : NULL, length < size ? size - length : 0,
+                             "--" TARS_UPLOAD_BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; "
+                             "filename=\"payload.jpg\"\r\nContent-Type: image/jpeg\r\n\r\n"));
+    return length;
+}
+
+size_t tarsUploadHead(char *out, size_t size, const char *host, const char *path, size_t contentLength) {
+    return clamp(snprintf(out, size,
+                          "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: multipart/form-data; boundary=" TARS_UPLOAD_BOUNDARY
+                          "\r\nContent-Length: %u\r\nConnection: keep-alive\r\n\r\n",
+                          path, host, (unsigned int)contentLength));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+
+/* TArSProtocol.h
+- Messages the two boards exchange with each other and with the server, kept in one place so both firmwares agree
+- LAN trigger, ESP32-S3 -> ESP32-CAM over UDP, skips the cloud status flag when it gets through
+    - ESP32-S3 sends "TARS-TRIGGER <scan_id>" to LOCAL_TRIGGER_PORT of ESP32-CAM
+        - Broadcast on the subnet until the address of ESP32-CAM is known from its first reply
+    - ESP32-CAM captures the image and replies "TARS-ACK <scan_id>" to the sender
+    - Without a reply ESP32-S3 falls back to the cloud status flag (addStatusURL)
+- Edge result, ESP32-CAM -> ESP32-S3 over UDP, lets ESP32-S3 sort without waiting for the server
+    - ESP32-CAM classifies the image itself (EdgeClassifier) and sends "TARS-EDGE <scan_id> <label> <confidence>"
+      to the address and port the trigger came from, e.g. "TARS-EDGE <scan_id> metal 0.93"
+    - ESP32-S3 sorts on it if the confidence is high enough, otherwise it asks the server as before
+    - The image is uploaded either way, with the edge result, so the server can confirm it
+- Motion trigger, ESP32-CAM -> ESP32-S3 over UDP, a scan without a button press
+    - ESP32-CAM saw an item come to rest in the chute (MotionDetector) and captured it under a scan_id of its own
+    - It sends "TARS-MOTION <scan_id>" to LOCAL_TRIGGER_PORT of ESP32-S3, broadcast until its address is known
+    - ESP32-S3 starts a scan with that scan_id, waiting for the prediction right away, and replies "TARS-ACK <scan_id>"
+    - Sent again until acknowledged, a repeated message of a scan already started is only acknowledged again
+- SCAN_ID_MAX_LENGTH: buffer size for a scan_id read from a server reply, terminator included
+- Server requests, built by the functions below (TArSProtocol.cpp) into a buffer of the caller, no String and no heap
+    - The firmwares and the fleet load generator (TArS-simulator/tools/FleetLoad.cpp) send the same bytes
+    - Each returns the length of the text like snprintf(), a length of size or more means it did not fit
+    - tarsStatusBody(): body of the trigger to addStatusURL, {"status":true,"scan_id":"<scan_id>"}
+    - tarsPredictionURL(): getPredictionURL with the scan_id and the long-poll wait in seconds as query parameters
+    - tarsCapacityReading(): one reading of a telemetry batch to updateCapacityURL, {"readings":[<reading>, ...]}
+      between TARS_CAPACITY_OPEN and TARS_CAPACITY_CLOSE, first is false for every reading after the first
+    - tarsUploadForm(): multipart/form-data fields of an image upload to predictURL up to the head of the file part,
+      the JPEG and TARS_UPLOAD_FOOTER follow, a field without a value (NULL, 0, edgeLabel NULL) is left out
+    - tarsUploadHead(): request line and headers of the upload, Content-Length is form, JPEG and footer together
+*/
+#define LOCAL_TRIGGER_PORT 4210
+#define LOCAL_TRIGGER_MESSAGE "TARS-TRIGGER "
+#define LOCAL_TRIGGER_ACK "TARS-ACK "
+#define LOCAL_EDGE_RESULT "TARS-EDGE "
+#define LOCAL_MOTION_MESSAGE "TARS-MOTION "
+#define LOCAL_TRIGGER_MAX_LENGTH 96
+#define SCAN_ID_MAX_LENGTH 64
+
+#define TARS_STATUS_BODY_MAX (32 + SCAN_ID_MAX_LENGTH)
+#define TARS_URL_MAX 256
+#define TARS_CAPACITY_OPEN "{\"readings\":["
+#define TARS_CAPACITY_CLOSE "]}"
+#define TARS_UPLOAD_BOUNDARY "RequestBoundary"
+#define TARS_UPLOAD_FOOTER "\r\n--" TARS_UPLOAD_BOUNDARY "--\r\n"
+#define TARS_UPLOAD_FORM_MAX 640
+#define TARS_UPLOAD_HEAD_MAX 384
+
+struct TArSUploadFields {
+    const char *scanID;        // NULL or "" if the image has none
+    const char *profile;       // capture profile of the camera
+    int jpegQuality;           // 0 if not known
+    const char *edgeLabel;     // class of the edge classifier, NULL if the image was not classified
+    float edgeConfidence;
+};
+
+size_t tarsStatusBody(char *out, size_t size, const char *scanID);
+size_t tarsPredictionURL(char *out, size_t size, const char *baseURL, const char *scanID, int waitS);
+size_t tarsCapacityReading(char *out, size_t size, bool first, const char *binID, int capacity, unsigned long ageS);
+size_t tarsUploadForm(char *out, size_t size, const TArSUploadFields &fields);
+size_t tarsUploadHead(char *out, size_t size, const char *host, const char *path, size_t contentLength);
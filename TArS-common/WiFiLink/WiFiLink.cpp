@@ -0,0 +1,214 @@
+#include "WiFiLink.h"
+
+#include <string.h>
+
+WiFiLink::WiFiLink()
+    : ssid_(""),
+      password_(""),
+      cacheValid_(false),
+      cacheChanged_(false),
+      connected_(false),
+      reportPending_(false),
+      fastAttempt_(false),
+      fastFailingSince_(0),
+      rescanMs_(WIFI_LINK_RESCAN_MS),
+      attemptStartedAt_(0),
+      downSince_(0),
+      connectMs_(0),
+      ready_(NULL) {
+    memset(&cache_, 0, sizeof(cache_));
+    memset(&seen_, 0, sizeof(seen_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+// hashOf() function, to find the FNV-1a hash of text, kept with the cache instead of the SSID itself
+uint32_t WiFiLink::hashOf(const char *text) {
+    uint32_t hash = 2166136261u;
+    for (; *text != '\0'; text++) {
+        hash = (hash ^ (uint8_t)*text) * 16777619u;
+    }
+    return hash;
+}
+
+/* begin() function
+- Function to start connecting to ssid, returns at once, the connection is made in the background
+- Load the cache of the last good connection from NVS, it is used only if it was made with ssid
+- Keep the driver from writing its own config to NVS on every begin() and from reconnecting on its own,
+  reconnects are started by onEvent()
+*/
+void WiFiLink::begin(const char *ssid, const char *password) {
+    ssid_ = ssid;
+    password_ = password;
+    cacheValid_ = loadCache();
+    if (ready_ == NULL) {
+        ready_ = xSemaphoreCreateBinary();
+    }
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
+    WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) { onEvent(event, info); });
+    downSince_ = millis();
+    connect();
+}
+
+/* connect() function
+- Function to start one connection attempt, its end is reported by an event
+- Fast: static IP of the cached lease, straight to the cached BSSID on the cached channel
+- Full: DHCP and a scan of every channel, if there is no cache or fast attempts failed for rescanMs_
+*/
+void WiFiLink::connect() {
+    attemptStartedAt_ = millis();
+    fastAttempt_ = cacheValid_ && (fastFailingSince_ == 0 || attemptStartedAt_ - fastFailingSince_ < rescanMs_);
+    if (fastAttempt_) {
+        WiFi.config(IPAddress(cache_.ip), IPAddress(cache_.gateway), IPAddress(cache_.subnet), IPAddress(cache_.dns));
+        WiFi.begin(ssid_, password_, cache_.channel, cache_.bssid);
+    } else {
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());   // DHCP
+        WiFi.begin(ssid_, password_);
+    }
+}
+
+/* attemptFailed() function
+- Function to start the next attempt after one failed
+- A failed full connect starts the fast attempts over, they may fail twice as long before the next full connect
+*/
+void WiFiLink::attemptFailed() {
+    stats_.failedAttempts++;
+    if (fastAttempt_) {
+        unsigned long startedAt = attemptStartedAt_;
+        if (fastFailingSince_ == 0) {
+            fastFailingSince_ = startedAt != 0 ? startedAt : 1;
+        }
+    } else if (cacheValid_) {
+        fastFailingSince_ = 0;
+        rescanMs_ = min(rescanMs_ * 2, (unsigned long)WIFI_LINK_MAX_RESCAN_MS);
+    }
+    connect();
+}
+
+/* onEvent() function
+- Event handler of the Wi-Fi driver, runs in its event task, touches no state of WiFiLink but events_
+- ARDUINO_EVENT_WIFI_STA_GOT_IP: read the access point and lease into the event
+- ARDUINO_EVENT_WIFI_STA_DISCONNECTED: only the time
+    - WIFI_REASON_ASSOC_LEAVE is the board leaving on its own, e.g. begin() while connecting, no attempt ended, dropped
+- Push the event to events_ and wake waitConnected() with ready_
+    - An event that does not fit is lost, the attempt is then given up by poll() after WIFI_LINK_ATTEMPT_TIMEOUT_MS
+*/
+void WiFiLink::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+    LinkEvent linkEvent;
+    memset(&linkEvent, 0, sizeof(linkEvent));
+    linkEvent.at = millis();
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        Cache &seen = linkEvent.seen;
+        seen.ssidHash = hashOf(ssid_);
+        const uint8_t *bssid = WiFi.BSSID();
+        if (bssid != NULL) {
+            memcpy(seen.bssid, bssid, sizeof(seen.bssid));
+        }
+        seen.channel = (uint8_t)WiFi.channel();
+        seen.ip = info.got_ip.ip_info.ip.addr;
+        seen.gateway = info.got_ip.ip_info.gw.addr;
+        seen.subnet = info.got_ip.ip_info.netmask.addr;
+        seen.dns = (uint32_t)WiFi.dnsIP();
+        linkEvent.gotIP = true;
+    } else if (event != ARDUINO_EVENT_WIFI_STA_DISCONNECTED ||
+               info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE) {
+        return;
+    }
+    events_.push(linkEvent);
+    xSemaphoreGive(ready_);
+}
+
+/* handleEvents() function
+- Function to act on the events onEvent() pushed to events_, in the task of poll() or waitConnected()
+- Got IP: note the access point and lease in seen_, flag the cache if they differ from it,
+  keep the connect time for poll()
+- Disconnected: a connected link dropped, reconnect right away, or an attempt failed, start the next one
+*/
+void WiFiLink::handleEvents() {
+    LinkEvent event;
+    while (events_.pop(event)) {
+        if (event.gotIP) {
+            seen_ = event.seen;
+            cacheChanged_ = !cacheValid_ || memcmp(&seen_, &cache_, sizeof(seen_)) != 0;
+            if (fastAttempt_) {
+                stats_.fastConnects++;
+            } else {
+                stats_.fullConnects++;
+            }
+            fastFailingSince_ = 0;
+            rescanMs_ = WIFI_LINK_RESCAN_MS;
+            connectMs_ = event.at - downSince_;
+            reportPending_ = true;
+            connected_ = true;
+        } else if (connected_) {
+            connected_ = false;
+            stats_.linkLosses++;
+            downSince_ = event.at;
+            connect();
+        } else {
+            attemptFailed();
+        }
+    }
+}
+
+/* waitConnected() function
+- Function to block until the connection is made, woken by onEvent(), no polling
+- Handle the events with handleEvents() function each time it is woken
+- Return false if it is not made within timeoutMs
+*/
+bool WiFiLink::waitConnected(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    handleEvents();
+    while (connected_ == false) {
+        unsigned long waited = millis() - start;
+        if (waited >= timeoutMs) {
+            return false;
+        }
+        xSemaphoreTake(ready_, pdMS_TO_TICKS(timeoutMs - waited));
+        handleEvents();
+    }
+    return true;
+}
+
+/* poll() function
+- Function to run WiFiLink, called from loop(), every change of its state is made here (or in waitConnected())
+- Handle the events of the driver with handleEvents() function, a reconnect starts from here
+- Give up an attempt that got no event for WIFI_LINK_ATTEMPT_TIMEOUT_MS and start the next one
+- Write the cache to NVS if the last connection changed it
+- Return true once per connection, connectMs is the time from begin() or the loss of the link until the IP
+*/
+bool WiFiLink::poll(unsigned long &connectMs) {
+    handleEvents();
+    if (connected_ == false && millis() - attemptStartedAt_ >= WIFI_LINK_ATTEMPT_TIMEOUT_MS) {
+        attemptFailed();
+    }
+    if (cacheChanged_ == true) {
+        cacheChanged_ = false;
+        cache_ = seen_;
+        cacheValid_ = true;
+        saveCache();
+    }
+    if (reportPending_ == false) {
+        return false;
+    }
+    reportPending_ = false;
+    connectMs = connectMs_;
+    return true;
+}
+
+// loadCache() function, to read the cache from NVS, false if there is none or it is of another SSID
+bool WiFiLink::loadCache() {
+    preferences_.begin(WIFI_LINK_NVS_NAMESPACE, true);
+    bool found = preferences_.getBytes("link", &cache_, sizeof(cache_)) == sizeof(cache_);
+    preferences_.end();
+    return found && cache_.ssidHash == hashOf(ssid_) && cache_.channel != 0;
+}
+
+// saveCache() function, to write the cache to NVS, one flash commit
+void WiFiLink::saveCache() {
+    preferences_.begin(WIFI_LINK_NVS_NAMESPACE, false);
+    preferences_.putBytes("link", &cache_, sizeof(cache_));
+    preferences_.end();
+    stats_.cacheWrites++;
+}
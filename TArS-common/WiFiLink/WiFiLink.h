@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <RingBuffer.h>
+
+/* WiFiLink
+- Wi-Fi station connection of ESP32-CAM and ESP32-S3, driven by the events of the Wi-Fi driver instead of polling
+- Fast connect: BSSID, channel and IP lease of the last good connection are kept in NVS (namespace WIFI_LINK_NVS_NAMESPACE)
+    - begin() and every reconnect go straight to that access point on that channel, with the leased IP as a static IP:
+      no scan of every channel and no DHCP, a few hundred milliseconds instead of a few seconds
+    - Full connect (scan + DHCP) if there is no cache (first boot, other SSID), and once fast attempts failed
+      for WIFI_LINK_RESCAN_MS, the access point may have come back on another channel
+        - A full connect that fails as well doubles the time until the next one, up to WIFI_LINK_MAX_RESCAN_MS:
+          while the access point is down, scanning for it does not help, and a scan running when it is back
+          delays the reconnect by up to a scan
+    - The cache is written when it changed only, not on every connect, to spare the flash
+    - The router must keep the lease for the board (DHCP reservation), an address given to another device meanwhile
+      would be used twice
+- Reconnect: on the next poll() after ARDUINO_EVENT_WIFI_STA_DISCONNECTED, the auto reconnect of the driver is turned off
+    - An attempt that got no event for WIFI_LINK_ATTEMPT_TIMEOUT_MS is given up by poll()
+- Threads: the event handler runs in the event task of the driver, begin(), waitConnected() and poll() in setup()/loop()
+    - The event handler only pushes the event to events_ (RingBuffer, WIFI_LINK_EVENTS) and gives ready_,
+      every state change and every new attempt is made by handleEvents(), called from poll() and waitConnected()
+    - connected() may be read from any task
+- poll(connectMs): writes the cache if it changed, returns true once per connection with the time from begin()
+  or the loss of the link until the IP, for the caller to record in Metrics
+- stats(): counters of the connects and failures, e.g. for metrics.watch()
+- Usage:
+    WiFiLink wifiLink;
+    wifiLink.begin(ssid, password);                  // in setup(), returns at once
+    wifiLink.waitConnected(10000);                   // blocks until connected, false after the timeout
+    unsigned long connectMs;
+    if (wifiLink.poll(connectMs)) {                  // in loop()
+        metrics.record("wifi_connect", connectMs);
+    }
+    if (wifiLink.connected()) { ... }
+*/
+#define WIFI_LINK_NVS_NAMESPACE "wifi"
+#define WIFI_LINK_RESCAN_MS 10000
+#define WIFI_LINK_MAX_RESCAN_MS 80000
+#define WIFI_LINK_ATTEMPT_TIMEOUT_MS 10000
+#define WIFI_LINK_EVENTS 8
+
+struct WiFiLinkStats {
+    unsigned long fastConnects;     // connected to the cached access point with the cached lease
+    unsigned long fullConnects;     // connected after a scan and DHCP
+    unsigned long failedAttempts;
+    unsigned long linkLosses;       // connected link dropped
+    unsigned long cacheWrites;
+};
+
+class WiFiLink {
+public:
+    WiFiLink();
+
+    void begin(const char *ssid, const char *password);
+    bool waitConnected(unsigned long timeoutMs);
+    bool poll(unsigned long &connectMs);
+    bool connected() const { return connected_; }
+
+    const WiFiLinkStats &stats() const { return stats_; }
+
+private:
+    struct Cache {
+        uint32_t ssidHash;   // FNV-1a of the SSID, a cache of another network is not used
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint8_t reserved;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t subnet;
+        uint32_t dns;
+    };
+
+    struct LinkEvent {
+        bool gotIP;           // ARDUINO_EVENT_WIFI_STA_GOT_IP, otherwise ARDUINO_EVENT_WIFI_STA_DISCONNECTED
+        unsigned long at;     // millis() of the event
+        Cache seen;           // access point and lease of the new connection, if gotIP
+    };
+
+    void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+    void handleEvents();
+    void connect();
+    void attemptFailed();
+    bool loadCache();
+    void saveCache();
+    static uint32_t hashOf(const char *text);
+
+    const char *ssid_;
+    const char *password_;
+    Preferences preferences_;
+    Cache cache_;           // what the next fast attempt uses, written by poll()
+    Cache seen_;            // access point and lease of the connection now
+    bool cacheValid_;
+    bool cacheChanged_;
+    volatile bool connected_;
+    bool reportPending_;
+    bool fastAttempt_;
+    unsigned long fastFailingSince_;   // first of the fast attempts failed in a row, 0 if none
+    unsigned long rescanMs_;           // time fast attempts may fail before the next full connect
+    unsigned long attemptStartedAt_;
+    unsigned long downSince_;
+    unsigned long connectMs_;
+    RingBuffer<LinkEvent, WIFI_LINK_EVENTS> events_;   // event task to handleEvents()
+    SemaphoreHandle_t ready_;
+    WiFiLinkStats stats_;
+};
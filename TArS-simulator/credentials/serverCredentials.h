@@ -0,0 +1,10 @@
+// Stand-in server URLs and bin IDs for the host simulation.
+// No include guard on purpose: both firmwares include it, each inside its own namespace.
+const char* addStatusURL = "http://tars-sim.local/api/status/add";
+const char* getStatusURL = "http://tars-sim.local/api/status";
+const char* predictURL = "http://tars-sim.local/api/predict";
+const char* getPredictionURL = "http://tars-sim.local/api/prediction/latest";
+const char* updateCapacityURL = "http://tars-sim.local/api/bins/capacity";
+const char* cardboardBinID = "bin-cardboard";
+const char* metalCanBinID = "bin-metal";
+const char* plasticBinID = "bin-plastic";
@@ -0,0 +1,3 @@
+// Stand-in Wi-Fi credentials of the ESP32-CAM for the host simulation
+const char* ssid = "tars-sim";
+const char* password = "tars-sim";
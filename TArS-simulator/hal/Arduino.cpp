@@ -0,0 +1,295 @@
+#include "Arduino.h"
+
+#include <map>
+#include <random>
+
+#include "sim/Heap.h"
+#include "sim/World.h"
+
+using sim::Scheduler;
+using sim::World;
+
+/* String */
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) {
+    if (base == 10) {
+        s_ = std::to_string(value);
+    } else {
+        s_ = (value < 0 ? "-" : "") + String((unsigned long)(value < 0 ? -value : value), base).s_;
+    }
+}
+
+String::String(unsigned long value, unsigned char base) {
+    if (base == 10) {
+        s_ = std::to_string(value);
+        return;
+    }
+    const char *digits = "0123456789abcdef";
+    do {
+        s_.insert(s_.begin(), digits[value % base]);
+        value /= base;
+    } while (value);
+}
+
+String::String(float value, unsigned int decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.*f", (int)decimalPlaces, value);
+    s_ = buffer;
+}
+
+bool String::equalsIgnoreCase(const String &rhs) const {
+    if (s_.size() != rhs.s_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < s_.size(); i++) {
+        if (std::tolower((unsigned char)s_[i]) != std::tolower((unsigned char)rhs.s_[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool String::endsWith(const String &suffix) const {
+    return s_.size() >= suffix.s_.size() && s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+}
+
+int String::indexOf(char ch, unsigned int from) const {
+    size_t found = s_.find(ch, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const String &needle, unsigned int from) const {
+    size_t found = s_.find(needle.s_, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(char ch) const {
+    size_t found = s_.rfind(ch);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int from) const {
+    return from >= s_.size() ? String() : String(s_.substr(from));
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+        std::swap(from, to);
+    }
+    return from >= s_.size() ? String() : String(s_.substr(from, to - from));
+}
+
+void String::trim() {
+    size_t first = s_.find_first_not_of(" \t\r\n");
+    size_t last = s_.find_last_not_of(" \t\r\n");
+    s_ = first == std::string::npos ? "" : s_.substr(first, last - first + 1);
+}
+
+void String::toLowerCase() {
+    for (char &ch : s_) {
+        ch = (char)std::tolower((unsigned char)ch);
+    }
+}
+
+void String::toUpperCase() {
+    for (char &ch : s_) {
+        ch = (char)std::toupper((unsigned char)ch);
+    }
+}
+
+void String::replace(const String &find, const String &replacement) {
+    if (find.s_.empty()) {
+        return;
+    }
+    size_t at = 0;
+    while ((at = s_.find(find.s_, at)) != std::string::npos) {
+        s_.replace(at, find.s_.size(), replacement.s_);
+        at += replacement.s_.size();
+    }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index < s_.size()) {
+        s_.erase(index, count);
+    }
+}
+
+String operator+(const String &lhs, const String &rhs) { return String(lhs.std() + rhs.std()); }
+String operator+(const String &lhs, const char *rhs) { return String(lhs.std() + rhs); }
+String operator+(const char *lhs, const String &rhs) { return String(lhs + rhs.std()); }
+String operator+(const String &lhs, char rhs) { return String(lhs.std() + rhs); }
+
+/* Print / Stream */
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size--) {
+        written += write(*buffer++);
+    }
+    return written;
+}
+
+size_t Print::printf(const char *format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write((const uint8_t *)buffer, std::min((size_t)length, sizeof(buffer) - 1));
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length) {
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < length) {
+        if (available() > 0) {
+            buffer[count++] = (uint8_t)read();
+        } else if (millis() - start >= timeoutMs_) {
+            break;
+        } else {
+            delay(1);
+        }
+    }
+    return count;
+}
+
+String Stream::readStringUntil(char terminator) {
+    std::string text;
+    uint8_t ch;
+    while (readBytes(&ch, 1) == 1 && ch != (uint8_t)terminator) {
+        text += (char)ch;
+    }
+    return String(text);
+}
+
+/* Serial: echoed to stdout with the virtual timestamp and board name in verbose mode */
+HardwareSerial Serial;
+HardwareSerial Serial0;
+
+size_t HardwareSerial::write(uint8_t value) {
+    sim::HostAllocations host;
+    static std::map<int, std::string> lines;
+    int board = Scheduler::instance().currentBoard();
+    std::string &line = lines[board];
+    if (value == '\n') {
+        if (World::instance().config.verbose) {
+            std::printf("[%10.3f s] [%s] %s\n", Scheduler::instance().now() / 1e6,
+                        board == sim::BOARD_CAM ? "cam" : "s3 ", line.c_str());
+        }
+        line.clear();
+    } else if (value != '\r') {
+        line += (char)value;
+    }
+    return 1;
+}
+
+EspClass ESP;
+
+/* Free heap
+- 200 KB of free heap after boot minus what the firmware allocated (see sim/Heap.h)
+- Large buffers would land in PSRAM on the real boards, the number can only get to 0
+*/
+namespace {
+const size_t BOOT_FREE_HEAP = 200 * 1024;
+
+int heapBoard() {
+    return Scheduler::instance().currentBoard() == sim::BOARD_CAM ? sim::BOARD_CAM : sim::BOARD_S3;
+}
+
+uint32_t freeAfter(size_t used) {
+    return used >= BOOT_FREE_HEAP ? 0 : (uint32_t)(BOOT_FREE_HEAP - used);
+}
+}  // namespace
+
+uint32_t EspClass::getFreeHeap() { return freeAfter(sim::heapInUse(heapBoard())); }
+uint32_t EspClass::getMinFreeHeap() { return freeAfter(sim::heapPeak(heapBoard())); }
+
+/* GPIO, per board */
+namespace {
+std::map<int, uint8_t> pinLevels[2];
+
+int boardIndex() {
+    int board = Scheduler::instance().currentBoard();
+    return board == sim::BOARD_CAM ? 0 : 1;
+}
+}  // namespace
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    pinLevels[boardIndex()][pin] = mode == INPUT_PULLUP ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    uint8_t &level = pinLevels[boardIndex()][pin];
+    uint8_t previous = level;
+    level = value ? HIGH : LOW;
+    if (level != previous) {
+        World::instance().onDigitalWrite(boardIndex(), pin, level);
+    }
+}
+
+namespace sim {
+void setPinLevel(int board, int pin, int level) {
+    pinLevels[board == BOARD_CAM ? 0 : 1][pin] = level ? HIGH : LOW;
+}
+}  // namespace sim
+
+int digitalRead(uint8_t pin) {
+    return pinLevels[boardIndex()][pin];
+}
+
+/* pulseIn()
+- Echo pins of the HC-SR04 models return the round trip time of one noisy ping of the simulated bin
+- Any other pin or a lost echo times out, exactly like a disconnected sensor
+*/
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeoutUs) {
+    (void)state;
+    double distance = World::instance().sampleEchoCm(Scheduler::instance().currentBoard(), pin, false);
+    if (distance < 0) {
+        Scheduler::instance().sleepFor(timeoutUs);
+        return 0;
+    }
+    unsigned long duration = (unsigned long)(distance * 2 / 0.0343);
+    Scheduler::instance().sleepFor(450 + duration);   // sensor burst + echo
+    return duration;
+}
+
+/* Timing */
+unsigned long millis() { return (unsigned long)(Scheduler::instance().now() / 1000); }
+unsigned long micros() { return (unsigned long)Scheduler::instance().now(); }
+void delay(uint32_t ms) { Scheduler::instance().sleepFor((sim::Micros)ms * 1000); }
+void delayMicroseconds(uint32_t us) { Scheduler::instance().sleepFor(us); }
+void yield() { Scheduler::instance().sleepFor(0); }
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+    World::instance().onAttachInterrupt(Scheduler::instance().currentBoard(), pin, isr, mode);
+}
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode) {
+    World::instance().onAttachInterrupt(Scheduler::instance().currentBoard(), pin, [isr, arg]() { isr(arg); }, mode);
+}
+
+void detachInterrupt(uint8_t pin) {
+    World::instance().onAttachInterrupt(Scheduler::instance().currentBoard(), pin, nullptr, 0);
+}
+
+bool psramFound() { return true; }
+
+void *ps_malloc(size_t size) { return sim::psramAllocate(size); }
+
+long random(long maxValue) { return random(0, maxValue); }
+
+long random(long minValue, long maxValue) {
+    if (maxValue <= minValue) {
+        return minValue;
+    }
+    std::uniform_int_distribution<long> pick(minValue, maxValue - 1);
+    return pick(World::instance().rng());
+}
+
+void randomSeed(unsigned long seed) { (void)seed; }
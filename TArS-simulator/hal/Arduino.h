@@ -0,0 +1,197 @@
+#pragma once
+
+/* Arduino.h (host stand-in)
+- The subset of the arduino-esp32 core used by both firmwares, backed by the
+  virtual clock in sim/Scheduler.h
+- Only what the firmware needs is here, add to it when the firmware starts using more
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sim/Scheduler.h"
+
+#define IRAM_ATTR
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+class String {
+public:
+    String() {}
+    String(const char *value) : s_(value ? value : "") {}
+    String(const std::string &value) : s_(value) {}
+    explicit String(char value) : s_(1, value) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimalPlaces = 2);
+    explicit String(double value, unsigned int decimalPlaces = 2);
+
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    const char *c_str() const { return s_.c_str(); }
+    bool reserve(unsigned int size) { s_.reserve(size); return true; }
+    char *begin() { return &s_[0]; }
+    char *end() { return &s_[0] + s_.size(); }
+    const char *begin() const { return s_.data(); }
+    const char *end() const { return s_.data() + s_.size(); }
+
+    String &operator+=(const String &rhs) { s_ += rhs.s_; return *this; }
+    String &operator+=(const char *rhs) { s_ += rhs; return *this; }
+    String &operator+=(char rhs) { s_ += rhs; return *this; }
+    String &operator+=(int rhs) { s_ += std::to_string(rhs); return *this; }
+    String &operator+=(unsigned long rhs) { s_ += std::to_string(rhs); return *this; }
+    bool concat(const String &rhs) { s_ += rhs.s_; return true; }
+    bool concat(const char *rhs) { s_ += rhs; return true; }
+    bool concat(char rhs) { s_ += rhs; return true; }
+
+    bool operator==(const String &rhs) const { return s_ == rhs.s_; }
+    bool operator==(const char *rhs) const { return s_ == rhs; }
+    bool operator!=(const String &rhs) const { return s_ != rhs.s_; }
+    bool operator!=(const char *rhs) const { return s_ != rhs; }
+    bool equals(const String &rhs) const { return s_ == rhs.s_; }
+    bool equalsIgnoreCase(const String &rhs) const;
+    bool startsWith(const String &prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+    bool endsWith(const String &suffix) const;
+    char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index) { return s_[index]; }
+
+    int indexOf(char ch, unsigned int from = 0) const;
+    int indexOf(const String &needle, unsigned int from = 0) const;
+    int indexOf(const char *needle, unsigned int from = 0) const { return indexOf(String(needle), from); }
+    int lastIndexOf(char ch) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    void replace(const String &find, const String &replacement);
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+    long toInt() const { return std::strtol(s_.c_str(), nullptr, 10); }
+    float toFloat() const { return std::strtof(s_.c_str(), nullptr); }
+
+    const std::string &std() const { return s_; }
+
+private:
+    std::string s_;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text) { return text ? write((const uint8_t *)text, std::strlen(text)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char *text) { return write(text); }
+    size_t print(const String &text) { return write((const uint8_t *)text.c_str(), text.length()); }
+    size_t print(char value) { return write((uint8_t)value); }
+    size_t print(int value, int base = 10) { return print(String((long)value, base)); }
+    size_t print(unsigned int value, int base = 10) { return print(String((unsigned long)value, base)); }
+    size_t print(long value, int base = 10) { return print(String(value, base)); }
+    size_t print(unsigned long value, int base = 10) { return print(String(value, base)); }
+    size_t print(double value, int digits = 2) { return print(String(value, digits)); }
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value) { size_t n = print(value); return n + println(); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(uint8_t *buffer, size_t length);
+    size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+    String readStringUntil(char terminator);
+    void setTimeout(unsigned long timeoutMs) { timeoutMs_ = timeoutMs; }
+
+protected:
+    unsigned long timeoutMs_ = 1000;
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t value) override;
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial0;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getHeapSize() { return 320 * 1024; }
+    uint32_t getPsramSize() { return 4 * 1024 * 1024; }
+    void restart() { throw sim::StopSimulation{}; }
+};
+
+extern EspClass ESP;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeoutUs = 1000000);
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+bool psramFound();
+void *ps_malloc(size_t size);
+
+long random(long maxValue);
+long random(long minValue, long maxValue);
+void randomSeed(unsigned long seed);
+
+template <typename T, typename L, typename H>
+T constrain(T value, L low, H high) { return value < low ? low : (value > high ? high : value); }
@@ -0,0 +1,273 @@
+#include "esp_camera.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#include "img_converters.h"
+#include "sim/Heap.h"
+#include "sim/Scene.h"
+#include "sim/World.h"
+
+using sim::Scheduler;
+using sim::World;
+
+namespace {
+
+struct Resolution {
+    int width;
+    int height;
+};
+
+const Resolution RESOLUTIONS[FRAMESIZE_INVALID] = {
+    {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296},
+    {480, 320}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200},
+};
+
+/* Frame buffers of the driver
+- The sensor streams from esp_camera_init() on, frame k starts at sensorStartUs + k frame periods,
+  fb->timestamp is that start
+- Auto exposure and white balance need AEC_SETTLE_FRAMES frames after the start, a JPEG taken before
+  shows nothing the server or the edge classifier can recognise
+- CAMERA_GRAB_WHEN_EMPTY: a buffer is filled with the next frame as soon as it is free (init, esp_camera_fb_return())
+  and kept until the firmware takes it, so fb_get can hand out a frame taken long before the call
+- CAMERA_GRAB_LATEST: free buffers are overwritten with every frame, fb_get hands out the newest finished one
+- A frame shows the scene of the moment its buffer was filled, WHEN_EMPTY, or the moment of fb_get, LATEST
+  (at most two frame periods off)
+*/
+struct Shot {
+    sim::Micros startUs;
+    int itemClass;
+    int itemId;
+    double offset;
+};
+
+const int AEC_SETTLE_FRAMES = 6;
+
+bool initialised = false;
+camera_config_t activeConfig;
+sim::Micros sensorStartUs = 0;
+std::deque<Shot> filled;   // WHEN_EMPTY: frames waiting in the buffers, oldest first
+int buffersOut = 0;        // buffers the firmware holds
+int64_t lastFrame = -1;    // number of the newest frame handed out or buffered
+framesize_t frameSize = FRAMESIZE_UXGA;
+Resolution rawOutput = {0, 0};   // set_res_raw() output size, 0 = frameSize
+bool rawUxgaTiming = false;
+pixformat_t pixelFormat = PIXFORMAT_JPEG;
+int jpegQuality = 10;
+uint32_t fillerState = 0x2545F491;
+uint32_t grayFrames = 0;
+sensor_t sensor;
+
+int setPixformat(sensor_t *, pixformat_t value) { pixelFormat = value; return 0; }
+int setFramesize(sensor_t *, framesize_t value) { frameSize = value; rawOutput = {0, 0}; return 0; }
+int setQuality(sensor_t *, int value) { jpegQuality = value; return 0; }
+int setResRaw(sensor_t *, int mode, int, int, int, int, int, int, int, int outputX, int outputY, bool, bool) {
+    rawOutput = {outputX, outputY};
+    rawUxgaTiming = mode == 0;
+    return 0;
+}
+int setIgnored(sensor_t *, int) { return 0; }
+int setGainceiling(sensor_t *, gainceiling_t) { return 0; }
+
+// Frame period of the OV2640 at 20 MHz XCLK, large frames and UXGA windows run at the slower UXGA timing
+double framePeriodMs(framesize_t size) {
+    return size >= FRAMESIZE_XGA || (rawOutput.width > 0 && rawUxgaTiming) ? 80 : 40;
+}
+
+Resolution outputResolution() {
+    return rawOutput.width > 0 ? rawOutput : RESOLUTIONS[frameSize];
+}
+
+sim::Micros framePeriodUs() {
+    return sim::ms(framePeriodMs(frameSize));
+}
+
+// First frame that starts at or after atUs and after the last one handed out or buffered
+int64_t nextFrameAfter(sim::Micros atUs) {
+    sim::Micros period = framePeriodUs();
+    int64_t frame = atUs <= sensorStartUs ? 0 : (atUs - sensorStartUs + period - 1) / period;
+    return std::max(frame, lastFrame + 1);
+}
+
+// Scene in front of the camera now, for a frame that starts at startUs
+Shot shotOf(sim::Micros startUs) {
+    Shot shot{startUs, -1, 0, 0};
+    shot.itemClass = World::instance().presentedItem(&shot.itemId);
+    shot.offset = World::instance().presentedOffset();
+    if (startUs < sensorStartUs + AEC_SETTLE_FRAMES * framePeriodUs() && pixelFormat != PIXFORMAT_GRAYSCALE) {
+        shot.itemClass = -1;   // over- or underexposed, nothing to recognise
+    }
+    return shot;
+}
+
+// Fill a free buffer with the next frame, WHEN_EMPTY
+void fillBuffer() {
+    lastFrame = nextFrameAfter(Scheduler::instance().now());
+    filled.push_back(shotOf(sensorStartUs + lastFrame * framePeriodUs()));
+}
+
+/* jpegBytes()
+- Rough JPEG size model of the OV2640: bits per pixel fall as the quality number rises
+- UXGA at quality 10 lands around 190 KB, SVGA at quality 12 around 40 KB
+*/
+size_t jpegBytes(const Resolution &resolution, int quality) {
+    double bytesPerPixel = 1.2 / (quality + 2);
+    std::uniform_real_distribution<double> jitter(0.9, 1.1);
+    return (size_t)(resolution.width * resolution.height * bytesPerPixel * jitter(World::instance().rng()));
+}
+
+}  // namespace
+
+esp_err_t esp_camera_init(const camera_config_t *config) {
+    Scheduler::instance().sleepFor(sim::ms(300));   // SCCB probe + sensor register upload
+    activeConfig = *config;
+    frameSize = config->frame_size;
+    rawOutput = {0, 0};
+    pixelFormat = config->pixel_format;
+    jpegQuality = config->jpeg_quality;
+    sensorStartUs = Scheduler::instance().now();
+    filled.clear();
+    buffersOut = 0;
+    lastFrame = -1;
+    if (config->grab_mode == CAMERA_GRAB_WHEN_EMPTY) {
+        for (size_t i = 0; i < std::max(config->fb_count, (size_t)1); i++) {
+            fillBuffer();
+        }
+    }
+
+    sensor.set_pixformat = setPixformat;
+    sensor.set_framesize = setFramesize;
+    sensor.set_quality = setQuality;
+    sensor.set_brightness = setIgnored;
+    sensor.set_contrast = setIgnored;
+    sensor.set_saturation = setIgnored;
+    sensor.set_special_effect = setIgnored;
+    sensor.set_whitebal = setIgnored;
+    sensor.set_awb_gain = setIgnored;
+    sensor.set_wb_mode = setIgnored;
+    sensor.set_exposure_ctrl = setIgnored;
+    sensor.set_aec2 = setIgnored;
+    sensor.set_ae_level = setIgnored;
+    sensor.set_aec_value = setIgnored;
+    sensor.set_gain_ctrl = setIgnored;
+    sensor.set_agc_gain = setIgnored;
+    sensor.set_gainceiling = setGainceiling;
+    sensor.set_bpc = setIgnored;
+    sensor.set_wpc = setIgnored;
+    sensor.set_raw_gma = setIgnored;
+    sensor.set_lenc = setIgnored;
+    sensor.set_hmirror = setIgnored;
+    sensor.set_vflip = setIgnored;
+    sensor.set_dcw = setIgnored;
+    sensor.set_colorbar = setIgnored;
+    sensor.set_res_raw = setResRaw;
+    initialised = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+    initialised = false;
+    return ESP_OK;
+}
+
+sensor_t *esp_camera_sensor_get() {
+    return initialised ? &sensor : nullptr;
+}
+
+camera_fb_t *esp_camera_fb_get() {
+    if (!initialised || buffersOut >= (int)std::max(activeConfig.fb_count, (size_t)1)) {
+        return nullptr;   // the real driver times out after 4 s with all buffers taken
+    }
+    Shot shot;
+    if (activeConfig.grab_mode == CAMERA_GRAB_WHEN_EMPTY) {
+        shot = filled.front();
+        filled.pop_front();
+    } else {
+        // Newest frame finished by now, or the first one if none has finished yet
+        sim::Micros period = framePeriodUs();
+        int64_t finished = (Scheduler::instance().now() - sensorStartUs) / period - 1;
+        lastFrame = std::max(finished, lastFrame + 1);
+        shot = shotOf(sensorStartUs + lastFrame * period);
+    }
+    sim::Micros readyUs = shot.startUs + framePeriodUs();
+    if (readyUs > Scheduler::instance().now()) {
+        Scheduler::instance().sleepFor(readyUs - Scheduler::instance().now());
+    }
+    buffersOut++;
+    sim::HostAllocations host;   // frame buffers belong to the driver (PSRAM), not the firmware heap
+
+    int itemId = shot.itemId;
+    int itemClass = shot.itemClass;
+    Resolution resolution = outputResolution();
+    sim::Micros now = shot.startUs;
+    if (pixelFormat == PIXFORMAT_GRAYSCALE) {
+        camera_fb_t *fb = new camera_fb_t();
+        fb->len = (size_t)resolution.width * resolution.height;
+        fb->buf = new uint8_t[fb->len];
+        fb->width = resolution.width;
+        fb->height = resolution.height;
+        fb->format = pixelFormat;
+        fb->timestamp.tv_sec = (time_t)(now / 1000000);
+        fb->timestamp.tv_usec = (suseconds_t)(now % 1000000);
+        sim::renderSceneGray(itemClass, itemId, World::instance().config.oddItemRate, shot.offset, grayFrames++,
+                             resolution.width, resolution.height, fb->buf);
+        return fb;
+    }
+    char marker[48];
+    int markerLength = std::snprintf(marker, sizeof(marker), "TARS-ITEM:%d:%d;", itemClass, itemId);
+
+    size_t length = std::max(jpegBytes(resolution, jpegQuality), (size_t)128);
+    camera_fb_t *fb = new camera_fb_t();
+    fb->buf = new uint8_t[length];
+    fb->len = length;
+    fb->width = resolution.width;
+    fb->height = resolution.height;
+    fb->format = pixelFormat;
+    fb->timestamp.tv_sec = (time_t)(now / 1000000);
+    fb->timestamp.tv_usec = (suseconds_t)(now % 1000000);
+
+    static const uint8_t header[] = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00};
+    std::memcpy(fb->buf, header, sizeof(header));
+    std::memcpy(fb->buf + sizeof(header), marker, markerLength);
+    for (size_t i = sizeof(header) + markerLength; i < length - 2; i++) {
+        fillerState ^= fillerState << 13;
+        fillerState ^= fillerState >> 17;
+        fillerState ^= fillerState << 5;
+        fb->buf[i] = (uint8_t)(0x80 | (fillerState & 0x7F));
+    }
+    fb->buf[length - 2] = 0xFF;
+    fb->buf[length - 1] = 0xD9;
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb) {
+    if (fb) {
+        delete[] fb->buf;
+        delete fb;
+        if (initialised && buffersOut > 0) {
+            buffersOut--;
+            if (activeConfig.grab_mode == CAMERA_GRAB_WHEN_EMPTY) {
+                fillBuffer();
+            }
+        }
+    }
+}
+
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t *out, jpg_scale_t scale) {
+    Scheduler::instance().sleepFor(sim::ms(World::instance().config.jpegDecodeMs));
+    static const char marker[] = "TARS-ITEM:";
+    const uint8_t *found = std::search(src, src + src_len, marker, marker + sizeof(marker) - 1);
+    char text[48] = {0};
+    std::memcpy(text, found, std::min((size_t)(src + src_len - found), sizeof(text) - 1));
+    int itemClass = -1;
+    int itemId = 0;
+    if (found == src + src_len || std::sscanf(text, "TARS-ITEM:%d:%d;", &itemClass, &itemId) != 2) {
+        return false;
+    }
+    Resolution resolution = outputResolution();
+    sim::renderScene(itemClass, itemId, World::instance().config.oddItemRate, resolution.width >> scale,
+                     resolution.height >> scale, out);
+    return true;
+}
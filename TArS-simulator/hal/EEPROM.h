@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Arduino.h"
+
+/* EEPROM (host stand-in)
+- RAM copy of the emulated EEPROM, commit() is charged as a flash sector write
+*/
+class EEPROMClass {
+public:
+    bool begin(size_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit();
+    size_t length() { return data_.size(); }
+
+    template <typename T>
+    T &get(int address, T &value) {
+        std::memcpy(&value, data_.data() + address, sizeof(T));
+        return value;
+    }
+    template <typename T>
+    const T &put(int address, const T &value) {
+        std::memcpy(data_.data() + address, &value, sizeof(T));
+        return value;
+    }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Arduino.h"
+
+/* Servo (host stand-in)
+- Forwards every write() to sim::World, which moves the pipe or gate at the servo's speed
+*/
+class Servo {
+public:
+    int attach(int pin) { pin_ = pin; return 1; }
+    int attach(int pin, int minUs, int maxUs) { (void)minUs; (void)maxUs; return attach(pin); }
+    void detach() { pin_ = -1; }
+    bool attached() const { return pin_ >= 0; }
+    void write(int angle);
+    void writeMicroseconds(int us) { write((us - 500) * 180 / 2000); }
+    int read() const { return angle_; }
+
+private:
+    int pin_ = -1;
+    int angle_ = 90;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <map>
+#include <memory>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+/* FS.h (host stand-in)
+- In-memory file system, every operation is charged with the SD cost model of sim::World
+  (FAT lookup on open, directory entry on create, sustained read/write throughput)
+- Opening, creating and removing a file also searches its folder, the cost grows with the files in it
+*/
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2,
+};
+
+struct FileNode;
+class FS;
+
+class File : public Stream {
+public:
+    File() {}
+    File(std::shared_ptr<FileNode> node, const std::string &path, bool writable, bool directory, FS *owner);
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    size_t read(uint8_t *buffer, size_t size);
+    int peek() override;
+    void flush() override {}
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const { return pos_; }
+    size_t size() const;
+    void close();
+    const char *name() const;
+    const char *path() const { return path_.c_str(); }
+    bool isDirectory() const { return directory_; }
+    File openNextFile(const char *mode = FILE_READ);
+    operator bool() const { return node_ != nullptr || directory_; }
+
+private:
+    std::shared_ptr<FileNode> node_;
+    std::string path_;
+    size_t pos_ = 0;
+    bool writable_ = false;
+    bool directory_ = false;
+    std::string lastListed_;
+    FS *owner_ = nullptr;
+};
+
+class FS {
+public:
+    virtual ~FS() {}
+    File open(const char *path, const char *mode = FILE_READ, bool create = false);
+    File open(const String &path, const char *mode = FILE_READ, bool create = false) {
+        return open(path.c_str(), mode, create);
+    }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to);
+    bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+    bool mkdir(const char *path);
+    bool mkdir(const String &path) { return mkdir(path.c_str()); }
+    bool rmdir(const char *path) { (void)path; return true; }
+
+    // Host side helpers for the simulator report
+    size_t fileCount() const;
+    uint64_t bytesStored() const;
+    std::string nextEntry(const std::string &directory, const std::string &after) const;
+
+protected:
+    bool mounted_ = false;
+
+private:
+    void chargeSearch(const std::string &path);
+
+    std::map<std::string, std::shared_ptr<FileNode>> files_;
+    std::map<std::string, bool> directories_;
+    std::map<std::string, size_t> entries_;   // files per folder
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sim/Heap.h"
+#include "sim/Scheduler.h"
+
+using sim::Micros;
+using sim::Scheduler;
+
+/* Queue object
+- Ring buffer of fixed-size items, allocated once at creation like the real kernel does
+- Tasks blocked on it are remembered and woken when the other side makes progress
+*/
+struct QueueDefinition {
+    UBaseType_t length = 0;
+    UBaseType_t itemSize = 0;
+    UBaseType_t count = 0;
+    UBaseType_t head = 0;
+    std::vector<uint8_t> storage;
+    std::vector<int> receivers;
+    std::vector<int> senders;
+};
+
+/* Event group object
+- The bits, and the tasks blocked until their bits are set
+*/
+struct EventGroupDefinition {
+    EventBits_t bits = 0;
+    std::vector<int> waiters;
+};
+
+namespace {
+
+std::map<int, BaseType_t> taskCores;
+
+Micros deadlineOf(TickType_t ticks) {
+    Micros now = Scheduler::instance().now();
+    return ticks == portMAX_DELAY ? UINT64_MAX / 2 : now + sim::ms(ticks);
+}
+
+void wakeAll(std::vector<int> &waiters) {
+    for (int task : waiters) {
+        Scheduler::instance().wake(task);
+    }
+    waiters.clear();
+}
+
+bool tryPush(QueueHandle_t queue, const void *item, bool front) {
+    if (queue->count >= queue->length) {
+        return false;
+    }
+    UBaseType_t slot;
+    if (front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->itemSize > 0 && item != nullptr) {
+        std::memcpy(queue->storage.data() + slot * queue->itemSize, item, queue->itemSize);
+    }
+    queue->count++;
+    wakeAll(queue->receivers);
+    return true;
+}
+
+bool tryPop(QueueHandle_t queue, void *buffer, bool remove) {
+    if (queue->count == 0) {
+        return false;
+    }
+    if (queue->itemSize > 0 && buffer != nullptr) {
+        std::memcpy(buffer, queue->storage.data() + queue->head * queue->itemSize, queue->itemSize);
+    }
+    if (remove) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        wakeAll(queue->senders);
+    }
+    return true;
+}
+
+void waitOn(std::vector<int> &waiters, Micros deadline) {
+    Scheduler &scheduler = Scheduler::instance();
+    int self = scheduler.currentTask();
+    {
+        sim::HostAllocations host;
+        waiters.push_back(self);
+    }
+    scheduler.sleepUntil(deadline);
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), self), waiters.end());
+}
+
+BaseType_t send(QueueHandle_t queue, const void *item, TickType_t ticksToWait, bool front) {
+    Micros deadline = deadlineOf(ticksToWait);
+    while (!tryPush(queue, item, front)) {
+        if (Scheduler::instance().now() >= deadline) {
+            return errQUEUE_FULL;
+        }
+        waitOn(queue->senders, deadline);
+    }
+    return pdPASS;
+}
+
+BaseType_t receive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait, bool remove) {
+    Micros deadline = deadlineOf(ticksToWait);
+    while (!tryPop(queue, buffer, remove)) {
+        if (Scheduler::instance().now() >= deadline) {
+            return errQUEUE_EMPTY;
+        }
+        waitOn(queue->receivers, deadline);
+    }
+    return pdPASS;
+}
+
+}  // namespace
+
+/* Tasks */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *createdTask, BaseType_t coreId) {
+    (void)stackDepth;
+    (void)priority;
+    Scheduler &scheduler = Scheduler::instance();
+    int id = scheduler.spawn(scheduler.currentBoard(), name, [code, parameters]() { code(parameters); });
+    {
+        sim::HostAllocations host;
+        taskCores[id] = coreId == tskNO_AFFINITY ? 0 : coreId;
+    }
+    if (createdTask != nullptr) {
+        *createdTask = (TaskHandle_t)(intptr_t)(id + 1);
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *createdTask) {
+    return xTaskCreatePinnedToCore(code, name, stackDepth, parameters, priority, createdTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == xTaskGetCurrentTaskHandle()) {
+        throw sim::TaskExit{};
+    }
+    // Deleting another task is not needed by the firmware, the stand-in leaves it running
+}
+
+void vTaskDelay(TickType_t ticks) {
+    Scheduler::instance().sleepFor(sim::ms(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(Scheduler::instance().now() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return (TaskHandle_t)(intptr_t)(Scheduler::instance().currentTask() + 1);
+}
+
+BaseType_t xPortGetCoreID() {
+    auto core = taskCores.find(Scheduler::instance().currentTask());
+    return core == taskCores.end() ? 1 : core->second;   // Arduino loopTask runs on core 1
+}
+
+/* Queues */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    QueueHandle_t queue = new QueueDefinition();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->storage.resize((size_t)length * itemSize);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    return send(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    return send(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higherPriorityTaskWoken) {
+    bool woke = !queue->receivers.empty();
+    bool sent = tryPush(queue, item, false);
+    if (higherPriorityTaskWoken != nullptr && sent && woke) {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+    return sent ? pdPASS : errQUEUE_FULL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+    return receive(queue, buffer, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+    return receive(queue, buffer, ticksToWait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    queue->count = 0;
+    queue->head = 0;
+    wakeAll(queue->senders);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) { return queue->count; }
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) { return queue->length - queue->count; }
+
+/* Semaphores */
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    mutex->count = 1;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+    semaphore->count = std::min(initialCount, maxCount);
+    return semaphore;
+}
+
+/* Event groups */
+EventGroupHandle_t xEventGroupCreate() { return new EventGroupDefinition(); }
+
+void vEventGroupDelete(EventGroupHandle_t group) { delete group; }
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    group->bits |= bits;
+    wakeAll(group->waiters);
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) { return group->bits; }
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticksToWait) {
+    Micros deadline = deadlineOf(ticksToWait);
+    for (;;) {
+        EventBits_t set = group->bits & bits;
+        bool done = waitForAll ? set == bits : set != 0;
+        if (done || Scheduler::instance().now() >= deadline) {
+            EventBits_t value = group->bits;
+            if (done && clearOnExit) {
+                group->bits &= ~bits;
+            }
+            return value;
+        }
+        waitOn(group->waiters, deadline);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+typedef enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_CREATED = 201,
+    HTTP_CODE_ACCEPTED = 202,
+    HTTP_CODE_NO_CONTENT = 204,
+    HTTP_CODE_BAD_REQUEST = 400,
+    HTTP_CODE_NOT_FOUND = 404,
+    HTTP_CODE_REQUEST_TIMEOUT = 408,
+    HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+    HTTP_CODE_SERVICE_UNAVAILABLE = 503,
+} t_http_codes;
+
+/* HTTPClient (host stand-in)
+- Same surface as the arduino-esp32 HTTPClient for the calls the firmware makes
+- begin(url) opens a fresh connection for every request and end() closes it
+- begin(client, url) with setReuse(true) keeps the caller's connection open across requests
+- After GET()/POST() the body is left in the stream, getString() drains it
+*/
+class HTTPClient {
+public:
+    HTTPClient() {}
+    ~HTTPClient();
+
+    bool begin(const String &url);
+    bool begin(WiFiClient &client, const String &url);
+    void end();
+    bool connected();
+
+    void setReuse(bool reuse) { reuse_ = reuse; }
+    void setTimeout(uint16_t timeoutMs) { timeoutMs_ = timeoutMs; }
+    void setConnectTimeout(int32_t timeoutMs) { connectTimeoutMs_ = timeoutMs; }
+    void addHeader(const String &name, const String &value, bool first = false, bool replace = true);
+
+    int GET();
+    int POST(uint8_t *payload, size_t size);
+    int POST(const String &payload);
+    int sendRequest(const char *type, const uint8_t *payload = nullptr, size_t size = 0);
+    int sendRequest(const char *type, const String &payload);
+
+    int getSize() { return size_; }
+    String getString();
+    WiFiClient &getStream() { return *client_; }
+    WiFiClient *getStreamPtr() { return connected() ? client_ : nullptr; }
+    static String errorToString(int error);
+
+private:
+    bool parseUrl(const String &url);
+    int readResponseHeader();
+
+    std::unique_ptr<WiFiClient> ownClient_;
+    WiFiClient *client_ = nullptr;
+    String host_;
+    uint16_t port_ = 80;
+    String uri_;
+    std::vector<std::pair<String, String>> headers_;
+    bool reuse_ = true;
+    bool canReuse_ = false;
+    uint16_t timeoutMs_ = 5000;
+    int32_t connectTimeoutMs_ = 5000;
+    int size_ = -1;
+    int returnCode_ = 0;
+};
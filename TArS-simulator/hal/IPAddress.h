@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Arduino.h"
+
+class IPAddress {
+public:
+    IPAddress() : value_(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : value_((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t value) : value_(value) {}
+
+    operator uint32_t() const { return value_; }
+    uint8_t operator[](int index) const { return (uint8_t)(value_ >> (8 * index)); }
+    bool operator==(const IPAddress &rhs) const { return value_ == rhs.value_; }
+    bool operator!=(const IPAddress &rhs) const { return value_ != rhs.value_; }
+    bool fromString(const char *text);
+    String toString() const;
+
+private:
+    uint32_t value_;
+};
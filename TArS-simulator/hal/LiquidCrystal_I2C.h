@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define LCD_5x8DOTS 0x00
+
+/* LiquidCrystal_I2C (host stand-in)
+- Keeps the text the firmware has drawn, so the simulator can show it
+- Charges the I2C time of the PCF8574 backpack: every character or command is sent
+  as two nibbles of three bus transactions each (~1.2 ms at 100 kHz), clear() and
+  home() add the 2 ms the HD44780 needs to execute them
+*/
+class LiquidCrystal_I2C : public Print {
+public:
+    LiquidCrystal_I2C(uint8_t address, uint8_t cols, uint8_t rows);
+
+    void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
+    void init();
+    void clear();
+    void home();
+    void setCursor(uint8_t col, uint8_t row);
+    void backlight();
+    void noBacklight();
+    size_t write(uint8_t value) override;
+    using Print::write;
+
+    std::string line(int row) const;
+    uint64_t transactions() const { return transactions_; }
+
+private:
+    void send(int bytes, double extraUs = 0);
+
+    uint8_t cols_;
+    uint8_t rows_;
+    uint8_t col_ = 0;
+    uint8_t row_ = 0;
+    std::vector<std::string> text_;
+    uint64_t transactions_ = 0;
+};
@@ -0,0 +1,703 @@
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "HTTPClient.h"
+#include "WiFi.h"
+#include "WiFiClient.h"
+#include "WiFiClientSecure.h"
+#include "sim/Heap.h"
+#include "sim/Server.h"
+#include "sim/World.h"
+
+using sim::Micros;
+using sim::Scheduler;
+using sim::World;
+
+namespace sim {
+
+struct Connection {
+    int board = BOARD_NONE;
+    bool open = false;
+    std::string out;
+    std::string in;
+    size_t inPos = 0;
+    Micros readyUs = 0;
+    Micros lastUs = 0;   // last byte sent or received, for the server's idle timeout
+    bool incoming = false;   // opened by the simulator towards a WiFiServer of the board
+};
+
+namespace {
+
+struct Listener {
+    int board;
+    uint16_t port;
+    std::deque<std::shared_ptr<Connection>> waiting;
+};
+
+std::vector<Listener> listeners;
+std::vector<std::shared_ptr<Connection>> incomingConnections;
+
+Listener *listenerOf(int board, uint16_t port) {
+    for (Listener &listener : listeners) {
+        if (listener.board == board && listener.port == port) {
+            return &listener;
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+int connectToBoard(int board, uint16_t port, const std::string &request) {
+    HostAllocations host;
+    Listener *listener = listenerOf(board, port);
+    if (listener == nullptr || !World::instance().linkUp(board)) {
+        return -1;
+    }
+    auto connection = std::make_shared<Connection>();
+    connection->board = board;
+    connection->open = true;
+    connection->incoming = true;
+    connection->in = request;
+    connection->readyUs = Scheduler::instance().now();
+    connection->lastUs = connection->readyUs;
+    listener->waiting.push_back(connection);
+    incomingConnections.push_back(connection);
+    return (int)incomingConnections.size() - 1;
+}
+
+std::string replyFromBoard(int id) {
+    return id >= 0 && id < (int)incomingConnections.size() ? incomingConnections[id]->out : std::string();
+}
+
+namespace {
+
+int boardIndex() {
+    return Scheduler::instance().currentBoard() == BOARD_CAM ? BOARD_CAM : BOARD_S3;
+}
+
+Micros transferUs(size_t bytes, double kBps) {
+    return (Micros)(bytes / (kBps * 1024.0) * 1e6);
+}
+
+bool isIpLiteral(const char *host) {
+    for (const char *p = host; *p; p++) {
+        if (!std::isdigit((unsigned char)*p) && *p != '.') {
+            return false;
+        }
+    }
+    return *host != 0;
+}
+
+const char *reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 408: return "Request Timeout";
+        case 500: return "Internal Server Error";
+        default: return "Unknown";
+    }
+}
+
+/* dispatchRequests()
+- Hands every complete HTTP request written so far to the stand-in server
+- Queues the serialized reply, readable once it has travelled back to the board
+*/
+void dispatchRequests(Connection &connection) {
+    World &world = World::instance();
+    for (;;) {
+        size_t headerEnd = connection.out.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            return;
+        }
+        HttpRequest request;
+        request.board = connection.board;
+        size_t lineEnd = connection.out.find("\r\n");
+        std::string requestLine = connection.out.substr(0, lineEnd);
+        size_t space1 = requestLine.find(' ');
+        size_t space2 = requestLine.find(' ', space1 + 1);
+        request.method = requestLine.substr(0, space1);
+        request.path = Server::pathOf(requestLine.substr(space1 + 1, space2 - space1 - 1), &request.query);
+
+        size_t contentLength = 0;
+        size_t at = lineEnd + 2;
+        while (at < headerEnd) {
+            size_t next = connection.out.find("\r\n", at);
+            std::string line = connection.out.substr(at, next - at);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                std::string name = line.substr(0, colon);
+                for (char &ch : name) {
+                    ch = (char)std::tolower((unsigned char)ch);
+                }
+                std::string value = line.substr(colon + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                if (!request.headers.count(name)) {
+                    request.headers[name] = value;
+                }
+                if (name == "content-length") {
+                    contentLength = std::strtoul(value.c_str(), nullptr, 10);
+                }
+            }
+            at = next + 2;
+        }
+        size_t bodyStart = headerEnd + 4;
+        if (connection.out.size() < bodyStart + contentLength) {
+            return;
+        }
+        request.body = connection.out.substr(bodyStart, contentLength);
+        connection.out.erase(0, bodyStart + contentLength);
+
+        HttpResponse response = Server::instance().handle(request);
+        std::string reply = "HTTP/1.1 " + std::to_string(response.code) + " " + reasonPhrase(response.code) +
+                            "\r\nContent-Type: " + response.contentType +
+                            "\r\nContent-Length: " + std::to_string(response.body.size()) +
+                            "\r\nConnection: keep-alive\r\n\r\n" + response.body;
+        const NetworkProfile &net = world.net(connection.board);
+        Micros ready = response.readyUs + ms(net.rttMs) + transferUs(reply.size(), net.downlinkKBps);
+        if (connection.inPos >= connection.in.size()) {
+            connection.in.clear();
+            connection.inPos = 0;
+        }
+        connection.in += reply;
+        connection.readyUs = std::max(connection.readyUs, ready);
+        world.bytesDown[connection.board] += reply.size();
+    }
+}
+
+}  // namespace
+}  // namespace sim
+
+using sim::Connection;
+
+/* IPAddress */
+bool IPAddress::fromString(const char *text) {
+    unsigned int a, b, c, d;
+    if (std::sscanf(text, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) {
+        return false;
+    }
+    *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+    return true;
+}
+
+String IPAddress::toString() const {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+}
+
+/* WiFi */
+WiFiClass WiFi;
+
+namespace {
+
+struct EventHandler {
+    WiFiEventFuncCb callback;
+    arduino_event_id_t event;
+};
+
+std::vector<EventHandler> eventHandlers[2];
+IPAddress staticIPs[2];
+uint8_t bssids[2][6];
+
+IPAddress dhcpAddress(int board) {
+    return IPAddress(192, 168, 1, board == sim::BOARD_CAM ? 50 : 51);
+}
+
+// dispatch() function, to hand a link change of sim::World to the callbacks registered with onEvent()
+void dispatch(int board, bool up, int reason) {
+    arduino_event_info_t info;
+    std::memset(&info, 0, sizeof(info));
+    arduino_event_id_t event;
+    if (up) {
+        event = ARDUINO_EVENT_WIFI_STA_GOT_IP;
+        info.got_ip.ip_info.ip.addr = staticIPs[board] != IPAddress() ? staticIPs[board] : dhcpAddress(board);
+        info.got_ip.ip_info.netmask.addr = IPAddress(255, 255, 255, 0);
+        info.got_ip.ip_info.gw.addr = IPAddress(192, 168, 1, 1);
+    } else {
+        event = ARDUINO_EVENT_WIFI_STA_DISCONNECTED;
+        info.wifi_sta_disconnected.reason = (uint8_t)reason;
+        std::memcpy(info.wifi_sta_disconnected.bssid, World::AP_BSSID, 6);
+    }
+    std::vector<EventHandler> handlers = eventHandlers[board];   // a callback may register another one
+    for (const EventHandler &handler : handlers) {
+        if (handler.event == ARDUINO_EVENT_MAX || handler.event == event) {
+            handler.callback(event, info);
+        }
+    }
+}
+
+}  // namespace
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel, const uint8_t *bssid,
+                             bool connect) {
+    (void)ssid;
+    (void)passphrase;
+    int board = sim::boardIndex();
+    if (connect) {
+        World::instance().onWiFiBegin(board, channel, bssid, staticIPs[board] != IPAddress());
+    }
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress localIP, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+    (void)gateway;
+    (void)subnet;
+    (void)dns1;
+    (void)dns2;
+    staticIPs[sim::boardIndex()] = localIP;   // 0.0.0.0 turns DHCP back on
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    return World::instance().linkUp(sim::boardIndex()) ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool WiFiClass::disconnect(bool) {
+    World::instance().onWiFiDisconnect(sim::boardIndex());
+    return true;
+}
+
+bool WiFiClass::reconnect() { return true; }
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect) {
+    World::instance().setAutoReconnect(sim::boardIndex(), autoReconnect);
+    return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+    int board = sim::boardIndex();
+    sim::HostAllocations host;
+    if (eventHandlers[board].empty()) {
+        World::instance().setLinkHandler(board, [board](bool up, int reason) { dispatch(board, up, reason); });
+    }
+    eventHandlers[board].push_back({std::move(callback), event});
+    return eventHandlers[board].size();
+}
+
+IPAddress WiFiClass::localIP() {
+    if (status() != WL_CONNECTED) {
+        return IPAddress();
+    }
+    int board = sim::boardIndex();
+    return staticIPs[board] != IPAddress() ? staticIPs[board] : dhcpAddress(board);
+}
+
+IPAddress WiFiClass::gatewayIP() {
+    return status() == WL_CONNECTED ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t) {
+    return status() == WL_CONNECTED ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+
+uint8_t *WiFiClass::BSSID() {
+    int board = sim::boardIndex();
+    if (status() != WL_CONNECTED) {
+        return nullptr;
+    }
+    std::memcpy(bssids[board], World::AP_BSSID, 6);
+    return bssids[board];
+}
+
+int32_t WiFiClass::channel() {
+    return status() == WL_CONNECTED ? World::AP_CHANNEL : 0;
+}
+
+String WiFiClass::macAddress() {
+    return sim::boardIndex() == sim::BOARD_CAM ? "24:6F:28:00:00:CA" : "34:85:18:00:00:53";
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &result) {
+    int board = sim::boardIndex();
+    if (sim::isIpLiteral(host)) {
+        return result.fromString(host) ? 1 : 0;
+    }
+    Scheduler::instance().sleepFor(sim::ms(World::instance().net(board).dnsMs));
+    World::instance().dnsLookups[board]++;
+    if (!World::instance().linkUp(board)) {
+        return 0;
+    }
+    result = IPAddress(10, 0, 0, 1);
+    return 1;
+}
+
+/* WiFiClient */
+WiFiClient::WiFiClient() {}
+
+WiFiClient::~WiFiClient() {}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) {
+        return 0;
+    }
+    return connect(address, port);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    (void)ip;
+    (void)port;
+    sim::HostAllocations host;
+    stop();
+    int board = sim::boardIndex();
+    World &world = World::instance();
+    if (!world.linkUp(board)) {
+        Scheduler::instance().sleepFor(sim::ms(3));
+        return 0;
+    }
+    Scheduler::instance().sleepFor(sim::ms(world.net(board).rttMs));
+    connection_ = std::make_shared<Connection>();
+    connection_->board = board;
+    connection_->open = true;
+    connection_->lastUs = Scheduler::instance().now();
+    world.connectionsOpened[board]++;
+    return 1;
+}
+
+size_t WiFiClient::write(uint8_t value) { return write(&value, 1); }
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+    if (!connected()) {
+        return 0;
+    }
+    World &world = World::instance();
+    if (!world.linkUp(connection_->board)) {
+        connection_->open = false;
+        return 0;
+    }
+    Scheduler::instance().sleepFor(sim::transferUs(size, world.net(connection_->board).uplinkKBps));
+    sim::HostAllocations host;
+    connection_->out.append((const char *)buffer, size);
+    connection_->lastUs = Scheduler::instance().now();
+    world.bytesUp[connection_->board] += size;
+    if (!connection_->incoming) {
+        sim::dispatchRequests(*connection_);
+    }
+    return size;
+}
+
+int WiFiClient::available() {
+    if (!connection_ || connection_->inPos >= connection_->in.size() ||
+        Scheduler::instance().now() < connection_->readyUs) {
+        return 0;
+    }
+    return (int)(connection_->in.size() - connection_->inPos);
+}
+
+int WiFiClient::read() {
+    if (available() <= 0) {
+        return -1;
+    }
+    return (uint8_t)connection_->in[connection_->inPos++];
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+    int count = std::min((int)size, available());
+    if (count <= 0) {
+        return -1;
+    }
+    std::memcpy(buffer, connection_->in.data() + connection_->inPos, count);
+    connection_->inPos += count;
+    return count;
+}
+
+int WiFiClient::peek() {
+    if (available() <= 0) {
+        return -1;
+    }
+    return (uint8_t)connection_->in[connection_->inPos];
+}
+
+uint8_t WiFiClient::connected() {
+    if (!connection_) {
+        return 0;
+    }
+    World &world = World::instance();
+    Micros now = Scheduler::instance().now();
+    if (connection_->open && !world.linkUp(connection_->board)) {
+        connection_->open = false;
+    }
+    Micros idleSince = std::max(connection_->lastUs, connection_->readyUs);
+    if (connection_->open && connection_->inPos >= connection_->in.size() &&
+        now > idleSince + sim::ms(world.net(connection_->board).idleCloseMs)) {
+        connection_->open = false;   // server closed the idle keep-alive connection
+    }
+    return connection_->open || available() > 0;
+}
+
+void WiFiClient::stop() {
+    if (connection_) {
+        connection_->open = false;
+        connection_.reset();
+    }
+}
+
+sim::Micros WiFiClient::replyReadyUs() const {
+    return connection_ ? connection_->readyUs : 0;
+}
+
+/* WiFiServer */
+void WiFiServer::begin(uint16_t port) {
+    sim::HostAllocations host;
+    if (port != 0) {
+        port_ = port;
+    }
+    board_ = sim::boardIndex();
+    if (sim::listenerOf(board_, port_) == nullptr) {
+        sim::listeners.push_back({board_, port_, {}});
+    }
+}
+
+WiFiClient WiFiServer::available() {
+    sim::Listener *listener = board_ < 0 ? nullptr : sim::listenerOf(board_, port_);
+    if (listener == nullptr || listener->waiting.empty()) {
+        return WiFiClient();
+    }
+    sim::HostAllocations host;
+    std::shared_ptr<Connection> connection = listener->waiting.front();
+    listener->waiting.pop_front();
+    return WiFiClient(connection);
+}
+
+bool WiFiServer::hasClient() {
+    sim::Listener *listener = board_ < 0 ? nullptr : sim::listenerOf(board_, port_);
+    return listener != nullptr && !listener->waiting.empty();
+}
+
+void WiFiServer::stop() {
+    sim::HostAllocations host;
+    for (size_t i = 0; i < sim::listeners.size(); i++) {
+        if (sim::listeners[i].board == board_ && sim::listeners[i].port == port_) {
+            sim::listeners.erase(sim::listeners.begin() + i);
+            break;
+        }
+    }
+    board_ = -1;
+}
+
+/* WiFiClientSecure */
+int WiFiClientSecure::connect(const char *host, uint16_t port) {
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) {
+        return 0;
+    }
+    return connect(address, port);
+}
+
+int WiFiClientSecure::connect(IPAddress ip, uint16_t port) {
+    if (!WiFiClient::connect(ip, port)) {
+        return 0;
+    }
+    const sim::NetworkProfile &net = World::instance().net(sim::boardIndex());
+    Scheduler::instance().sleepFor(sim::ms(2 * net.rttMs + net.tlsHandshakeMs));
+    return 1;
+}
+
+/* HTTPClient */
+HTTPClient::~HTTPClient() {
+    if (ownClient_) {
+        ownClient_->stop();
+    }
+}
+
+bool HTTPClient::parseUrl(const String &url) {
+    String rest = url;
+    port_ = 80;
+    int scheme = rest.indexOf("://");
+    if (scheme >= 0) {
+        if (rest.substring(0, scheme) == "https") {
+            port_ = 443;
+        }
+        rest = rest.substring(scheme + 3);
+    }
+    int slash = rest.indexOf('/');
+    String hostPort = slash < 0 ? rest : rest.substring(0, slash);
+    uri_ = slash < 0 ? String("/") : rest.substring(slash);
+    int colon = hostPort.indexOf(':');
+    if (colon >= 0) {
+        port_ = (uint16_t)hostPort.substring(colon + 1).toInt();
+        hostPort = hostPort.substring(0, colon);
+    }
+    host_ = hostPort;
+    headers_.clear();
+    size_ = -1;
+    return host_.length() > 0;
+}
+
+bool HTTPClient::begin(const String &url) {
+    ownClient_.reset(new WiFiClient());
+    client_ = ownClient_.get();
+    return parseUrl(url);
+}
+
+bool HTTPClient::begin(WiFiClient &client, const String &url) {
+    ownClient_.reset();
+    client_ = &client;
+    return parseUrl(url);
+}
+
+bool HTTPClient::connected() {
+    return client_ != nullptr && client_->connected();
+}
+
+void HTTPClient::addHeader(const String &name, const String &value, bool first, bool replace) {
+    for (auto &header : headers_) {
+        if (header.first.equalsIgnoreCase(name)) {
+            if (replace) {
+                header.second = value;
+            }
+            return;
+        }
+    }
+    if (first) {
+        headers_.insert(headers_.begin(), {name, value});
+    } else {
+        headers_.push_back({name, value});
+    }
+}
+
+int HTTPClient::GET() { return sendRequest("GET"); }
+
+int HTTPClient::POST(uint8_t *payload, size_t size) { return sendRequest("POST", payload, size); }
+
+int HTTPClient::POST(const String &payload) { return sendRequest("POST", payload); }
+
+int HTTPClient::sendRequest(const char *type, const String &payload) {
+    return sendRequest(type, (const uint8_t *)payload.c_str(), payload.length());
+}
+
+int HTTPClient::sendRequest(const char *type, const uint8_t *payload, size_t size) {
+    if (client_ == nullptr) {
+        return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    if (!client_->connected() && !client_->connect(host_.c_str(), port_)) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    if (size > 0) {
+        addHeader("Content-Length", String((unsigned long)size));
+    }
+    String header = String(type) + " " + uri_ + " HTTP/1.1\r\nHost: " + host_;
+    if (port_ != 80 && port_ != 443) {
+        header += ":" + String((unsigned int)port_);
+    }
+    header += "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: ";
+    header += reuse_ ? "keep-alive" : "close";
+    header += "\r\n";
+    for (auto &entry : headers_) {
+        header += entry.first + ": " + entry.second + "\r\n";
+    }
+    header += "\r\n";
+    if (client_->write((const uint8_t *)header.c_str(), header.length()) != header.length()) {
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (size > 0 && client_->write(payload, size) != size) {
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    return readResponseHeader();
+}
+
+/* readResponseHeader()
+- Blocks (in virtual time) until the reply arrives or the read timeout expires
+- Consumes status line and headers, the body stays in the stream
+*/
+int HTTPClient::readResponseHeader() {
+    Scheduler &scheduler = Scheduler::instance();
+    Micros deadline = scheduler.now() + (Micros)timeoutMs_ * 1000;
+    while (client_->available() <= 0) {
+        if (!client_->connected()) {
+            return HTTPC_ERROR_CONNECTION_LOST;
+        }
+        Micros ready = client_->replyReadyUs();
+        if (ready > deadline) {
+            scheduler.sleepFor(deadline - scheduler.now());
+            client_->stop();
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        scheduler.sleepFor(ready > scheduler.now() ? ready - scheduler.now() : 1000);
+    }
+
+    String line;
+    size_ = -1;
+    returnCode_ = 0;
+    canReuse_ = reuse_;
+    bool statusLine = true;
+    while (client_->available() > 0) {
+        char ch = (char)client_->read();
+        if (ch == '\r') {
+            continue;
+        }
+        if (ch != '\n') {
+            line += ch;
+            continue;
+        }
+        if (line.length() == 0) {
+            break;
+        }
+        if (statusLine) {
+            returnCode_ = (int)line.substring(line.indexOf(' ') + 1).toInt();
+            statusLine = false;
+        } else {
+            int colon = line.indexOf(':');
+            String name = line.substring(0, colon);
+            String value = line.substring(colon + 1);
+            value.trim();
+            if (name.equalsIgnoreCase("Content-Length")) {
+                size_ = (int)value.toInt();
+            } else if (name.equalsIgnoreCase("Connection") && value.indexOf("close") >= 0) {
+                canReuse_ = false;
+            }
+        }
+        line = "";
+    }
+    return returnCode_ > 0 ? returnCode_ : HTTPC_ERROR_NO_HTTP_SERVER;
+}
+
+String HTTPClient::getString() {
+    if (client_ == nullptr || size_ <= 0) {
+        return String();
+    }
+    std::string body((size_t)size_, '\0');
+    int got = client_->read((uint8_t *)&body[0], body.size());
+    body.resize(got > 0 ? (size_t)got : 0);
+    size_ = 0;
+    return String(body);
+}
+
+void HTTPClient::end() {
+    if (client_ != nullptr) {
+        while (client_->available() > 0) {
+            client_->read();
+        }
+        if (ownClient_ || !(reuse_ && canReuse_)) {
+            client_->stop();
+        }
+    }
+    ownClient_.reset();
+    client_ = nullptr;
+    headers_.clear();
+    size_ = -1;
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+        case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+        case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+        case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+        case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+        case HTTPC_ERROR_NO_STREAM: return "no stream";
+        case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+        case HTTPC_ERROR_TOO_LESS_RAM: return "too less ram";
+        case HTTPC_ERROR_ENCODING: return "Transfer-Encoding not supported";
+        case HTTPC_ERROR_STREAM_WRITE: return "Stream write error";
+        case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+        default: return String();
+    }
+}
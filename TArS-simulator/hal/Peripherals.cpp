@@ -0,0 +1,74 @@
+#include "ESP32Servo.h"
+#include "LiquidCrystal_I2C.h"
+#include "Wire.h"
+#include "sim/World.h"
+
+using sim::Scheduler;
+using sim::World;
+
+TwoWire Wire;
+
+void Servo::write(int angle) {
+    angle_ = constrain(angle, 0, 180);
+    if (pin_ >= 0) {
+        World::instance().onServoWrite(Scheduler::instance().currentBoard(), pin_, angle_);
+    }
+}
+
+namespace {
+const int TRANSACTIONS_PER_BYTE = 6;
+const double TRANSACTION_US = 200;   // address + data byte at 100 kHz
+}  // namespace
+
+LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t, uint8_t cols, uint8_t rows)
+    : cols_(cols), rows_(rows), text_(rows, std::string(cols, ' ')) {}
+
+void LiquidCrystal_I2C::send(int bytes, double extraUs) {
+    transactions_ += (uint64_t)bytes * TRANSACTIONS_PER_BYTE;
+    Scheduler::instance().sleepFor((sim::Micros)(bytes * TRANSACTIONS_PER_BYTE * TRANSACTION_US + extraUs));
+}
+
+void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t rows, uint8_t) {
+    cols_ = cols;
+    rows_ = rows;
+    text_.assign(rows, std::string(cols, ' '));
+    send(8, 50000);   // power-on wait and 4-bit mode handshake
+}
+
+void LiquidCrystal_I2C::init() { begin(cols_, rows_); }
+
+void LiquidCrystal_I2C::clear() {
+    text_.assign(rows_, std::string(cols_, ' '));
+    col_ = 0;
+    row_ = 0;
+    send(1, 2000);
+}
+
+void LiquidCrystal_I2C::home() {
+    col_ = 0;
+    row_ = 0;
+    send(1, 2000);
+}
+
+void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row) {
+    col_ = col;
+    row_ = row < rows_ ? row : rows_ - 1;
+    send(1);
+}
+
+void LiquidCrystal_I2C::backlight() { send(1); }
+
+void LiquidCrystal_I2C::noBacklight() { send(1); }
+
+size_t LiquidCrystal_I2C::write(uint8_t value) {
+    if (col_ < cols_) {
+        text_[row_][col_] = (char)value;
+    }
+    col_++;
+    send(1);
+    return 1;
+}
+
+std::string LiquidCrystal_I2C::line(int row) const {
+    return row >= 0 && row < rows_ ? text_[row] : std::string();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+/* Preferences (host stand-in)
+- Key/value store in NVS, one set of namespaces per board, kept for the whole run (survives ESP.restart())
+- Every put is charged as a flash commit (see sim::Config::flashCommitMs)
+- Covers the part of the ESP32 Arduino API the firmware uses
+*/
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false);
+    void end();
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putBool(const char *key, bool value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putUChar(const char *key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putULong(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putFloat(const char *key, float value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putString(const char *key, const String &value) { return putBytes(key, value.c_str(), value.length()); }
+    size_t putBytes(const char *key, const void *value, size_t length);
+
+    bool getBool(const char *key, bool defaultValue = false) { return get(key, defaultValue); }
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    uint32_t getULong(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    float getFloat(const char *key, float defaultValue = NAN) { return get(key, defaultValue); }
+    String getString(const char *key, const String &defaultValue = String());
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t length);
+
+private:
+    template <typename T>
+    T get(const char *key, T defaultValue) {
+        T value;
+        return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+    std::map<std::string, std::vector<uint8_t>> *entries();
+
+    int board_ = -1;
+    std::string name_;
+    bool readOnly_ = false;
+};
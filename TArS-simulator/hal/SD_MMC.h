@@ -0,0 +1,24 @@
+#pragma once
+
+#include "FS.h"
+
+typedef enum {
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN,
+} sdcard_type_t;
+
+class SDMMCFS : public fs::FS {
+public:
+    bool begin(const char *mountpoint = "/sdcard", bool mode1bit = false, bool formatIfMountFailed = false,
+               int sdmmcFrequency = 20000, uint8_t maxOpenFiles = 5);
+    void end() { mounted_ = false; }
+    sdcard_type_t cardType() { return mounted_ ? CARD_SDHC : CARD_NONE; }
+    uint64_t cardSize() { return 8ULL * 1024 * 1024 * 1024; }
+    uint64_t totalBytes() { return cardSize(); }
+    uint64_t usedBytes() { return bytesStored(); }
+};
+
+extern SDMMCFS SD_MMC;
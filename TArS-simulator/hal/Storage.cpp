@@ -0,0 +1,383 @@
+#include "EEPROM.h"
+#include "FS.h"
+#include "Preferences.h"
+#include "SD_MMC.h"
+#include "sim/Heap.h"
+#include "sim/World.h"
+
+using sim::Scheduler;
+using sim::World;
+
+namespace fs {
+
+struct FileNode {
+    std::vector<uint8_t> data;
+};
+
+namespace {
+
+void charge(double msValue) {
+    Scheduler::instance().sleepFor(sim::ms(msValue));
+}
+
+void chargeTransfer(size_t bytes, double kBps) {
+    Scheduler::instance().sleepFor((sim::Micros)(bytes / (kBps * 1024.0) * 1e6));
+}
+
+std::string parentOf(const std::string &path) {
+    size_t slash = path.rfind('/');
+    return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+}
+
+}  // namespace
+
+File::File(std::shared_ptr<FileNode> node, const std::string &path, bool writable, bool directory, FS *owner)
+    : node_(std::move(node)), path_(path), writable_(writable), directory_(directory), owner_(owner) {}
+
+size_t File::write(uint8_t value) { return write(&value, 1); }
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+    sim::HostAllocations host;  // card contents live in host memory
+    if (!node_ || !writable_) {
+        return 0;
+    }
+    chargeTransfer(size, World::instance().config.sdWriteKBps);
+    if (node_->data.size() < pos_ + size) {
+        node_->data.resize(pos_ + size);
+    }
+    std::memcpy(node_->data.data() + pos_, buffer, size);
+    pos_ += size;
+    World::instance().sdBytesWritten += size;
+    return size;
+}
+
+int File::available() {
+    return node_ && pos_ < node_->data.size() ? (int)(node_->data.size() - pos_) : 0;
+}
+
+int File::read() {
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+    size_t count = std::min(size, (size_t)available());
+    if (count == 0) {
+        return 0;
+    }
+    chargeTransfer(count, World::instance().config.sdReadKBps);
+    std::memcpy(buffer, node_->data.data() + pos_, count);
+    pos_ += count;
+    World::instance().sdBytesRead += count;
+    return count;
+}
+
+int File::peek() {
+    return available() > 0 ? node_->data[pos_] : -1;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!node_) {
+        return false;
+    }
+    size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? pos_ : node_->data.size());
+    pos_ = base + pos;
+    return true;
+}
+
+size_t File::size() const { return node_ ? node_->data.size() : 0; }
+
+void File::close() {
+    if (node_ || directory_) {
+        charge(World::instance().config.sdCloseMs);
+    }
+    node_.reset();
+    directory_ = false;
+}
+
+const char *File::name() const {
+    size_t slash = path_.rfind('/');
+    return slash == std::string::npos ? path_.c_str() : path_.c_str() + slash + 1;
+}
+
+File File::openNextFile(const char *mode) {
+    sim::HostAllocations host;  // card contents live in host memory
+    if (!directory_ || owner_ == nullptr) {
+        return File();
+    }
+    std::string next = owner_->nextEntry(path_, lastListed_);
+    if (next.empty()) {
+        return File();
+    }
+    lastListed_ = next;
+    return owner_->open(next.c_str(), mode);
+}
+
+// chargeSearch() function, to charge the search of path in its folder, entry by entry
+void FS::chargeSearch(const std::string &path) {
+    auto folder = entries_.find(parentOf(path));
+    if (folder != entries_.end()) {
+        charge(World::instance().config.sdDirEntryMs * folder->second);
+    }
+}
+
+File FS::open(const char *path, const char *mode, bool create) {
+    sim::HostAllocations host;  // card contents live in host memory
+    const sim::Config &config = World::instance().config;
+    std::string key = path;
+    if (!mounted_) {
+        return File();
+    }
+    chargeSearch(key);
+    if (directories_.count(key) || key == "/") {
+        charge(config.sdOpenMs);
+        return File(nullptr, key, false, true, this);
+    }
+    auto found = files_.find(key);
+    bool writing = mode[0] == 'w' || mode[0] == 'a' || (mode[0] == 'r' && mode[1] == '+');
+    if (found == files_.end()) {
+        if (!writing && !create) {
+            charge(config.sdOpenMs);
+            return File();
+        }
+        charge(config.sdCreateMs);
+        found = files_.emplace(key, std::make_shared<FileNode>()).first;
+        entries_[parentOf(key)]++;
+        World::instance().sdFilesCreated++;
+    } else {
+        charge(config.sdOpenMs);
+        if (mode[0] == 'w') {
+            found->second->data.clear();
+        }
+    }
+    File file(found->second, key, writing, false, this);
+    if (mode[0] == 'a') {
+        file.seek(0, SeekEnd);
+    }
+    return file;
+}
+
+bool FS::exists(const char *path) {
+    charge(World::instance().config.sdOpenMs);
+    chargeSearch(path);
+    return files_.count(path) > 0 || directories_.count(path) > 0;
+}
+
+bool FS::remove(const char *path) {
+    sim::HostAllocations host;  // card contents live in host memory
+    charge(World::instance().config.sdCreateMs);
+    chargeSearch(path);
+    if (files_.erase(path) == 0) {
+        return false;
+    }
+    entries_[parentOf(path)]--;
+    return true;
+}
+
+bool FS::rename(const char *from, const char *to) {
+    sim::HostAllocations host;  // card contents live in host memory
+    charge(World::instance().config.sdCreateMs);
+    auto found = files_.find(from);
+    if (found == files_.end() || found->first == to) {
+        return found != files_.end();
+    }
+    chargeSearch(to);
+    if (files_.count(to) == 0) {
+        entries_[parentOf(to)]++;
+    }
+    entries_[parentOf(from)]--;
+    files_[to] = found->second;
+    files_.erase(found);
+    return true;
+}
+
+bool FS::mkdir(const char *path) {
+    sim::HostAllocations host;  // card contents live in host memory
+    charge(World::instance().config.sdCreateMs);
+    directories_[path] = true;
+    return true;
+}
+
+size_t FS::fileCount() const { return files_.size(); }
+
+uint64_t FS::bytesStored() const {
+    uint64_t total = 0;
+    for (const auto &entry : files_) {
+        total += entry.second->data.size();
+    }
+    return total;
+}
+
+std::string FS::nextEntry(const std::string &directory, const std::string &after) const {
+    for (auto it = files_.upper_bound(after); it != files_.end(); ++it) {
+        if (parentOf(it->first) == directory) {
+            return it->first;
+        }
+    }
+    return std::string();
+}
+
+}  // namespace fs
+
+SDMMCFS SD_MMC;
+
+bool SDMMCFS::begin(const char *, bool, bool, int, uint8_t) {
+    Scheduler::instance().sleepFor(sim::ms(120));   // card init + FAT mount
+    mounted_ = true;
+    return true;
+}
+
+EEPROMClass EEPROM;
+
+bool EEPROMClass::begin(size_t size) {
+    data_.assign(size, 0);
+    return true;
+}
+
+uint8_t EEPROMClass::read(int address) {
+    return address >= 0 && address < (int)data_.size() ? data_[address] : 0;
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+    if (address >= 0 && address < (int)data_.size()) {
+        data_[address] = value;
+    }
+}
+
+bool EEPROMClass::commit() {
+    Scheduler::instance().sleepFor(sim::ms(World::instance().config.flashCommitMs));
+    World::instance().flashCommits++;
+    return true;
+}
+
+namespace {
+std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs[2];   // per board: namespace -> key -> value
+}  // namespace
+
+std::map<std::string, std::vector<uint8_t>> *Preferences::entries() {
+    return board_ < 0 ? nullptr : &nvs[board_][name_];
+}
+
+bool Preferences::begin(const char *name, bool readOnly) {
+    sim::HostAllocations host;
+    board_ = Scheduler::instance().currentBoard() == sim::BOARD_CAM ? sim::BOARD_CAM : sim::BOARD_S3;
+    name_ = name;
+    readOnly_ = readOnly;
+    return true;
+}
+
+void Preferences::end() { board_ = -1; }
+
+bool Preferences::clear() {
+    sim::HostAllocations host;
+    if (board_ < 0 || readOnly_) {
+        return false;
+    }
+    entries()->clear();
+    Scheduler::instance().sleepFor(sim::ms(World::instance().config.flashCommitMs));
+    World::instance().flashCommits++;
+    return true;
+}
+
+bool Preferences::remove(const char *key) {
+    sim::HostAllocations host;
+    return board_ >= 0 && !readOnly_ && entries()->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+    sim::HostAllocations host;
+    return board_ >= 0 && entries()->count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length) {
+    sim::HostAllocations host;
+    if (board_ < 0 || readOnly_) {
+        return 0;
+    }
+    const uint8_t *bytes = (const uint8_t *)value;
+    (*entries())[key].assign(bytes, bytes + length);
+    Scheduler::instance().sleepFor(sim::ms(World::instance().config.flashCommitMs));
+    World::instance().flashCommits++;
+    return length;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+    sim::HostAllocations host;
+    if (board_ < 0) {
+        return 0;
+    }
+    auto entry = entries()->find(key);
+    return entry == entries()->end() ? 0 : entry->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t length) {
+    sim::HostAllocations host;
+    size_t stored = getBytesLength(key);
+    if (stored == 0 || stored > length) {
+        return 0;
+    }
+    std::memcpy(buffer, (*entries())[key].data(), stored);
+    return stored;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+    sim::HostAllocations host;
+    size_t stored = getBytesLength(key);
+    if (stored == 0) {
+        return defaultValue;
+    }
+    const std::vector<uint8_t> &value = (*entries())[key];
+    return String(std::string(value.begin(), value.end()));
+}
+
+namespace sim {
+
+/* NVS file (--nvs)
+- One line per key: board (0 = cam, 1 = s3), namespace, key and the value in hex ("-" if empty), separated by spaces
+- Loaded before the run and saved after it, so the next run boots like a unit that has run before
+*/
+bool loadNvs(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;   // first run, nothing stored yet
+    }
+    int board = 0;
+    char name[64];
+    char key[64];
+    char hex[1024];
+    while (std::fscanf(file, "%d %63s %63s %1023s", &board, name, key, hex) == 4) {
+        if (board != BOARD_CAM && board != BOARD_S3) {
+            continue;
+        }
+        std::vector<uint8_t> &value = nvs[board][name][key];
+        value.clear();
+        for (size_t i = 0; hex[0] != '-' && hex[i] != '\0' && hex[i + 1] != '\0'; i += 2) {
+            unsigned int byte = 0;
+            std::sscanf(hex + i, "%2x", &byte);
+            value.push_back((uint8_t)byte);
+        }
+    }
+    std::fclose(file);
+    return true;
+}
+
+bool saveNvs(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    for (int board : {BOARD_CAM, BOARD_S3}) {
+        for (const auto &space : nvs[board]) {
+            for (const auto &entry : space.second) {
+                std::fprintf(file, "%d %s %s ", board, space.first.c_str(), entry.first.c_str());
+                for (uint8_t byte : entry.second) {
+                    std::fprintf(file, "%02x", byte);
+                }
+                std::fprintf(file, entry.second.empty() ? "-\n" : "\n");
+            }
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+}  // namespace sim
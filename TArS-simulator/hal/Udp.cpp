@@ -0,0 +1,155 @@
+#include <map>
+#include <random>
+#include <utility>
+
+#include "WiFi.h"
+#include "WiFiUdp.h"
+#include "sim/Heap.h"
+#include "sim/World.h"
+
+using sim::Scheduler;
+using sim::World;
+
+namespace {
+
+// Never destroyed: the firmware's WiFiUDP globals unbind themselves during static destruction
+std::map<std::pair<int, uint16_t>, WiFiUDP *> &sockets = *new std::map<std::pair<int, uint16_t>, WiFiUDP *>();
+uint16_t nextEphemeralPort = 49152;
+
+int currentBoard() {
+    return Scheduler::instance().currentBoard() == sim::BOARD_CAM ? sim::BOARD_CAM : sim::BOARD_S3;
+}
+
+IPAddress boardAddress(int board) {
+    return IPAddress(192, 168, 1, board == sim::BOARD_CAM ? 50 : 51);
+}
+
+}  // namespace
+
+WiFiUDP::~WiFiUDP() {
+    sim::HostAllocations host;
+    stop();
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+    sim::HostAllocations host;
+    stop();
+    board_ = currentBoard();
+    port_ = port;
+    sockets[{board_, port_}] = this;
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if (board_ >= 0) {
+        auto bound = sockets.find({board_, port_});
+        if (bound != sockets.end() && bound->second == this) {
+            sockets.erase(bound);
+        }
+    }
+    board_ = -1;
+    received_.clear();
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    sim::HostAllocations host;
+    destination_ = ip;
+    destinationPort_ = port;
+    outgoing_.clear();
+    return 1;
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) {
+        return 0;
+    }
+    return beginPacket(address, port);
+}
+
+size_t WiFiUDP::write(uint8_t value) { return write(&value, 1); }
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+    sim::HostAllocations host;
+    outgoing_.append((const char *)buffer, size);
+    return size;
+}
+
+/* endPacket()
+- Sends the datagram: every board whose address matches (all others for broadcast)
+  gets it lanMs later, if both links are up at that moment and it is not lost on the air
+*/
+int WiFiUDP::endPacket() {
+    sim::HostAllocations host;
+    World &world = World::instance();
+    int from = currentBoard();
+    if (!world.linkUp(from)) {
+        return 0;
+    }
+    if (port_ == 0 || board_ < 0) {
+        board_ = from;
+        port_ = nextEphemeralPort++;
+        sockets[{board_, port_}] = this;
+    }
+    world.udpDatagrams[from]++;
+    std::uniform_real_distribution<double> chance(0, 1);
+    for (int to = sim::BOARD_CAM; to <= sim::BOARD_S3; to++) {
+        bool broadcast = destination_[3] == 255;
+        if (to == from || (!broadcast && destination_ != boardAddress(to))) {
+            continue;
+        }
+        if (chance(world.rng()) < world.net(from).lanLossRate) {
+            continue;
+        }
+        std::string data = outgoing_;
+        IPAddress source = boardAddress(from);
+        uint16_t sourcePort = port_;
+        uint16_t destinationPort = destinationPort_;
+        Scheduler::instance().at(Scheduler::instance().now() + sim::ms(world.net(from).lanMs), to,
+                                 [to, data, source, sourcePort, destinationPort]() {
+                                     auto bound = sockets.find({to, destinationPort});
+                                     if (bound != sockets.end() && World::instance().linkUp(to)) {
+                                         bound->second->deliver(data, source, sourcePort);
+                                     }
+                                 });
+    }
+    outgoing_.clear();
+    return 1;
+}
+
+void WiFiUDP::deliver(const std::string &data, IPAddress from, uint16_t fromPort) {
+    sim::HostAllocations host;
+    received_.push_back(Datagram{data, from, fromPort});
+}
+
+int WiFiUDP::parsePacket() {
+    sim::HostAllocations host;
+    if (received_.empty()) {
+        current_.clear();
+        currentPos_ = 0;
+        return 0;
+    }
+    current_ = received_.front().data;
+    remoteIP_ = received_.front().from;
+    remotePort_ = received_.front().fromPort;
+    currentPos_ = 0;
+    received_.pop_front();
+    return (int)current_.size();
+}
+
+int WiFiUDP::available() { return (int)(current_.size() - currentPos_); }
+
+int WiFiUDP::read() {
+    return currentPos_ < current_.size() ? (uint8_t)current_[currentPos_++] : -1;
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t size) {
+    size_t count = std::min(size, current_.size() - currentPos_);
+    std::memcpy(buffer, current_.data() + currentPos_, count);
+    currentPos_ += count;
+    return (int)count;
+}
+
+int WiFiUDP::peek() {
+    return currentPos_ < current_.size() ? (uint8_t)current_[currentPos_] : -1;
+}
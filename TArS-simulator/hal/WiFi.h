@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+#include "WiFiUdp.h"
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_SCAN_DONE,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+    ARDUINO_EVENT_MAX,
+} arduino_event_id_t;
+
+#define WIFI_REASON_ASSOC_LEAVE 8
+#define WIFI_REASON_BEACON_TIMEOUT 200
+#define WIFI_REASON_NO_AP_FOUND 201
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+typedef struct {
+    esp_netif_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef union {
+    wifi_event_sta_disconnected_t wifi_sta_disconnected;
+    ip_event_got_ip_t got_ip;
+} arduino_event_info_t;
+
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+typedef size_t wifi_event_id_t;
+
+/* WiFi (host stand-in)
+- The link of each board follows sim::World, see its Wi-Fi link model: begin() starts a connection attempt
+  that takes a full scan, or the probe of one channel if begin() is given the channel and BSSID,
+  then association and DHCP, no DHCP after config() with a static IP
+- Outages drop the link, the driver reconnects on its own unless setAutoReconnect(false)
+- onEvent(): ARDUINO_EVENT_WIFI_STA_GOT_IP once connected, ARDUINO_EVENT_WIFI_STA_DISCONNECTED when an attempt
+  fails or the link drops, called from a timed event like the event task of the ESP32 Arduino core,
+  the callback must not block
+- disconnect() drops the link without an event
+*/
+class WiFiClass {
+public:
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t *bssid = nullptr, bool connect = true);
+    bool config(IPAddress localIP, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(),
+                IPAddress dns2 = IPAddress());
+    wl_status_t status();
+    bool isConnected() { return status() == WL_CONNECTED; }
+    bool disconnect(bool wifiOff = false);
+    bool reconnect();
+    bool mode(wifi_mode_t) { return true; }
+    void persistent(bool) {}
+    bool setAutoReconnect(bool autoReconnect);
+    bool setSleep(bool) { return true; }
+    wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress dnsIP(uint8_t dnsNumber = 0);
+    uint8_t *BSSID();
+    int32_t channel();
+    IPAddress broadcastIP() { return IPAddress(192, 168, 1, 255); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    int8_t RSSI() { return -55; }
+    String macAddress();
+    int hostByName(const char *host, IPAddress &result);
+};
+
+extern WiFiClass WiFi;
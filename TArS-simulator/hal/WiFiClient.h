@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+namespace sim {
+struct Connection;
+}
+
+/* WiFiClient (host stand-in)
+- A TCP connection to the in-process stand-in server
+- connect() pays DNS (for host names) plus one round trip
+- Bytes written are charged against the board's uplink; once a whole HTTP request
+  has been written it is handed to sim::Server and the reply becomes readable one
+  round trip (plus server time and downlink time) later
+- Copies share the same socket, like the real class
+*/
+class WiFiClient : public Stream {
+public:
+    WiFiClient();
+    ~WiFiClient() override;
+
+    virtual int connect(const char *host, uint16_t port);
+    virtual int connect(IPAddress ip, uint16_t port);
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buffer, size_t size);
+    int peek() override;
+    uint8_t connected();
+    void stop();
+    void setNoDelay(bool) {}
+    operator bool() { return connected(); }
+
+    // Virtual time at which the pending reply (if any) becomes readable
+    sim::Micros replyReadyUs() const;
+
+private:
+    friend class WiFiServer;
+    explicit WiFiClient(std::shared_ptr<sim::Connection> connection) : connection_(connection) {}
+
+    std::shared_ptr<sim::Connection> connection_;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+/* WiFiServer (host stand-in)
+- A TCP port the board listens on, for connections the simulator opens towards it
+  with sim::connectToBoard() (nothing else in the simulated LAN connects to a board)
+- begin() binds it to the board whose task calls it, available() hands out one waiting
+  connection per call, with the whole request already readable
+- Bytes the board writes back are charged against its uplink and kept for sim::replyFromBoard()
+*/
+class WiFiServer {
+public:
+    explicit WiFiServer(uint16_t port = 80, uint8_t maxClients = 4) : port_(port) { (void)maxClients; }
+
+    void begin(uint16_t port = 0);
+    WiFiClient available();
+    WiFiClient accept() { return available(); }
+    bool hasClient();
+    void stop();
+
+private:
+    uint16_t port_;
+    int board_ = -1;
+};
+
+namespace sim {
+
+// Open a connection to the WiFiServer of board on port and send request, returns its id (-1: refused)
+int connectToBoard(int board, uint16_t port, const std::string &request);
+
+// Everything the board wrote on connection id so far
+std::string replyFromBoard(int id);
+
+}  // namespace sim
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+/* WiFiUDP (host stand-in)
+- Datagrams between the simulated boards on the shared Wi-Fi LAN (192.168.1.0/24)
+- Delivered lanMs after endPacket() to the socket bound to the destination board and port,
+  the broadcast address reaches every other board
+- Dropped when either link is down, or at random with the configured LAN loss rate
+*/
+class WiFiUDP : public Stream {
+public:
+    WiFiUDP() {}
+    ~WiFiUDP() override;
+
+    uint8_t begin(uint16_t port);
+    uint8_t begin(IPAddress address, uint16_t port) { (void)address; return begin(port); }
+    void stop();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacket(const char *host, uint16_t port);
+    int endPacket();
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    int parsePacket();
+    int available() override;
+    int read() override;
+    int read(uint8_t *buffer, size_t size);
+    int read(char *buffer, size_t size) { return read((uint8_t *)buffer, size); }
+    int peek() override;
+    void flush() override {}
+    IPAddress remoteIP() const { return remoteIP_; }
+    uint16_t remotePort() const { return remotePort_; }
+
+    // Called by the simulated LAN when a datagram for this socket arrives
+    void deliver(const std::string &data, IPAddress from, uint16_t fromPort);
+
+private:
+    struct Datagram {
+        std::string data;
+        IPAddress from;
+        uint16_t fromPort;
+    };
+
+    int board_ = -1;
+    uint16_t port_ = 0;
+    std::deque<Datagram> received_;
+    std::string current_;
+    size_t currentPos_ = 0;
+    IPAddress remoteIP_;
+    uint16_t remotePort_ = 0;
+    std::string outgoing_;
+    IPAddress destination_;
+    uint16_t destinationPort_ = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Arduino.h"
+
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+        (void)sda;
+        (void)scl;
+        if (frequency) {
+            frequency_ = frequency;
+        }
+        return true;
+    }
+    bool setClock(uint32_t frequency) { frequency_ = frequency; return true; }
+    uint32_t getClock() const { return frequency_; }
+
+private:
+    uint32_t frequency_ = 100000;
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in: the firmware includes this header but uses none of its functions
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+/* FreeRTOS (host stand-in)
+- The subset of the ESP-IDF FreeRTOS API the firmware uses, on top of sim::Scheduler
+- One tick is one millisecond, like CONFIG_FREERTOS_HZ=1000 on the ESP32 Arduino core
+- Core affinity and priorities are accepted and ignored, tasks are already serialized
+*/
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define errQUEUE_FULL ((BaseType_t)0)
+#define errQUEUE_EMPTY ((BaseType_t)0)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+#define tskIDLE_PRIORITY ((UBaseType_t)0)
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+
+#define xSemaphoreTake(semaphore, ticks) xQueueReceive((semaphore), nullptr, (ticks))
+#define xSemaphoreGive(semaphore) xQueueSend((semaphore), nullptr, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSendFromISR((semaphore), nullptr, (woken))
+#define uxSemaphoreGetCount(semaphore) uxQueueMessagesWaiting(semaphore)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "esp_camera.h"
+
+/* img_converters.h (host stand-in)
+- jpg2rgb565(): "decodes" a frame of the camera stand-in, whatever its size, by rendering the item
+  encoded in it with sim::renderScene() at the size the real decoder would output
+- Output is RGB565 with the high byte first, like the esp32-camera decoder
+- Takes Config::jpegDecodeMs of virtual time
+*/
+typedef enum {
+    JPG_SCALE_NONE,
+    JPG_SCALE_2X,
+    JPG_SCALE_4X,
+    JPG_SCALE_8X,
+    JPG_SCALE_MAX = JPG_SCALE_8X,
+} jpg_scale_t;
+
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t *out, jpg_scale_t scale);
@@ -0,0 +1,89 @@
+#include "sim/Heap.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "sim/Scheduler.h"
+
+namespace sim {
+
+namespace {
+
+thread_local bool tlsHostAllocation = false;
+std::atomic<int64_t> inUse[2];
+std::atomic<int64_t> peak[2];
+std::atomic<int64_t> psram[2];
+
+// Prefix in front of every block, keeps the caller's pointer max-aligned
+struct alignas(std::max_align_t) BlockHeader {
+    size_t size;
+    int board;
+};
+
+void *allocate(size_t size) {
+    BlockHeader *header = (BlockHeader *)std::malloc(sizeof(BlockHeader) + size);
+    if (header == nullptr) {
+        throw std::bad_alloc();
+    }
+    int board = tlsHostAllocation ? BOARD_NONE : Scheduler::instance().currentBoard();
+    header->size = size;
+    header->board = board == BOARD_CAM || board == BOARD_S3 ? board : BOARD_NONE;
+    if (header->board != BOARD_NONE) {
+        int64_t used = inUse[header->board] += (int64_t)size;
+        int64_t seen = peak[header->board].load();
+        while (used > seen && !peak[header->board].compare_exchange_weak(seen, used)) {
+        }
+    }
+    return header + 1;
+}
+
+void release(void *pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+    BlockHeader *header = (BlockHeader *)pointer - 1;
+    if (header->board != BOARD_NONE) {
+        inUse[header->board] -= (int64_t)header->size;
+    }
+    std::free(header);
+}
+
+}  // namespace
+
+HostAllocations::HostAllocations() : saved_(tlsHostAllocation) { tlsHostAllocation = true; }
+
+HostAllocations::~HostAllocations() { tlsHostAllocation = saved_; }
+
+size_t heapInUse(int board) { return (size_t)inUse[board].load(); }
+
+size_t heapPeak(int board) { return (size_t)peak[board].load(); }
+
+void *psramAllocate(size_t size) {
+    int board = Scheduler::instance().currentBoard();
+    if (board == BOARD_CAM || board == BOARD_S3) {
+        psram[board] += (int64_t)size;
+    }
+    return std::malloc(size);
+}
+
+size_t psramInUse(int board) { return (size_t)psram[board].load(); }
+
+}  // namespace sim
+
+void *operator new(size_t size) { return sim::allocate(size); }
+void *operator new[](size_t size) { return sim::allocate(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return sim::allocate(size);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *pointer) noexcept { sim::release(pointer); }
+void operator delete[](void *pointer) noexcept { sim::release(pointer); }
+void operator delete(void *pointer, size_t) noexcept { sim::release(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { sim::release(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { sim::release(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { sim::release(pointer); }
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* sim heap accounting
+- Global operator new/delete are replaced so every allocation made by firmware code
+  is charged to the board whose task made it (ESP.getFreeHeap() reports it back)
+- Allocations made by the simulator itself (server, sockets, SD contents, camera
+  driver buffers, the scheduler) are wrapped in a HostAllocations scope and not charged
+- ps_malloc() is charged to the PSRAM of the board instead (psramInUse()), never given back,
+  firmware allocates it once at boot
+*/
+namespace sim {
+
+class HostAllocations {
+public:
+    HostAllocations();
+    ~HostAllocations();
+    HostAllocations(const HostAllocations &) = delete;
+    HostAllocations &operator=(const HostAllocations &) = delete;
+
+private:
+    bool saved_;
+};
+
+size_t heapInUse(int board);
+size_t heapPeak(int board);
+void *psramAllocate(size_t size);
+size_t psramInUse(int board);
+
+}  // namespace sim
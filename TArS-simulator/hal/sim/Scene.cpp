@@ -0,0 +1,124 @@
+#include "sim/Scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace sim {
+
+namespace {
+
+struct Look {
+    double r, g, b;
+    double mix;        // share of the item colour, the rest is background seen through it
+    double bands;      // strength of the highlight and shadow bands, 0 = matte
+    int bandPeriod;    // pixels between two highlights
+};
+
+Look lookOf(int itemClass, bool odd, std::mt19937 &rng) {
+    std::uniform_real_distribution<double> jitter(-20, 20);
+    Look look = {0, 0, 0, 1, 0, 4};
+    switch (odd ? (itemClass + 1 + rng() % 2) % 3 : itemClass) {
+        case 0: look = {175, 135, 90, 1.0, 0.0, 4}; break;
+        case 1: look = {145, 145, 145, 1.0, 0.8, 4}; break;
+        default: look = {110, 150, 195, 0.75, 0.3, 9}; break;
+    }
+    if (odd) {
+        // Looks like the class picked above, keeps a little of its own: white paper, painted can, brown bottle
+        look.bands = itemClass == 1 ? 0.5 : look.bands * 0.5;
+    }
+    look.r += jitter(rng);
+    look.g += jitter(rng);
+    look.b += jitter(rng);
+    return look;
+}
+
+uint16_t pack(double r, double g, double b) {
+    int ri = std::clamp((int)std::lround(r), 0, 255);
+    int gi = std::clamp((int)std::lround(g), 0, 255);
+    int bi = std::clamp((int)std::lround(b), 0, 255);
+    return (uint16_t)(((ri >> 3) << 11) | ((gi >> 2) << 5) | (bi >> 3));
+}
+
+struct Item {
+    Look look;
+    double centerX, centerY;
+    double radiusX, radiusY;
+    double bandPeriod, bandPhase;
+};
+
+// Look and place of the item in a width x height frame, drawn first from the item's own random numbers
+Item itemOf(int itemClass, double oddRate, int width, int height, std::mt19937 &rng) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    bool odd = itemClass >= 0 && unit(rng) < oddRate;
+    Item item;
+    item.look = itemClass >= 0 ? lookOf(itemClass, odd, rng) : Look{0, 0, 0, 0, 0, 4};
+    item.centerX = width * (0.5 + (unit(rng) - 0.5) * 0.2);
+    item.centerY = height * (0.5 + (unit(rng) - 0.5) * 0.2);
+    item.radiusX = width * (0.25 + unit(rng) * 0.1);
+    item.radiusY = height * (0.30 + unit(rng) * 0.1);
+    item.bandPeriod = std::max(2.0, item.look.bandPeriod * width / 30.0);
+    item.bandPhase = unit(rng) * item.bandPeriod;
+    return item;
+}
+
+}  // namespace
+
+void renderScene(int itemClass, int itemId, double oddRate, int width, int height, uint8_t *rgb565) {
+    std::mt19937 rng((uint32_t)itemId * 2654435761u + 12345u);
+    Item item = itemOf(itemClass, oddRate, width, height, rng);
+    const Look &look = item.look;
+    std::normal_distribution<double> noise(0, 4);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double r = 58 + noise(rng);
+            double g = 60 + noise(rng);
+            double b = 64 + noise(rng);
+            double dx = (x + 0.5 - item.centerX) / item.radiusX;
+            double dy = (y + 0.5 - item.centerY) / item.radiusY;
+            if (itemClass >= 0 && dx * dx + dy * dy <= 1) {
+                double shade = 1 + look.bands * 0.7 * std::cos(2 * M_PI * (x + item.bandPhase) / item.bandPeriod);
+                double grain = noise(rng) * 1.5;
+                r = r * (1 - look.mix) + (look.r * shade + grain) * look.mix;
+                g = g * (1 - look.mix) + (look.g * shade + grain) * look.mix;
+                b = b * (1 - look.mix) + (look.b * shade + grain) * look.mix;
+            }
+            uint16_t pixel = pack(r, g, b);
+            rgb565[2 * (y * width + x)] = (uint8_t)(pixel >> 8);
+            rgb565[2 * (y * width + x) + 1] = (uint8_t)(pixel & 0xFF);
+        }
+    }
+}
+
+void renderSceneGray(int itemClass, int itemId, double oddRate, double offset, uint32_t frame, int width, int height,
+                     uint8_t *gray) {
+    std::mt19937 rng((uint32_t)itemId * 2654435761u + 12345u);
+    Item item = itemOf(itemClass, oddRate, width, height, rng);
+    const Look &look = item.look;
+    double luma = (look.r * 77 + look.g * 150 + look.b * 29) / 256;
+    double centerY = item.centerY - offset * (item.centerY + item.radiusY);
+    uint32_t noise = frame * 2654435761u + 0x9E3779B9u;
+    std::vector<double> shade(width);
+    for (int x = 0; x < width; x++) {
+        shade[x] = luma * look.mix * (1 + look.bands * 0.7 * std::cos(2 * M_PI * (x + item.bandPhase) / item.bandPeriod));
+    }
+
+    for (int y = 0; y < height; y++) {
+        double dy = (y + 0.5 - centerY) / item.radiusY;
+        for (int x = 0; x < width; x++) {
+            noise ^= noise << 13;
+            noise ^= noise >> 17;
+            noise ^= noise << 5;
+            double value = 60 + (int)(noise & 7) - 3.5;
+            double dx = (x + 0.5 - item.centerX) / item.radiusX;
+            if (itemClass >= 0 && dx * dx + dy * dy <= 1) {
+                value = value * (1 - look.mix) + shade[x];
+            }
+            gray[y * width + x] = (uint8_t)std::clamp((int)std::lround(value), 0, 255);
+        }
+    }
+}
+
+}  // namespace sim
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+/* sim::renderScene
+- What the camera sees of an item in the chute, for the decoder stand-in (jpg2rgb565) and the edge benchmark
+- Dark chute background, the item as an ellipse in the middle
+    - paper: warm brown/beige, matte
+    - metal: grey, vertical highlight and shadow bands (the curved can reflects the lamp)
+    - plastic: bluish and see-through (mixed with the background), one highlight
+- Colour, size and position vary from item to item, seeded by itemId only, so a frame of the same item
+  always looks the same and nothing is drawn from the world's random numbers
+- A fraction oddRate of the items look like another class: white paper, painted cans, brown bottles
+- Pixels are RGB565 with the high byte first, as jpg2rgb565() writes them
+*/
+namespace sim {
+
+void renderScene(int itemClass, int itemId, double oddRate, int width, int height, uint8_t *rgb565);
+
+/* sim::renderSceneGray
+- The same item as renderScene() in 8-bit grayscale, as the camera streams it for the motion trigger
+- offset: how far the item still is from where it comes to rest, 1 = just entering the frame from the top,
+  0 = at rest, the item slides down into the chute
+- frame: seeds the sensor noise, a different number per frame so still frames are not identical
+*/
+void renderSceneGray(int itemClass, int itemId, double oddRate, double offset, uint32_t frame, int width, int height,
+                     uint8_t *gray);
+
+}  // namespace sim
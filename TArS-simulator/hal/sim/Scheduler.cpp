@@ -0,0 +1,180 @@
+#include "sim/Scheduler.h"
+
+#include <climits>
+
+#include "sim/Heap.h"
+
+namespace sim {
+
+namespace {
+thread_local int tlsTaskId = -1;
+thread_local int tlsTaskBoard = BOARD_NONE;
+thread_local const char *tlsTaskName = "host";
+thread_local int tlsEventBoard = INT_MIN;
+}  // namespace
+
+Scheduler &Scheduler::instance() {
+    static Scheduler scheduler;
+    return scheduler;
+}
+
+int Scheduler::spawn(int board, const std::string &name, std::function<void()> body) {
+    HostAllocations host;
+    std::unique_lock<std::mutex> lock(mutex_);
+    tasks_.emplace_back(new Task());
+    Task *task = tasks_.back().get();
+    task->id = (int)tasks_.size() - 1;
+    task->board = board;
+    task->name = name;
+    task->wake = now_;
+    task->body = std::move(body);
+    task->thread = std::thread([this, task]() {
+        tlsTaskId = task->id;
+        tlsTaskBoard = task->board;
+        tlsTaskName = task->name.c_str();
+        {
+            std::unique_lock<std::mutex> startLock(mutex_);
+            cv_.wait(startLock, [&]() { return running_ == task->id; });
+            if (stopping_) {
+                task->finished = true;
+                running_ = -1;
+                cv_.notify_all();
+                return;
+            }
+        }
+        try {
+            task->body();
+        } catch (const StopSimulation &) {
+        } catch (const TaskExit &) {
+        }
+        HostAllocations host;
+        std::unique_lock<std::mutex> endLock(mutex_);
+        task->finished = true;
+        if (stopping_) {
+            running_ = -1;
+            cv_.notify_all();
+        } else {
+            dispatch(endLock);
+        }
+    });
+    return task->id;
+}
+
+void Scheduler::at(Micros when, int board, std::function<void()> fn) {
+    HostAllocations host;
+    std::unique_lock<std::mutex> lock(mutex_);
+    events_.push(Event{when < now_ ? now_ : when, eventSeq_++, board, std::move(fn)});
+}
+
+int Scheduler::currentBoard() const {
+    return tlsEventBoard != INT_MIN ? tlsEventBoard : tlsTaskBoard;
+}
+
+int Scheduler::currentTask() const { return tlsTaskId; }
+
+const char *Scheduler::currentTaskName() const { return tlsTaskName; }
+
+void Scheduler::sleepFor(Micros us) {
+    sleepUntil(now_ + us);
+}
+
+void Scheduler::sleepUntil(Micros when) {
+    HostAllocations host;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+        throw StopSimulation{};
+    }
+    Task *self = tasks_[tlsTaskId].get();
+    self->wake = when < now_ ? now_ : when;
+    dispatch(lock);
+    waitForBaton(lock, self);
+}
+
+void Scheduler::wake(int task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (task >= 0 && task < (int)tasks_.size() && tasks_[task]->wake > now_) {
+        tasks_[task]->wake = now_;
+    }
+}
+
+void Scheduler::waitForBaton(std::unique_lock<std::mutex> &lock, Task *self) {
+    cv_.wait(lock, [&]() { return running_ == self->id; });
+    if (stopping_) {
+        throw StopSimulation{};
+    }
+}
+
+/* dispatch() function
+- Called by whoever holds the baton, with the mutex locked
+- Runs every timed event that is due before the next task wake-up
+- Hands the baton to the earliest task, or back to the host thread once the end is reached
+*/
+void Scheduler::dispatch(std::unique_lock<std::mutex> &lock) {
+    for (;;) {
+        Task *next = nullptr;
+        for (auto &task : tasks_) {
+            if (!task->finished && (next == nullptr || task->wake < next->wake)) {
+                next = task.get();
+            }
+        }
+        if (!events_.empty() && (next == nullptr || events_.top().when <= next->wake)) {
+            if (events_.top().when > until_) {
+                break;
+            }
+            Event event = events_.top();
+            events_.pop();
+            if (event.when > now_) {
+                now_ = event.when;
+            }
+            int savedBoard = tlsEventBoard;
+            tlsEventBoard = event.board;
+            lock.unlock();
+            event.fn();
+            lock.lock();
+            tlsEventBoard = savedBoard;
+            continue;
+        }
+        if (next == nullptr || next->wake > until_) {
+            break;
+        }
+        if (next->wake > now_) {
+            now_ = next->wake;
+        }
+        if (running_ != next->id) {
+            switches_++;
+        }
+        running_ = next->id;
+        cv_.notify_all();
+        return;
+    }
+    now_ = until_;
+    stopping_ = true;
+    running_ = -1;
+    cv_.notify_all();
+}
+
+void Scheduler::run(Micros until) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    until_ = until;
+    stopping_ = false;
+    dispatch(lock);
+    cv_.wait(lock, [&]() { return stopping_ && running_ == -1; });
+
+    // Unwind the task threads one at a time so their destructors never overlap
+    for (auto &task : tasks_) {
+        if (task->finished) {
+            continue;
+        }
+        running_ = task->id;
+        cv_.notify_all();
+        cv_.wait(lock, [&]() { return running_ == -1; });
+    }
+    lock.unlock();
+    for (auto &task : tasks_) {
+        if (task->thread.joinable()) {
+            task->thread.join();
+        }
+    }
+}
+
+}  // namespace sim
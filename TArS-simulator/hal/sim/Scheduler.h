@@ -0,0 +1,101 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* sim::Scheduler
+- Virtual clock shared by every simulated board
+- Each firmware task (setup()/loop() pair, FreeRTOS task) runs on its own host thread,
+  but only one of them holds the "baton" at a time, so the run is deterministic
+- A task gives the baton away by sleeping (delay(), pulseIn(), network waits, ...)
+- The task (or timed event) with the earliest wake-up time runs next, virtual time
+  jumps straight to it, so minutes of firmware time pass in milliseconds of host time
+- Timed events model interrupts and the physical world, they run in between tasks
+*/
+namespace sim {
+
+using Micros = uint64_t;
+
+enum Board : int {
+    BOARD_NONE = -1,
+    BOARD_CAM = 0,
+    BOARD_S3 = 1,
+};
+
+// Thrown inside a task thread to unwind it once the simulation is over
+struct StopSimulation {};
+
+// Thrown by a task that deletes itself (vTaskDelete(NULL)), ends only that task
+struct TaskExit {};
+
+class Scheduler {
+public:
+    static Scheduler &instance();
+
+    // Register a task, it starts running at the current virtual time, returns its id
+    int spawn(int board, const std::string &name, std::function<void()> body);
+
+    // Schedule a callback (ISR, world event) at an absolute virtual time
+    void at(Micros when, int board, std::function<void()> fn);
+
+    // Called from a task: give the baton away for the given virtual duration
+    void sleepFor(Micros us);
+    void sleepUntil(Micros when);
+
+    // Bring a sleeping task's wake-up forward to now (semaphore given, queue filled, ...)
+    void wake(int task);
+
+    // Run all tasks until the virtual clock reaches the given time, then unwind them
+    void run(Micros until);
+
+    Micros now() const { return now_; }
+    int currentBoard() const;
+    int currentTask() const;
+    const char *currentTaskName() const;
+    uint64_t contextSwitches() const { return switches_; }
+
+private:
+    struct Task {
+        int id;
+        int board;
+        std::string name;
+        Micros wake = 0;
+        bool finished = false;
+        std::function<void()> body;
+        std::thread thread;
+    };
+    struct Event {
+        Micros when;
+        uint64_t seq;
+        int board;
+        std::function<void()> fn;
+        bool operator>(const Event &other) const {
+            return when != other.when ? when > other.when : seq > other.seq;
+        }
+    };
+
+    void dispatch(std::unique_lock<std::mutex> &lock);
+    void waitForBaton(std::unique_lock<std::mutex> &lock, Task *self);
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::unique_ptr<Task>> tasks_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t eventSeq_ = 0;
+    int running_ = -1;   // id of the task holding the baton, -1 means the host main thread
+    bool stopping_ = false;
+    Micros now_ = 0;
+    Micros until_ = 0;
+    uint64_t switches_ = 0;
+};
+
+inline Micros ms(double value) { return (Micros)(value * 1000.0); }
+
+}  // namespace sim
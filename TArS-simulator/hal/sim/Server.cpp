@@ -0,0 +1,288 @@
+#include "sim/Server.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "sim/World.h"
+
+namespace sim {
+
+const char *endpointName(Endpoint endpoint) {
+    switch (endpoint) {
+        case Endpoint::AddStatus: return "addStatus";
+        case Endpoint::GetStatus: return "getStatus";
+        case Endpoint::Predict: return "predict";
+        case Endpoint::GetPrediction: return "getPrediction";
+        case Endpoint::UpdateCapacity: return "updateCapacity";
+        default: return "unknown";
+    }
+}
+
+Server &Server::instance() {
+    static Server server;
+    return server;
+}
+
+std::string Server::pathOf(const std::string &url, std::string *query) {
+    std::string rest = url;
+    size_t scheme = rest.find("://");
+    if (scheme != std::string::npos) {
+        rest = rest.substr(scheme + 3);
+        size_t slash = rest.find('/');
+        rest = slash == std::string::npos ? "/" : rest.substr(slash);
+    }
+    size_t mark = rest.find('?');
+    if (query) {
+        *query = mark == std::string::npos ? "" : rest.substr(mark + 1);
+    }
+    return mark == std::string::npos ? rest : rest.substr(0, mark);
+}
+
+std::string Server::queryParam(const std::string &query, const std::string &name) {
+    size_t at = 0;
+    while (at < query.size()) {
+        size_t end = query.find('&', at);
+        std::string pair = query.substr(at, end == std::string::npos ? std::string::npos : end - at);
+        size_t equals = pair.find('=');
+        if (pair.substr(0, equals) == name) {
+            return equals == std::string::npos ? "" : pair.substr(equals + 1);
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        at = end + 1;
+    }
+    return "";
+}
+
+std::string Server::jsonString(const std::string &body, const std::string &name) {
+    size_t key = body.find("\"" + name + "\"");
+    if (key == std::string::npos) {
+        return "";
+    }
+    size_t open = body.find('"', body.find(':', key) + 1);
+    size_t close = open == std::string::npos ? open : body.find('"', open + 1);
+    return close == std::string::npos ? "" : body.substr(open + 1, close - open - 1);
+}
+
+std::string Server::formField(const std::string &body, const std::string &name) {
+    size_t field = body.find("name=\"" + name + "\"");
+    if (field == std::string::npos) {
+        return "";
+    }
+    size_t start = body.find("\r\n\r\n", field);
+    size_t end = start == std::string::npos ? start : body.find("\r\n", start + 4);
+    return end == std::string::npos ? "" : body.substr(start + 4, end - start - 4);
+}
+
+void Server::bind(const std::string &url, Endpoint endpoint) {
+    routes_[pathOf(url)] = endpoint;
+}
+
+HttpResponse Server::handle(const HttpRequest &request) {
+    World &world = World::instance();
+    auto route = routes_.find(request.path);
+    Endpoint endpoint = route == routes_.end() ? Endpoint::Unknown : route->second;
+    EndpointStats &stats = world.endpoints[endpointName(endpoint)];
+    stats.requests++;
+    stats.bytesIn += request.body.size();
+
+    if (endpoint == Endpoint::Predict) {
+        noteUpload(request);
+    }
+
+    HttpResponse response;
+    std::uniform_real_distribution<double> chance(0, 1);
+    if (world.config.errorRate > 0 && chance(world.rng()) < world.config.errorRate) {
+        response.code = 500;
+        response.body = "{\"error\":\"injected failure\"}";
+    } else {
+        switch (endpoint) {
+            case Endpoint::AddStatus: response = addStatus(request); break;
+            case Endpoint::GetStatus: response = getStatus(request); break;
+            case Endpoint::Predict: response = predict(request); break;
+            case Endpoint::GetPrediction: response = getPrediction(request); break;
+            case Endpoint::UpdateCapacity: response = updateCapacity(request); break;
+            default: response.body = "{\"error\":\"not found\"}"; break;
+        }
+    }
+    if (response.code >= 400) {
+        stats.errors++;
+    }
+    Micros now = Scheduler::instance().now();
+    if (response.readyUs < now) {
+        response.readyUs = now;
+    }
+    response.readyUs += ms(world.net(request.board).serverMs);
+    stats.bytesOut += response.body.size();
+    return response;
+}
+
+/* noteUpload()
+- Checks that an image replayed from the camera's SD card is sent as it was first sent,
+  before a failure is injected, so an upload the server never answered counts too
+- A replay is an upload without jpeg_quality, the camera does not keep the quality with the image
+- Its edge_class and capture_profile must match the first upload of its scan_id, if one
+  got through to the server (an image captured while Wi-Fi was down is only sent as a replay)
+*/
+void Server::noteUpload(const HttpRequest &request) {
+    std::string scanId = formField(request.body, "scan_id");
+    std::string sent = formField(request.body, "edge_class") + "/" + formField(request.body, "capture_profile");
+    if (formField(request.body, "jpeg_quality").empty()) {
+        replayedUploads++;
+        replayedEdgeResults += !formField(request.body, "edge_class").empty();
+        auto first = firstUpload_.find(scanId);
+        replayedChanged += first != firstUpload_.end() && first->second != sent;
+    }
+    if (!scanId.empty()) {
+        firstUpload_.emplace(scanId, sent);
+    }
+}
+
+HttpResponse Server::addStatus(const HttpRequest &request) {
+    HttpResponse response;
+    if (request.body.find("\"status\":true") == std::string::npos &&
+        request.body.find("\"status\": true") == std::string::npos) {
+        response.code = 400;
+        response.body = "{\"error\":\"invalid body\"}";
+        return response;
+    }
+    status = true;
+    pendingScanId = jsonString(request.body, "scan_id");
+    response.code = 201;
+    response.body = "{\"message\":\"status updated\"}";
+    return response;
+}
+
+HttpResponse Server::getStatus(const HttpRequest &) {
+    HttpResponse response;
+    response.code = 200;
+    if (!status) {
+        response.body = "{\"status\":false}";
+    } else if (pendingScanId.empty()) {
+        response.body = "{\"status\":true}";
+    } else {
+        response.body = "{\"status\":true,\"scan_id\":\"" + pendingScanId + "\"}";
+    }
+    return response;
+}
+
+/* predict endpoint
+- Accepts the multipart/form-data upload of the camera
+- The simulated camera embeds "TARS-ITEM:<class>:<item id>;" in every frame,
+  standing in for what the real model would recognise in the picture
+- Clears the status flag so the camera stops capturing
+*/
+HttpResponse Server::predict(const HttpRequest &request) {
+    HttpResponse response;
+    size_t marker = request.body.find("TARS-ITEM:");
+    if (request.body.find("Content-Type: image/jpeg") == std::string::npos || marker == std::string::npos) {
+        response.code = 400;
+        response.body = "{\"error\":\"no image\"}";
+        return response;
+    }
+    int itemClass = -1;
+    int itemId = 0;
+    std::sscanf(request.body.c_str() + marker, "TARS-ITEM:%d:%d;", &itemClass, &itemId);
+    status = false;
+    pendingScanId.clear();
+
+    Micros now = Scheduler::instance().now();
+    Prediction prediction;
+    scanCounter_++;
+    prediction.predictionId = "prediction-" + std::to_string(scanCounter_);
+    prediction.scanId = formField(request.body, "scan_id");
+    if (prediction.scanId.empty()) {
+        prediction.scanId = "scan-" + std::to_string(scanCounter_);
+    }
+    prediction.itemId = itemId;
+    std::string profile = formField(request.body, "capture_profile");
+    captureProfiles[profile.empty() ? "none" : profile]++;
+    int quality = std::atoi(formField(request.body, "jpeg_quality").c_str());
+    if (quality > 0) {
+        jpegQualityMin = jpegQualityMin == 0 ? quality : std::min(jpegQualityMin, quality);
+        jpegQualityMax = std::max(jpegQualityMax, quality);
+    }
+    std::string edgeClass = formField(request.body, "edge_class");
+    if (!edgeClass.empty()) {
+        edgeResults++;
+        edgeAgreed += itemClass >= 0 && itemClass < CLASS_COUNT && edgeClass == CLASS_LABELS[itemClass];
+    }
+    prediction.itemClass = itemClass;
+    prediction.readyUs = now + ms(World::instance().config.inferenceMs);
+    predictions.push_back(prediction);
+
+    response.code = 201;
+    response.body = "{\"message\":\"image received\",\"scan_id\":\"" + prediction.scanId + "\"}";
+    return response;
+}
+
+/* getPrediction endpoint
+- Without scan_id: the latest finished prediction, like the original server
+- With scan_id: 200 once that scan is classified, 202 while it is not, 404 for an unknown scan
+- With wait=<seconds>: a scan that is still being classified is held until its result
+  is ready or the wait expires (long-poll)
+*/
+HttpResponse Server::getPrediction(const HttpRequest &request) {
+    HttpResponse response;
+    Micros now = Scheduler::instance().now();
+    std::string scanId = queryParam(request.query, "scan_id");
+    Micros wait = ms(std::atof(queryParam(request.query, "wait").c_str()) * 1000);
+    const Prediction *latest = nullptr;
+    for (const Prediction &prediction : predictions) {
+        if (scanId.empty() ? prediction.readyUs <= now : prediction.scanId == scanId) {
+            latest = &prediction;
+        }
+    }
+    if (latest == nullptr) {
+        bool announced = !scanId.empty() && scanId == pendingScanId;
+        response.code = announced ? 202 : 404;
+        response.body = announced ? "{\"status\":\"waiting for image\"}" : "{\"error\":\"no prediction yet\"}";
+        return response;
+    }
+    if (latest->readyUs > now + wait) {
+        response.code = 202;
+        response.body = "{\"status\":\"processing\",\"scan_id\":\"" + latest->scanId + "\"}";
+        response.readyUs = now + wait;
+        return response;
+    }
+    response.readyUs = latest->readyUs;
+    const char *label = latest->itemClass >= 0 && latest->itemClass < CLASS_COUNT
+                            ? CLASS_LABELS[latest->itemClass] : "unknown";
+    char confidence[8];   // made up from the item id, so it draws nothing from the world's random numbers
+    std::snprintf(confidence, sizeof(confidence), "%.2f", 0.80 + (latest->itemId * 37 % 20) / 100.0);
+    response.code = 200;
+    response.body = "{\"prediction_id\":\"" + latest->predictionId + "\",\"scan_id\":\"" + latest->scanId +
+                    "\",\"timestamp\":\"" + std::to_string(latest->readyUs / 1000) +
+                    "\",\"detected_type\":\"" + label + "\",\"confidence\":" + confidence +
+                    ",\"image_url\":\"https://storage.example/scans/" + latest->scanId + ".jpg\"}";
+    return response;
+}
+
+HttpResponse Server::updateCapacity(const HttpRequest &request) {
+    HttpResponse response;
+    // One reading {"bin_id":...,"fullness_level_cm":...} or a batch {"readings":[{...}, ...]}
+    int readings = 0;
+    for (size_t at = request.body.find("\"bin_id\""); at != std::string::npos;
+         at = request.body.find("\"bin_id\"", at + 1)) {
+        std::string reading = request.body.substr(at, request.body.find('}', at) - at);
+        size_t level = reading.find("\"fullness_level_cm\"");
+        if (level != std::string::npos) {
+            reportedFullness[jsonString(reading, "bin_id")] = std::atoi(reading.c_str() + reading.find(':', level) + 1);
+        }
+        readings++;
+    }
+    if (readings == 0) {
+        response.code = 400;
+        response.body = "{\"error\":\"invalid body\"}";
+        return response;
+    }
+    capacityReadings += readings;
+    response.code = 201;
+    response.body = "{\"message\":\"capacity updated\"}";
+    return response;
+}
+
+}  // namespace sim
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sim/Scheduler.h"
+
+/* sim::Server
+- In-process stand-in for the TArS backend (https://github.com/mikhaelsiallagan/ml-tars)
+- Endpoints are bound to the URLs the firmware reads from serverCredentials.h,
+  requests are routed by path so scheme and host do not matter
+- Inference runs "in the background": an uploaded image becomes a prediction
+  inferenceMs later, which is exactly what the S3 has to wait for
+- Scan correlation: the trigger may carry a scan_id, the camera gets it back from the
+  status endpoint and sends it along with the image, the S3 asks for that scan_id only
+  (?scan_id=...), optionally long-polling (&wait=<seconds>) until the result is ready
+*/
+namespace sim {
+
+enum class Endpoint {
+    Unknown,
+    AddStatus,
+    GetStatus,
+    Predict,
+    GetPrediction,
+    UpdateCapacity,
+};
+
+const char *endpointName(Endpoint endpoint);
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::map<std::string, std::string> headers;   // lower-case names
+    std::string body;
+    int board = BOARD_NONE;
+};
+
+struct HttpResponse {
+    int code = 404;
+    std::string contentType = "application/json";
+    std::string body;
+    Micros readyUs = 0;   // earliest time the first response byte can leave the server
+};
+
+struct Prediction {
+    std::string predictionId;
+    std::string scanId;
+    int itemId;
+    int itemClass;
+    Micros readyUs;
+};
+
+class Server {
+public:
+    static Server &instance();
+
+    void bind(const std::string &url, Endpoint endpoint);
+    HttpResponse handle(const HttpRequest &request);
+
+    static std::string pathOf(const std::string &url, std::string *query = nullptr);
+    static std::string queryParam(const std::string &query, const std::string &name);
+    static std::string jsonString(const std::string &body, const std::string &name);
+    static std::string formField(const std::string &body, const std::string &name);
+
+    bool status = false;
+    std::string pendingScanId;   // scan_id carried by the last trigger, handed to the camera
+    std::vector<Prediction> predictions;
+    std::map<std::string, uint64_t> captureProfiles;   // uploads per capture_profile form field
+    int jpegQualityMin = 0;                             // range of the jpeg_quality form field
+    int jpegQualityMax = 0;
+    std::map<std::string, int> reportedFullness;        // last fullness_level_cm per bin_id
+    uint64_t capacityReadings = 0;                      // bin readings received, batched or not
+    uint64_t edgeResults = 0;                           // uploads carrying the edge_class form field
+    uint64_t edgeAgreed = 0;                            // of those, edge_class matches the item
+    uint64_t replayedUploads = 0;                       // images sent again from the camera's SD card (no jpeg_quality)
+    uint64_t replayedEdgeResults = 0;                   // of those, carrying the edge_class form field
+    uint64_t replayedChanged = 0;                       // of those, edge_class or capture_profile differs from
+                                                        // the first upload of the same scan_id
+
+private:
+    HttpResponse addStatus(const HttpRequest &request);
+    HttpResponse getStatus(const HttpRequest &request);
+    HttpResponse predict(const HttpRequest &request);
+    HttpResponse getPrediction(const HttpRequest &request);
+    HttpResponse updateCapacity(const HttpRequest &request);
+    void noteUpload(const HttpRequest &request);
+
+    std::map<std::string, Endpoint> routes_;
+    std::map<std::string, std::string> firstUpload_;   // edge_class and capture_profile per scan_id, as first sent
+    int scanCounter_ = 0;
+};
+
+}  // namespace sim
@@ -0,0 +1,421 @@
+#include "sim/World.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "sim/Heap.h"
+
+namespace sim {
+
+const char *const CLASS_LABELS[CLASS_COUNT] = {"paper", "metal", "plastic"};
+
+namespace {
+const int FALLING_EDGE = 2;   // same value as FALLING in the Arduino stand-in
+const double GATE_OPEN_DEG = 45;
+}  // namespace
+
+double ServoModel::angleAt(Micros t) const {
+    if (t <= startUs) {
+        return from;
+    }
+    double travelled = (t - startUs) / 1e6 * degPerSec;
+    double span = std::fabs(to - from);
+    if (travelled >= span) {
+        return to;
+    }
+    return from + (to > from ? travelled : -travelled);
+}
+
+Micros ServoModel::arrivalUs() const {
+    return startUs + (Micros)(std::fabs(to - from) / degPerSec * 1e6);
+}
+
+World &World::instance() {
+    static World world;
+    return world;
+}
+
+const NetworkProfile &World::net(int board) const {
+    return config.net[board == BOARD_CAM ? BOARD_CAM : BOARD_S3];
+}
+
+void World::start() {
+    rng_.seed(config.seed);
+    servos_[gatePin].from = servos_[gatePin].to = 0;   // gate rests closed, pipe rests at 90 deg
+    scheduleArrival(ms(config.firstArrivalMs));
+}
+
+/* User model
+- Saturated mode (arrivalMs == 0): a new user steps up as soon as the previous one leaves
+- Otherwise users arrive with exponential inter-arrival times and queue at the bin
+- The user at the front presses the button, waits for the gate and drops the item in
+- No gate after patienceMs: press again, give up after maxPresses
+- Auto trigger: the user puts the item in the chute instead, it slides for settleMs and is at rest when the
+  press would have come without reaching for the button (thinkMs - buttonMs), the button is only pressed
+  if the gate did not open patienceMs after that
+*/
+void World::scheduleArrival(Micros when) {
+    Scheduler::instance().at(when, BOARD_NONE, [this]() { userArrives(); });
+}
+
+void World::userArrives() {
+    std::uniform_int_distribution<int> pickClass(0, CLASS_COUNT - 1);
+    User user;
+    user.id = nextUserId_++;
+    user.itemClass = pickClass(rng_);
+    user.arrivedUs = Scheduler::instance().now();
+    queue_.push_back(user);
+    usersArrived++;
+    if (queue_.size() == 1) {
+        stepUp();
+    }
+    if (config.arrivalMs > 0) {
+        std::exponential_distribution<double> gap(1.0 / config.arrivalMs);
+        scheduleArrival(Scheduler::instance().now() + ms(gap(rng_)));
+    }
+}
+
+void World::stepUp() {
+    if (queue_.empty()) {
+        if (config.arrivalMs <= 0) {
+            scheduleArrival(Scheduler::instance().now());
+        }
+        return;
+    }
+    int userId = queue_.front().id;
+    if (config.autoTrigger) {
+        double placeMs = std::max(config.thinkMs - config.buttonMs - config.settleMs, 0.0);
+        Scheduler::instance().at(Scheduler::instance().now() + ms(placeMs), BOARD_NONE,
+                                 [this, userId]() { place(userId); });
+        return;
+    }
+    Scheduler::instance().at(Scheduler::instance().now() + ms(config.thinkMs), BOARD_NONE,
+                             [this, userId]() { press(userId, 1); });
+}
+
+void World::place(int userId) {
+    if (queue_.empty() || queue_.front().id != userId) {
+        return;
+    }
+    Micros now = Scheduler::instance().now();
+    User &user = queue_.front();
+    user.placedUs = now;
+    user.firstPressUs = now + ms(config.settleMs);
+    Scheduler::instance().at(user.firstPressUs + ms(config.patienceMs), BOARD_NONE,
+                             [this, userId]() { press(userId, 1); });
+}
+
+bool World::presenting(const User &user) const {
+    return user.presses > 0 || user.placedUs > 0;
+}
+
+void World::press(int userId, int pressNumber) {
+    if (queue_.empty() || queue_.front().id != userId) {
+        return;
+    }
+    User &user = queue_.front();
+    if (user.dropping || user.presses != pressNumber - 1) {
+        return;
+    }
+    if (pressNumber > config.maxPresses) {
+        usersGaveUp++;
+        leave();
+        return;
+    }
+    Micros now = Scheduler::instance().now();
+    user.presses = pressNumber;
+    user.lastPressUs = now;
+    if (pressNumber == 1 && user.placedUs == 0) {
+        user.firstPressUs = now;
+    }
+    if (buttonIsr_ && buttonMode_ == FALLING_EDGE) {
+        buttonIsr_();
+    }
+    Scheduler::instance().at(now + ms(config.patienceMs), BOARD_NONE,
+                             [this, userId, pressNumber]() { press(userId, pressNumber + 1); });
+}
+
+void World::leave() {
+    queue_.pop_front();
+    stepUp();
+}
+
+void World::onAttachInterrupt(int board, int pin, std::function<void()> isr, int mode) {
+    HostAllocations host;
+    if (board == BOARD_S3 && pin == buttonPin) {
+        buttonIsr_ = std::move(isr);
+        buttonMode_ = mode;
+    } else if (isr) {
+        pinIsrs_[{board, pin}] = std::move(isr);
+    } else {
+        pinIsrs_.erase({board, pin});
+    }
+}
+
+/* onDigitalWrite()
+- The falling edge of a 10 us pulse on a trigger pin fires that HC-SR04
+- 450 us later the echo pin goes high for the round trip time (38 ms without an echo), the
+  echo pin's ISR is called on both edges as with attachInterrupt(..., CHANGE) on the S3
+- A sensor that hears another one's burst (fired less than crosstalkMs ago) may read that echo
+*/
+void World::onDigitalWrite(int board, int pin, int level) {
+    HostAllocations host;
+    if (board != BOARD_S3 || level != 0) {
+        return;
+    }
+    for (const BinModel &bin : bins) {
+        if (bin.trigPin != pin) {
+            continue;
+        }
+        Micros now = Scheduler::instance().now();
+        bool crosstalk = lastPingPin_[board] >= 0 && lastPingPin_[board] != pin &&
+                         now - lastPingUs_[board] < ms(config.crosstalkMs);
+        lastPingUs_[board] = now;
+        lastPingPin_[board] = pin;
+        echoPings++;
+        double distance = sampleEchoCm(board, bin.echoPin, crosstalk);
+        Micros duration = distance < 0 ? 38000 : (Micros)(distance * 2 / 0.0343);
+        int echoPin = bin.echoPin;
+        for (int edge = 0; edge < 2; edge++) {
+            int echoLevel = edge == 0 ? 1 : 0;
+            Scheduler::instance().at(now + 450 + (edge == 0 ? 0 : duration), board, [this, board, echoPin, echoLevel]() {
+                setPinLevel(board, echoPin, echoLevel);
+                auto isr = pinIsrs_.find({board, echoPin});
+                if (isr != pinIsrs_.end()) {
+                    isr->second();
+                }
+            });
+        }
+        return;
+    }
+}
+
+void World::onServoWrite(int board, int pin, int angle) {
+    HostAllocations host;
+    Micros now = Scheduler::instance().now();
+    ServoModel &servo = servos_[pin];
+    double current = servo.angleAt(now);
+    servo.board = board;
+    servo.from = current;
+    servo.to = angle;
+    servo.startUs = now;
+
+    bool opening = pin == gatePin && current < GATE_OPEN_DEG && angle >= GATE_OPEN_DEG;
+    if (opening && !queue_.empty() && presenting(queue_.front()) && !queue_.front().dropping) {
+        int userId = queue_.front().id;
+        queue_.front().dropping = true;
+        Micros gateOpenUs = std::max(now, servo.startUs + (Micros)((GATE_OPEN_DEG - current) / servo.degPerSec * 1e6));
+        Scheduler::instance().at(gateOpenUs + ms(config.reactionMs), BOARD_NONE,
+                                 [this, userId]() { drop(userId); });
+    }
+}
+
+void World::drop(int userId) {
+    if (queue_.empty() || queue_.front().id != userId) {
+        return;
+    }
+    Micros now = Scheduler::instance().now();
+    User user = queue_.front();
+    if (servos_[gatePin].angleAt(now) < GATE_OPEN_DEG) {
+        usersMissed++;
+        leave();
+        return;
+    }
+
+    double pipeAngle = servos_.count(pipePin) ? servos_[pipePin].angleAt(now) : 90;
+    int binIndex = 0;
+    for (int i = 1; i < (int)bins.size(); i++) {
+        if (std::fabs(bins[i].angle - pipeAngle) < std::fabs(bins[binIndex].angle - pipeAngle)) {
+            binIndex = i;
+        }
+    }
+    Micros landedUs = now + ms(config.fallMs);
+    Scheduler::instance().at(landedUs, BOARD_NONE, [this, user, binIndex, landedUs]() {
+        BinModel &bin = bins[binIndex];
+        bin.fillCm = std::min(bin.depthCm - 2, bin.fillCm + config.itemHeightCm);
+        bin.items++;
+        if (config.emptyAtPercent > 0 && bin.fillCm >= bin.depthCm * config.emptyAtPercent / 100) {
+            bin.fillCm = 0;
+            binsEmptied++;
+        }
+        if (binIndex != user.itemClass) {
+            misrouted++;
+        }
+        cycles.push_back(CycleRecord{user.id, user.itemClass, binIndex, user.presses,
+                                     user.arrivedUs, user.firstPressUs, landedUs});
+    });
+    leave();
+}
+
+double World::echoDistanceCm(int board, int echoPin) const {
+    for (const BinModel &bin : bins) {
+        if (board == BOARD_S3 && bin.echoPin == echoPin) {
+            return std::max(2.0, bin.depthCm - bin.fillCm);
+        }
+    }
+    return -1;
+}
+
+double World::sampleEchoCm(int board, int echoPin, bool crosstalk) {
+    double distance = echoDistanceCm(board, echoPin);
+    if (distance < 0) {
+        return -1;
+    }
+    std::uniform_real_distribution<double> chance(0, 1);
+    std::normal_distribution<double> noise(0, config.echoNoiseCm);
+    double roll = chance(rng_);
+    if (roll < config.echoLossRate) {
+        return -1;
+    }
+    if (roll < config.echoLossRate + config.echoOutlierRate || (crosstalk && chance(rng_) < 0.5)) {
+        return distance * (0.2 + 0.6 * chance(rng_));
+    }
+    return std::max(2.0, distance + noise(rng_));
+}
+
+int World::presentedItem(int *itemId) const {
+    if (queue_.empty() || !presenting(queue_.front())) {
+        return -1;
+    }
+    if (itemId) {
+        *itemId = queue_.front().id;
+    }
+    return queue_.front().itemClass;
+}
+
+double World::presentedOffset() const {
+    if (queue_.empty() || queue_.front().placedUs == 0 || config.settleMs <= 0) {
+        return 0;
+    }
+    double remaining = 1 - (Scheduler::instance().now() - queue_.front().placedUs) / (config.settleMs * 1000);
+    return remaining > 0 ? remaining * remaining : 0;
+}
+
+/* Wi-Fi link model
+- One access point on AP_CHANNEL with AP_BSSID, each begin() starts a connection attempt
+    - Without a channel: full scan (scanMs), with a channel: probe of that channel only (channelScanMs)
+    - Then association (associateMs) and DHCP (dhcpMs), no DHCP with a static IP
+    - The attempt fails at the end of the scan or probe if an outage of the board overlapped it, or the channel or
+      BSSID given are not the ones of the access point, and at its end if an outage started during the handshake
+- An outage drops a connected link when it starts, the driver sees the beacons stop
+- A failed attempt or a dropped link reports "down" to the handler of the WiFi stand-in, a connection "up",
+  then the driver tries again on its own if auto reconnect is on and the handler did not start an attempt itself
+*/
+const uint8_t World::AP_BSSID[6] = {0x3C, 0x84, 0x6A, 0x5A, 0x1B, 0x06};
+
+namespace {
+const int REASON_BEACON_TIMEOUT = 200;   // same values as WIFI_REASON_* in the WiFi stand-in
+const int REASON_NO_AP_FOUND = 201;
+}  // namespace
+
+void World::onWiFiBegin(int board, int channel, const uint8_t *bssid, bool staticIP) {
+    LinkState &link = links_[board];
+    link.connected = false;
+    link.channel = channel;
+    link.bssidMatches = bssid == nullptr || std::equal(AP_BSSID, AP_BSSID + 6, bssid);
+    link.staticIP = staticIP;
+    startAttempt(board);
+}
+
+void World::onWiFiDisconnect(int board) {
+    LinkState &link = links_[board];
+    link.connected = false;
+    link.connecting = false;
+    link.attempt++;
+}
+
+void World::setAutoReconnect(int board, bool autoReconnect) { links_[board].autoReconnect = autoReconnect; }
+
+void World::setLinkHandler(int board, std::function<void(bool up, int reason)> handler) {
+    links_[board].handler = std::move(handler);
+}
+
+void World::startAttempt(int board) {
+    LinkState &link = links_[board];
+    const NetworkProfile &profile = net(board);
+    bool apFound = link.channel == 0 || (link.channel == AP_CHANNEL && link.bssidMatches);
+    Micros startUs = Scheduler::instance().now();
+    Micros scannedUs = startUs + ms(link.channel == 0 ? profile.scanMs : profile.channelScanMs);
+    Micros connectedUs = scannedUs + ms(profile.associateMs + (link.staticIP ? 0 : profile.dhcpMs));
+    uint64_t attempt = ++link.attempt;
+    link.connecting = true;
+    wifiAttempts[board]++;
+    Scheduler::instance().at(scannedUs, board, [this, board, attempt, startUs, connectedUs, apFound]() {
+        if (!apFound || inOutage(board, startUs)) {
+            finishAttempt(board, attempt, false);
+            return;
+        }
+        Micros handshakeUs = Scheduler::instance().now();
+        Scheduler::instance().at(connectedUs, board, [this, board, attempt, handshakeUs]() {
+            finishAttempt(board, attempt, !inOutage(board, handshakeUs));
+        });
+    });
+}
+
+void World::finishAttempt(int board, uint64_t attempt, bool apFound) {
+    LinkState &link = links_[board];
+    if (attempt != link.attempt) {
+        return;
+    }
+    link.connecting = false;
+    Micros now = Scheduler::instance().now();
+    if (!apFound) {
+        if (link.handler) {
+            link.handler(false, REASON_NO_AP_FOUND);
+        }
+        if (link.autoReconnect && !link.connecting) {
+            startAttempt(board);
+        }
+        return;
+    }
+    link.connected = true;
+    if (wifiUpUs[board] == 0) {
+        wifiUpUs[board] = now;
+    }
+    if (link.outageEndUs != 0) {
+        HostAllocations host;
+        wifiRecoveryMs[board].push_back((now - link.outageEndUs) / 1000.0);
+        link.outageEndUs = 0;
+    }
+    if (link.handler) {
+        link.handler(true, 0);
+    }
+}
+
+void World::addOutage(int board, double startMs, double durationMs) {
+    Micros endUs = ms(startMs + durationMs);
+    outages_[board].push_back({ms(startMs), endUs});
+    Scheduler::instance().at(ms(startMs), board, [this, board, endUs]() { outageStarts(board, endUs); });
+}
+
+void World::outageStarts(int board, Micros endUs) {
+    LinkState &link = links_[board];
+    link.outageEndUs = endUs;
+    if (!link.connected) {
+        return;   // an attempt running fails once it ends
+    }
+    link.connected = false;
+    if (link.handler) {
+        link.handler(false, REASON_BEACON_TIMEOUT);
+    }
+    if (link.autoReconnect && !link.connecting) {
+        startAttempt(board);
+    }
+}
+
+// inOutage() function, to tell if an outage of board overlaps the time from since until now
+bool World::inOutage(int board, Micros since) const {
+    Micros now = Scheduler::instance().now();
+    for (const auto &outage : outages_[board]) {
+        if (outage.first <= now && outage.second > since) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool World::linkUp(int board) const {
+    return board >= 0 && links_[board].connected;
+}
+
+}  // namespace sim
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sim/Scheduler.h"
+
+/* sim::World
+- Physical model around the two boards: the user at the bin, the sorting pipe and gate,
+  the three trash bins and what the ultrasonic sensors see
+- Network and storage cost models used by the HAL stand-ins
+- Collects every number the report needs (per-cycle latency, throughput, traffic)
+*/
+namespace sim {
+
+const int CLASS_COUNT = 3;
+extern const char *const CLASS_LABELS[CLASS_COUNT];   // labels the server answers with
+
+struct NetworkProfile {
+    double scanMs = 1800;       // active scan of every channel, WiFi.begin() without a channel
+    double channelScanMs = 60;  // probe of the one channel given to WiFi.begin(), the access point answers at once
+    double associateMs = 250;   // authentication, association and WPA2 handshake
+    double dhcpMs = 450;        // DHCP discover to ack, skipped with a static IP from WiFi.config()
+    double dnsMs = 25;          // name lookup per fresh connection
+    double rttMs = 60;          // round trip to the server
+    double serverMs = 15;       // server handler time for simple requests
+    double uplinkKBps = 120;    // sustained upload throughput
+    double downlinkKBps = 400;
+    double timeoutMs = 5000;    // HTTPClient default read timeout
+    double lanMs = 3;           // one-way latency between the boards through the access point
+    double lanLossRate = 0;     // fraction of LAN datagrams lost on the air
+    double idleCloseMs = 60000;  // server closes a keep-alive connection idle this long
+    double tlsHandshakeMs = 400;  // ECDHE + certificate checks on the ESP32 CPU (https only)
+};
+
+struct Config {
+    double minutes = 60;
+    uint32_t seed = 1;
+    double inferenceMs = 5000;   // server-side inference per uploaded image
+    double errorRate = 0;        // fraction of server responses turned into HTTP 500
+    double arrivalMs = 0;        // mean time between users, 0 = next user steps up right away
+    double thinkMs = 2000;       // saturated mode: gap between one user leaving and the next press
+    bool autoTrigger = false;    // users put the item in the chute and leave the trigger to the camera's motion detector
+    double buttonMs = 500;       // part of thinkMs spent reaching for the button, saved with the auto trigger
+    double settleMs = 600;       // auto trigger: the item slides this long before it comes to rest in the chute
+    double reactionMs = 800;     // time for the user to drop the item once the gate opens
+    double fallMs = 400;         // time for the item to land in the bin
+    double firstArrivalMs = 10000;  // first user shows up once both boards had time to boot
+    double patienceMs = 120000;  // user presses again if the gate did not open by then
+    int maxPresses = 3;          // user gives up after this many presses
+    double itemHeightCm = 1.5;   // fill added by one item
+    double emptyAtPercent = 0;   // a bin is emptied once it is this full, 0 = never, it fills up and stays full
+    double loopTickMs = 1;       // virtual cost of one pass through an Arduino loop()
+    double sdOpenMs = 8;         // FAT lookup when opening an existing file
+    double sdCreateMs = 15;      // directory entry + cluster allocation for a new file
+    double sdCloseMs = 3;
+    double sdDirEntryMs = 0.15;  // per file in the folder, the FAT directory is searched entry by entry
+    double sdWriteKBps = 1500;   // SD_MMC 4-bit sustained throughput
+    double sdReadKBps = 3000;
+    double flashCommitMs = 25;   // EEPROM/NVS sector erase + write
+    double jpegDecodeMs = 8;     // jpg2rgb565() of a chute frame at 1/8 scale (DC coefficients only)
+    double oddItemRate = 0.05;   // fraction of items that look like another class (white paper, painted cans)
+    double echoNoiseCm = 0.3;    // HC-SR04 jitter (1 sigma)
+    double echoOutlierRate = 0.03;  // fraction of pings answered by a stray reflection, reads short
+    double echoLossRate = 0.02;  // fraction of pings without an echo, the echo pin stays high for 38 ms
+    double crosstalkMs = 25;     // a ping this soon after another sensor's ping may hear that one instead
+    bool verbose = false;        // echo firmware Serial output
+    bool printCycles = false;    // one line per sorted item
+    bool printMetrics = false;   // fetch /metrics from both boards before the end of the run
+    std::string nvsPath;         // NVS of both boards kept in this file between runs, empty = NVS starts empty
+    NetworkProfile net[2];
+};
+
+struct BinModel {
+    const char *id;   // bin_id the S3 reports the capacity under
+    int angle;        // pipe angle that routes into this bin
+    int trigPin;
+    int echoPin;
+    double depthCm;
+    double fillCm;
+    int items;
+};
+
+struct ServoModel {
+    int board = BOARD_NONE;
+    double from = 90;
+    double to = 90;
+    Micros startUs = 0;
+    double degPerSec = 300;   // MG996R, no load, ~0.17 s / 60 deg
+    double angleAt(Micros t) const;
+    Micros arrivalUs() const;
+};
+
+struct User {
+    int id;
+    int itemClass;
+    Micros arrivedUs;
+    Micros firstPressUs = 0;
+    Micros placedUs = 0;       // auto trigger: item put in the chute, at rest settleMs later
+    Micros lastPressUs = 0;
+    int presses = 0;
+    bool dropping = false;
+};
+
+struct CycleRecord {
+    int itemId;
+    int itemClass;
+    int binIndex;
+    int presses;
+    Micros arrivedUs;
+    Micros pressUs;     // button press, with the auto trigger the item coming to rest
+    Micros sortedUs;
+};
+
+struct EndpointStats {
+    uint64_t requests = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t errors = 0;
+};
+
+class World {
+public:
+    static World &instance();
+
+    Config config;
+
+    // Physical layout, matches the wiring table in the top-level README
+    const int buttonPin = 47;
+    const int pipePin = 8;
+    const int gatePin = 21;
+    std::vector<BinModel> bins{
+        {"bin-cardboard", 70, 4, 5, 48, 0, 0},
+        {"bin-metal", 90, 6, 7, 50, 0, 0},
+        {"bin-plastic", 110, 1, 2, 53, 0, 0},
+    };
+
+    void start();
+
+    // Hooks called by the HAL stand-ins
+    void onServoWrite(int board, int pin, int angle);
+    double echoDistanceCm(int board, int echoPin) const;
+    double sampleEchoCm(int board, int echoPin, bool crosstalk);   // one noisy ping, -1 = no echo
+    void onDigitalWrite(int board, int pin, int level);
+    int presentedItem(int *itemId) const;   // class of the item held at the camera, -1 if none
+    double presentedOffset() const;         // how far the item still slides, 1 = entering the frame, 0 = at rest
+    void onAttachInterrupt(int board, int pin, std::function<void()> isr, int mode);
+
+    // Wi-Fi link model, see "Wi-Fi link model" in World.cpp
+    static const int AP_CHANNEL = 6;
+    static const uint8_t AP_BSSID[6];
+    bool linkUp(int board) const;
+    void onWiFiBegin(int board, int channel, const uint8_t *bssid, bool staticIP);
+    void onWiFiDisconnect(int board);
+    void setAutoReconnect(int board, bool autoReconnect);
+    void setLinkHandler(int board, std::function<void(bool up, int reason)> handler);
+    void addOutage(int board, double startMs, double durationMs);
+
+    std::mt19937 &rng() { return rng_; }
+    const NetworkProfile &net(int board) const;
+
+    // Statistics
+    std::vector<CycleRecord> cycles;
+    std::map<std::string, EndpointStats> endpoints;
+    int usersArrived = 0;
+    int usersMissed = 0;
+    int usersGaveUp = 0;
+    int misrouted = 0;
+    Micros wifiUpUs[2] = {0, 0};
+    std::vector<double> wifiRecoveryMs[2];   // end of an outage until the link was up again
+    uint64_t wifiAttempts[2] = {0, 0};
+    uint64_t connectionsOpened[2] = {0, 0};
+    uint64_t dnsLookups[2] = {0, 0};
+    uint64_t bytesUp[2] = {0, 0};
+    uint64_t bytesDown[2] = {0, 0};
+    uint64_t udpDatagrams[2] = {0, 0};
+    uint64_t sdBytesWritten = 0;
+    uint64_t sdBytesRead = 0;
+    uint64_t sdFilesCreated = 0;
+    uint64_t flashCommits = 0;
+    uint64_t echoPings = 0;
+    uint64_t binsEmptied = 0;
+
+private:
+    void scheduleArrival(Micros when);
+    void userArrives();
+    void stepUp();
+    void press(int userId, int pressNumber);
+    void place(int userId);
+    bool presenting(const User &user) const;
+    void leave();
+    void drop(int userId);
+    void startAttempt(int board);
+    void finishAttempt(int board, uint64_t attempt, bool apFound);
+    void outageStarts(int board, Micros endUs);
+    bool inOutage(int board, Micros since) const;
+
+    std::mt19937 rng_;
+    std::deque<User> queue_;
+    int nextUserId_ = 1;
+    std::map<int, ServoModel> servos_;
+    std::function<void()> buttonIsr_;
+    int buttonMode_ = 0;
+    std::map<std::pair<int, int>, std::function<void()>> pinIsrs_;   // (board, pin) -> ISR of any other pin
+    Micros lastPingUs_[2] = {0, 0};
+    int lastPingPin_[2] = {-1, -1};
+    struct LinkState {
+        bool connected = false;
+        bool connecting = false;
+        bool autoReconnect = true;   // default of the ESP32 Arduino core
+        bool staticIP = false;
+        int channel = 0;             // 0 = scan every channel
+        bool bssidMatches = true;    // no BSSID given, or the one of the access point
+        uint64_t attempt = 0;        // bumped by every begin(), a finished attempt of an older one is ignored
+        Micros outageEndUs = 0;      // link dropped by an outage, recovery not recorded yet
+        std::function<void(bool up, int reason)> handler;
+    };
+    LinkState links_[2];
+    std::vector<std::pair<Micros, Micros>> outages_[2];
+};
+
+// Drives an input pin from the world side (echo pins), implemented next to the GPIO stand-in
+void setPinLevel(int board, int pin, int level);
+
+// NVS of both boards from and to a file (--nvs), implemented next to the Preferences stand-in
+bool loadNvs(const std::string &path);
+bool saveNvs(const std::string &path);
+
+}  // namespace sim
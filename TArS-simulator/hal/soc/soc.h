@@ -0,0 +1,4 @@
+#pragma once
+
+#define WRITE_PERI_REG(addr, val) ((void)(addr), (void)(val))
+#define READ_PERI_REG(addr) ((void)(addr), 0u)
@@ -0,0 +1,27 @@
+#include "SimPrelude.h"
+
+namespace cam {
+#include "../../TArS-ESP32-CAM/src/main.cpp"
+}  // namespace cam
+
+namespace sim {
+
+void startCamBoard() {
+    Server &server = Server::instance();
+    server.bind(String(cam::getStatusURL).c_str(), Endpoint::GetStatus);
+    server.bind(String(cam::predictURL).c_str(), Endpoint::Predict);
+
+    cam::motionTrigger = World::instance().config.autoTrigger;
+
+    Scheduler::instance().spawn(BOARD_CAM, "cam.loopTask", []() {
+        cam::setup();
+        for (;;) {
+            cam::loop();
+            Scheduler::instance().sleepFor(ms(World::instance().config.loopTickMs));
+        }
+    });
+}
+
+unsigned long camBootReadyMs() { return cam::bootReadyMs; }
+
+}  // namespace sim
@@ -0,0 +1,30 @@
+#include "SimPrelude.h"
+
+namespace s3 {
+#include "../../TArS-IoT-system/src/main.cpp"
+}  // namespace s3
+
+namespace sim {
+
+void startS3Board() {
+    Server &server = Server::instance();
+    server.bind(String(s3::addStatusURL).c_str(), Endpoint::AddStatus);
+    server.bind(String(s3::getPredictionURL).c_str(), Endpoint::GetPrediction);
+    server.bind(String(s3::updateCapacityURL).c_str(), Endpoint::UpdateCapacity);
+
+    Scheduler::instance().spawn(BOARD_S3, "s3.loopTask", []() {
+        s3::setup();
+        for (;;) {
+            s3::loop();
+            Scheduler::instance().sleepFor(ms(World::instance().config.loopTickMs));
+        }
+    });
+}
+
+unsigned long s3BootReadyMs() { return s3::bootReadyMs; }
+
+std::string s3LcdLine(int row) { return s3::lcd.line(row); }
+
+uint64_t s3LcdTransactions() { return s3::lcd.transactions(); }
+
+}  // namespace sim
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+/* Boards.h
+- Entry points of the two firmware images compiled for the host (BoardCam.cpp, BoardS3.cpp)
+*/
+namespace sim {
+
+void startCamBoard();
+void startS3Board();
+
+unsigned long camBootReadyMs();
+unsigned long s3BootReadyMs();
+std::string s3LcdLine(int row);
+uint64_t s3LcdTransactions();
+
+}  // namespace sim
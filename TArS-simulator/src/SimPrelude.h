@@ -0,0 +1,44 @@
+#pragma once
+
+/* SimPrelude.h
+- Every header the firmware includes, pulled in at global scope first
+- The firmware sources are then compiled inside their own namespace (cam::, s3::),
+  their #includes hit the include guards and resolve to these global declarations
+*/
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <ESP32Servo.h>
+#include <FS.h>
+#include <HTTPClient.h>
+#include <LiquidCrystal_I2C.h>
+#include <Preferences.h>
+#include <SD_MMC.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <WiFiServer.h>
+#include <WiFiUdp.h>
+#include <Wire.h>
+#include <math.h>
+
+#include <ConnectionManager.h>
+#include <EdgeClassifier.h>
+#include <JsonScanner.h>
+#include <Metrics.h>
+#include <MotionDetector.h>
+#include <ImageStore.h>
+#include <ServoMotion.h>
+#include <WiFiLink.h>
+#include <LabelMap.h>
+#include <RingBuffer.h>
+#include <FramePool.h>
+#include <TArSProtocol.h>
+
+#include "driver/rtc_io.h"
+#include "esp_camera.h"
+#include "img_converters.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/soc.h"
+
+#include "sim/Scheduler.h"
+#include "sim/Server.h"
+#include "sim/World.h"
@@ -0,0 +1,286 @@
+/* TArS host simulator
+- Runs the unmodified setup()/loop() pairs of the ESP32-CAM and the ESP32-S3 on Linux,
+  against the stand-in server in hal/sim/Server.cpp, on a shared virtual clock
+- A simulated queue of users presses the button, shows the item to the camera and drops
+  it in once the gate opens, so every sorted item yields one deposit-to-sorted latency
+    - With --auto-trigger the users only put the item in the chute, the deposit is the item coming to rest
+- Prints per-cycle latency, items per minute and the traffic both boards generated
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <Metrics.h>
+#include <WiFiServer.h>
+
+#include "Boards.h"
+#include "sim/Heap.h"
+#include "sim/Scheduler.h"
+#include "sim/Server.h"
+#include "sim/World.h"
+
+using namespace sim;
+
+namespace {
+
+void printUsage() {
+    std::printf(
+        "usage: tars-sim [options]\n"
+        "  --minutes N         virtual run time (default 60)\n"
+        "  --seed N            random seed (default 1)\n"
+        "  --inference-ms N    server inference time per image (default 5000)\n"
+        "  --rtt-ms N          network round trip of both boards (default 60)\n"
+        "  --uplink-kbps N     upload throughput of both boards in KB/s (default 120)\n"
+        "  --error-rate F      fraction of server replies turned into HTTP 500 (default 0)\n"
+        "  --lan-loss F        fraction of datagrams between the boards lost on the LAN (default 0)\n"
+        "  --arrival-s N       mean seconds between users, 0 = always someone waiting (default 0)\n"
+        "  --think-ms N        delay before the next user presses the button (default 2000)\n"
+        "  --auto-trigger      users put the item in the chute, the camera's motion trigger starts the scan\n"
+        "  --outage B:S:D      Wi-Fi outage on board B (cam|s3) at S seconds for D seconds\n"
+        "  --odd-items F       fraction of items that look like another class to the camera (default 0.05)\n"
+        "  --empty-at P        a bin is emptied once it is P %% full, 0 = never (default 0)\n"
+        "  --nvs FILE          NVS of both boards, loaded before the run and saved after it, so a second\n"
+        "                      run boots like a unit that has run before (Wi-Fi cache, calibration)\n"
+        "  --cycles            print one line per sorted item\n"
+        "  --metrics           fetch /metrics from both boards 10 s before the end and print it\n"
+        "  --verbose           echo the firmware Serial output\n");
+}
+
+bool parseArgs(int argc, char **argv, Config &config) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--minutes") {
+            config.minutes = std::atof(value());
+        } else if (arg == "--seed") {
+            config.seed = (uint32_t)std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--inference-ms") {
+            config.inferenceMs = std::atof(value());
+        } else if (arg == "--rtt-ms") {
+            config.net[BOARD_CAM].rttMs = config.net[BOARD_S3].rttMs = std::atof(value());
+        } else if (arg == "--uplink-kbps") {
+            config.net[BOARD_CAM].uplinkKBps = config.net[BOARD_S3].uplinkKBps = std::atof(value());
+        } else if (arg == "--error-rate") {
+            config.errorRate = std::atof(value());
+        } else if (arg == "--lan-loss") {
+            config.net[BOARD_CAM].lanLossRate = config.net[BOARD_S3].lanLossRate = std::atof(value());
+        } else if (arg == "--arrival-s") {
+            config.arrivalMs = std::atof(value()) * 1000;
+        } else if (arg == "--think-ms") {
+            config.thinkMs = std::atof(value());
+        } else if (arg == "--auto-trigger") {
+            config.autoTrigger = true;
+        } else if (arg == "--outage") {
+            char board[8] = {0};
+            double start = 0, duration = 0;
+            if (std::sscanf(value(), "%7[^:]:%lf:%lf", board, &start, &duration) != 3) {
+                std::fprintf(stderr, "--outage expects cam|s3:start_s:duration_s\n");
+                return false;
+            }
+            World::instance().addOutage(std::strcmp(board, "cam") == 0 ? BOARD_CAM : BOARD_S3,
+                                        start * 1000, duration * 1000);
+        } else if (arg == "--odd-items") {
+            config.oddItemRate = std::atof(value());
+        } else if (arg == "--empty-at") {
+            config.emptyAtPercent = std::atof(value());
+        } else if (arg == "--nvs") {
+            config.nvsPath = value();
+        } else if (arg == "--cycles") {
+            config.printCycles = true;
+        } else if (arg == "--metrics") {
+            config.printMetrics = true;
+        } else if (arg == "--verbose") {
+            config.verbose = true;
+        } else {
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(fraction * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+std::string bytes(uint64_t value) {
+    char buffer[32];
+    if (value >= 1024 * 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f MB", value / (1024.0 * 1024.0));
+    } else if (value >= 1024) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f KB", value / 1024.0);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%llu B", (unsigned long long)value);
+    }
+    return buffer;
+}
+
+// Ids of the /metrics requests sent to each board by scheduleMetricsScrape(), -1 if none got through
+int metricsScrapes[2] = {-1, -1};
+
+void scheduleMetricsScrape(const Config &config) {
+    Micros when = ms(std::max(config.minutes * 60 * 1000 - 10000, 0.0));
+    for (int board : {BOARD_CAM, BOARD_S3}) {
+        Scheduler::instance().at(when, board, [board]() {
+            metricsScrapes[board] = connectToBoard(board, METRICS_PORT, "GET /metrics HTTP/1.1\r\nHost: tars\r\n\r\n");
+        });
+    }
+}
+
+void report(const Config &config, double hostSeconds) {
+    World &world = World::instance();
+    std::vector<double> latencies;
+    std::vector<double> turnarounds;
+    for (const CycleRecord &cycle : world.cycles) {
+        latencies.push_back((cycle.sortedUs - cycle.pressUs) / 1000.0);
+        turnarounds.push_back((cycle.sortedUs - cycle.arrivedUs) / 1000.0);
+    }
+    if (config.printCycles) {
+        int number = 1;
+        for (const CycleRecord &cycle : world.cycles) {
+            std::printf("cycle %4d  item %4d  %-7s -> bin %d  presses %d  pressed %9.3f s  latency %8.3f s\n",
+                        number++, cycle.itemId, CLASS_LABELS[cycle.itemClass], cycle.binIndex, cycle.presses,
+                        cycle.pressUs / 1e6, (cycle.sortedUs - cycle.pressUs) / 1e6);
+        }
+    }
+    double mean = 0;
+    for (double latency : latencies) {
+        mean += latency / latencies.size();
+    }
+    double minutes = config.minutes;
+    double itemsPerMinute = world.cycles.size() / minutes;
+
+    std::printf("TArS host simulation: %.1f min virtual time, seed %u, inference %.0f ms, rtt %.0f ms, %s trigger\n",
+                minutes, config.seed, config.inferenceMs, config.net[BOARD_S3].rttMs,
+                config.autoTrigger ? "motion" : "button");
+    std::printf("boards online          : cam %.2f s, s3 %.2f s after power-on\n",
+                world.wifiUpUs[BOARD_CAM] / 1e6, world.wifiUpUs[BOARD_S3] / 1e6);
+    std::printf("boards ready           : cam %.2f s, s3 %.2f s after power-on (0: not ready)\n",
+                camBootReadyMs() / 1e3, s3BootReadyMs() / 1e3);
+    for (int board : {BOARD_CAM, BOARD_S3}) {
+        const std::vector<double> &recoveries = world.wifiRecoveryMs[board];
+        if (!recoveries.empty()) {
+            std::vector<double> sorted = recoveries;
+            std::sort(sorted.begin(), sorted.end());
+            std::printf("wifi recovery (%-3s)    : %zu outages, back online max %.2f s after the end, %llu attempts\n",
+                        board == BOARD_CAM ? "cam" : "s3", sorted.size(), sorted.back() / 1000,
+                        (unsigned long long)world.wifiAttempts[board]);
+        }
+    }
+    std::printf("users                  : %d arrived, %zu sorted (%d misrouted), %d missed the gate, %d gave up\n",
+                world.usersArrived, world.cycles.size(), world.misrouted, world.usersMissed, world.usersGaveUp);
+    std::printf("deposit-to-sorted (s)  : mean %.2f  p50 %.2f  p95 %.2f  max %.2f\n", mean / 1000,
+                percentile(latencies, 0.5) / 1000, percentile(latencies, 0.95) / 1000,
+                percentile(latencies, 1.0) / 1000);
+    std::printf("arrival-to-sorted (s)  : p50 %.2f  p95 %.2f  (includes waiting in line)\n",
+                percentile(turnarounds, 0.5) / 1000, percentile(turnarounds, 0.95) / 1000);
+    std::printf("throughput             : %.2f items/min\n", itemsPerMinute);
+    std::printf("HTTP requests          :");
+    for (const auto &entry : world.endpoints) {
+        std::printf(" %s %llu (%llu err)", entry.first.c_str(), (unsigned long long)entry.second.requests,
+                    (unsigned long long)entry.second.errors);
+    }
+    std::printf("\n");
+    std::printf("connections (dns)      : cam %llu (%llu), s3 %llu (%llu)\n",
+                (unsigned long long)world.connectionsOpened[BOARD_CAM], (unsigned long long)world.dnsLookups[BOARD_CAM],
+                (unsigned long long)world.connectionsOpened[BOARD_S3], (unsigned long long)world.dnsLookups[BOARD_S3]);
+    std::printf("LAN datagrams          : cam %llu, s3 %llu\n", (unsigned long long)world.udpDatagrams[BOARD_CAM],
+                (unsigned long long)world.udpDatagrams[BOARD_S3]);
+    std::printf("traffic up/down        : cam %s / %s, s3 %s / %s\n", bytes(world.bytesUp[BOARD_CAM]).c_str(),
+                bytes(world.bytesDown[BOARD_CAM]).c_str(), bytes(world.bytesUp[BOARD_S3]).c_str(),
+                bytes(world.bytesDown[BOARD_S3]).c_str());
+    const EndpointStats &uploads = world.endpoints["predict"];
+    std::printf("image uploads          : %s per request, profile", bytes(uploads.requests ? uploads.bytesIn / uploads.requests : 0).c_str());
+    for (const auto &entry : Server::instance().captureProfiles) {
+        std::printf(" %s %llu", entry.first.c_str(), (unsigned long long)entry.second);
+    }
+    std::printf(", jpeg quality %d..%d\n", Server::instance().jpegQualityMin, Server::instance().jpegQualityMax);
+    std::printf("edge classifier        : %llu of %llu uploads classified on the camera, %llu agree with the item\n",
+                (unsigned long long)Server::instance().edgeResults, (unsigned long long)uploads.requests,
+                (unsigned long long)Server::instance().edgeAgreed);
+    std::printf("image replay           : %llu uploads from the SD card, %llu with edge_class, %llu sent other than first\n",
+                (unsigned long long)Server::instance().replayedUploads,
+                (unsigned long long)Server::instance().replayedEdgeResults,
+                (unsigned long long)Server::instance().replayedChanged);
+    std::printf("SD / flash             : %llu files created, %s written, %s read, %llu flash commits\n",
+                (unsigned long long)world.sdFilesCreated, bytes(world.sdBytesWritten).c_str(),
+                bytes(world.sdBytesRead).c_str(), (unsigned long long)world.flashCommits);
+    std::printf("bin fill reported/true :");
+    for (const BinModel &bin : world.bins) {
+        auto reported = Server::instance().reportedFullness.find(bin.id);
+        std::printf(" %s %s/%.0f %%", bin.id,
+                    reported == Server::instance().reportedFullness.end() ? "-" : std::to_string(reported->second).c_str(),
+                    bin.fillCm / bin.depthCm * 100);
+    }
+    std::printf(" (%llu readings, %llu pings, %llu emptied)\n", (unsigned long long)Server::instance().capacityReadings,
+                (unsigned long long)world.echoPings, (unsigned long long)world.binsEmptied);
+    std::printf("firmware heap peak     : cam %s, s3 %s (camera frame buffers not included), PSRAM cam %s, s3 %s\n",
+                bytes(heapPeak(BOARD_CAM)).c_str(), bytes(heapPeak(BOARD_S3)).c_str(),
+                bytes(psramInUse(BOARD_CAM)).c_str(), bytes(psramInUse(BOARD_S3)).c_str());
+    std::printf("LCD                    : %llu I2C transactions\n", (unsigned long long)s3LcdTransactions());
+    for (int row = 0; row < 4; row++) {
+        std::printf("  |%s|\n", s3LcdLine(row).c_str());
+    }
+    if (config.printMetrics) {
+        for (int board : {BOARD_CAM, BOARD_S3}) {
+            std::string reply = replyFromBoard(metricsScrapes[board]);
+            size_t body = reply.find("\r\n\r\n");
+            std::printf("metrics %-14s : %s\n", board == BOARD_CAM ? "cam" : "s3",
+                        body == std::string::npos ? "(no reply)" : reply.substr(body + 4, reply.find_last_not_of("\r\n") - body - 3).c_str());
+        }
+    }
+    std::printf("host time              : %.2f s (%llu task switches)\n", hostSeconds,
+                (unsigned long long)Scheduler::instance().contextSwitches());
+    std::printf("RESULT items_per_min=%.3f sorted=%zu misrouted=%d mean_ms=%.0f p50_ms=%.0f p95_ms=%.0f max_ms=%.0f\n",
+                itemsPerMinute, world.cycles.size(), world.misrouted, mean, percentile(latencies, 0.5),
+                percentile(latencies, 0.95), percentile(latencies, 1.0));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Config &config = World::instance().config;
+    if (!parseArgs(argc, argv, config)) {
+        return 2;
+    }
+
+    if (!config.nvsPath.empty()) {
+        loadNvs(config.nvsPath);
+    }
+    auto hostStart = std::chrono::steady_clock::now();
+    World::instance().start();
+    startCamBoard();
+    startS3Board();
+    if (config.printMetrics) {
+        scheduleMetricsScrape(config);
+    }
+    Scheduler::instance().run(ms(config.minutes * 60 * 1000));
+    double hostSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+
+    report(config, hostSeconds);
+    if (Server::instance().replayedChanged > 0) {
+        std::fprintf(stderr, "replayed images lost the edge_class or capture_profile of their first upload\n");
+        return 1;
+    }
+    if (!config.nvsPath.empty() && !saveNvs(config.nvsPath)) {
+        std::fprintf(stderr, "%s: can not write the NVS file\n", config.nvsPath.c_str());
+        return 1;
+    }
+    return 0;
+}
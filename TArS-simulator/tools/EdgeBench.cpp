@@ -0,0 +1,173 @@
+/* EdgeBench
+- Runs the edge classifier of the ESP32-CAM (TArS-common/EdgeClassifier) on the host
+- Input: binary PPM (P6) files, e.g. sample JPEGs decoded at 1/8 scale like the camera does it:
+      djpeg -scale 1/8 -pnm paper_1.jpg > paper_1.ppm
+  or --synthetic N: N chute frames per class, rendered like the simulator's camera (hal/sim/Scene.h)
+- A file whose name starts with paper, cardboard, metal or plastic counts towards the accuracy
+- Prints the result of every file, then accuracy, time per inference, MACs and tensor arena use
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <EdgeClassifier.h>
+
+#include "Netpbm.h"
+#include "sim/Scene.h"
+
+namespace {
+
+void printUsage() {
+    std::printf(
+        "usage: edge-bench [options] [image.ppm ...]\n"
+        "  --runs N            inferences per image, for the timing (default 100)\n"
+        "  --confidence F      confidence ESP32-S3 sorts on, for the summary (default 0.85)\n"
+        "  --synthetic N       add N rendered chute frames per class (default 0)\n"
+        "  --odd-items F       fraction of rendered items that look like another class (default 0.05)\n"
+        "  --quiet             print the summary only\n");
+}
+
+struct Image {
+    std::string name;
+    int expected = -1;     // class from the file name, -1 if unknown
+    int width = 0;
+    int height = 0;
+    bool rgb565 = false;   // rendered frames come as RGB565 like jpg2rgb565(), files as RGB888
+    std::vector<uint8_t> pixels;
+};
+
+int expectedClass(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const char *const prefixes[] = {"paper", "metal", "plastic", "cardboard"};
+    for (int i = 0; i < 4; i++) {
+        if (name.compare(0, std::strlen(prefixes[i]), prefixes[i]) == 0) {
+            return i % EDGE_CLASS_COUNT;
+        }
+    }
+    return -1;
+}
+
+bool loadPPM(const std::string &path, Image &image) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::fprintf(stderr, "%s: can not open\n", path.c_str());
+        return false;
+    }
+    int maxValue = 0;
+    bool ok = std::fgetc(file) == 'P' && std::fgetc(file) == '6' && tools::readHeaderNumber(file, image.width) &&
+              tools::readHeaderNumber(file, image.height) && tools::readHeaderNumber(file, maxValue) && maxValue == 255;
+    if (ok) {
+        image.pixels.resize((size_t)image.width * image.height * 3);
+        ok = std::fread(image.pixels.data(), 1, image.pixels.size(), file) == image.pixels.size();
+    }
+    std::fclose(file);
+    if (!ok) {
+        std::fprintf(stderr, "%s: not a binary PPM (P6, 8 bit)\n", path.c_str());
+        return false;
+    }
+    image.name = path;
+    image.expected = expectedClass(path);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int runs = 100;
+    double confidenceMin = 0.85;
+    int synthetic = 0;
+    double oddItemRate = 0.05;
+    bool quiet = false;
+    std::vector<Image> images;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--runs" && hasValue) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--confidence" && hasValue) {
+            confidenceMin = std::atof(argv[++i]);
+        } else if (arg == "--synthetic" && hasValue) {
+            synthetic = std::atoi(argv[++i]);
+        } else if (arg == "--odd-items" && hasValue) {
+            oddItemRate = std::atof(argv[++i]);
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg[0] == '-') {
+            printUsage();
+            return 2;
+        } else {
+            Image image;
+            if (!loadPPM(arg, image)) {
+                return 1;
+            }
+            images.push_back(std::move(image));
+        }
+    }
+    for (int id = 0; id < synthetic * EDGE_CLASS_COUNT; id++) {
+        Image image;
+        image.name = "synthetic-" + std::to_string(id) + "-" + EdgeClassifier::label(id % EDGE_CLASS_COUNT);
+        image.expected = id % EDGE_CLASS_COUNT;
+        image.width = EDGE_INPUT_WIDTH;
+        image.height = EDGE_INPUT_HEIGHT;
+        image.rgb565 = true;
+        image.pixels.resize((size_t)image.width * image.height * 2);
+        sim::renderScene(image.expected, id, oddItemRate, image.width, image.height, image.pixels.data());
+        images.push_back(std::move(image));
+    }
+    if (images.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    static EdgeClassifier classifier;   // static like on the board, the arena is not on the stack
+    int labelled = 0, correct = 0, confident = 0, confidentLabelled = 0, confidentCorrect = 0;
+    double totalUs = 0;
+    uint32_t macs = 0;
+    for (const Image &image : images) {
+        EdgeResult result = {};
+        auto start = std::chrono::steady_clock::now();
+        bool ok = true;
+        for (int run = 0; run < runs && ok; run++) {
+            ok = image.rgb565 ? classifier.classifyRGB565(image.pixels.data(), image.width, image.height, result)
+                              : classifier.classifyRGB888(image.pixels.data(), image.width, image.height, result);
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+        if (!ok) {
+            std::fprintf(stderr, "%s: %dx%d is smaller than the model input %dx%d\n", image.name.c_str(), image.width,
+                         image.height, EDGE_INPUT_WIDTH, EDGE_INPUT_HEIGHT);
+            continue;
+        }
+        totalUs += us;
+        macs = result.macs;
+        bool sure = result.confidence >= confidenceMin;
+        confident += sure;
+        if (image.expected >= 0) {
+            labelled++;
+            correct += result.label == image.expected;
+            confidentLabelled += sure;
+            confidentCorrect += sure && result.label == image.expected;
+        }
+        if (!quiet) {
+            std::printf("%-40s %-8s %.2f%s  %.1f us\n", image.name.c_str(), EdgeClassifier::label(result.label),
+                        result.confidence, image.expected >= 0 && result.label != image.expected ? "  WRONG" : "", us);
+        }
+    }
+
+    size_t count = images.size();
+    std::printf("images                 : %zu, %d with a class in the file name\n", count, labelled);
+    if (labelled > 0) {
+        std::printf("accuracy               : %.1f %% (all), %.1f %% of the %d at confidence >= %.2f\n",
+                    100.0 * correct / labelled, confidentLabelled > 0 ? 100.0 * confidentCorrect / confidentLabelled : 0.0,
+                    confidentLabelled, confidenceMin);
+    }
+    std::printf("confident              : %.1f %% of the images would be sorted without the server\n",
+                100.0 * confident / count);
+    std::printf("inference              : %.1f us on this host, %u MACs, tensor arena %zu of %d bytes\n",
+                totalUs / count, macs, classifier.arenaUsed(), EDGE_ARENA_BYTES);
+    return 0;
+}
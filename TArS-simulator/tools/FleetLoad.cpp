@@ -0,0 +1,1121 @@
+/* FleetLoad
+- Load generator for the TArS backend: a fleet of ESP32-CAM/ESP32-S3 pairs against one server, on the host
+- Every pair follows the protocol of the firmwares with their defaults (see the firmware timing below)
+    - ESP32-CAM polls getStatusURL every STATUS_POLL_MS, or STATUS_POLL_FALLBACK_MS once the LAN trigger works,
+      captures on a trigger, sends its edge result to ESP32-S3 and uploads the image to predictURL,
+      an upload that failed is sent again QUEUE_BATCH_INTERVAL_MS later
+    - ESP32-S3 sends the LAN trigger on a button press and falls back to addStatusURL, sorts on a confident
+      edge result or long-polls getPredictionURL with backoff, and sends the bin capacity to updateCapacityURL
+      in batches, with a heartbeat for bins that did not change
+    - Users press the button of a pair at random (Poisson, --arrival-s), a user who finds the pair busy waits in line
+    - Request bodies, URLs and the upload form are made by the builders of TArSProtocol.h the firmwares use,
+      so the byte counts are the ones the boards send
+- The server is a bundled mock of the TArS backend, the endpoints of sim::Server with their state per pair
+    - --server-threads request handlers, each request takes --request-ms of one of them
+    - --inference-workers, each image takes --inference-ms (+-20 %) of one of them
+    - A long-poll of getPrediction is parked without a handler until its result or the wait is over,
+      --sync-long-poll keeps the handler busy instead, like a server with one thread per request
+    - --error-rate turns that fraction of requests into HTTP 500 without handling them
+- Single thread, virtual time: an hour of a few hundred pairs takes about a second
+- Prints per endpoint the requests, rate, errors, idle requests, latency seen by the boards (p50/p95/p99/max)
+  and bytes, the scan latency (button press until ESP32-S3 has the class), the load of handlers and inference
+  workers, and the share of the handler time spent on idle requests
+    - Idle: getStatus answered with status false, and capacity batches of heartbeat readings only
+- The last line (RESULT ...) is meant to be compared between protocol changes
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <TArSProtocol.h>
+
+namespace {
+
+typedef int64_t Micros;
+
+Micros ms(double value) {
+    return (Micros)(value * 1000);
+}
+
+// Firmware timing, the defaults of TArS-ESP32-CAM/src/main.cpp and TArS-IoT-system/src/main.cpp, keep in sync
+const int STATUS_POLL_MS = 2000;
+const int STATUS_POLL_FALLBACK_MS = 15000;
+const int QUEUE_BATCH_INTERVAL_MS = 30000;
+const int LOCAL_TRIGGER_ATTEMPTS = 3;
+const int LOCAL_TRIGGER_ACK_TIMEOUT_MS = 300;
+const int PREDICTION_TIMEOUT_MS = 90000;
+const int PREDICTION_BACKOFF_MIN_MS = 1000;
+const int PREDICTION_BACKOFF_MAX_MS = 8000;
+const int PREDICTION_LONG_POLL_S = 10;
+const int TELEMETRY_BUFFER_SIZE = 32;
+const int TELEMETRY_BATCH_MAX = 16;
+const int TELEMETRY_FLUSH_READINGS = 8;
+const int TELEMETRY_DELTA_PCT = 5;
+const int TELEMETRY_FLUSH_MS = 60000;
+const int TELEMETRY_RETRY_MS = 15000;
+const int TELEMETRY_HEARTBEAT_MS = 900000;
+const size_t TELEMETRY_READING_MAX_LENGTH = 112;
+
+// Model of one pair
+const int BIN_COUNT = 3;
+const char *const BIN_IDS[BIN_COUNT] = {"bin-cardboard", "bin-metal", "bin-plastic"};
+const char *const CLASS_LABELS[BIN_COUNT] = {"cardboard", "metal", "plastic"};
+const int DEPOSIT_PCT = 3;        // fill of a bin per item
+const int EMPTY_AT_PCT = 90;      // a bin is emptied at this fill
+const int CAPTURE_MS = 400;       // trigger until the image is classified on ESP32-CAM
+const int LAN_MS = 2;             // one datagram between the boards
+const int NEXT_USER_MS = 2000;    // a user waiting in line steps up after the scan before
+const int JPEG_QUALITY = 8;       // qualityMin of the "chute" capture profile
+
+// The mock server, URLs like the ones of serverCredentials.h
+#define SERVER_HOST "tars-fleet.local"
+#define SERVER_URL "http://" SERVER_HOST
+
+enum Endpoint { ADD_STATUS, GET_STATUS, PREDICT, GET_PREDICTION, UPDATE_CAPACITY, ENDPOINT_COUNT };
+const char *const ENDPOINT_NAMES[ENDPOINT_COUNT] = {"addStatus", "getStatus", "predict", "getPrediction",
+                                                    "updateCapacity"};
+const char *const ENDPOINT_PATHS[ENDPOINT_COUNT] = {"/api/status/add", "/api/status", "/api/predict",
+                                                    "/api/prediction/latest", "/api/bins/capacity"};
+
+struct Config {
+    int pairs = 200;
+    double minutes = 60;
+    unsigned seed = 1;
+    double arrivalS = 300;
+    double imageKB = 7.3;
+    double uplinkKBps = 120;
+    double rttMs = 60;
+    double lanLoss = 0;
+    double edgeShare = 0.8;
+    bool lanTrigger = true;
+    int statusPollMs = STATUS_POLL_MS;
+    int serverThreads = 8;
+    double requestMs = 5;
+    int inferenceWorkers = 8;
+    double inferenceMs = 5000;
+    double errorRate = 0;
+    bool syncLongPoll = false;
+};
+
+void printUsage() {
+    std::printf(
+        "usage: fleet-load [options]\n"
+        "  --pairs N             ESP32-CAM/ESP32-S3 pairs (default 200)\n"
+        "  --minutes N           virtual run time (default 60)\n"
+        "  --seed N              random seed (default 1)\n"
+        "  --arrival-s N         mean seconds between button presses of one pair (default 300)\n"
+        "  --image-kb N          mean JPEG size in KB (default 7.3)\n"
+        "  --uplink-kbps N       upload throughput of each board in KB/s (default 120)\n"
+        "  --rtt-ms N            network round trip between a board and the server (default 60)\n"
+        "  --lan-loss F          fraction of datagrams between the boards lost on the LAN (default 0)\n"
+        "  --edge-share F        fraction of images the camera classifies confidently (default 0.8)\n"
+        "  --no-lan-trigger      every trigger goes through addStatus, like LOCAL_TRIGGER_ENABLED false\n"
+        "  --poll-ms N           status poll of ESP32-CAM before the LAN trigger works (default %d)\n"
+        "  --server-threads N    request handlers of the server (default 8)\n"
+        "  --request-ms N        handler time per request (default 5)\n"
+        "  --inference-workers N images classified at the same time (default 8)\n"
+        "  --inference-ms N      inference time per image (default 5000)\n"
+        "  --error-rate F        fraction of requests answered with HTTP 500 (default 0)\n"
+        "  --sync-long-poll      a long-poll holds its handler until it is answered\n",
+        STATUS_POLL_MS);
+}
+
+bool parseArgs(int argc, char **argv, Config &config) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--pairs" && hasValue) {
+            config.pairs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--minutes" && hasValue) {
+            config.minutes = std::atof(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            config.seed = (unsigned)std::atoi(argv[++i]);
+        } else if (arg == "--arrival-s" && hasValue) {
+            config.arrivalS = std::max(1.0, std::atof(argv[++i]));
+        } else if (arg == "--image-kb" && hasValue) {
+            config.imageKB = std::max(0.1, std::atof(argv[++i]));
+        } else if (arg == "--uplink-kbps" && hasValue) {
+            config.uplinkKBps = std::max(1.0, std::atof(argv[++i]));
+        } else if (arg == "--rtt-ms" && hasValue) {
+            config.rttMs = std::atof(argv[++i]);
+        } else if (arg == "--lan-loss" && hasValue) {
+            config.lanLoss = std::atof(argv[++i]);
+        } else if (arg == "--edge-share" && hasValue) {
+            config.edgeShare = std::atof(argv[++i]);
+        } else if (arg == "--no-lan-trigger") {
+            config.lanTrigger = false;
+        } else if (arg == "--poll-ms" && hasValue) {
+            config.statusPollMs = std::max(100, std::atoi(argv[++i]));
+        } else if (arg == "--server-threads" && hasValue) {
+            config.serverThreads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--request-ms" && hasValue) {
+            config.requestMs = std::atof(argv[++i]);
+        } else if (arg == "--inference-workers" && hasValue) {
+            config.inferenceWorkers = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--inference-ms" && hasValue) {
+            config.inferenceMs = std::atof(argv[++i]);
+        } else if (arg == "--error-rate" && hasValue) {
+            config.errorRate = std::atof(argv[++i]);
+        } else if (arg == "--sync-long-poll") {
+            config.syncLongPoll = true;
+        } else {
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(fraction * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+// Request line and headers HTTPClient of the ESP32 Arduino core sends, the length only
+size_t httpClientHeadBytes(const char *method, const char *path, size_t bodyLength) {
+    return (size_t)std::snprintf(nullptr, 0,
+                                 "%s %s HTTP/1.1\r\nHost: " SERVER_HOST "\r\nUser-Agent: ESP32HTTPClient\r\n"
+                                 "Connection: keep-alive\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n"
+                                 "%s%s\r\n",
+                                 method, path, bodyLength > 0 ? "Content-Type: application/json\r\n" : "",
+                                 bodyLength > 0 ? "Content-Length: 000\r\n" : "") +
+           bodyLength;
+}
+
+// Status line, headers and body of a reply of the mock server, the length only
+size_t httpReplyBytes(int code, const std::string &body) {
+    return (size_t)std::snprintf(nullptr, 0,
+                                 "HTTP/1.1 %d OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                                 "Connection: keep-alive\r\n\r\n",
+                                 code, body.size()) +
+           body.size();
+}
+
+enum EventType {
+    EVENT_PRESS,             // pair, arg 1 if the user waited in line: a user presses the button
+    EVENT_CAM_POLL,          // pair: ESP32-CAM polls the status
+    EVENT_LAN_ATTEMPT,       // pair, arg scan: ESP32-S3 sends the LAN trigger, or falls back to the server
+    EVENT_LAN_TRIGGER,       // pair, arg scan: the LAN trigger reached ESP32-CAM
+    EVENT_LAN_ACK,           // pair, arg scan: its acknowledgement reached ESP32-S3
+    EVENT_CAPTURED,          // pair: ESP32-CAM has the image and its edge result
+    EVENT_EDGE_RESULT,       // pair, arg 1 if confident: the edge result reached ESP32-S3
+    EVENT_PREDICTION_POLL,   // pair, arg scan: the prediction backoff of ESP32-S3 is over
+    EVENT_UPLOAD_REPLAY,     // pair: ESP32-CAM sends a stored image again
+    EVENT_TELEMETRY,         // pair: a capacity batch may be due
+    EVENT_HEARTBEAT,         // pair: bins not queued for TELEMETRY_HEARTBEAT_MS are queued again
+    EVENT_ARRIVE,            // arg request: the request reached the server
+    EVENT_HANDLED,           // arg request: its handler is done with it
+    EVENT_INFERRED,          // arg request: the image of this predict request is classified
+    EVENT_WAIT_OVER,         // arg request: the long-poll wait of a parked request is over
+    EVENT_REPLY,             // arg request: the reply reached the board
+};
+
+struct Event {
+    Micros at;
+    uint64_t order;   // same time: in the order scheduled
+    EventType type;
+    int pair;
+    int arg;
+
+    bool operator>(const Event &other) const {
+        return at != other.at ? at > other.at : order > other.order;
+    }
+};
+
+struct Request {
+    int pair;
+    Endpoint endpoint;
+    std::string scanID;      // addStatus, predict, getPrediction, and the scan_id a getStatus reply carries
+    Micros sentUs;
+    Micros arrivedUs = 0;
+    Micros startedUs = 0;
+    bool holdsHandler = false;
+    bool parked = false;     // getPrediction waiting for its result
+    bool idle = false;
+    int readings = 0;        // updateCapacity
+    int code = 0;
+    bool status = false;     // getStatus reply
+};
+
+struct ServerScan {
+    std::string scanID;
+    bool ready = false;
+    std::vector<int> held;   // parked getPrediction requests
+};
+
+struct Reading {
+    int bin;
+    int capacity;
+    Micros measuredUs;
+    bool heartbeat;
+};
+
+enum Stage { STAGE_FREE, STAGE_TRIGGER_LAN, STAGE_TRIGGER_CLOUD, STAGE_PREDICTION_BACKOFF, STAGE_PREDICTION };
+
+enum Outcome { OUTCOME_EDGE, OUTCOME_SERVER, OUTCOME_FAILED, OUTCOME_COUNT };
+
+struct Pair {
+    std::string mac;
+    // ESP32-CAM
+    bool camBusy = false;      // in a blocking HTTP request or a capture
+    bool pollDue = false;      // the status poll came due while busy
+    bool lanSeen = false;
+    std::string triggerID;     // scan_id of a LAN trigger that came while busy
+    std::string capturedID;
+    std::deque<std::string> storedImages;
+    bool replayScheduled = false;
+    // ESP32-S3
+    Stage stage = STAGE_FREE;
+    int scan = 0;
+    std::string scanID;
+    int itemBin = 0;
+    Micros pressedUs = 0;
+    Micros deadlineUs = 0;
+    Micros backoffUs = 0;
+    int triggerAttempt = 0;
+    bool edgeConfident = false;
+    int waiting = 0;           // users in line
+    int fill[BIN_COUNT] = {};
+    int lastQueued[BIN_COUNT] = {};
+    Micros lastQueuedUs[BIN_COUNT] = {};
+    std::deque<Reading> readings;
+    int telemetryInFlight = 0;
+    Micros telemetryNextUs = 0;
+    // The mock server, state of this pair
+    bool status = false;
+    std::string statusScanID;
+    std::vector<ServerScan> serverScans;
+};
+
+// Handlers or inference workers of the server: size of them, FIFO queue of the requests waiting for one
+struct Pool {
+    int size = 1;
+    int busy = 0;
+    int peakQueue = 0;
+    Micros busyUs = 0;
+    Micros lastUs = 0;
+    std::deque<int> queue;
+    std::vector<double> waitsMs;
+
+    void account(Micros now) {
+        busyUs += busy * (now - lastUs);
+        lastUs = now;
+    }
+};
+
+struct EndpointStats {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t idle = 0;
+    uint64_t bytesUp = 0;
+    uint64_t bytesDown = 0;
+    Micros handlerUs = 0;
+    std::vector<double> latenciesMs;
+};
+
+class Fleet {
+public:
+    explicit Fleet(const Config &config);
+    void run();
+    void report(double hostSeconds) const;
+
+private:
+    void schedule(Micros at, EventType type, int pair, int arg);
+    Micros randomExp(double meanMs);
+    bool lanDelivered();
+    int send(int pair, Endpoint endpoint, const std::string &scanID, size_t bytesUp);
+
+    // ESP32-CAM
+    void camPoll(int pair);
+    void camFree(int pair);
+    void capture(int pair, const std::string &scanID);
+    void captured(int pair);
+    void upload(int pair, const std::string &scanID, bool live);
+    void replay(int pair);
+    void lanTrigger(int pair, int scan);
+    // ESP32-S3
+    void press(int pair, bool fromLine);
+    void startScan(int pair);
+    void lanAttempt(int pair, int scan);
+    void triggerDone(int pair);
+    void edgeResult(int pair, bool confident);
+    void predictionPoll(int pair, int scan);
+    void finishScan(int pair, Outcome outcome);
+    void queueReading(int pair, int bin, bool heartbeat);
+    void scheduleTelemetry(int pair);
+    void flushTelemetry(int pair);
+    void heartbeat(int pair);
+    void reply(int id);
+    // The mock server
+    void arrive(int id);
+    void startHandler(int id);
+    void releaseHandler(int id);
+    void handled(int id);
+    void respond(int id, int code, const std::string &body);
+    void respondPrediction(int id);
+    void startInference(int id);
+    void inferred(int id);
+    void waitOver(int id);
+    ServerScan *findScan(Pair &pair, const std::string &scanID);
+
+    Config config_;
+    std::mt19937_64 random_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t eventCount_ = 0;
+    Micros now_ = 0;
+    Micros endUs_ = 0;
+    std::vector<Pair> pairs_;
+    std::vector<Request> requests_;
+    Pool handlers_;
+    Pool inference_;
+    EndpointStats endpoints_[ENDPOINT_COUNT];
+    std::vector<double> scanMs_[OUTCOME_COUNT];
+    uint64_t presses_ = 0;
+    uint64_t lanDatagrams_ = 0;
+    uint64_t lanFallbacks_ = 0;
+    uint64_t uploadReplays_ = 0;
+    uint64_t readingsDropped_ = 0;
+    uint64_t flagCollisions_ = 0;
+    int flagsSet_ = 0;
+    Micros idleHandlerUs_ = 0;
+    int held_ = 0;
+    int peakHeld_ = 0;
+};
+
+Fleet::Fleet(const Config &config) : config_(config), random_(config.seed) {
+    handlers_.size = config.serverThreads;
+    inference_.size = config.inferenceWorkers;
+    endUs_ = ms(config.minutes * 60 * 1000);
+    pairs_.resize(config.pairs);
+    std::uniform_real_distribution<double> unit(0, 1);
+    for (int i = 0; i < config.pairs; i++) {
+        Pair &pair = pairs_[i];
+        char mac[16];
+        std::snprintf(mac, sizeof(mac), "%012llX", (unsigned long long)(random_() & 0xFFFFFFFFFFFFull));
+        pair.mac = mac;
+        // Boards power on within the first poll interval, the bins are anywhere between empty and nearly full
+        Micros bootUs = (Micros)(unit(random_) * ms(config.statusPollMs));
+        schedule(bootUs, EVENT_CAM_POLL, i, 0);
+        schedule(bootUs, EVENT_HEARTBEAT, i, 0);
+        schedule(bootUs + randomExp(config.arrivalS * 1000), EVENT_PRESS, i, 0);
+        for (int bin = 0; bin < BIN_COUNT; bin++) {
+            pair.fill[bin] = (int)(unit(random_) * EMPTY_AT_PCT);
+            pair.lastQueuedUs[bin] = bootUs - ms(TELEMETRY_HEARTBEAT_MS);   // queued at boot
+        }
+    }
+}
+
+void Fleet::schedule(Micros at, EventType type, int pair, int arg) {
+    events_.push(Event{at, eventCount_++, type, pair, arg});
+}
+
+Micros Fleet::randomExp(double meanMs) {
+    std::exponential_distribution<double> exp(1.0 / meanMs);
+    return ms(exp(random_));
+}
+
+bool Fleet::lanDelivered() {
+    lanDatagrams_++;
+    return std::uniform_real_distribution<double>(0, 1)(random_) >= config_.lanLoss;
+}
+
+// send() function, to start a request of a board, it reaches the server after half a round trip and its upload
+int Fleet::send(int pair, Endpoint endpoint, const std::string &scanID, size_t bytesUp) {
+    Request request;
+    request.pair = pair;
+    request.endpoint = endpoint;
+    request.scanID = scanID;
+    request.sentUs = now_;
+    requests_.push_back(request);
+    int id = (int)requests_.size() - 1;
+    endpoints_[endpoint].requests++;
+    endpoints_[endpoint].bytesUp += bytesUp;
+    schedule(now_ + ms(config_.rttMs / 2) + ms(bytesUp / config_.uplinkKBps / 1024 * 1000), EVENT_ARRIVE, -1, id);
+    return id;
+}
+
+void Fleet::run() {
+    while (!events_.empty() && events_.top().at <= endUs_) {
+        Event event = events_.top();
+        events_.pop();
+        now_ = event.at;
+        switch (event.type) {
+            case EVENT_PRESS: press(event.pair, event.arg != 0); break;
+            case EVENT_CAM_POLL: camPoll(event.pair); break;
+            case EVENT_LAN_ATTEMPT: lanAttempt(event.pair, event.arg); break;
+            case EVENT_LAN_TRIGGER: lanTrigger(event.pair, event.arg); break;
+            case EVENT_LAN_ACK:
+                if (pairs_[event.pair].scan == event.arg && pairs_[event.pair].stage == STAGE_TRIGGER_LAN) {
+                    triggerDone(event.pair);
+                }
+                break;
+            case EVENT_CAPTURED: captured(event.pair); break;
+            case EVENT_EDGE_RESULT: edgeResult(event.pair, event.arg != 0); break;
+            case EVENT_PREDICTION_POLL: predictionPoll(event.pair, event.arg); break;
+            case EVENT_UPLOAD_REPLAY: replay(event.pair); break;
+            case EVENT_TELEMETRY: flushTelemetry(event.pair); break;
+            case EVENT_HEARTBEAT: heartbeat(event.pair); break;
+            case EVENT_ARRIVE: arrive(event.arg); break;
+            case EVENT_HANDLED: handled(event.arg); break;
+            case EVENT_INFERRED: inferred(event.arg); break;
+            case EVENT_WAIT_OVER: waitOver(event.arg); break;
+            case EVENT_REPLY: reply(event.arg); break;
+        }
+    }
+    now_ = endUs_;
+    handlers_.account(now_);
+    inference_.account(now_);
+}
+
+/* camPoll() function
+- The status poll of ESP32-CAM, like taskHTTPGETtrigger(): GET getStatusURL, the next one an interval after this one
+- ESP32-CAM is single-threaded, a poll that comes due during an upload or capture is made once that is over
+*/
+void Fleet::camPoll(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.camBusy) {
+        pair.pollDue = true;
+        return;
+    }
+    pair.pollDue = false;
+    pair.camBusy = true;
+    send(pairIndex, GET_STATUS, "", httpClientHeadBytes("GET", ENDPOINT_PATHS[GET_STATUS], 0));
+    schedule(now_ + ms(pair.lanSeen ? STATUS_POLL_FALLBACK_MS : config_.statusPollMs), EVENT_CAM_POLL, pairIndex, 0);
+}
+
+// camFree() function, to go on with a LAN trigger or a status poll that came while ESP32-CAM was busy
+void Fleet::camFree(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    pair.camBusy = false;
+    if (!pair.triggerID.empty()) {
+        std::string scanID = pair.triggerID;
+        pair.triggerID.clear();
+        if (scanID != pair.capturedID) {
+            capture(pairIndex, scanID);
+            return;
+        }
+    }
+    if (pair.pollDue) {
+        camPoll(pairIndex);
+    }
+}
+
+void Fleet::capture(int pairIndex, const std::string &scanID) {
+    Pair &pair = pairs_[pairIndex];
+    pair.camBusy = true;
+    pair.capturedID = scanID;
+    schedule(now_ + ms(CAPTURE_MS), EVENT_CAPTURED, pairIndex, 0);
+}
+
+// captured() function, to send the edge result over the LAN and upload the image, like the capture of ESP32-CAM
+void Fleet::captured(int pairIndex) {
+    bool confident = std::uniform_real_distribution<double>(0, 1)(random_) < config_.edgeShare;
+    if (lanDelivered()) {
+        schedule(now_ + ms(LAN_MS), EVENT_EDGE_RESULT, pairIndex, confident);
+    }
+    upload(pairIndex, pairs_[pairIndex].capturedID, true);
+}
+
+/* upload() function
+- POST of one image to predictURL, the form and head made by tarsUploadForm() and tarsUploadHead()
+- A live image carries jpeg_quality and the edge result, a stored one sent again does not, like taskUploadImage()
+- The size of the JPEG varies by +-15 % around --image-kb
+*/
+void Fleet::upload(int pairIndex, const std::string &scanID, bool live) {
+    char form[TARS_UPLOAD_FORM_MAX];
+    char head[TARS_UPLOAD_HEAD_MAX];
+    TArSUploadFields fields = {scanID.c_str(), "chute", live ? JPEG_QUALITY : 0,
+                               live ? CLASS_LABELS[pairs_[pairIndex].itemBin] : nullptr, 0.91f};
+    size_t imageSize = (size_t)(config_.imageKB * 1024 * std::uniform_real_distribution<double>(0.85, 1.15)(random_));
+    size_t formLength = tarsUploadForm(form, sizeof(form), fields);
+    size_t footerLength = std::strlen(TARS_UPLOAD_FOOTER);
+    size_t headLength = tarsUploadHead(head, sizeof(head), SERVER_HOST, ENDPOINT_PATHS[PREDICT],
+                                       formLength + imageSize + footerLength);
+    pairs_[pairIndex].camBusy = true;
+    send(pairIndex, PREDICT, scanID, headLength + formLength + imageSize + footerLength);
+}
+
+// replay() function, to send the oldest stored image again, like taskReplayQueue() of ESP32-CAM
+void Fleet::replay(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    pair.replayScheduled = false;
+    if (pair.storedImages.empty()) {
+        return;
+    }
+    if (pair.camBusy) {
+        pair.replayScheduled = true;
+        schedule(now_ + ms(1000), EVENT_UPLOAD_REPLAY, pairIndex, 0);
+        return;
+    }
+    std::string scanID = pair.storedImages.front();
+    pair.storedImages.pop_front();
+    uploadReplays_++;
+    upload(pairIndex, scanID, false);
+}
+
+// lanTrigger() function, ESP32-CAM got the LAN trigger: acknowledge it and capture, once per scan
+void Fleet::lanTrigger(int pairIndex, int scan) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.scan != scan) {
+        return;
+    }
+    pair.lanSeen = true;
+    if (lanDelivered()) {
+        schedule(now_ + ms(LAN_MS), EVENT_LAN_ACK, pairIndex, scan);
+    }
+    if (pair.scanID == pair.capturedID) {
+        return;
+    }
+    if (pair.camBusy) {
+        pair.triggerID = pair.scanID;
+    } else {
+        capture(pairIndex, pair.scanID);
+    }
+}
+
+// press() function, a user at the pair: start a scan, or wait in line while the pair is busy with another
+void Fleet::press(int pairIndex, bool fromLine) {
+    Pair &pair = pairs_[pairIndex];
+    if (!fromLine) {
+        presses_++;
+        schedule(now_ + randomExp(config_.arrivalS * 1000), EVENT_PRESS, pairIndex, 0);
+        if (pair.stage != STAGE_FREE) {
+            pair.waiting++;
+            return;
+        }
+    }
+    startScan(pairIndex);
+}
+
+/* startScan() function
+- The scan of a button press, like taskStartScan() of ESP32-S3, with a scan_id of the same form
+- The LAN trigger first, or addStatus if the LAN trigger is off
+*/
+void Fleet::startScan(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    pair.scan++;
+    pair.scanID = "tars-" + pair.mac + "-" + std::to_string(pair.scan) + "-" + std::to_string(now_ / 1000);
+    pair.itemBin = (int)(random_() % BIN_COUNT);
+    pair.pressedUs = now_;
+    pair.triggerAttempt = 0;
+    pair.edgeConfident = false;
+    if (config_.lanTrigger) {
+        pair.stage = STAGE_TRIGGER_LAN;
+        lanAttempt(pairIndex, pair.scan);
+    } else {
+        char body[TARS_STATUS_BODY_MAX];
+        pair.stage = STAGE_TRIGGER_CLOUD;
+        send(pairIndex, ADD_STATUS, pair.scanID,
+             httpClientHeadBytes("POST", ENDPOINT_PATHS[ADD_STATUS], tarsStatusBody(body, sizeof(body), pair.scanID.c_str())));
+    }
+}
+
+// lanAttempt() function, to send the LAN trigger again until acknowledged, then fall back to addStatus
+void Fleet::lanAttempt(int pairIndex, int scan) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.scan != scan || pair.stage != STAGE_TRIGGER_LAN) {
+        return;
+    }
+    if (pair.triggerAttempt == LOCAL_TRIGGER_ATTEMPTS) {
+        char body[TARS_STATUS_BODY_MAX];
+        lanFallbacks_++;
+        pair.stage = STAGE_TRIGGER_CLOUD;
+        send(pairIndex, ADD_STATUS, pair.scanID,
+             httpClientHeadBytes("POST", ENDPOINT_PATHS[ADD_STATUS], tarsStatusBody(body, sizeof(body), pair.scanID.c_str())));
+        return;
+    }
+    pair.triggerAttempt++;
+    if (lanDelivered()) {
+        schedule(now_ + ms(LAN_MS), EVENT_LAN_TRIGGER, pairIndex, scan);
+    }
+    schedule(now_ + ms(LOCAL_TRIGGER_ACK_TIMEOUT_MS), EVENT_LAN_ATTEMPT, pairIndex, scan);
+}
+
+void Fleet::triggerDone(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    pair.stage = STAGE_PREDICTION_BACKOFF;
+    pair.deadlineUs = now_ + ms(PREDICTION_TIMEOUT_MS);
+    pair.backoffUs = ms(PREDICTION_BACKOFF_MIN_MS);
+    schedule(now_ + pair.backoffUs, EVENT_PREDICTION_POLL, pairIndex, pair.scan);
+}
+
+// edgeResult() function, ESP32-S3 sorts on a confident edge result unless a prediction request is in flight
+void Fleet::edgeResult(int pairIndex, bool confident) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.capturedID != pair.scanID || pair.stage == STAGE_FREE) {
+        return;
+    }
+    pair.edgeConfident = confident;
+    if (confident && pair.stage == STAGE_PREDICTION_BACKOFF) {
+        finishScan(pairIndex, OUTCOME_EDGE);
+    }
+}
+
+// predictionPoll() function, the long-poll of taskHTTPGETprediction(), the URL made by tarsPredictionURL()
+void Fleet::predictionPoll(int pairIndex, int scan) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.scan != scan || pair.stage != STAGE_PREDICTION_BACKOFF) {
+        return;
+    }
+    char url[TARS_URL_MAX];
+    tarsPredictionURL(url, sizeof(url), SERVER_URL "/api/prediction/latest", pair.scanID.c_str(), PREDICTION_LONG_POLL_S);
+    pair.stage = STAGE_PREDICTION;
+    pair.backoffUs = std::min(pair.backoffUs * 2, ms(PREDICTION_BACKOFF_MAX_MS));
+    send(pairIndex, GET_PREDICTION, pair.scanID, httpClientHeadBytes("GET", url + std::strlen(SERVER_URL), 0));
+}
+
+// finishScan() function, to record the scan and drop the item in its bin, the next user in line steps up
+void Fleet::finishScan(int pairIndex, Outcome outcome) {
+    Pair &pair = pairs_[pairIndex];
+    scanMs_[outcome].push_back((now_ - pair.pressedUs) / 1000.0);
+    pair.stage = STAGE_FREE;
+    if (outcome != OUTCOME_FAILED) {
+        int bin = pair.itemBin;
+        pair.fill[bin] += DEPOSIT_PCT;
+        if (pair.fill[bin] >= EMPTY_AT_PCT) {
+            pair.fill[bin] = 0;
+        }
+        if (std::abs(pair.fill[bin] - pair.lastQueued[bin]) >= TELEMETRY_DELTA_PCT) {
+            queueReading(pairIndex, bin, false);
+        }
+    }
+    if (pair.waiting > 0) {
+        pair.waiting--;
+        schedule(now_ + ms(NEXT_USER_MS), EVENT_PRESS, pairIndex, 1);
+    }
+}
+
+// queueReading() function, like taskSampleTelemetry(): the oldest reading is dropped once the buffer is full
+void Fleet::queueReading(int pairIndex, int bin, bool heartbeat) {
+    Pair &pair = pairs_[pairIndex];
+    if ((int)pair.readings.size() == TELEMETRY_BUFFER_SIZE) {
+        if (pair.telemetryInFlight > 0) {
+            readingsDropped_++;
+            return;
+        }
+        pair.readings.pop_front();
+        readingsDropped_++;
+    }
+    pair.readings.push_back(Reading{bin, pair.fill[bin], now_, heartbeat});
+    pair.lastQueued[bin] = pair.fill[bin];
+    pair.lastQueuedUs[bin] = now_;
+    scheduleTelemetry(pairIndex);
+}
+
+// scheduleTelemetry() function, to check for a due batch at the time taskFlushTelemetry() would send it
+void Fleet::scheduleTelemetry(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.telemetryInFlight > 0 || pair.readings.empty()) {
+        return;
+    }
+    Micros dueUs = (int)pair.readings.size() >= TELEMETRY_FLUSH_READINGS
+                       ? now_ : pair.readings.front().measuredUs + ms(TELEMETRY_FLUSH_MS);
+    schedule(std::max(dueUs, pair.telemetryNextUs), EVENT_TELEMETRY, pairIndex, 0);
+}
+
+/* flushTelemetry() function
+- One batch of up to TELEMETRY_BATCH_MAX readings, written with tarsCapacityReading() like taskFlushTelemetry()
+- A batch of heartbeat readings only counts as idle
+*/
+void Fleet::flushTelemetry(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    if (pair.telemetryInFlight > 0 || pair.readings.empty() || now_ < pair.telemetryNextUs) {
+        return;
+    }
+    if ((int)pair.readings.size() < TELEMETRY_FLUSH_READINGS &&
+        now_ - pair.readings.front().measuredUs < ms(TELEMETRY_FLUSH_MS)) {
+        return;
+    }
+    char body[32 + TELEMETRY_BATCH_MAX * TELEMETRY_READING_MAX_LENGTH];
+    size_t length = std::snprintf(body, sizeof(body), TARS_CAPACITY_OPEN);
+    int count = 0;
+    bool idle = true;
+    while (count < (int)pair.readings.size() && count < TELEMETRY_BATCH_MAX) {
+        const Reading &reading = pair.readings[count];
+        size_t written = tarsCapacityReading(body + length, sizeof(body) - length, count == 0, BIN_IDS[reading.bin],
+                                             reading.capacity, (unsigned long)((now_ - reading.measuredUs) / 1000000));
+        if (length + written + 3 > sizeof(body)) {
+            break;
+        }
+        length += written;
+        idle = idle && reading.heartbeat;
+        count++;
+    }
+    length += std::snprintf(body + length, sizeof(body) - length, TARS_CAPACITY_CLOSE);
+    pair.telemetryInFlight = count;
+    int id = send(pairIndex, UPDATE_CAPACITY, "", httpClientHeadBytes("POST", ENDPOINT_PATHS[UPDATE_CAPACITY], length));
+    requests_[id].readings = count;
+    requests_[id].idle = idle;
+}
+
+// heartbeat() function, to queue every bin not queued for TELEMETRY_HEARTBEAT_MS, then wait for the next one due
+void Fleet::heartbeat(int pairIndex) {
+    Pair &pair = pairs_[pairIndex];
+    Micros nextUs = now_ + ms(TELEMETRY_HEARTBEAT_MS);
+    for (int bin = 0; bin < BIN_COUNT; bin++) {
+        if (now_ - pair.lastQueuedUs[bin] >= ms(TELEMETRY_HEARTBEAT_MS)) {
+            queueReading(pairIndex, bin, true);
+        }
+        nextUs = std::min(nextUs, pair.lastQueuedUs[bin] + ms(TELEMETRY_HEARTBEAT_MS));
+    }
+    schedule(nextUs, EVENT_HEARTBEAT, pairIndex, 0);
+}
+
+// reply() function, the reply reached the board that sent the request
+void Fleet::reply(int id) {
+    const Request &request = requests_[id];
+    Pair &pair = pairs_[request.pair];
+    EndpointStats &stats = endpoints_[request.endpoint];
+    stats.latenciesMs.push_back((now_ - request.sentUs) / 1000.0);
+    stats.errors += request.code >= 500;
+    stats.idle += request.idle;
+
+    switch (request.endpoint) {
+        case GET_STATUS:
+            if (request.code == 200 && request.status && !request.scanID.empty() && request.scanID != pair.capturedID) {
+                capture(request.pair, request.scanID);
+            } else {
+                camFree(request.pair);
+            }
+            break;
+        case PREDICT:
+            if (request.code != 201) {
+                pair.storedImages.push_back(request.scanID);
+                if (!pair.replayScheduled) {
+                    pair.replayScheduled = true;
+                    schedule(now_ + ms(QUEUE_BATCH_INTERVAL_MS), EVENT_UPLOAD_REPLAY, request.pair, 0);
+                }
+            }
+            camFree(request.pair);
+            break;
+        case ADD_STATUS:
+            if (pair.scanID != request.scanID || pair.stage != STAGE_TRIGGER_CLOUD) {
+                break;
+            }
+            if (request.code == 201 || request.code == 200) {
+                triggerDone(request.pair);
+            } else {
+                finishScan(request.pair, OUTCOME_FAILED);
+            }
+            break;
+        case GET_PREDICTION:
+            if (pair.scanID != request.scanID || pair.stage != STAGE_PREDICTION) {
+                break;
+            }
+            if (request.code == 200) {
+                finishScan(request.pair, OUTCOME_SERVER);
+            } else if (pair.edgeConfident) {
+                finishScan(request.pair, OUTCOME_EDGE);
+            } else if (now_ >= pair.deadlineUs) {
+                finishScan(request.pair, OUTCOME_FAILED);
+            } else {
+                pair.stage = STAGE_PREDICTION_BACKOFF;
+                schedule(now_ + pair.backoffUs, EVENT_PREDICTION_POLL, request.pair, pair.scan);
+            }
+            break;
+        case UPDATE_CAPACITY:
+            if (request.code == 200 || request.code == 201 || request.code == 400) {
+                pair.readings.erase(pair.readings.begin(), pair.readings.begin() + request.readings);
+                pair.telemetryNextUs = now_;
+            } else {
+                pair.telemetryNextUs = now_ + ms(TELEMETRY_RETRY_MS);
+            }
+            pair.telemetryInFlight = 0;
+            scheduleTelemetry(request.pair);
+            break;
+        case ENDPOINT_COUNT:
+            break;
+    }
+}
+
+void Fleet::arrive(int id) {
+    requests_[id].arrivedUs = now_;
+    if (handlers_.busy < handlers_.size) {
+        startHandler(id);
+        return;
+    }
+    handlers_.queue.push_back(id);
+    handlers_.peakQueue = std::max(handlers_.peakQueue, (int)handlers_.queue.size());
+}
+
+void Fleet::startHandler(int id) {
+    Request &request = requests_[id];
+    handlers_.account(now_);
+    handlers_.busy++;
+    handlers_.waitsMs.push_back((now_ - request.arrivedUs) / 1000.0);
+    request.startedUs = now_;
+    request.holdsHandler = true;
+    schedule(now_ + ms(config_.requestMs), EVENT_HANDLED, -1, id);
+}
+
+void Fleet::releaseHandler(int id) {
+    Request &request = requests_[id];
+    Micros handlerUs = now_ - request.startedUs;
+    endpoints_[request.endpoint].handlerUs += handlerUs;
+    idleHandlerUs_ += request.idle ? handlerUs : 0;
+    request.holdsHandler = false;
+    handlers_.account(now_);
+    handlers_.busy--;
+    if (!handlers_.queue.empty()) {
+        int next = handlers_.queue.front();
+        handlers_.queue.pop_front();
+        startHandler(next);
+    }
+}
+
+ServerScan *Fleet::findScan(Pair &pair, const std::string &scanID) {
+    for (ServerScan &scan : pair.serverScans) {
+        if (scan.scanID == scanID) {
+            return &scan;
+        }
+    }
+    return nullptr;
+}
+
+/* handled() function
+- The endpoints of sim::Server, with the status flag and the predictions of each pair on their own
+    - addStatus: sets the flag of the pair, counted as a collision if the flag of another pair is set,
+      which a server with one global flag (like the original one) would hand to the wrong camera
+    - getStatus: the flag and the scan_id that set it, idle if the flag is not set
+    - predict: clears the flag, the image waits for an inference worker
+    - getPrediction: 200 with the result, 202 while classifying or announced, 404 for an unknown scan,
+      parked until the result is ready or the wait is over
+    - updateCapacity: always taken
+*/
+void Fleet::handled(int id) {
+    Request &request = requests_[id];
+    Pair &pair = pairs_[request.pair];
+    if (std::uniform_real_distribution<double>(0, 1)(random_) < config_.errorRate) {
+        respond(id, 500, "{\"error\":\"internal server error\"}");
+        return;
+    }
+    switch (request.endpoint) {
+        case ADD_STATUS:
+            flagCollisions_ += flagsSet_ > (pair.status ? 1 : 0);
+            flagsSet_ += pair.status ? 0 : 1;
+            pair.status = true;
+            pair.statusScanID = request.scanID;
+            respond(id, 201, "{\"message\":\"status updated\"}");
+            break;
+        case GET_STATUS:
+            request.status = pair.status;
+            request.idle = !pair.status;
+            if (!pair.status) {
+                respond(id, 200, "{\"status\":false}");
+            } else {
+                request.scanID = pair.statusScanID;
+                respond(id, 200, "{\"status\":true,\"scan_id\":\"" + pair.statusScanID + "\"}");
+            }
+            break;
+        case PREDICT: {
+            flagsSet_ -= pair.status ? 1 : 0;
+            pair.status = false;
+            pair.statusScanID.clear();
+            if (findScan(pair, request.scanID) == nullptr) {
+                if (pair.serverScans.size() == 4) {
+                    pair.serverScans.erase(pair.serverScans.begin());
+                }
+                pair.serverScans.push_back(ServerScan{request.scanID, false, {}});
+                if (inference_.busy < inference_.size) {
+                    startInference(id);
+                } else {
+                    inference_.queue.push_back(id);
+                    inference_.peakQueue = std::max(inference_.peakQueue, (int)inference_.queue.size());
+                }
+            }
+            respond(id, 201, "{\"message\":\"image received\",\"scan_id\":\"" + request.scanID + "\"}");
+            break;
+        }
+        case GET_PREDICTION: {
+            ServerScan *scan = findScan(pair, request.scanID);
+            if (scan == nullptr) {
+                bool announced = pair.status && pair.statusScanID == request.scanID;
+                respond(id, announced ? 202 : 404,
+                        announced ? "{\"status\":\"waiting for image\"}" : "{\"error\":\"no prediction yet\"}");
+            } else if (scan->ready) {
+                respondPrediction(id);
+            } else {
+                request.parked = true;
+                scan->held.push_back(id);
+                held_++;
+                peakHeld_ = std::max(peakHeld_, held_);
+                schedule(now_ + ms(PREDICTION_LONG_POLL_S * 1000), EVENT_WAIT_OVER, -1, id);
+                if (!config_.syncLongPoll) {
+                    releaseHandler(id);
+                }
+            }
+            break;
+        }
+        case UPDATE_CAPACITY:
+            respond(id, 201, "{\"message\":\"capacity updated\"}");
+            break;
+        case ENDPOINT_COUNT:
+            break;
+    }
+}
+
+// respond() function, to send the reply of request `id`, it reaches the board half a round trip later
+void Fleet::respond(int id, int code, const std::string &body) {
+    Request &request = requests_[id];
+    request.code = code;
+    endpoints_[request.endpoint].bytesDown += httpReplyBytes(code, body);
+    if (request.holdsHandler) {
+        releaseHandler(id);
+    }
+    schedule(now_ + ms(config_.rttMs / 2), EVENT_REPLY, -1, id);
+}
+
+// respondPrediction() function, to answer getPrediction request `id` with the result of its scan
+void Fleet::respondPrediction(int id) {
+    const Request &request = requests_[id];
+    respond(id, 200, "{\"prediction_id\":\"prediction-" + request.scanID + "\",\"scan_id\":\"" + request.scanID +
+                         "\",\"timestamp\":\"" + std::to_string(now_ / 1000) + "\",\"detected_type\":\"" +
+                         CLASS_LABELS[pairs_[request.pair].itemBin] +
+                         "\",\"confidence\":0.93,\"image_url\":\"https://storage.example/scans/" + request.scanID +
+                         ".jpg\"}");
+}
+
+void Fleet::startInference(int id) {
+    inference_.account(now_);
+    inference_.busy++;
+    inference_.waitsMs.push_back((now_ - requests_[id].startedUs - ms(config_.requestMs)) / 1000.0);
+    double jitter = std::uniform_real_distribution<double>(0.8, 1.2)(random_);
+    schedule(now_ + ms(config_.inferenceMs * jitter), EVENT_INFERRED, -1, id);
+}
+
+// inferred() function, the result of the image of predict request `id` is ready, parked long-polls get it
+void Fleet::inferred(int id) {
+    const Request &request = requests_[id];
+    Pair &pair = pairs_[request.pair];
+    ServerScan *scan = findScan(pair, request.scanID);
+    if (scan != nullptr) {
+        scan->ready = true;
+        std::vector<int> held;
+        held.swap(scan->held);
+        for (int heldID : held) {
+            requests_[heldID].parked = false;
+            held_--;
+            respondPrediction(heldID);
+        }
+    }
+    inference_.account(now_);
+    inference_.busy--;
+    if (!inference_.queue.empty()) {
+        int next = inference_.queue.front();
+        inference_.queue.pop_front();
+        startInference(next);
+    }
+}
+
+void Fleet::waitOver(int id) {
+    Request &request = requests_[id];
+    if (!request.parked) {
+        return;
+    }
+    request.parked = false;
+    held_--;
+    ServerScan *scan = findScan(pairs_[request.pair], request.scanID);
+    if (scan != nullptr) {
+        scan->held.erase(std::remove(scan->held.begin(), scan->held.end(), id), scan->held.end());
+    }
+    respond(id, 202, "{\"status\":\"processing\",\"scan_id\":\"" + request.scanID + "\"}");
+}
+
+void Fleet::report(double hostSeconds) const {
+    double seconds = config_.minutes * 60;
+    size_t scans = 0;
+    std::vector<double> sortedMs;
+    for (int outcome = 0; outcome < OUTCOME_COUNT; outcome++) {
+        scans += scanMs_[outcome].size();
+        if (outcome != OUTCOME_FAILED) {
+            sortedMs.insert(sortedMs.end(), scanMs_[outcome].begin(), scanMs_[outcome].end());
+        }
+    }
+    uint64_t requests = 0;
+    Micros handlerUs = 0;
+    for (const EndpointStats &stats : endpoints_) {
+        requests += stats.requests;
+        handlerUs += stats.handlerUs;
+    }
+    double idleShare = handlerUs > 0 ? (double)idleHandlerUs_ / handlerUs : 0;
+    double handlerBusy = (double)handlers_.busyUs / (handlers_.size * (double)endUs_);
+    double inferenceBusy = (double)inference_.busyUs / (inference_.size * (double)endUs_);
+
+    std::printf("TArS fleet load: %d pairs, %.1f min virtual time, seed %u, a press every %.0f s per pair, "
+                "rtt %.0f ms, %s trigger\n",
+                config_.pairs, config_.minutes, config_.seed, config_.arrivalS, config_.rttMs,
+                config_.lanTrigger ? "LAN" : "cloud");
+    std::printf("server                 : %d handlers x %.1f ms per request%s, %d inference workers x %.0f ms, "
+                "%.0f %% errors injected\n",
+                config_.serverThreads, config_.requestMs, config_.syncLongPoll ? " (long-poll holds one)" : "",
+                config_.inferenceWorkers, config_.inferenceMs, config_.errorRate * 100);
+    std::printf("scans                  : %llu presses, %zu scans, %zu sorted on the edge result, %zu on the server "
+                "result, %zu failed\n",
+                (unsigned long long)presses_, scans, scanMs_[OUTCOME_EDGE].size(), scanMs_[OUTCOME_SERVER].size(),
+                scanMs_[OUTCOME_FAILED].size());
+    std::printf("press-to-class (s)     : all p50 %.2f  p95 %.2f  p99 %.2f  max %.2f, server result p50 %.2f  "
+                "p95 %.2f\n",
+                percentile(sortedMs, 0.5) / 1000, percentile(sortedMs, 0.95) / 1000, percentile(sortedMs, 0.99) / 1000,
+                percentile(sortedMs, 1.0) / 1000, percentile(scanMs_[OUTCOME_SERVER], 0.5) / 1000,
+                percentile(scanMs_[OUTCOME_SERVER], 0.95) / 1000);
+    std::printf("%-16s %9s %8s %7s %8s %8s %8s %8s %8s %9s %9s\n", "endpoint", "requests", "req/s", "errors", "idle",
+                "p50 ms", "p95 ms", "p99 ms", "max ms", "MB up", "MB down");
+    for (int endpoint = 0; endpoint < ENDPOINT_COUNT; endpoint++) {
+        const EndpointStats &stats = endpoints_[endpoint];
+        std::printf("%-16s %9llu %8.2f %7llu %8llu %8.0f %8.0f %8.0f %8.0f %9.2f %9.2f\n", ENDPOINT_NAMES[endpoint],
+                    (unsigned long long)stats.requests, stats.requests / seconds, (unsigned long long)stats.errors,
+                    (unsigned long long)stats.idle, percentile(stats.latenciesMs, 0.5),
+                    percentile(stats.latenciesMs, 0.95), percentile(stats.latenciesMs, 0.99),
+                    percentile(stats.latenciesMs, 1.0), stats.bytesUp / 1e6, stats.bytesDown / 1e6);
+    }
+    std::printf("requests               : %.2f req/s, %.1f per scan\n", requests / seconds,
+                scans > 0 ? (double)requests / scans : 0.0);
+    std::printf("handlers               : %.1f %% busy, %.1f %% of the handler time on idle requests, "
+                "queue wait p99 %.1f ms max %.1f ms (peak %d waiting), long-polls parked peak %d\n",
+                handlerBusy * 100, idleShare * 100, percentile(handlers_.waitsMs, 0.99),
+                percentile(handlers_.waitsMs, 1.0), handlers_.peakQueue, peakHeld_);
+    std::printf("inference              : %.1f %% busy, queue wait p95 %.0f ms max %.0f ms (peak %d waiting)\n",
+                inferenceBusy * 100, percentile(inference_.waitsMs, 0.95), percentile(inference_.waitsMs, 1.0),
+                inference_.peakQueue);
+    std::printf("boards                 : %llu LAN datagrams, %llu cloud fallbacks of the LAN trigger, %llu uploads "
+                "sent again, %llu capacity readings dropped\n",
+                (unsigned long long)lanDatagrams_, (unsigned long long)lanFallbacks_,
+                (unsigned long long)uploadReplays_, (unsigned long long)readingsDropped_);
+    std::printf("status flag            : %llu addStatus requests while the flag of another pair was set "
+                "(taken by the wrong camera with one global flag)\n",
+                (unsigned long long)flagCollisions_);
+    std::printf("host time              : %.2f s (%llu events)\n", hostSeconds, (unsigned long long)eventCount_);
+    std::printf("RESULT req_per_s=%.2f idle_share=%.3f handler_busy=%.3f scan_p95_ms=%.0f predict_p99_ms=%.0f "
+                "prediction_p99_ms=%.0f failed=%zu\n",
+                requests / seconds, idleShare, handlerBusy, percentile(sortedMs, 0.95),
+                percentile(endpoints_[PREDICT].latenciesMs, 0.99),
+                percentile(endpoints_[GET_PREDICTION].latenciesMs, 0.99), scanMs_[OUTCOME_FAILED].size());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Config config;
+    if (!parseArgs(argc, argv, config)) {
+        return 2;
+    }
+    auto hostStart = std::chrono::steady_clock::now();
+    Fleet fleet(config);
+    fleet.run();
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+    fleet.report(hostSeconds);
+    return 0;
+}
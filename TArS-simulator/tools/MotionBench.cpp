@@ -0,0 +1,190 @@
+/* MotionBench
+- Runs the motion trigger of the ESP32-CAM (TArS-common/MotionDetector) on the host
+- Input: binary PGM (P5) frames of one camera stream in the order given, e.g. a video of the chute
+  scaled to QQVGA like the camera streams it:
+      ffmpeg -i chute.mp4 -r 15 -vf scale=160:120,format=gray frame_%04d.pgm
+  or --synthetic N: N items that slide into the chute, rest and are taken out again, rendered like
+  the simulator's camera (hal/sim/Scene.h)
+- The first frame is the background, it must show the empty chute
+- Prints the frames the detector triggers on, then the number of triggers (one per item expected),
+  the time per frame and the frame rate the kernel alone could keep up
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <MotionDetector.h>
+
+#include "Netpbm.h"
+#include "sim/Scene.h"
+
+namespace {
+
+// Frames of one synthetic item, at 15 frames/s like MOTION_FRAME_INTERVAL_MS of the ESP32-CAM
+const int EMPTY_FRAMES = 10;
+const int SLIDE_FRAMES = 9;
+const int REST_FRAMES = 20;
+
+void printUsage() {
+    std::printf(
+        "usage: motion-bench [options] [frame.pgm ...]\n"
+        "  --runs N            passes over all frames, for the timing (default 20)\n"
+        "  --synthetic N       add N rendered items, %d frames each (default 0)\n"
+        "  --odd-items F       fraction of rendered items that look like another class (default 0.05)\n"
+        "  --quiet             print the summary only\n",
+        EMPTY_FRAMES + SLIDE_FRAMES + REST_FRAMES);
+}
+
+struct Frame {
+    std::string name;
+    bool atRest = false;   // rendered frames only: the item is at rest, a trigger is expected in this stretch
+    std::vector<uint32_t> words;   // 4-byte aligned like the frame buffers of the camera driver
+};
+
+bool loadPGM(const std::string &path, int &width, int &height, Frame &frame) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::fprintf(stderr, "%s: can not open\n", path.c_str());
+        return false;
+    }
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int maxValue = 0;
+    bool ok = std::fgetc(file) == 'P' && std::fgetc(file) == '5' && tools::readHeaderNumber(file, frameWidth) &&
+              tools::readHeaderNumber(file, frameHeight) && tools::readHeaderNumber(file, maxValue) && maxValue == 255;
+    if (!ok) {
+        std::fclose(file);
+        std::fprintf(stderr, "%s: not a binary PGM (P5, 8 bit)\n", path.c_str());
+        return false;
+    }
+    if (width != 0 && (frameWidth != width || frameHeight != height)) {
+        std::fclose(file);
+        std::fprintf(stderr, "%s: %dx%d, the frames before are %dx%d\n", path.c_str(), frameWidth, frameHeight,
+                     width, height);
+        return false;
+    }
+    width = frameWidth;
+    height = frameHeight;
+    size_t bytes = (size_t)width * height;
+    frame.words.resize((bytes + 3) / 4);
+    ok = std::fread(frame.words.data(), 1, bytes, file) == bytes;
+    std::fclose(file);
+    if (!ok) {
+        std::fprintf(stderr, "%s: file too short\n", path.c_str());
+        return false;
+    }
+    frame.name = path;
+    return true;
+}
+
+// Frames of one rendered item: empty chute, sliding in, at rest, empty again after it was taken out
+void renderItem(int itemId, double oddRate, int width, int height, uint32_t &frameNumber, std::vector<Frame> &frames) {
+    int itemClass = itemId % 3;
+    for (int i = 0; i < EMPTY_FRAMES + SLIDE_FRAMES + REST_FRAMES; i++) {
+        Frame frame;
+        frame.words.resize((size_t)width * height / 4);
+        int slide = i - EMPTY_FRAMES;
+        double offset = slide < SLIDE_FRAMES ? 1 - (double)slide / SLIDE_FRAMES : 0;
+        sim::renderSceneGray(slide < 0 ? -1 : itemClass, itemId, oddRate, offset * offset, frameNumber++, width,
+                             height, (uint8_t *)frame.words.data());
+        frame.name = "synthetic-" + std::to_string(itemId) + "-" + std::to_string(i);
+        frame.atRest = slide >= SLIDE_FRAMES;
+        frames.push_back(std::move(frame));
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int runs = 20;
+    int synthetic = 0;
+    double oddItemRate = 0.05;
+    bool quiet = false;
+    int width = 0;
+    int height = 0;
+    std::vector<Frame> frames;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--runs" && hasValue) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--synthetic" && hasValue) {
+            synthetic = std::atoi(argv[++i]);
+        } else if (arg == "--odd-items" && hasValue) {
+            oddItemRate = std::atof(argv[++i]);
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg[0] == '-') {
+            printUsage();
+            return 2;
+        } else {
+            Frame frame;
+            if (!loadPGM(arg, width, height, frame)) {
+                return 1;
+            }
+            frames.push_back(std::move(frame));
+        }
+    }
+    if (synthetic > 0) {
+        if (width == 0) {
+            width = 160;
+            height = 120;
+        }
+        uint32_t frameNumber = 0;
+        for (int id = 0; id < synthetic; id++) {
+            renderItem(id, oddItemRate, width, height, frameNumber, frames);
+        }
+        if (frames.front().atRest) {
+            std::fprintf(stderr, "the first frame must show the empty chute\n");
+            return 1;
+        }
+    }
+    if (frames.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    static MotionDetector detector;   // 2 x MOTION_MAX_PIXELS bytes, not on the stack
+    if (!detector.begin(width, height)) {
+        std::fprintf(stderr, "%dx%d: the detector takes up to %d pixels, a multiple of 4\n", width, height,
+                     MOTION_MAX_PIXELS);
+        return 1;
+    }
+    int triggers = 0;
+    int triggersAtRest = 0;
+    for (const Frame &frame : frames) {
+        if (detector.update((const uint8_t *)frame.words.data())) {
+            triggers++;
+            triggersAtRest += frame.atRest;
+            if (!quiet) {
+                std::printf("%-40s trigger, %u pixels differ from the background\n", frame.name.c_str(),
+                            detector.foregroundPixels());
+            }
+        }
+    }
+
+    double totalUs = 0;
+    for (int run = 0; run < runs; run++) {
+        detector.begin(width, height);
+        auto start = std::chrono::steady_clock::now();
+        for (const Frame &frame : frames) {
+            detector.update((const uint8_t *)frame.words.data());
+        }
+        totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+    double frameUs = totalUs / runs / frames.size();
+
+    std::printf("frames                 : %zu of %dx%d, %d rendered items\n", frames.size(), width, height, synthetic);
+    if (synthetic > 0) {
+        std::printf("triggers               : %d, %d of the %d rendered items at rest\n", triggers, triggersAtRest,
+                    synthetic);
+    } else {
+        std::printf("triggers               : %d\n", triggers);
+    }
+    std::printf("update                 : %.1f us per frame on this host, %.0f frames/s\n", frameUs, 1e6 / frameUs);
+    return 0;
+}
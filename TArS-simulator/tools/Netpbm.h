@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdio>
+
+/* Netpbm header reading, shared by the benches in tools/
+- EdgeBench reads binary PPM (P6) images, MotionBench binary PGM (P5) frames, both headers are the magic number,
+  then width, height and maximum value as decimal numbers, separated by whitespace and '#' comments
+*/
+namespace tools {
+
+// readHeaderNumber() function, to read the next number of a PPM or PGM header, comments skipped
+inline bool readHeaderNumber(FILE *file, int &value) {
+    int ch = std::fgetc(file);
+    while (ch == '#' || ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+        if (ch == '#') {
+            while (ch != '\n' && ch != EOF) {
+                ch = std::fgetc(file);
+            }
+        }
+        ch = std::fgetc(file);
+    }
+    value = 0;
+    if (ch < '0' || ch > '9') {
+        return false;
+    }
+    while (ch >= '0' && ch <= '9') {
+        value = value * 10 + (ch - '0');
+        ch = std::fgetc(file);
+    }
+    return true;   // the single whitespace after the number is consumed
+}
+
+}  // namespace tools